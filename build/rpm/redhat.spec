@@ -269,6 +269,7 @@ BuildRequires: systemtap-sdt-devel
 %endif
 %if !%{disable_libuv}
 BuildRequires: libuv-devel >= 1.0
+BuildRequires: snappy-devel protobuf-c-devel >= 1.3.0
 %endif
 %if !%{disable_openssl}
 BuildRequires: openssl-devel >= 1.1.1
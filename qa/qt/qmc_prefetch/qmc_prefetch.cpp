@@ -0,0 +1,184 @@
+//
+// Test QmcPrefetch class
+// Samples fetched ahead on the prefetch thread, from a duplicate of an
+// archive context, must match those fetched directly from the original
+// context, moving forward and backward, along the grid and off it.
+//
+
+#include <QTextStream>
+#include <string.h>
+#include <unistd.h>
+#include <qmc.h>
+#include <qmc_prefetch.h>
+
+QTextStream cerr(stderr);
+QTextStream cout(stdout);
+
+static int	context;
+static QList<pmID> pmids;
+
+static long long
+usec(struct timeval const &tv)
+{
+    return (long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static bool
+sameValues(pmResult *a, pmResult *b)
+{
+    int i, j;
+
+    // interpolated timestamps are not always normalized
+    if (usec(a->timestamp) != usec(b->timestamp) ||
+	a->numpmid != b->numpmid)
+	return false;
+    for (i = 0; i < a->numpmid; i++) {
+	pmValueSet *as = a->vset[i], *bs = b->vset[i];
+	if (as->pmid != bs->pmid || as->numval != bs->numval ||
+	    (as->numval > 0 && as->valfmt != bs->valfmt))
+	    return false;
+	for (j = 0; j < as->numval; j++) {
+	    pmValue *av = &as->vlist[j], *bv = &bs->vlist[j];
+	    if (av->inst != bv->inst)
+		return false;
+	    if (as->valfmt == PM_VAL_INSITU) {
+		if (av->value.lval != bv->value.lval)
+		    return false;
+	    }
+	    else if (av->value.pval->vlen != bv->value.pval->vlen ||
+		     memcmp(av->value.pval, bv->value.pval,
+			    av->value.pval->vlen) != 0)
+		return false;
+	}
+    }
+    return true;
+}
+
+//
+// Seek both contexts, then fetch <count> samples from each and compare.
+// The prefetch thread is given up to 5 seconds for each sample.
+//
+static void
+check(QmcPrefetch &prefetch, const char *title, int mode,
+      struct timeval *when, int interval, int count)
+{
+    pmResult	*direct, *prefetched;
+    int		i, tries, sts, matched = 0, missed = 0, differ = 0;
+
+    if (prefetch.seek(mode, when, interval) == false) {
+	cout << "=== " << title << ": not prefetched" << Qt::endl;
+	return;
+    }
+    pmUseContext(context);
+    if ((sts = pmSetMode(mode, when, interval)) < 0) {
+	cerr << "pmSetMode: " << pmErrStr(sts) << Qt::endl;
+	exit(1);
+    }
+
+    for (i = 0; i < count; i++) {
+	sts = pmFetch(pmids.size(), pmids.toVector().data(), &direct);
+	for (tries = 0; tries < 500; tries++) {
+	    if ((prefetched = prefetch.take(0)) != NULL)
+		break;
+	    if (sts < 0)	// nothing to wait for, the prefetch fails too
+		break;
+	    usleep(10000);
+	}
+	if (sts < 0) {
+	    cout << "sample " << i << ": " << pmErrStr(sts)
+		 << (prefetched ? ", but prefetched" : "") << Qt::endl;
+	}
+	else if (prefetched == NULL)
+	    missed++;
+	else if (sameValues(direct, prefetched))
+	    matched++;
+	else
+	    differ++;
+	if (sts >= 0)
+	    pmFreeResult(direct);
+	if (prefetched)
+	    pmFreeResult(prefetched);
+	prefetch.advance();
+    }
+    cout << "=== " << title << ": " << matched << " matched, " << missed
+	 << " missed, " << differ << " differ" << Qt::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char	*archive = "archives/20041125";
+    const char	*names[] = { "kernel.all.load", "disk.dev.total" };
+    pmID	ids[2];
+    pmLogLabel	label;
+    struct timeval when;
+    int		sts, dup;
+
+    pmSetProgname(argv[0]);
+    if (argc != 1) {
+	cerr << "Usage: " << pmGetProgname() << Qt::endl;
+	exit(1);
+	/*NOTREACHED*/
+    }
+
+    if ((context = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+	cerr << archive << ": " << pmErrStr(context) << Qt::endl;
+	exit(1);
+    }
+    if ((sts = pmLookupName(2, names, ids)) < 0) {
+	cerr << "pmLookupName: " << pmErrStr(sts) << Qt::endl;
+	exit(1);
+    }
+    pmGetArchiveLabel(&label);
+    if ((dup = pmDupContext()) < 0) {
+	cerr << "pmDupContext: " << pmErrStr(dup) << Qt::endl;
+	exit(1);
+    }
+
+    QmcPrefetch prefetch(8);
+    prefetch.addContext(0, dup);
+    pmids.append(ids[0]);
+    pmids.append(ids[1]);
+    prefetch.setPMIDs(0, pmids);
+    prefetch.start();
+
+    when = label.ll_start;
+    when.tv_sec += 10;
+    check(prefetch, "forward", PM_MODE_INTERP | PM_XTB_SET(PM_TIME_SEC),
+	  &when, 60, 20);
+
+    // along the grid, keeping what was already prefetched
+    when.tv_sec += 60 * 24;
+    check(prefetch, "forward skip", PM_MODE_INTERP | PM_XTB_SET(PM_TIME_SEC),
+	  &when, 60, 10);
+
+    // off the grid, in milliseconds
+    when.tv_usec = 500000;
+    check(prefetch, "forward off grid", PM_MODE_INTERP | PM_XTB_SET(PM_TIME_MSEC),
+	  &when, 30500, 10);
+
+    when.tv_sec += 600;
+    when.tv_usec = 0;
+    check(prefetch, "backward", PM_MODE_INTERP | PM_XTB_SET(PM_TIME_SEC),
+	  &when, -45, 12);
+
+    // fewer samples ahead, and fewer metrics
+    prefetch.setSamples(2);
+    pmids.clear();
+    pmids.append(ids[1]);
+    prefetch.setPMIDs(0, pmids);
+    check(prefetch, "smaller window", PM_MODE_INTERP | PM_XTB_SET(PM_TIME_SEC),
+	  &when, 15, 10);
+
+    // running off the end of the archive
+    when = label.ll_start;
+    when.tv_sec += 2820;
+    check(prefetch, "end of archive", PM_MODE_INTERP | PM_XTB_SET(PM_TIME_SEC),
+	  &when, 20, 6);
+
+    check(prefetch, "forward mode", PM_MODE_FORW, &label.ll_start, 0, 5);
+    if (prefetch.take(0) != NULL)
+	cout << "prefetched after a seek in forward mode" << Qt::endl;
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+//
+// Test QmcValueStore class
+// Rows are added at either end of the ring, moved, cleared and
+// resized, and columns are released and reused.
+//
+
+#include <QTextStream>
+#include <qmc.h>
+#include <qmc_store.h>
+
+QTextStream cerr(stderr);
+QTextStream cout(stdout);
+
+static void
+dump(const char *title, QmcValueStore const &store, int a, int b)
+{
+    cout << "=== " << title << ": " << store.count() << " of "
+	 << store.capacity() << " rows" << Qt::endl;
+    for (int row = 0; row < store.count(); row++) {
+	double va = store.value(a, row), vb = store.value(b, row);
+	cout << "row " << row << ": ";
+	if (qIsNaN(va))
+	    cout << "-";
+	else
+	    cout << va;
+	cout << " ";
+	if (qIsNaN(vb))
+	    cout << "-";
+	else
+	    cout << vb;
+	cout << Qt::endl;
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    QmcValueStore	store;
+    int			a, b, c, i;
+
+    pmSetProgname(argv[0]);
+    if (argc != 1) {
+	cerr << "Usage: " << pmGetProgname() << Qt::endl;
+	exit(1);
+	/*NOTREACHED*/
+    }
+
+    if (store.enabled())
+	cout << "store enabled before setCapacity" << Qt::endl;
+    store.push();
+    dump("disabled", store, -1, -1);
+
+    store.setCapacity(4);
+    a = store.addColumn();
+    b = store.addColumn();
+
+    // no value for b in the third row
+    for (i = 1; i <= 6; i++) {
+	store.push(true);
+	store.setValue(a, i);
+	if (i != 3)
+	    store.setValue(b, i * 10);
+    }
+    dump("forward", store, a, b);
+
+    for (i = 100; i <= 101; i++) {
+	store.push(false);
+	store.setValue(a, i);
+	store.setValue(b, i * 10);
+    }
+    dump("backward", store, a, b);
+
+    store.moveRow(0, 3);
+    store.clearRow(1);
+    store.moveRow(2, 7);
+    dump("moved and cleared", store, a, b);
+
+    store.setCapacity(2);
+    dump("shrunk", store, a, b);
+
+    store.setCapacity(5);
+    store.push(true);
+    store.setValue(a, 7);
+    store.setValue(b, 70);
+    dump("grown", store, a, b);
+
+    store.push(false);
+    store.setValue(a, 8);
+    dump("backward not full", store, a, b);
+
+    store.removeColumn(a);
+    store.removeColumn(a);
+    c = store.addColumn();
+    cout << "reused column: " << (c == a ? "yes" : "no") << Qt::endl;
+    dump("new column", store, c, b);
+    c = store.addColumn();
+    cout << "another column: " << (c != a && c != b ? "yes" : "no") << Qt::endl;
+
+    store.clear();
+    dump("cleared", store, a, b);
+
+    return 0;
+}
@@ -0,0 +1,503 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * Exercise the asynchronous PMAPI ... many host contexts, each working
+ * through names, descriptors, instance domains and fetches, driven from
+ * one poll() loop, and checked against the synchronous PMAPI (names,
+ * descriptors, instances and the values fetched, so the metrics named
+ * should have values that do not change).  With -p, each context
+ * pipelines up to that many requests at a time.
+ *
+ * Timings go to stderr, everything else to stdout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <pcp/pmapi.h>
+
+static int	ncontext = 10;
+static int	iter = 10;
+static int	depth = 1;
+static int	nmetric;
+static const char **namelist;
+
+enum { NAMES, DESCS, INDOM, FETCH, DONE };
+
+#define MAXWINDOW	100	/* more than libpcp allows */
+
+typedef struct {
+    int			ctx;
+    int			phase;		/* NAMES, DESCS, ... */
+    int			nsent;		/* requests sent in this phase */
+    int			nrecv;		/* replies received in this phase */
+    int			*tokens;	/* outstanding requests, oldest first */
+    int			ntoken;
+    pmID		*pmids;
+    pmDesc		*descs;
+    int			indom;		/* index of first metric with an indom */
+    int			numinst;
+    int			*instlist;
+    char		**inamelist;
+    pmResult		**results;	/* one per outstanding fetch */
+    pmResult		*result;	/* from the last fetch */
+    int			errors;
+} client_t;
+
+static client_t	*client;
+static int	verbose;
+
+static void
+report(client_t *cp, const char *what, int sts)
+{
+    if (sts < 0) {
+	printf("context %d: %s: %s\n", cp->ctx, what, pmErrStr(sts));
+	cp->errors++;
+    }
+}
+
+/* number of requests in the current phase */
+static int
+phase_size(client_t *cp)
+{
+    switch (cp->phase) {
+	case NAMES:
+	    return 1;
+	case DESCS:
+	    return nmetric;
+	case INDOM:
+	    return cp->indom < nmetric;
+	case FETCH:
+	    return iter;
+    }
+    return 0;
+}
+
+/*
+ * send requests for this client until there are depth outstanding or
+ * the current phase has no more to send (each phase needs the replies
+ * from the one before), return 0 when there is nothing outstanding
+ */
+static int
+request(client_t *cp)
+{
+    int		sts = 0;
+
+    while (cp->ntoken < depth && cp->nsent < phase_size(cp)) {
+	switch (cp->phase) {
+	    case NAMES:
+		sts = pmRequestNames(cp->ctx, nmetric, namelist, cp->pmids);
+		break;
+	    case DESCS:
+		sts = pmRequestDesc(cp->ctx, cp->pmids[cp->nsent],
+				    &cp->descs[cp->nsent]);
+		break;
+	    case INDOM:
+		sts = pmRequestInDom(cp->ctx, cp->descs[cp->indom].indom,
+				    &cp->instlist, &cp->inamelist);
+		break;
+	    case FETCH:
+		sts = pmRequestFetch(cp->ctx, nmetric, cp->pmids,
+				    &cp->results[cp->nsent % depth]);
+		break;
+	}
+	if (sts == PM_ERR_AGAIN && cp->ntoken > 0)
+	    /* window is smaller than depth */
+	    break;
+	if (sts < 0) {
+	    report(cp, "request", sts);
+	    break;
+	}
+	cp->tokens[cp->ntoken++] = sts;
+	cp->nsent++;
+    }
+    return cp->ntoken > 0;
+}
+
+/* reply for the oldest outstanding request is here */
+static int
+receive(client_t *cp)
+{
+    pmResult	*rp;
+    int		token = -1;
+    int		sts;
+    int		i;
+
+    sts = pmReceiveReply(cp->ctx, &token);
+    if (token != cp->tokens[0]) {
+	printf("context %d: token %d expected %d\n", cp->ctx, token, cp->tokens[0]);
+	cp->errors++;
+    }
+    cp->ntoken--;
+    memmove(&cp->tokens[0], &cp->tokens[1], cp->ntoken * sizeof(int));
+    switch (cp->phase) {
+	case NAMES:
+	    if (sts != nmetric)
+		report(cp, "names", sts < 0 ? sts : PM_ERR_NAME);
+	    break;
+	case DESCS:
+	    report(cp, "desc", sts);
+	    break;
+	case INDOM:
+	    report(cp, "indom", sts);
+	    cp->numinst = sts;
+	    break;
+	case FETCH:
+	    report(cp, "fetch", sts);
+	    if (sts >= 0) {
+		rp = cp->results[cp->nrecv % depth];
+		if (cp->nrecv == iter-1)
+		    cp->result = rp;
+		else
+		    pmFreeResult(rp);
+	    }
+	    break;
+    }
+    if (sts < 0)
+	return 0;
+    if (++cp->nrecv == phase_size(cp)) {
+	do {
+	    if (++cp->phase == INDOM) {
+		/* instance domain of the first metric that has one, if any */
+		for (i = 0; i < nmetric; i++) {
+		    if (cp->descs[i].indom != PM_INDOM_NULL)
+			break;
+		}
+		cp->indom = i;
+	    }
+	} while (cp->phase < DONE && phase_size(cp) == 0);
+	cp->nsent = cp->nrecv = 0;
+    }
+    return request(cp);
+}
+
+static int
+same_value(pmValueSet *a, pmValueSet *b, int j)
+{
+    pmValue	*av = &a->vlist[j];
+    pmValue	*bv = &b->vlist[j];
+
+    if (av->inst != bv->inst || a->valfmt != b->valfmt)
+	return 0;
+    if (a->valfmt == PM_VAL_INSITU)
+	return av->value.lval == bv->value.lval;
+    return av->value.pval->vlen == bv->value.pval->vlen &&
+	   memcmp(av->value.pval, bv->value.pval, av->value.pval->vlen) == 0;
+}
+
+/*
+ * same again with the synchronous PMAPI, and compare
+ */
+static void
+check(client_t *cp)
+{
+    pmID	pmid;
+    pmDesc	desc;
+    pmResult	*rp;
+    int		*instlist;
+    char	**inamelist;
+    int		sts;
+    int		i;
+    int		j;
+
+    if ((sts = pmUseContext(cp->ctx)) < 0) {
+	report(cp, "pmUseContext", sts);
+	return;
+    }
+    for (i = 0; i < nmetric; i++) {
+	if ((sts = pmLookupName(1, &namelist[i], &pmid)) < 0)
+	    report(cp, "pmLookupName", sts);
+	else if (pmid != cp->pmids[i]) {
+	    printf("context %d: %s: PMID %s", cp->ctx, namelist[i], pmIDStr(pmid));
+	    printf(" async %s\n", pmIDStr(cp->pmids[i]));
+	    cp->errors++;
+	}
+	if ((sts = pmLookupDesc(cp->pmids[i], &desc)) < 0)
+	    report(cp, "pmLookupDesc", sts);
+	else if (memcmp(&desc, &cp->descs[i], sizeof(desc)) != 0) {
+	    printf("context %d: %s: pmDesc differs\n", cp->ctx, namelist[i]);
+	    cp->errors++;
+	}
+    }
+    for (i = 0; i < nmetric; i++) {
+	if (cp->descs[i].indom == PM_INDOM_NULL)
+	    continue;
+	if ((sts = pmGetInDom(cp->descs[i].indom, &instlist, &inamelist)) < 0)
+	    report(cp, "pmGetInDom", sts);
+	else {
+	    if (sts != cp->numinst) {
+		printf("context %d: %d instances async %d\n", cp->ctx, sts, cp->numinst);
+		cp->errors++;
+	    }
+	    else {
+		for (j = 0; j < sts; j++) {
+		    if (instlist[j] != cp->instlist[j] ||
+			strcmp(inamelist[j], cp->inamelist[j]) != 0) {
+			printf("context %d: instance [%d] differs\n", cp->ctx, j);
+			cp->errors++;
+		    }
+		}
+	    }
+	    free(instlist);
+	    free(inamelist);
+	}
+	break;
+    }
+    for (j = 1; j < iter; j++) {
+	/* same number of fetches as the asynchronous pass */
+	if ((sts = pmFetch(nmetric, cp->pmids, &rp)) < 0)
+	    report(cp, "pmFetch", sts);
+	else
+	    pmFreeResult(rp);
+    }
+    if ((sts = pmFetch(nmetric, cp->pmids, &rp)) < 0)
+	report(cp, "pmFetch", sts);
+    else {
+	for (i = 0; i < nmetric; i++) {
+	    if (rp->vset[i]->pmid != cp->result->vset[i]->pmid ||
+		rp->vset[i]->numval != cp->result->vset[i]->numval) {
+		printf("context %d: %s: numval %d async %d\n", cp->ctx,
+			namelist[i], rp->vset[i]->numval,
+			cp->result->vset[i]->numval);
+		cp->errors++;
+		continue;
+	    }
+	    /* the metrics given are expected to have unchanging values */
+	    for (j = 0; j < rp->vset[i]->numval; j++) {
+		if (!same_value(rp->vset[i], cp->result->vset[i], j)) {
+		    printf("context %d: %s: value [%d] differs\n", cp->ctx,
+			    namelist[i], j);
+		    cp->errors++;
+		}
+	    }
+	}
+	pmFreeResult(rp);
+    }
+}
+
+/*
+ * error cases
+ */
+static void
+errors(const char *archive)
+{
+    client_t	*cp = &client[0];
+    pmResult	*rp;
+    pmResult	*rps[MAXWINDOW];
+    pmID	pmid;
+    int		tokens[MAXWINDOW];
+    int		token;
+    int		ctx;
+    int		sts;
+    int		i;
+    int		n;
+
+    sts = pmReceiveReply(cp->ctx, &token);
+    printf("pmReceiveReply() nothing outstanding: %s\n", pmErrStr(sts));
+    /* fill the window, then the replies come back in order */
+    for (n = 0; n < MAXWINDOW; n++) {
+	if ((sts = pmRequestFetch(cp->ctx, nmetric, cp->pmids, &rps[n])) < 0)
+	    break;
+	tokens[n] = sts;
+    }
+    printf("pmRequestFetch() x %d then: %s\n", n, sts < 0 ? pmErrStr(sts) : "OK");
+    for (i = 0, sts = 0; i < n; i++) {
+	if ((sts = pmReceiveReply(cp->ctx, &token)) < 0)
+	    break;
+	pmFreeResult(rps[i]);
+	if (token != tokens[i]) {
+	    printf("token %d expected %d\n", token, tokens[i]);
+	    cp->errors++;
+	}
+    }
+    printf("pmReceiveReply() x %d: %s\n", i, sts < 0 ? pmErrStr(sts) : "OK");
+    sts = pmRequestFetch(cp->ctx, 0, cp->pmids, &rp);
+    printf("pmRequestFetch() no metrics: %s\n", pmErrStr(sts));
+    sts = pmRequestDesc(-1, cp->pmids[0], &cp->descs[0]);
+    printf("pmRequestDesc() bad context: %s\n", pmErrStr(sts));
+    sts = pmRequestInDom(cp->ctx, PM_INDOM_NULL, &cp->instlist, &cp->inamelist);
+    printf("pmRequestInDom() PM_INDOM_NULL: %s\n", pmErrStr(sts));
+    {
+	const char	*bad = "no.such.metric";
+
+	sts = pmRequestNames(cp->ctx, 1, &bad, &pmid);
+	if (sts >= 0)
+	    sts = pmReceiveReply(cp->ctx, &token);
+	printf("pmRequestNames() %s: %s\n", bad, pmErrStr(sts));
+    }
+    if (archive != NULL) {
+	if ((ctx = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0)
+	    printf("pmNewContext(%s): %s\n", archive, pmErrStr(ctx));
+	else {
+	    sts = pmGetContextFD(ctx);
+	    printf("pmGetContextFD() archive: %s\n", pmErrStr(sts));
+	    sts = pmRequestFetch(ctx, nmetric, cp->pmids, &rp);
+	    printf("pmRequestFetch() archive: %s\n", pmErrStr(sts));
+	    pmDestroyContext(ctx);
+	}
+    }
+    /* outstanding request is discarded with the context */
+    sts = pmRequestFetch(cp->ctx, nmetric, cp->pmids, &rp);
+    printf("pmRequestFetch() then pmDestroyContext(): %s\n",
+	    sts < 0 ? pmErrStr(sts) : "OK");
+}
+
+int
+main(int argc, char **argv)
+{
+    struct pollfd	*pfd;
+    struct timeval	start;
+    struct timeval	end;
+    client_t		*cp;
+    char		*host = "local:";
+    char		*archive = NULL;
+    int			c;
+    int			i;
+    int			sts;
+    int			errflag = 0;
+    int			active;
+    int			nerrors = 0;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "a:c:D:h:i:p:v")) != EOF) {
+	switch (c) {
+
+	case 'a':	/* archive for error cases */
+	    archive = optarg;
+	    break;
+
+	case 'c':	/* number of contexts */
+	    ncontext = atoi(optarg);
+	    break;
+
+	case 'D':	/* debug options */
+	    if ((sts = pmSetDebug(optarg)) < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 'h':	/* pmcd host */
+	    host = optarg;
+	    break;
+
+	case 'i':	/* fetches per context */
+	    iter = atoi(optarg);
+	    break;
+
+	case 'p':	/* requests outstanding per context */
+	    depth = atoi(optarg);
+	    break;
+
+	case 'v':	/* report values for the first context */
+	    verbose++;
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind == argc || ncontext < 1 || iter < 1 ||
+	depth < 1 || depth > MAXWINDOW) {
+	fprintf(stderr, "Usage: %s [-a archive] [-c contexts] [-D debug] [-h host] [-i iterations] [-p depth] [-v] metric ...\n", pmGetProgname());
+	exit(1);
+    }
+    nmetric = argc - optind;
+    namelist = (const char **)&argv[optind];
+
+    client = (client_t *)calloc(ncontext, sizeof(client_t));
+    pfd = (struct pollfd *)calloc(ncontext, sizeof(struct pollfd));
+    if (client == NULL || pfd == NULL) {
+	fprintf(stderr, "calloc failed\n");
+	exit(1);
+    }
+    for (i = 0; i < ncontext; i++) {
+	cp = &client[i];
+	if ((cp->ctx = pmNewContext(PM_CONTEXT_HOST, host)) < 0) {
+	    fprintf(stderr, "pmNewContext(%s) #%d: %s\n", host, i, pmErrStr(cp->ctx));
+	    exit(1);
+	}
+	cp->pmids = (pmID *)calloc(nmetric, sizeof(pmID));
+	cp->descs = (pmDesc *)calloc(nmetric, sizeof(pmDesc));
+	cp->tokens = (int *)calloc(depth, sizeof(int));
+	cp->results = (pmResult **)calloc(depth, sizeof(pmResult *));
+	if (cp->pmids == NULL || cp->descs == NULL ||
+	    cp->tokens == NULL || cp->results == NULL) {
+	    fprintf(stderr, "calloc failed\n");
+	    exit(1);
+	}
+	if ((sts = pmGetContextFD(cp->ctx)) < 0) {
+	    fprintf(stderr, "pmGetContextFD(%d): %s\n", cp->ctx, pmErrStr(sts));
+	    exit(1);
+	}
+	pfd[i].fd = sts;
+	pfd[i].events = POLLIN;
+    }
+    printf("%d contexts, %d metrics, %d fetches\n", ncontext, nmetric, iter);
+
+    pmtimevalNow(&start);
+    active = 0;
+    for (i = 0; i < ncontext; i++) {
+	if (request(&client[i]))
+	    active++;
+	else
+	    pfd[i].fd = -1;
+    }
+    while (active > 0) {
+	if ((sts = poll(pfd, ncontext, 10000)) <= 0) {
+	    fprintf(stderr, "poll: %s\n", sts < 0 ? pmErrStr(-oserror()) : "timeout");
+	    exit(1);
+	}
+	for (i = 0; i < ncontext; i++) {
+	    if (pfd[i].fd < 0 || (pfd[i].revents & (POLLIN|POLLHUP|POLLERR)) == 0)
+		continue;
+	    if (!receive(&client[i])) {
+		pfd[i].fd = -1;
+		active--;
+	    }
+	}
+    }
+    pmtimevalNow(&end);
+    fprintf(stderr, "async: %d contexts depth %d %.3f sec\n", ncontext, depth, pmtimevalSub(&end, &start));
+
+    if (verbose) {
+	cp = &client[0];
+	for (i = 0; i < nmetric; i++) {
+	    printf("%s: PMID %s", namelist[i], pmIDStr(cp->pmids[i]));
+	    printf(" type %s", pmTypeStr(cp->descs[i].type));
+	    printf(" indom %s", pmInDomStr(cp->descs[i].indom));
+	    printf(" numval %d\n", cp->result->vset[i]->numval);
+	}
+	for (i = 0; i < cp->numinst; i++)
+	    printf("  inst [%d or \"%s\"]\n", cp->instlist[i], cp->inamelist[i]);
+    }
+
+    pmtimevalNow(&start);
+    for (i = 0; i < ncontext; i++)
+	check(&client[i]);
+    pmtimevalNow(&end);
+    fprintf(stderr, "sync: %d contexts %.3f sec\n", ncontext, pmtimevalSub(&end, &start));
+
+    errors(archive);
+
+    for (i = 0; i < ncontext; i++) {
+	cp = &client[i];
+	nerrors += cp->errors;
+	if (cp->result != NULL)
+	    pmFreeResult(cp->result);
+	if (cp->numinst > 0) {
+	    free(cp->instlist);
+	    free(cp->inamelist);
+	}
+	pmDestroyContext(cp->ctx);
+    }
+    printf("%d errors\n", nerrors);
+
+    exit(0);
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * PMAPI throughput with many contexts and many threads ... each thread
+ * switches between its own share of the contexts, calling pmUseContext(),
+ * pmLookupDesc() and pmGetContextHostName_r() for each, so nearly all the
+ * time goes on mapping handles to contexts.  Contexts alternate between
+ * two archives from different hosts, so a handle mapped to the wrong
+ * context is seen, and another thread creates and destroys contexts
+ * throughout, reusing context slots while the handles are looked up.
+ *
+ * Also check handles are not reused when a context slot is.
+ *
+ * Calls per second go to stderr, everything else to stdout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pcp/pmapi.h>
+#include <pthread.h>
+#include "libpcp.h"
+
+static int	ncontext = 500;
+static int	iter = 100;
+static int	*handle;
+static char	*archive[2];
+static char	host[2][MAXHOSTNAMELEN];
+static pmID	pmid;
+static pmDesc	desc;
+static volatile int	done;
+
+typedef struct {
+    int		first;		/* this thread uses handle[first] ... */
+    int		step;		/* ... handle[first+step] ... */
+    int		calls;
+    int		errors;
+} work_t;
+
+static void *
+func(void *arg)
+{
+    work_t	*wp = (work_t *)arg;
+    pmDesc	mydesc;
+    char	myhost[MAXHOSTNAMELEN];
+    int		i;
+    int		j;
+    int		sts;
+
+    for (i = 0; i < iter; i++) {
+	for (j = wp->first; j < ncontext; j += wp->step) {
+	    wp->calls++;
+	    if ((sts = pmUseContext(handle[j])) < 0) {
+		fprintf(stderr, "pmUseContext(%d): %s\n", handle[j], pmErrStr(sts));
+		wp->errors++;
+		continue;
+	    }
+	    if (pmWhichContext() != handle[j])
+		wp->errors++;
+	    if ((sts = pmLookupDesc(pmid, &mydesc)) < 0) {
+		fprintf(stderr, "pmLookupDesc(%d): %s\n", handle[j], pmErrStr(sts));
+		wp->errors++;
+	    }
+	    else if (mydesc.pmid != desc.pmid || mydesc.type != desc.type)
+		wp->errors++;
+	    if (pmGetContextHostName_r(handle[j], myhost, sizeof(myhost)) == NULL ||
+		strcmp(myhost, host[j % 2]) != 0) {
+		fprintf(stderr, "pmGetContextHostName_r(%d): %s not %s\n",
+			handle[j], myhost, host[j % 2]);
+		wp->errors++;
+	    }
+	}
+    }
+    return NULL;
+}
+
+/*
+ * create and destroy contexts until the workers are done, each new
+ * context likely reusing the slot of the one before
+ */
+static void *
+churn(void *arg)
+{
+    work_t	*wp = (work_t *)arg;
+    pmDesc	mydesc;
+    int		ctx;
+    int		sts;
+
+    while (!done) {
+	wp->calls++;
+	if ((ctx = pmNewContext(PM_CONTEXT_ARCHIVE, archive[1])) < 0) {
+	    fprintf(stderr, "churn: pmNewContext: %s\n", pmErrStr(ctx));
+	    wp->errors++;
+	    continue;
+	}
+	if (pmWhichContext() != ctx)
+	    wp->errors++;
+	if ((sts = pmLookupDesc(pmid, &mydesc)) < 0 || mydesc.pmid != desc.pmid) {
+	    fprintf(stderr, "churn: pmLookupDesc(%d): %s\n", ctx, pmErrStr(sts));
+	    wp->errors++;
+	}
+	if ((sts = pmDestroyContext(ctx)) < 0) {
+	    fprintf(stderr, "churn: pmDestroyContext(%d): %s\n", ctx, pmErrStr(sts));
+	    wp->errors++;
+	}
+	if (pmUseContext(ctx) != PM_ERR_NOCONTEXT)
+	    wp->errors++;
+    }
+    return NULL;
+}
+
+static void
+run(int nthread)
+{
+    pthread_t		*tid;
+    pthread_t		churnid;
+    work_t		*work;
+    work_t		churnwork = { 0 };
+    struct timeval	start;
+    struct timeval	end;
+    double		secs;
+    int			calls = 0;
+    int			errors = 0;
+    int			i;
+    int			sts;
+
+    tid = (pthread_t *)malloc(nthread * sizeof(pthread_t));
+    work = (work_t *)calloc(nthread, sizeof(work_t));
+    if (tid == NULL || work == NULL) {
+	fprintf(stderr, "run: malloc failed\n");
+	exit(1);
+    }
+    done = 0;
+    if ((sts = pthread_create(&churnid, NULL, churn, &churnwork)) != 0) {
+	fprintf(stderr, "pthread_create: %s\n", pmErrStr(-sts));
+	exit(1);
+    }
+    pmtimevalNow(&start);
+    for (i = 0; i < nthread; i++) {
+	work[i].first = i;
+	work[i].step = nthread;
+	if ((sts = pthread_create(&tid[i], NULL, func, &work[i])) != 0) {
+	    fprintf(stderr, "pthread_create: %s\n", pmErrStr(-sts));
+	    exit(1);
+	}
+    }
+    for (i = 0; i < nthread; i++) {
+	pthread_join(tid[i], NULL);
+	calls += work[i].calls;
+	errors += work[i].errors;
+    }
+    pmtimevalNow(&end);
+    done = 1;
+    pthread_join(churnid, NULL);
+    secs = pmtimevalSub(&end, &start);
+    if (secs <= 0)
+	secs = 0.001;
+    printf("%d threads: %d calls, %d errors, %d churn errors\n",
+	    nthread, calls, errors, churnwork.errors);
+    fprintf(stderr, "%d threads %d contexts: %.3f sec %.0f calls/sec, %d churned\n",
+	    nthread, ncontext, secs, calls / secs, churnwork.calls);
+    free(tid);
+    free(work);
+}
+
+int
+main(int argc, char **argv)
+{
+    int		c;
+    int		i;
+    int		sts;
+    int		errflag = 0;
+    int		maxthread = 4;
+    int		nthread;
+    int		old;
+    int		new;
+    char	*name;
+
+    pmSetProgname(argv[0]);
+
+    while ((c = getopt(argc, argv, "c:D:i:t:")) != EOF) {
+	switch (c) {
+
+	case 'c':	/* number of contexts */
+	    ncontext = atoi(optarg);
+	    break;
+
+	case 'D':	/* debug options */
+	    if ((sts = pmSetDebug(optarg)) < 0) {
+		fprintf(stderr, "%s: unrecognized debug options specification (%s)\n",
+		    pmGetProgname(), optarg);
+		errflag++;
+	    }
+	    break;
+
+	case 'i':	/* iterations */
+	    iter = atoi(optarg);
+	    break;
+
+	case 't':	/* up to this many threads */
+	    maxthread = atoi(optarg);
+	    break;
+
+	case '?':
+	default:
+	    errflag++;
+	    break;
+	}
+    }
+
+    if (errflag || optind != argc-3 || ncontext < 2 || iter < 1 || maxthread < 1) {
+	fprintf(stderr, "Usage: %s [-c contexts] [-D debug] [-i iterations] [-t threads] archive1 archive2 metric\n", pmGetProgname());
+	exit(1);
+    }
+    archive[0] = argv[optind];
+    archive[1] = argv[optind+1];
+    name = argv[optind+2];
+
+    if ((handle = (int *)malloc(ncontext * sizeof(int))) == NULL) {
+	fprintf(stderr, "malloc failed\n");
+	exit(1);
+    }
+    for (i = 0; i < ncontext; i++) {
+	if ((handle[i] = pmNewContext(PM_CONTEXT_ARCHIVE, archive[i % 2])) < 0) {
+	    fprintf(stderr, "pmNewContext(%s) #%d: %s\n", archive[i % 2], i, pmErrStr(handle[i]));
+	    exit(1);
+	}
+	if (i < 2)
+	    pmGetContextHostName_r(handle[i], host[i], sizeof(host[i]));
+    }
+    if (strcmp(host[0], host[1]) == 0) {
+	fprintf(stderr, "archives %s and %s both from host %s\n", archive[0], archive[1], host[0]);
+	exit(1);
+    }
+    if ((sts = pmLookupName(1, (const char **)&name, &pmid)) < 0) {
+	fprintf(stderr, "pmLookupName(%s): %s\n", name, pmErrStr(sts));
+	exit(1);
+    }
+    if ((sts = pmLookupDesc(pmid, &desc)) < 0) {
+	fprintf(stderr, "pmLookupDesc(%s): %s\n", name, pmErrStr(sts));
+	exit(1);
+    }
+    printf("%d contexts\n", ncontext);
+
+    for (nthread = 1; nthread <= maxthread; nthread *= 2)
+	run(nthread);
+
+    /*
+     * destroy a context in the middle and create another, which should
+     * get the same slot but not the same handle
+     */
+    old = handle[ncontext/2];
+    if ((sts = pmDestroyContext(old)) < 0) {
+	fprintf(stderr, "pmDestroyContext(%d): %s\n", old, pmErrStr(sts));
+	exit(1);
+    }
+    if ((new = pmNewContext(PM_CONTEXT_ARCHIVE, archive[(ncontext/2) % 2])) < 0) {
+	fprintf(stderr, "pmNewContext(%s): %s\n", archive[(ncontext/2) % 2], pmErrStr(new));
+	exit(1);
+    }
+    printf("new handle is %s\n", new == old ? "the old handle" : "a new handle");
+    sts = pmUseContext(old);
+    printf("pmUseContext(old): %s\n", sts < 0 ? pmErrStr(sts) : "OK");
+    sts = pmDestroyContext(old);
+    printf("pmDestroyContext(old): %s\n", sts < 0 ? pmErrStr(sts) : "OK");
+    sts = pmUseContext(new);
+    printf("pmUseContext(new): %s\n", sts < 0 ? pmErrStr(sts) : "OK");
+    handle[ncontext/2] = new;
+
+    for (i = 0; i < ncontext; i++)
+	pmDestroyContext(handle[i]);
+
+    exit(0);
+}
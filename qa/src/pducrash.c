@@ -602,6 +602,123 @@ decode_descs(const char *name)
     free(descs);
 }
 
+static void
+decode_delta_result(const char *name)
+{
+    __pmResult		*resp;
+    __pmResultDelta	last = { 0 };
+    int			sts;
+    struct delta_result {
+	__pmPDUHdr	hdr;
+	int		serial;
+	int		base;
+	int		length;
+	int		nbytes;
+	unsigned char	data[0];
+    } *delta, *xdelta;
+
+    delta = (struct delta_result *)malloc(sizeof(*delta));
+    xdelta = (struct delta_result *)malloc(sizeof(*delta)+16);
+
+    fprintf(stderr, "[%s] checking all-zeroes structure\n", name);
+    memset(delta, 0, sizeof(*delta));
+    sts = __pmDecodeDeltaResult((__pmPDU *)delta, &last, &resp);
+    fprintf(stderr, "  __pmDecodeDeltaResult: sts = %d (%s)\n", sts, pmErrStr(sts));
+
+    fprintf(stderr, "[%s] checking negative length field\n", name);
+    memset(delta, 0, sizeof(*delta));
+    delta->hdr.len = sizeof(*delta);
+    delta->hdr.type = PDU_DELTA_RESULT;
+    delta->serial = htonl(1);
+    delta->length = htonl(-32);
+    sts = __pmDecodeDeltaResult((__pmPDU *)delta, &last, &resp);
+    fprintf(stderr, "  __pmDecodeDeltaResult: sts = %d (%s)\n", sts, pmErrStr(sts));
+
+    fprintf(stderr, "[%s] checking large nbytes field\n", name);
+    memset(delta, 0, sizeof(*delta));
+    delta->hdr.len = sizeof(*delta);
+    delta->hdr.type = PDU_DELTA_RESULT;
+    delta->serial = htonl(1);
+    delta->length = htonl(32);
+    delta->nbytes = htonl(INT_MAX - 1);
+    sts = __pmDecodeDeltaResult((__pmPDU *)delta, &last, &resp);
+    fprintf(stderr, "  __pmDecodeDeltaResult: sts = %d (%s)\n", sts, pmErrStr(sts));
+
+    fprintf(stderr, "[%s] checking base with no last result\n", name);
+    memset(delta, 0, sizeof(*delta));
+    delta->hdr.len = sizeof(*delta);
+    delta->hdr.type = PDU_DELTA_RESULT;
+    delta->serial = htonl(2);
+    delta->base = htonl(1);
+    delta->length = htonl(32);
+    sts = __pmDecodeDeltaResult((__pmPDU *)delta, &last, &resp);
+    fprintf(stderr, "  __pmDecodeDeltaResult: sts = %d (%s)\n", sts, pmErrStr(sts));
+
+    fprintf(stderr, "[%s] checking runs beyond the result\n", name);
+    memset(xdelta, 0, sizeof(*delta) + 16);
+    xdelta->hdr.len = sizeof(*delta) + 16;
+    xdelta->hdr.type = PDU_DELTA_RESULT;
+    xdelta->serial = htonl(1);
+    xdelta->length = htonl(32);
+    xdelta->nbytes = htonl(3);
+    xdelta->data[0] = 4;	/* skip */
+    xdelta->data[1] = 2;	/* count */
+    xdelta->data[2] = 1;
+    sts = __pmDecodeDeltaResult((__pmPDU *)xdelta, &last, &resp);
+    fprintf(stderr, "  __pmDecodeDeltaResult: sts = %d (%s)\n", sts, pmErrStr(sts));
+
+    fprintf(stderr, "[%s] checking truncated varint\n", name);
+    memset(xdelta, 0, sizeof(*delta) + 16);
+    xdelta->hdr.len = sizeof(*delta) + 16;
+    xdelta->hdr.type = PDU_DELTA_RESULT;
+    xdelta->serial = htonl(1);
+    xdelta->length = htonl(32);
+    xdelta->nbytes = htonl(3);
+    xdelta->data[0] = 0;	/* skip */
+    xdelta->data[1] = 1;	/* count */
+    xdelta->data[2] = 0x80;
+    sts = __pmDecodeDeltaResult((__pmPDU *)xdelta, &last, &resp);
+    fprintf(stderr, "  __pmDecodeDeltaResult: sts = %d (%s)\n", sts, pmErrStr(sts));
+
+    fprintf(stderr, "[%s] checking result with no last result\n", name);
+    memset(xdelta, 0, sizeof(*delta) + 16);
+    xdelta->hdr.len = sizeof(*delta) + 16;
+    xdelta->hdr.type = PDU_DELTA_RESULT;
+    xdelta->serial = htonl(1);
+    xdelta->length = htonl(32);
+    xdelta->nbytes = htonl(3);
+    xdelta->data[0] = 2;	/* skip numpmid, high word of tv_sec */
+    xdelta->data[1] = 1;	/* count */
+    xdelta->data[2] = 20;	/* tv_sec += 10 */
+    sts = __pmDecodeDeltaResult((__pmPDU *)xdelta, &last, &resp);
+    fprintf(stderr, "  __pmDecodeDeltaResult: sts = %d (%s)\n", sts, pmErrStr(sts));
+    if (sts >= 0) {
+	fprintf(stderr, "  numpmid=%d sec=%lld\n", resp->numpmid, (long long)resp->timestamp.sec);
+	__pmFreeResult(resp);
+    }
+
+    fprintf(stderr, "[%s] checking result relative to the last\n", name);
+    xdelta->serial = htonl(2);
+    xdelta->base = htonl(1);
+    xdelta->data[2] = 3;	/* tv_sec -= 2 */
+    sts = __pmDecodeDeltaResult((__pmPDU *)xdelta, &last, &resp);
+    fprintf(stderr, "  __pmDecodeDeltaResult: sts = %d (%s)\n", sts, pmErrStr(sts));
+    if (sts >= 0) {
+	fprintf(stderr, "  numpmid=%d sec=%lld\n", resp->numpmid, (long long)resp->timestamp.sec);
+	__pmFreeResult(resp);
+    }
+
+    fprintf(stderr, "[%s] checking result relative to an older one\n", name);
+    xdelta->serial = htonl(3);
+    xdelta->base = htonl(1);
+    sts = __pmDecodeDeltaResult((__pmPDU *)xdelta, &last, &resp);
+    fprintf(stderr, "  __pmDecodeDeltaResult: sts = %d (%s)\n", sts, pmErrStr(sts));
+
+    __pmResetResultDelta(&last);
+    free(xdelta);
+    free(delta);
+}
+
 static void
 decode_instance_req(const char *name)
 {
@@ -1661,6 +1778,7 @@ struct pdu {
     { "highres_result",	decode_highres_result },
     { "desc_ids",	decode_desc_ids },
     { "descs", 		decode_descs },
+    { "delta_result",	decode_delta_result },
 };
 
 int
@@ -7,7 +7,7 @@
  *	remain fixed across releases, and they may not work, or may
  *	provide different semantics at some point in the future.
  *
- * Copyright (c) 2012-2022 Red Hat.
+ * Copyright (c) 2012-2022,2026 Red Hat.
  * Copyright (c) 2008-2009 Aconex.  All Rights Reserved.
  * Copyright (c) 1995-2002 Silicon Graphics, Inc.  All Rights Reserved.
  *
@@ -206,7 +206,8 @@ PCP_CALL extern int __pmHasPMNSFileChanged(const char *);
 #define PDU_HIGHRES_RESULT	0x7015
 #define PDU_DESC_IDS		0x7016
 #define PDU_DESCS		0x7017
-#define PDU_FINISH		0x7017
+#define PDU_DELTA_RESULT	0x7018
+#define PDU_FINISH		0x7018
 #define PDU_MAX		 	(PDU_FINISH - PDU_START)
 
 typedef __uint32_t	__pmPDU;
@@ -282,6 +283,8 @@ typedef struct {
 #define PDU_FLAG_LABELS		(1U<<9)
 #define PDU_FLAG_HIGHRES	(1U<<10)
 #define PDU_FLAG_DESCS		(1U<<11)
+#define PDU_FLAG_PIPELINE	(1U<<12)	/* replies tagged, see async.c */
+#define PDU_FLAG_DELTA		(1U<<13)	/* results delta-encoded, see p_result.c */
 /* Credential CVERSION PDU elements look like this */
 typedef struct {
 #ifdef HAVE_BITFIELDS_LTOR
@@ -383,6 +386,15 @@ PCP_CALL extern int __pmEncodeHighResResult(const __pmResult *, __pmPDU **);
 PCP_CALL extern int __pmDecodeResult(__pmPDU *, __pmResult **);
 PCP_CALL extern int __pmDecodeHighResResult(__pmPDU *, __pmResult **);
 PCP_CALL extern int __pmDecodeValueSet(__pmPDU *, int, __pmPDU *, char *, int, int, int, pmValueSet **);
+/* last result sent or received for a context, with PDU_FLAG_DELTA */
+typedef struct {
+    int			serial;		/* serial number of the last result */
+    int			len;		/* bytes in pdu, 0 for no result */
+    __pmPDU		*pdu;		/* as for PDU_HIGHRES_RESULT */
+} __pmResultDelta;
+PCP_CALL extern int __pmSendDeltaResult(int, int, const __pmResult *, __pmResultDelta *);
+PCP_CALL extern int __pmDecodeDeltaResult(__pmPDU *, __pmResultDelta *, __pmResult **);
+PCP_CALL extern void __pmResetResultDelta(__pmResultDelta *);
 PCP_CALL extern int __pmSendProfile(int, int, int, pmProfile *);
 PCP_CALL extern int __pmDecodeProfile(__pmPDU *, int *, pmProfile **);
 PCP_CALL extern int __pmSendFetchPDU(int, int, int, int, pmID *, int);
@@ -587,8 +599,14 @@ typedef struct __pm_fops {
     void	(*__pmclearerr)(__pmFILE *);
     int         (*__pmsetvbuf)(__pmFILE *, char *, int, size_t);
     int		(*__pmclose)(__pmFILE *);
+    int		(*__pmadvise)(__pmFILE *, int);		/* optional */
 } __pm_fops;
 
+/* access pattern hints for __pmFadvise() */
+#define PM_FADV_NORMAL		0
+#define PM_FADV_SEQUENTIAL	1
+#define PM_FADV_RANDOM		2
+
 /* Provide a stdio-like API for __pmFILE */
 PCP_CALL extern int __pmAccess(const char *, int);
 PCP_CALL extern __pmFILE *__pmFopen(const char *, const char *);
@@ -609,6 +627,7 @@ PCP_CALL extern int __pmFeof(__pmFILE *);
 PCP_CALL extern int __pmFerror(__pmFILE *);
 PCP_CALL extern void __pmClearerr(__pmFILE *);
 PCP_CALL extern int __pmSetvbuf(__pmFILE *, char *, int, size_t);
+PCP_CALL extern int __pmFadvise(__pmFILE *, int);
 PCP_CALL extern int __pmFclose(__pmFILE *);
 
 PCP_CALL extern int __pmCompressedFileIndex(char *, size_t);
@@ -630,6 +649,8 @@ typedef struct {
     int			pc_timeout;	/* set if connect times out */
     int			pc_tout_sec;	/* timeout for __pmGetPDU */
     time_t		pc_again;	/* time to try again */
+    void		*pc_async;	/* asynchronous requests, see async.c */
+    __pmResultDelta	pc_delta;	/* last result, for PDU_FLAG_DELTA */
 } __pmPMCDCtl;
 PCP_CALL extern int __pmAuxConnectPMCDPort(const char *, int);
 
@@ -815,6 +836,8 @@ typedef struct {
     __pmLogTI	*ti;		/* (when reading) temporal index */
     struct __pmnsTree *pmns;	/* namespace from meta data */
     int		multi;		/* part of a multi-archive context */
+    size_t	bufsize;	/* (when writing) data and meta data buffer */
+				/*                size, 0 for unbuffered */
 } __pmLogCtl;
 
 /* state values */
@@ -927,6 +950,7 @@ PCP_CALL extern size_t __pmLogLabelSize(const __pmLogCtl *);
 PCP_CALL extern int __pmLogChkLabel(__pmArchCtl *, __pmFILE *, __pmLogLabel *, int);
 PCP_CALL extern int __pmLogCreate(const char *, const char *, int, __pmArchCtl *);
 PCP_CALL extern __pmFILE *__pmLogNewFile(const char *, int);
+PCP_CALL extern __pmFILE *__pmLogNewFileBuf(const char *, int, size_t);
 PCP_CALL extern void __pmLogClose(__pmArchCtl *);
 PCP_CALL extern int __pmLogPutDesc(__pmArchCtl *, const pmDesc *, int, char **);
 PCP_CALL extern int __pmLogPutInDom(__pmArchCtl *, int, const __pmLogInDom * const);
@@ -993,6 +1017,7 @@ PCP_CALL extern int __pmFetchLocal(__pmContext *, int, pmID *, __pmResult **);
 PCP_CALL extern int __pmFetchHighResLocal(__pmContext *, int, pmID *, __pmResult **);
 PCP_CALL extern int __pmDecodeResult_ctx(__pmContext *, __pmPDU *, __pmResult **);
 PCP_CALL extern int __pmDecodeHighResResult_ctx(__pmContext *, __pmPDU *, __pmResult **);
+PCP_CALL extern int __pmDecodeDeltaResult_ctx(__pmContext *, __pmPDU *, __pmResult **);
 PCP_CALL extern void __pmGetResultSize(int, int, pmValueSet * const *, size_t *, size_t *);
 PCP_CALL extern void __pmSortInstances(__pmResult *);
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2022 Red Hat.
+ * Copyright (c) 2012-2022,2026 Red Hat.
  * Copyright (c) 1997,2004 Silicon Graphics, Inc.  All Rights Reserved.
  *
  * This library is free software; you can redistribute it and/or modify it
@@ -562,6 +562,24 @@ PCP_CALL extern int pmHighResFetch(int, pmID *, pmHighResResult **);
 PCP_CALL extern int pmFetchArchive(pmResult **);
 PCP_CALL extern int pmFetchHighResArchive(pmHighResResult **);
 
+/*
+ * Asynchronous requests for PM_CONTEXT_HOST contexts.  The request is
+ * sent to pmcd for the given context and a token (>= 0) is returned,
+ * then once pmGetContextFD() is ready for reading, pmReceiveReply()
+ * completes the request, filling in the result arguments and returning
+ * what the synchronous variant would have returned.  Result arguments
+ * must remain valid until the reply has been received.  If pmcd allows,
+ * several requests may be outstanding (pipelined) for one context, and
+ * the replies are received in the order the requests were made.
+ */
+PCP_CALL extern int pmRequestNames(int, int, const char **, pmID *);
+PCP_CALL extern int pmRequestDesc(int, pmID, pmDesc *);
+PCP_CALL extern int pmRequestInDom(int, pmInDom, int **, char ***);
+PCP_CALL extern int pmRequestFetch(int, int, pmID *, pmResult **);
+PCP_CALL extern int pmRequestFetchHighRes(int, int, pmID *, pmHighResResult **);
+PCP_CALL extern int pmReceiveReply(int, int *);
+PCP_CALL extern int pmGetContextFD(int);
+
 /*
  * Support for metric values annotated with name:value pairs (labels).
  *
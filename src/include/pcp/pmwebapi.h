@@ -240,6 +240,7 @@ extern int pmDiscoverSetSlots(pmDiscoverModule *, void *);
 extern int pmDiscoverSetEventLoop(pmDiscoverModule *, void *);
 extern int pmDiscoverSetConfiguration(pmDiscoverModule *, struct dict *);
 extern int pmDiscoverSetMetricRegistry(pmDiscoverModule *, struct mmv_registry *);
+extern int pmDiscoverSetSourceMetrics(pmDiscoverModule *, const char *, int);
 extern void pmDiscoverClose(pmDiscoverModule *);
 
 /*
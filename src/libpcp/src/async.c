@@ -0,0 +1,659 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * Asynchronous PMAPI for PM_CONTEXT_HOST contexts.
+ *
+ * pmRequest*() sends the same PDU as the synchronous routine would and
+ * returns without waiting for pmcd.  The request is remembered in the
+ * pc_async field of the context's __pmPMCDCtl, and pmReceiveReply()
+ * reads the reply PDU and decodes it with the same __pmDecode*() and
+ * derived metric routines as the synchronous routines, so one thread
+ * can have requests outstanding for many contexts at once and wait
+ * for any of them with poll() or select() on the pmGetContextFD()
+ * descriptors.
+ *
+ * Each request PDU carries its token in the "from" field of the PDU
+ * header.  If pmcd offers PDU_FLAG_PIPELINE, it tags each reply with
+ * the "from" of the request being answered, and we may send up to
+ * ASYNC_WINDOW requests back to back without waiting for the replies,
+ * matching replies to requests by tag.  pmcd handles the requests from
+ * one client in the order they arrive, so the replies come back in
+ * that order too, but the tags also let us drop a reply that no longer
+ * has a request, e.g. when pmcd rejects the profile sent ahead of a
+ * fetch with an error (tagged for the fetch) and then answers the
+ * fetch as well.  The window bounds what pmcd may have to buffer for
+ * a client that is slow to read replies.
+ *
+ * An older pmcd does not tag replies, so there is at most one request
+ * outstanding for each context in that case.
+ *
+ * Either way, the context must not be used for synchronous PMAPI calls
+ * until the replies for all outstanding requests have been received.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+#include "fault.h"
+
+typedef struct async_req {
+    struct async_req	*next;		/* next oldest outstanding request */
+    int			token;		/* returned to the caller, and tag */
+    int			pdutype;	/* request PDU sent */
+    int			numpmid;
+    /* pmRequestNames */
+    const char		**namelist;
+    pmID		*pmidlist;
+    /* pmRequestDesc */
+    pmID		pmid;
+    pmDesc		*desc;
+    /* pmRequestInDom */
+    int			**instlist;
+    char		***inamelist;
+    /* pmRequestFetch and pmRequestFetchHighRes */
+    int			have_dm;	/* from __pmPrepareFetch */
+    pmID		*dmlist;	/* ditto */
+    int			changed;	/* PMCD state changes before result */
+    pmResult		**result;
+    pmHighResResult	**hresult;
+} async_req_t;
+
+typedef struct {
+    int			last_token;
+    int			count;		/* outstanding requests */
+    async_req_t		*head;		/* oldest outstanding request */
+    async_req_t		*tail;		/* newest outstanding request */
+} async_ctl_t;
+
+/* most requests outstanding for one context when pmcd tags replies */
+#define ASYNC_WINDOW	32
+
+#define is_tagged(fd) \
+	((__pmFeaturesIPC(fd) & PDU_FLAG_PIPELINE) != 0)
+
+static void
+async_free(async_req_t *req)
+{
+    if (req->dmlist != NULL)
+	free(req->dmlist);
+    free(req);
+}
+
+void
+__pmAsyncFree(__pmPMCDCtl *pc)
+{
+    async_ctl_t		*acp = (async_ctl_t *)pc->pc_async;
+    async_req_t		*req;
+
+    if (acp == NULL)
+	return;
+    while ((req = acp->head) != NULL) {
+	acp->head = req->next;
+	async_free(req);
+    }
+    free(acp);
+    pc->pc_async = NULL;
+}
+
+/*
+ * ctx must be a connected PM_CONTEXT_HOST context ... if so, return
+ * the locked context, else NULL with the error in *sts
+ */
+static __pmContext *
+async_context(int ctx, int *sts)
+{
+    __pmContext		*ctxp;
+
+    if ((ctxp = __pmHandleToPtr(ctx)) == NULL) {
+	*sts = PM_ERR_NOCONTEXT;
+	return NULL;
+    }
+    if (ctxp->c_type != PM_CONTEXT_HOST) {
+	PM_UNLOCK(ctxp->c_lock);
+	*sts = PM_ERR_NOTHOST;
+	return NULL;
+    }
+    if (ctxp->c_pmcd->pc_fd < 0) {
+	PM_UNLOCK(ctxp->c_lock);
+	*sts = PM_ERR_NOTCONN;
+	return NULL;
+    }
+    return ctxp;
+}
+
+/*
+ * new request for a locked host context, or NULL with the error in *sts
+ */
+static async_req_t *
+async_request(__pmContext *ctxp, int pdutype, int *sts)
+{
+    __pmPMCDCtl		*pc = ctxp->c_pmcd;
+    async_ctl_t		*acp = (async_ctl_t *)pc->pc_async;
+    async_req_t		*req;
+
+    if (acp == NULL) {
+	if ((acp = (async_ctl_t *)calloc(1, sizeof(*acp))) == NULL) {
+	    *sts = -oserror();
+	    return NULL;
+	}
+	pc->pc_async = (void *)acp;
+    }
+    if (acp->count >= (is_tagged(pc->pc_fd) ? ASYNC_WINDOW : 1)) {
+	/* must receive some replies before sending more requests */
+	*sts = PM_ERR_AGAIN;
+	return NULL;
+    }
+    if ((req = (async_req_t *)calloc(1, sizeof(*req))) == NULL) {
+	*sts = -oserror();
+	return NULL;
+    }
+    /* tokens are positive, so never FROM_ANON */
+    acp->last_token = (acp->last_token + 1) & 0x7fffffff;
+    if (acp->last_token == 0)
+	acp->last_token = 1;
+    req->token = acp->last_token;
+    req->pdutype = pdutype;
+    return req;
+}
+
+/*
+ * request PDU sent with status sts ... the request is outstanding
+ * if that worked, else it is discarded
+ */
+static int
+async_sent(__pmContext *ctxp, async_req_t *req, int sts)
+{
+    async_ctl_t		*acp = (async_ctl_t *)ctxp->c_pmcd->pc_async;
+
+    if (sts < 0) {
+	async_free(req);
+	sts = __pmMapErrno(sts);
+    }
+    else {
+	if (acp->tail != NULL)
+	    acp->tail->next = req;
+	else
+	    acp->head = req;
+	acp->tail = req;
+	acp->count++;
+	sts = req->token;
+    }
+    PM_UNLOCK(ctxp->c_lock);
+    return sts;
+}
+
+/*
+ * outstanding request for the tag of a reply, or NULL if there is none
+ */
+static async_req_t *
+async_match(async_ctl_t *acp, int tag)
+{
+    async_req_t		*req;
+
+    for (req = acp->head; req != NULL; req = req->next) {
+	if (req->token == tag)
+	    break;
+    }
+    return req;
+}
+
+static void
+async_done(async_ctl_t *acp, async_req_t *req)
+{
+    async_req_t		*prev = NULL;
+    async_req_t		*rp;
+
+    for (rp = acp->head; rp != req; rp = rp->next)
+	prev = rp;
+    if (prev == NULL)
+	acp->head = req->next;
+    else
+	prev->next = req->next;
+    if (acp->tail == req)
+	acp->tail = prev;
+    acp->count--;
+    async_free(req);
+}
+
+static void
+trace_return(int sts)
+{
+    fprintf(stderr, ":> returns ");
+    if (sts >= 0)
+	fprintf(stderr, "%d\n", sts);
+    else {
+	char	errmsg[PM_MAXERRMSGLEN];
+	fprintf(stderr, "%s\n", pmErrStr_r(sts, errmsg, sizeof(errmsg)));
+    }
+}
+
+int
+pmRequestNames(int ctx, int numpmid, const char **namelist, pmID *pmidlist)
+{
+    __pmContext		*ctxp;
+    async_req_t		*req;
+    size_t		length;
+    int			i;
+    int			sts;
+
+    if (pmDebugOptions.pmapi)
+	fprintf(stderr, "pmRequestNames(%d, %d, name[0] %s, ...) <:",
+		ctx, numpmid, numpmid > 0 ? namelist[0] : "");
+
+    if (numpmid < 1) {
+	sts = PM_ERR_TOOSMALL;
+	goto pmapi_return;
+    }
+    /*
+     * one PDU round-trip only, so the names must fit in one PDU
+     * ... see pmLookupName_ctx() for the pmcd limit
+     */
+    length = sizeof(__pmPDUHdr) + 3*sizeof(int);
+    for (i = 0; i < numpmid; i++)
+	length += sizeof(int) + PM_PDU_SIZE_BYTES(strlen(namelist[i]));
+    if (length > 63*1024) {
+	sts = PM_ERR_TOOBIG;
+	goto pmapi_return;
+    }
+    if ((ctxp = async_context(ctx, &sts)) == NULL)
+	goto pmapi_return;
+    if ((req = async_request(ctxp, PDU_PMNS_NAMES, &sts)) == NULL) {
+	PM_UNLOCK(ctxp->c_lock);
+	goto pmapi_return;
+    }
+    req->numpmid = numpmid;
+    req->namelist = namelist;
+    req->pmidlist = pmidlist;
+    memset(pmidlist, PM_ID_NULL, numpmid * sizeof(pmID));
+
+    sts = __pmSendNameList(ctxp->c_pmcd->pc_fd, req->token,
+			    numpmid, namelist, NULL);
+    sts = async_sent(ctxp, req, sts);
+
+pmapi_return:
+    if (pmDebugOptions.pmapi)
+	trace_return(sts);
+    return sts;
+}
+
+int
+pmRequestDesc(int ctx, pmID pmid, pmDesc *desc)
+{
+    __pmContext		*ctxp;
+    async_req_t		*req;
+    int			sts;
+
+    if (pmDebugOptions.pmapi) {
+	char    dbgbuf[20];
+	fprintf(stderr, "pmRequestDesc(%d, %s, ...) <:",
+		ctx, pmIDStr_r(pmid, dbgbuf, sizeof(dbgbuf)));
+    }
+
+    if ((ctxp = async_context(ctx, &sts)) == NULL)
+	goto pmapi_return;
+    if ((req = async_request(ctxp, PDU_DESC_REQ, &sts)) == NULL) {
+	PM_UNLOCK(ctxp->c_lock);
+	goto pmapi_return;
+    }
+    req->pmid = pmid;
+    req->desc = desc;
+
+    sts = __pmSendDescReq(ctxp->c_pmcd->pc_fd, req->token, pmid);
+    sts = async_sent(ctxp, req, sts);
+
+pmapi_return:
+    if (pmDebugOptions.pmapi)
+	trace_return(sts);
+    return sts;
+}
+
+int
+pmRequestInDom(int ctx, pmInDom indom, int **instlist, char ***namelist)
+{
+    __pmContext		*ctxp;
+    async_req_t		*req;
+    int			sts;
+
+    if (pmDebugOptions.pmapi) {
+	char    dbgbuf[20];
+	fprintf(stderr, "pmRequestInDom(%d, %s, ...) <:",
+		ctx, pmInDomStr_r(indom, dbgbuf, sizeof(dbgbuf)));
+    }
+
+    if (indom == PM_INDOM_NULL) {
+	sts = PM_ERR_INDOM;
+	goto pmapi_return;
+    }
+    if ((ctxp = async_context(ctx, &sts)) == NULL)
+	goto pmapi_return;
+    if ((req = async_request(ctxp, PDU_INSTANCE_REQ, &sts)) == NULL) {
+	PM_UNLOCK(ctxp->c_lock);
+	goto pmapi_return;
+    }
+    req->instlist = instlist;
+    req->inamelist = namelist;
+
+    sts = __pmSendInstanceReq(ctxp->c_pmcd->pc_fd, req->token,
+			    indom, PM_IN_NULL, NULL);
+    sts = async_sent(ctxp, req, sts);
+
+pmapi_return:
+    if (pmDebugOptions.pmapi)
+	trace_return(sts);
+    return sts;
+}
+
+static int
+request_fetch(int ctx, int numpmid, pmID *pmidlist,
+		pmResult **result, pmHighResResult **hresult)
+{
+    __pmContext		*ctxp;
+    async_req_t		*req;
+    int			fd;
+    int			pdutype;
+    int			sts;
+
+    if (pmDebugOptions.pmapi) {
+	char    dbgbuf[20];
+	fprintf(stderr, "%s(%d, %d, pmid[0] %s, ...) <:",
+		result ? "pmRequestFetch" : "pmRequestFetchHighRes", ctx,
+		numpmid, numpmid > 0 ?
+		pmIDStr_r(pmidlist[0], dbgbuf, sizeof(dbgbuf)) : "");
+    }
+
+    if (numpmid < 1) {
+	sts = PM_ERR_TOOSMALL;
+	goto pmapi_return;
+    }
+    if ((ctxp = async_context(ctx, &sts)) == NULL)
+	goto pmapi_return;
+    fd = ctxp->c_pmcd->pc_fd;
+    /* use high resolution timestamps whenever pmcd supports them */
+    if ((__pmFeaturesIPC(fd) & PDU_FLAG_HIGHRES))
+	pdutype = PDU_HIGHRES_FETCH;
+    else
+	pdutype = PDU_FETCH;
+    if ((req = async_request(ctxp, pdutype, &sts)) == NULL) {
+	PM_UNLOCK(ctxp->c_lock);
+	goto pmapi_return;
+    }
+    req->result = result;
+    req->hresult = hresult;
+
+    /* for derived metrics, may need to rewrite the pmidlist */
+    req->have_dm = __pmPrepareFetch(ctxp, numpmid, pmidlist, &req->dmlist);
+    if (req->have_dm > numpmid) {
+	numpmid = req->have_dm;
+	pmidlist = req->dmlist;
+    }
+
+    /* profile carries the same tag, so any error from pmcd is for this fetch */
+    if ((sts = __pmUpdateProfile(fd, req->token, ctxp,
+				 ctxp->c_pmcd->pc_tout_sec)) >= 0)
+	sts = __pmSendFetchPDU(fd, req->token, ctxp->c_slot,
+				numpmid, pmidlist, pdutype);
+    sts = async_sent(ctxp, req, sts);
+
+pmapi_return:
+    if (pmDebugOptions.pmapi)
+	trace_return(sts);
+    return sts;
+}
+
+int
+pmRequestFetch(int ctx, int numpmid, pmID *pmidlist, pmResult **result)
+{
+    return request_fetch(ctx, numpmid, pmidlist, result, NULL);
+}
+
+int
+pmRequestFetchHighRes(int ctx, int numpmid, pmID *pmidlist,
+		pmHighResResult **result)
+{
+    return request_fetch(ctx, numpmid, pmidlist, NULL, result);
+}
+
+/*
+ * decode the reply PDU for req, returning what the synchronous
+ * routine would have returned
+ */
+static int
+receive_names(__pmContext *ctxp, async_req_t *req, int sts, __pmPDU *pb)
+{
+    int		op_status;
+    int		nfail = 0;
+    int		lsts;
+    int		i;
+
+    if (sts == PDU_PMNS_IDS) {
+	/* may be an error even though some ids are valid, see pmns.c */
+	sts = __pmDecodeIDList(pb, req->numpmid, req->pmidlist, &op_status);
+	if (sts >= 0) {
+	    sts = op_status;
+	    nfail = req->numpmid - op_status;
+	}
+    }
+    else if (sts == PDU_ERROR)
+	__pmDecodeError(pb, &sts);
+    else
+	sts = PM_ERR_IPC;
+
+    if (sts < 0 || nfail > 0) {
+	/* try derived metrics for any remaining unknown pmids */
+	nfail = 0;
+	for (i = 0; i < req->numpmid; i++) {
+	    if (req->pmidlist[i] == PM_ID_NULL) {
+		lsts = __dmgetpmid(ctxp, PM_NOT_LOCKED, req->namelist[i],
+				    &req->pmidlist[i]);
+		if (lsts < 0)
+		    nfail++;
+	    }
+	}
+	if (nfail == 0)
+	    sts = req->numpmid;
+    }
+    if (sts == 0 && req->numpmid == 1)
+	sts = PM_ERR_NAME;
+    return sts;
+}
+
+static int
+receive_desc(__pmContext *ctxp, async_req_t *req, int sts, __pmPDU *pb)
+{
+    int		sts2;
+
+    if (sts == PDU_DESC)
+	sts = __pmDecodeDesc(pb, req->desc);
+    else if (sts == PDU_ERROR)
+	__pmDecodeError(pb, &sts);
+    else
+	sts = PM_ERR_IPC;
+
+    if (sts == PM_ERR_PMID || sts == PM_ERR_NOAGENT) {
+	/* check for derived metric, as for pmLookupDesc() */
+	sts2 = __dmdesc(ctxp, PM_NOT_LOCKED, req->pmid, req->desc);
+	if (sts2 >= 0 || sts2 == PM_ERR_BADDERIVE)
+	    sts = sts2;
+    }
+    return sts;
+}
+
+static int
+receive_indom(async_req_t *req, int sts, __pmPDU *pb)
+{
+    pmInResult	*inresult;
+
+    if (sts == PDU_INSTANCE) {
+	if ((sts = __pmDecodeInstance(pb, &inresult)) >= 0)
+	    sts = __pmInResultToLists(inresult, req->instlist, req->inamelist);
+    }
+    else if (sts == PDU_ERROR)
+	__pmDecodeError(pb, &sts);
+    else
+	sts = PM_ERR_IPC;
+    return sts;
+}
+
+static int
+receive_fetch(__pmContext *ctxp, async_req_t *req, int sts, __pmPDU *pb,
+		__pmResult **rpp)
+{
+    if (sts == PDU_HIGHRES_RESULT && req->pdutype == PDU_HIGHRES_FETCH)
+	sts = __pmDecodeHighResResult_ctx(ctxp, pb, rpp);
+    else if (sts == PDU_DELTA_RESULT && req->pdutype == PDU_HIGHRES_FETCH)
+	sts = __pmDecodeDeltaResult_ctx(ctxp, pb, rpp);
+    else if (sts == PDU_RESULT && req->pdutype == PDU_FETCH)
+	sts = __pmDecodeResult_ctx(ctxp, pb, rpp);
+    else if (sts == PDU_ERROR)
+	__pmDecodeError(pb, &sts);
+    else
+	sts = PM_ERR_IPC;
+    return sts;
+}
+
+#define is_fetch(req) \
+	((req)->pdutype == PDU_FETCH || (req)->pdutype == PDU_HIGHRES_FETCH)
+
+static void
+finish_fetch(__pmContext *ctxp, async_req_t *req, int sts, __pmResult *rp)
+{
+    __pmTimestamp	stamp;
+
+    /* process derived metrics, if any */
+    if (req->have_dm)
+	__pmFinishResult(ctxp, sts, &rp);
+    if (sts < 0)
+	return;
+
+    stamp = rp->timestamp;	/* struct assignment */
+    if (req->result != NULL) {
+	pmResult	*ans = __pmOffsetResult(rp);
+
+	ans->timestamp.tv_sec = stamp.sec;
+	ans->timestamp.tv_usec = stamp.nsec / 1000;
+	*req->result = ans;
+    }
+    else {
+	pmHighResResult	*ans = __pmOffsetHighResResult(rp);
+
+	ans->timestamp.tv_sec = stamp.sec;
+	ans->timestamp.tv_nsec = stamp.nsec;
+	*req->hresult = ans;
+    }
+}
+
+int
+pmReceiveReply(int ctx, int *token)
+{
+    __pmContext		*ctxp;
+    async_ctl_t		*acp;
+    async_req_t		*req;
+    __pmResult		*rp = NULL;
+    __pmPDU		*pb;
+    int			pinpdu;
+    int			tagged;
+    int			fd;
+    int			sts;
+
+    if (pmDebugOptions.pmapi)
+	fprintf(stderr, "pmReceiveReply(%d, ...) <:", ctx);
+
+    if ((ctxp = async_context(ctx, &sts)) == NULL)
+	goto pmapi_return;
+    acp = (async_ctl_t *)ctxp->c_pmcd->pc_async;
+    if (acp == NULL || acp->head == NULL) {
+	PM_UNLOCK(ctxp->c_lock);
+	sts = -ENOMSG;
+	goto pmapi_return;
+    }
+    fd = ctxp->c_pmcd->pc_fd;
+    tagged = is_tagged(fd);
+
+PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
+    for ( ; ; ) {
+	sts = pinpdu = __pmGetPDU(fd, ANY_SIZE, ctxp->c_pmcd->pc_tout_sec, &pb);
+	if (sts == PM_ERR_TIMEOUT) {
+	    /* still outstanding, caller may try again */
+	    req = NULL;
+	    break;
+	}
+	if (sts <= 0 || !tagged)
+	    req = acp->head;
+	else if ((req = async_match(acp, ((__pmPDUHdr *)pb)->from)) == NULL) {
+	    /* request has gone, e.g. pmcd failed the profile for a fetch */
+	    if (pmDebugOptions.pmapi)
+		fprintf(stderr, "[dropped %s tag %d]",
+			__pmPDUTypeStr(sts), ((__pmPDUHdr *)pb)->from);
+	    if (sts == PDU_DELTA_RESULT &&
+		__pmDecodeDeltaResult_ctx(ctxp, pb, &rp) == 0) {
+		/* the next result may be relative to this one */
+		__pmFreeResult(rp);
+		rp = NULL;
+	    }
+	    __pmUnpinPDUBuf(pb);
+	    continue;
+	}
+	switch (req->pdutype) {
+	    case PDU_PMNS_NAMES:
+		sts = receive_names(ctxp, req, sts, pb);
+		break;
+	    case PDU_DESC_REQ:
+		sts = receive_desc(ctxp, req, sts, pb);
+		break;
+	    case PDU_INSTANCE_REQ:
+		sts = receive_indom(req, sts, pb);
+		break;
+	    default:
+		sts = receive_fetch(ctxp, req, sts, pb, &rp);
+		break;
+	}
+	if (pinpdu > 0)
+	    __pmUnpinPDUBuf(pb);
+	if (sts > 0 && rp == NULL && is_fetch(req)) {
+	    /* PMCD state change protocol, the result follows */
+	    req->changed |= sts;
+	    continue;
+	}
+	break;
+    }
+
+    if (req != NULL) {
+	if (is_fetch(req)) {
+	    if (sts == 0)
+		sts = req->changed;
+	    finish_fetch(ctxp, req, sts, rp);
+	}
+	if (token != NULL)
+	    *token = req->token;
+	async_done(acp, req);
+    }
+    PM_UNLOCK(ctxp->c_lock);
+
+pmapi_return:
+    if (pmDebugOptions.pmapi)
+	trace_return(sts);
+    return sts;
+}
+
+int
+pmGetContextFD(int ctx)
+{
+    __pmContext		*ctxp;
+    int			sts;
+
+    if ((ctxp = async_context(ctx, &sts)) == NULL)
+	return sts;
+    sts = ctxp->c_pmcd->pc_fd;
+    PM_UNLOCK(ctxp->c_lock);
+    return sts;
+}
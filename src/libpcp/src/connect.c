@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2014,2017 Red Hat.
+ * Copyright (c) 2012-2014,2017,2026 Red Hat.
  * Copyright (c) 1995-2002,2004 Silicon Graphics, Inc.  All Rights Reserved.
  * 
  * This library is free software; you can redistribute it and/or modify it
@@ -123,6 +123,22 @@ check_feature_flags(int ctxflags, int features, int local_conn)
 	 */
 	pduflags |= PDU_FLAG_CREDS_REQD;
 
+    if (features & PDU_FLAG_PIPELINE)
+	/*
+	 * Always ask for tagged replies, so that requests can be
+	 * pipelined (see async.c) ... synchronous calls do not care.
+	 */
+	pduflags |= PDU_FLAG_PIPELINE;
+
+    if ((features & PDU_FLAG_DELTA) && !local_conn &&
+	getenv("PCP_NO_DELTA") == NULL)		/* THREADSAFE */
+	/*
+	 * Ask for fetch results relative to the previous one for the
+	 * context, much smaller over a remote link ... locally the
+	 * extra copying is not worth it.
+	 */
+	pduflags |= PDU_FLAG_DELTA;
+
     if ((features & PDU_FLAG_CERT_REQD) && !local_conn) {
 	/*
 	 * This is a mandatory connection feature for remote connections.
@@ -299,6 +315,7 @@ __pmConnectHandshake(int fd, const char *hostname, int ctxflags, __pmHashCtl *at
 	     * completes the TLS handshake in encrypting mode, authentication
 	     * via SASL, and any other requested connection attributes).
 	     */
+	    pduflags &= ~(PDU_FLAG_PIPELINE | PDU_FLAG_DELTA);
 	    if (sts >= 0 && pduflags)
 		sts = attributes_handshake(fd, pduflags, hostname, attrs);
 	}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2018,2020-2022 Red Hat.
+ * Copyright (c) 2012-2018,2020-2022,2026 Red Hat.
  * Copyright (c) 2007-2008 Aconex.  All Rights Reserved.
  * Copyright (c) 1995-2002,2004,2006,2008 Silicon Graphics, Inc.  All Rights Reserved.
  *
@@ -18,10 +18,13 @@
  * curr_handle needs to be thread-private
  * curr_ctx needs to be thread-private
  *
- * contexts[], contexts_map[], contexts_len and last_handle are protected
- * from changes * using the local contexts_lock mutex.
+ * contexts[], contexts_map[], contexts_hash, contexts_len and last_handle
+ * are protected by the local contexts_lock, a read-write lock because
+ * nearly every PMAPI call maps a handle to a context but contexts are
+ * seldom created or destroyed ... the lookups take it for reading, and
+ * only changes to the context table take it for writing.
  *
- * Ditto for back n_backoff, def_backoff[] and backoff[].
+ * Ditto for back n_backoff, def_backoff[] and backoff[] (for writing).
  *
  * The actual contexts (__pmContext) are protected by the c_lock mutex
  * (no longer recursive) which is intialized in pmNewContext()
@@ -45,6 +48,12 @@ static int		last_handle = -1;	/* last returned context handle */
  * __pmContext is found via contexts[j]
  */
 static int		*contexts_map;
+/*
+ * And to find j without a search, contexts_hash maps handle x to j.
+ * Handles are never reused, so if contexts_map[j] is no longer x the
+ * context has been destroyed, even if slot j has been reused since.
+ */
+static __pmHashCtl	contexts_hash;
 
 /*
  * Special sentinals for contexts_map[] ...
@@ -68,9 +77,15 @@ static int		def_backoff[] = {5, 10, 20, 40, 80};
 static int		*backoff;
 
 #ifdef PM_MULTI_THREAD
-static pthread_mutex_t	contexts_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_rwlock_t	contexts_lock = PTHREAD_RWLOCK_INITIALIZER;
+#define CONTEXTS_RDLOCK()	pthread_rwlock_rdlock(&contexts_lock)
+#define CONTEXTS_WRLOCK()	pthread_rwlock_wrlock(&contexts_lock)
+#define CONTEXTS_UNLOCK()	pthread_rwlock_unlock(&contexts_lock)
 #else
 void			*contexts_lock;
+#define CONTEXTS_RDLOCK()	do { } while (0)
+#define CONTEXTS_WRLOCK()	do { } while (0)
+#define CONTEXTS_UNLOCK()	do { } while (0)
 #endif
 
 #if defined(PM_MULTI_THREAD) && defined(PM_MULTI_THREAD_DEBUG)
@@ -86,31 +101,36 @@ __pmIsContextsLock(void *lock)
 
 /*
  * Given a handle above the PMAPI, do the mapping to the index (ctxnum)
- * of the matching contexts[] entry
+ * of the matching contexts[] entry ... called with contexts_lock held
  */
 static int
-map_handle_nolock(int handle)
+map_handle(int handle)
 {
-    int		ctxnum = -1;
-    int		i;
+    __pmHashNode	*hp;
+    int			ctxnum;
 
-    for (i = 0; i < contexts_len; i++) {
-	if (contexts_map[i] == handle && contexts_map[i] >= 0) {
-	    if (contexts[i]->c_type != PM_CONTEXT_INIT) {
-		ctxnum = i;
-		break;
-	    }
-	}
-    }
+    if (handle < 0 ||
+	(hp = __pmHashSearch((unsigned int)handle, &contexts_hash)) == NULL)
+	return -1;
+    ctxnum = (int)(__psint_t)hp->data;
+    if (contexts_map[ctxnum] != handle ||
+	contexts[ctxnum]->c_type == PM_CONTEXT_INIT)
+	return -1;
     return ctxnum;
 }
 
-static int
-map_handle(int handle)
+/*
+ * Change the state of contexts[ctxnum] to MAP_FREE or MAP_TEARDOWN,
+ * so its handle no longer maps to it ... called with contexts_lock
+ * held for writing
+ */
+static void
+unmap_slot(int ctxnum, int state)
 {
-    PM_ASSERT_IS_LOCKED(contexts_lock);
-
-    return map_handle_nolock(handle);
+    if (contexts_map[ctxnum] >= 0)
+	__pmHashDel((unsigned int)contexts_map[ctxnum],
+			(void *)(__psint_t)ctxnum, &contexts_hash);
+    contexts_map[ctxnum] = state;
 }
 
 static void
@@ -119,7 +139,7 @@ waitawhile(__pmPMCDCtl *ctl)
     /*
      * after failure, compute delay before trying again ...
      */
-    PM_LOCK(contexts_lock);
+    CONTEXTS_WRLOCK();
     if (n_backoff == 0) {
 	char	*q;
 	int	bad = 0;
@@ -161,7 +181,7 @@ waitawhile(__pmPMCDCtl *ctl)
 	    n_backoff = 5;
 	    backoff = def_backoff;
 	}
-	PM_UNLOCK(contexts_lock);
+	CONTEXTS_UNLOCK();
 	if (bad) {
 	    pmNotifyErr(LOG_WARNING,
 			 "pmReconnectContext: ignored bad PMCD_RECONNECT_TIMEOUT = '%s'\n",
@@ -171,7 +191,7 @@ waitawhile(__pmPMCDCtl *ctl)
 	    free(q);
     }
     else
-	PM_UNLOCK(contexts_lock);
+	CONTEXTS_UNLOCK();
     if (ctl->pc_timeout == 0)
 	ctl->pc_timeout = 1;
     else if (ctl->pc_timeout < n_backoff)
@@ -185,38 +205,36 @@ waitawhile(__pmPMCDCtl *ctl)
 __pmContext *
 __pmHandleToPtr(int handle)
 {
-    int		i;
+    int		ctxnum;
 
-    PM_LOCK(contexts_lock);
-    for (i = 0; i < contexts_len; i++) {
-	if (contexts_map[i] == handle && contexts_map[i] >= 0) {
-	    if (contexts[i]->c_type > PM_CONTEXT_UNDEF) {
-		__pmContext	*sts = contexts[i];
-		/*
-		 * Important Note:
-		 *   Once c_lock is locked for _any_ context, the caller
-		 *   cannot call into the routines here where contexts_lock
-		 *   is acquired without first releasing the c_lock for all
-		 *   contexts that are locked.
-		 */
-		PM_LOCK(sts->c_lock);
-		/*
-		 * Note:
-		 *   Since we're holding the contexts_lock no
-		 *   pmDestroyContext() for this context can happen between
-		 *   the test above and the lock being granted ... and
-		 *   without a pmContextDestroy() there can be no reuse
-		 *   of the __pmContext struct, so the asserts below are
-		 *   to-be-sure-to-be-sure.
-		 */
-		PM_UNLOCK(contexts_lock);
-		assert(sts->c_handle == handle);
-		assert(sts->c_type > PM_CONTEXT_UNDEF);
-		return sts;
-	    }
-	}
+    CONTEXTS_RDLOCK();
+    if ((ctxnum = map_handle(handle)) >= 0 &&
+	contexts[ctxnum]->c_type > PM_CONTEXT_UNDEF) {
+	__pmContext	*sts = contexts[ctxnum];
+	/*
+	 * Important Note:
+	 *   Once c_lock is locked for _any_ context, the caller
+	 *   cannot call into the routines here where contexts_lock
+	 *   is acquired without first releasing the c_lock for all
+	 *   contexts that are locked.
+	 */
+	PM_LOCK(sts->c_lock);
+	/*
+	 * Note:
+	 *   Since we're holding the contexts_lock (for reading) no
+	 *   pmDestroyContext() for this context can happen between
+	 *   the test above and the lock being granted ... and
+	 *   without a pmContextDestroy() there can be no reuse
+	 *   of the __pmContext struct, so the asserts below are
+	 *   to-be-sure-to-be-sure.  Other threads can still find
+	 *   their contexts while we wait for this one.
+	 */
+	CONTEXTS_UNLOCK();
+	assert(sts->c_handle == handle);
+	assert(sts->c_type > PM_CONTEXT_UNDEF);
+	return sts;
     }
-    PM_UNLOCK(contexts_lock);
+    CONTEXTS_UNLOCK();
     return NULL;
 }
 
@@ -382,14 +400,11 @@ __pmConvertTimeout(int timeo)
 
 #ifdef PM_MULTI_THREAD
 /*
- * Called with contexts_lock mutex held.
+ * Called with contexts_lock held for writing.
  */
 static void
 initcontextlock(pthread_mutex_t *lock)
 {
-
-    PM_ASSERT_IS_LOCKED(contexts_lock);
-
     __pmInitMutex(lock);
 }
 
@@ -536,7 +551,7 @@ __pmFindOrOpenArchive(__pmContext *ctxp, const char *name, int multi_arch)
 	__pmArchCtl	*acp2;
 	__pmLogCtl	*lcp2 = NULL;
 
-	PM_LOCK(contexts_lock);
+	CONTEXTS_RDLOCK();
 	for (i = 0; i < contexts_len; i++) {
 	    if (i == PM_TPD(curr_handle))
 		continue;
@@ -575,7 +590,7 @@ __pmFindOrOpenArchive(__pmContext *ctxp, const char *name, int multi_arch)
 	    ++lcp2->refcnt;
 	    acp->ac_log = lcp2;
 	    PM_UNLOCK(acp2->ac_log->lc_lock);
-	    PM_UNLOCK(contexts_lock);
+	    CONTEXTS_UNLOCK();
 	    /*
 	     * Setup the per-context part of the controls ...
 	     */
@@ -593,7 +608,7 @@ __pmFindOrOpenArchive(__pmContext *ctxp, const char *name, int multi_arch)
 	    }
 	    return 0;
 	}
-	PM_UNLOCK(contexts_lock);
+	CONTEXTS_UNLOCK();
     }
 
     /*
@@ -1062,7 +1077,7 @@ pmNewContext(int type, const char *name)
     old_curr_handle = PM_TPD(curr_handle);
     old_curr_ctxp = PM_TPD(curr_ctxp);
 
-    PM_LOCK(contexts_lock);
+    CONTEXTS_WRLOCK();
     /* See if we can reuse a free context */
     for (i = 0; i < contexts_len; i++) {
 	if (contexts_map[i] == MAP_FREE) {
@@ -1105,6 +1120,7 @@ pmNewContext(int type, const char *name)
     initcontextlock(&new->c_lock);
 
     ctxnum = contexts_len;
+    contexts_map[ctxnum] = MAP_FREE;
     contexts_len++;
 
     /*
@@ -1120,12 +1136,14 @@ INIT_CONTEXT:
     /*
      * Set up the default state
      */
+    if ((sts = __pmHashAdd((unsigned int)(last_handle+1), (void *)(__psint_t)ctxnum, &contexts_hash)) < 0)
+	goto FAILED_LOCKED;
     PM_TPD(curr_ctxp) = new;
     PM_TPD(curr_handle) = new->c_handle = ++last_handle;
     new->c_slot = ctxnum;
     contexts[ctxnum] = &being_initialized;
     contexts_map[ctxnum] = last_handle;
-    PM_UNLOCK(contexts_lock);
+    CONTEXTS_UNLOCK();
     /* c_lock not re-initialized, created once from initcontextlock() above */
     new->c_type = (type & PM_CONTEXT_TYPEMASK);
     new->c_mode = 0;
@@ -1224,11 +1242,11 @@ INIT_CONTEXT:
 	goto pmapi_return;
     }
 
-    /* Take contexts_lock mutex to update contexts[] with this fully operational
-       battle station ^W context. */
-    PM_LOCK(contexts_lock);
+    /* Take contexts_lock for writing to update contexts[] with this fully
+       operational battle station ^W context. */
+    CONTEXTS_WRLOCK();
     contexts[ctxnum] = new;
-    PM_UNLOCK(contexts_lock);
+    CONTEXTS_UNLOCK();
 
     /* return the handle to the new (current) context */
     if (pmDebugOptions.context) {
@@ -1258,7 +1276,7 @@ FAILED:
      * free entry in contexts[] to replace the PM_CONTEXT_INIT
      * stub we left in its place.
     */
-    PM_LOCK(contexts_lock);
+    CONTEXTS_WRLOCK();
 
 FAILED_LOCKED:
     if (new != NULL) {
@@ -1270,14 +1288,14 @@ FAILED_LOCKED:
         /* We could memset-0 the struct, but this is not really
            necessary.  That's the first thing we'll do in INIT_CONTEXT. */
         contexts[ctxnum] = new;
-	contexts_map[ctxnum] = MAP_FREE;
+	unmap_slot(ctxnum, MAP_FREE);
     }
     PM_TPD(curr_handle) = old_curr_handle;
     PM_TPD(curr_ctxp) = old_curr_ctxp;
     if (pmDebugOptions.context)
 	fprintf(stderr, "pmNewContext(%d, %s) -> %d, curr_handle=%d\n",
 	    type, name ? name : "NULL", sts, PM_TPD(curr_handle));
-    PM_UNLOCK(contexts_lock);
+    CONTEXTS_UNLOCK();
 
 pmapi_return:
 
@@ -1305,17 +1323,17 @@ pmReconnectContext(int handle)
     if (pmDebugOptions.pmapi)
 	fprintf(stderr, "pmReconnectContext(%d) <:", handle);
 
-    PM_LOCK(contexts_lock);
+    CONTEXTS_RDLOCK();
     if ((ctxnum = map_handle(handle)) < 0) {
 	if (pmDebugOptions.context)
 	    fprintf(stderr, "pmReconnectContext(%d) -> %d\n", handle, PM_ERR_NOCONTEXT);
-	PM_UNLOCK(contexts_lock);
+	CONTEXTS_UNLOCK();
 	sts = PM_ERR_NOCONTEXT;
 	goto pmapi_return;
     }
 
     ctxp = contexts[ctxnum];
-    PM_UNLOCK(contexts_lock);
+    CONTEXTS_UNLOCK();
     PM_LOCK(ctxp->c_lock);
     ctl = ctxp->c_pmcd;
     if (ctxp->c_type == PM_CONTEXT_HOST) {
@@ -1334,6 +1352,9 @@ pmReconnectContext(int handle)
 	    __pmCloseSocket(ctl->pc_fd);
 	    ctl->pc_fd = -1;
 	}
+	/* any reply for an asynchronous request went with the socket */
+	__pmAsyncFree(ctl);
+	__pmResetResultDelta(&ctl->pc_delta);
 
 	if ((sts = __pmConnectPMCD(ctl->pc_hosts, ctl->pc_nhosts,
 				   ctxp->c_flags, &ctxp->c_attrs)) < 0) {
@@ -1407,17 +1428,17 @@ pmDupContext(void)
 	sts = old;
 	goto done;
     }
-    PM_LOCK(contexts_lock);
+    CONTEXTS_RDLOCK();
     if ((ctxnum = map_handle(old)) < 0) {
 	if (pmDebugOptions.context)
 	    fprintf(stderr, "pmDupContext(%d) -> %d\n", old, PM_ERR_NOCONTEXT);
-	PM_UNLOCK(contexts_lock);
+	CONTEXTS_UNLOCK();
 	sts = PM_ERR_NOCONTEXT;
 	goto pmapi_return;
     }
 
     oldcon = contexts[ctxnum];
-    PM_UNLOCK(contexts_lock);
+    CONTEXTS_UNLOCK();
     oldtype = oldcon->c_type | oldcon->c_flags;
     if (oldcon->c_type == PM_CONTEXT_HOST) {
 	__pmUnparseHostSpec(oldcon->c_pmcd->pc_hosts,
@@ -1433,16 +1454,16 @@ pmDupContext(void)
 	sts = new;
 	goto done;
     }
-    PM_LOCK(contexts_lock);
+    CONTEXTS_RDLOCK();
     if ((ctxnum = map_handle(new)) < 0) {
 	sts = PM_ERR_NOCONTEXT;
-	PM_UNLOCK(contexts_lock);
+	CONTEXTS_UNLOCK();
 	goto done;
     }
     newcon = contexts[ctxnum];
     PM_LOCK(oldcon->c_lock);
     PM_LOCK(newcon->c_lock);
-    PM_UNLOCK(contexts_lock);
+    CONTEXTS_UNLOCK();
     /*
      * cherry-pick the fields of __pmContext that need to be copied
      */
@@ -1580,9 +1601,9 @@ done_locked:
 done:
     /* return an error code, or the handle for the new context */
     if (sts < 0 && new >= 0) {
-	PM_LOCK(contexts_lock);
-	contexts_map[ctxnum] = MAP_FREE;
-	PM_UNLOCK(contexts_lock);
+	CONTEXTS_WRLOCK();
+	unmap_slot(ctxnum, MAP_FREE);
+	CONTEXTS_UNLOCK();
     }
 
     if (pmDebugOptions.context) {
@@ -1618,11 +1639,11 @@ pmUseContext(int handle)
 
     PM_INIT_LOCKS();
 
-    PM_LOCK(contexts_lock);
+    CONTEXTS_RDLOCK();
     if ((ctxnum = map_handle(handle)) < 0) {
 	if (pmDebugOptions.context)
 	    fprintf(stderr, "pmUseContext(%d) -> %d\n", handle, PM_ERR_NOCONTEXT);
-	PM_UNLOCK(contexts_lock);
+	CONTEXTS_UNLOCK();
 	sts = PM_ERR_NOCONTEXT;
 	goto pmapi_return;
     }
@@ -1632,7 +1653,7 @@ pmUseContext(int handle)
     PM_TPD(curr_handle) = handle;
     PM_TPD(curr_ctxp) = contexts[ctxnum];
 
-    PM_UNLOCK(contexts_lock);
+    CONTEXTS_UNLOCK();
 
     sts = 0;
 
@@ -1663,6 +1684,8 @@ __pmPMCDCtlFree(__pmPMCDCtl *cp)
 	__pmCloseSocket(cp->pc_fd);
     }
     __pmFreeHostSpec(cp->pc_hosts, cp->pc_nhosts);
+    __pmAsyncFree(cp);
+    __pmResetResultDelta(&cp->pc_delta);
     free(cp);
 }
 
@@ -1679,19 +1702,19 @@ pmDestroyContext(int handle)
 
     PM_INIT_LOCKS();
 
-    PM_LOCK(contexts_lock);
+    CONTEXTS_WRLOCK();
     if ((ctxnum = map_handle(handle)) < 0) {
 	if (pmDebugOptions.context)
 	fprintf(stderr, "pmDestroyContext(%d) -> %d\n", handle, PM_ERR_NOCONTEXT);
-	PM_UNLOCK(contexts_lock);
+	CONTEXTS_UNLOCK();
 	sts = PM_ERR_NOCONTEXT;
 	goto pmapi_return;
     }
 
     ctxp = contexts[ctxnum];
     PM_LOCK(ctxp->c_lock);
-    contexts_map[ctxnum] = MAP_TEARDOWN;
-    PM_UNLOCK(contexts_lock);
+    unmap_slot(ctxnum, MAP_TEARDOWN);
+    CONTEXTS_UNLOCK();
     if (ctxp->c_pmcd != NULL) {
 	__pmPMCDCtlFree(ctxp->c_pmcd);
 	ctxp->c_pmcd = NULL;
@@ -1728,9 +1751,9 @@ pmDestroyContext(int handle)
 
     PM_UNLOCK(ctxp->c_lock);
 
-    PM_LOCK(contexts_lock);
-    contexts_map[ctxnum] = MAP_FREE;
-    PM_UNLOCK(contexts_lock);
+    CONTEXTS_WRLOCK();
+    unmap_slot(ctxnum, MAP_FREE);
+    CONTEXTS_UNLOCK();
 
     sts = 0;
 
@@ -1756,9 +1779,10 @@ static const char *_mode[] = { "LIVE", "INTERP", "FORW", "BACK" };
  * for all instance domains.
  *
  * Threadsafe Note:
- *	contexts_lock mutex is not acquired here ... need to avoid
- *	nested locking, and this is only a diagnostic routine so
- *	any data race is an acceptable trade-off
+ *	contexts_lock is only held for reading here and the c_lock of
+ *	each context is not acquired ... need to avoid nested locking,
+ *	and this is only a diagnostic routine so any data race is an
+ *	acceptable trade-off
  */
 void
 __pmDumpContext(FILE *f, int context, pmInDom indom)
@@ -1768,8 +1792,11 @@ __pmDumpContext(FILE *f, int context, pmInDom indom)
 
     PM_INIT_LOCKS();
 
+    CONTEXTS_RDLOCK();
+    i = map_handle(PM_TPD(curr_handle));
+    CONTEXTS_UNLOCK();
     fprintf(f, "Dump Contexts: current -> contexts[%d] handle %d\n",
-	map_handle_nolock(PM_TPD(curr_handle)), PM_TPD(curr_handle));
+	i, PM_TPD(curr_handle));
     if (PM_TPD(curr_handle) < 0)
 	return;
 
@@ -1779,7 +1806,7 @@ __pmDumpContext(FILE *f, int context, pmInDom indom)
 	        indom, pmInDomStr_r(indom, strbuf, sizeof(strbuf)));
     }
 
-    PM_LOCK(contexts_lock);
+    CONTEXTS_RDLOCK();
     for (i = 0; i < contexts_len; i++) {
 	con = contexts[i];
 	if (context == -1 || context == i) {
@@ -1849,7 +1876,7 @@ __pmDumpContext(FILE *f, int context, pmInDom indom)
 	}
     }
 
-    PM_UNLOCK(contexts_lock);
+    CONTEXTS_UNLOCK();
 }
 
 #ifdef PM_MULTI_THREAD
@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 2009 Ken McDonell.  All Rights Reserved.
- * Copyright (c) 2022 Red Hat.
+ * Copyright (c) 2022,2026 Red Hat.
  *
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -39,6 +39,8 @@ typedef struct {		/* dynamic information for an expression node */
     int			last_numval;	/* length of last_ivlist[] */
     val_t		*last_ivlist;	/* values from previous fetch for delta() or rate() */
     struct timespec	last_stamp;	/* timestamp from previous fetch for rate() */
+    unsigned int	fetch;		/* last fetch evaluated, delta() and rate() ... */
+    unsigned int	prevfetch;	/* ... and the one before, see memo_t */
 } info_t;
 
 typedef struct {			/* for instance filtering */
@@ -71,6 +73,33 @@ typedef struct node {		/* expression tree node */
     } data;
 } node_t;
 
+/*
+ * Expressions are compiled into a linear program, one OP_EVAL per node
+ * in post-order (operands before operators), with an OP_PROBE ahead of
+ * the operands of any node that may share its value with other nodes
+ * of the same shape in the context (common sub-expressions).
+ */
+#define OP_EVAL		0	/* evaluate np, operands done */
+#define OP_PROBE	1	/* if np's memo slot is set, skip to its OP_EVAL */
+
+typedef struct {		/* one instruction */
+    int		op;		/* OP_EVAL or OP_PROBE */
+    node_t	*np;		/* expression node */
+    int		slot;		/* memo slot for np, -1 if none */
+    int		skip;		/* OP_PROBE, index of np's OP_EVAL */
+    int		parent;		/* OP_EVAL, index of parent's OP_EVAL or -1 */
+    int		vhint;		/* OP_EVAL N_NAME, last index into vset[] */
+} op_t;
+
+typedef struct {		/* shared value for one sub-expression */
+    node_t	*np;		/* first node compiled with this shape */
+    unsigned int sig;		/* hash of the shape */
+    unsigned int fetch;		/* last fetch evaluated ... */
+    node_t	*owner;		/* ... by this node */
+    int		sts;		/* ... with this result */
+    unsigned int prev;		/* delta() or rate(), owner's prevfetch */
+} memo_t;
+
 /* bit-fields for flags below */
 #define DM_BIND		1	/* 0/1 if bind expr() has been called */
 #define DM_GLOBAL	2	/* 0 => per-context, 1 => global */
@@ -85,6 +114,8 @@ typedef struct {		/* one derived metric */
     node_t	*expr;		/* NULL => invalid, e.g. dup or missing operands */
     const char	*oneline;	/* help text for PM_TEXT_ONELINE */
     const char	*helptext;	/* help text for PM_TEXT_HELP */
+    int		nop;		/* length of prog[] */
+    op_t	*prog;		/* expr compiled for fetch, NULL until needed */
 } dm_t;
 
 #define DM_UNLIMITED	-1	/* no limit on the # of derived metrics */
@@ -106,6 +137,18 @@ typedef struct {
     int			glob_last;	/* last global metric added */
     int			fetch_has_dm;	/* ==1 if pmResult rewrite needed */
     int			numpmid;	/* from pmFetch before rewrite */
+    unsigned int	fetchnum;	/* fetches, for memo[] */
+    int			nmemo;		/* # of memo slots */
+    memo_t		*memo;		/* common sub-expressions */
+    __pmHashCtl		memohash;	/* memo[] index by expression shape */
+    int			nhashed;	/* # of mlist[] entries in pmidhash */
+    __pmHashCtl		pmidhash;	/* mlist[] index by pmID */
+    int			pre_numpmid;	/* last pmFetch list ... */
+    pmID		*pre_pmidlist;
+    int			pre_nmetric;	/* ... nmetric then ... */
+    int			pre_has_dm;	/* ... and the __dmprefetch() results */
+    int			pre_newcnt;
+    pmID		*pre_newlist;
 } ctl_t;
 
 /* node_t types */
@@ -161,6 +204,7 @@ extern void __dmclosecontext(__pmContext *) _PCP_HIDDEN;
 extern int __dmdesc(__pmContext *, int, pmID, pmDesc *) _PCP_HIDDEN;
 extern int __dmprefetch(__pmContext *, int, const pmID *, pmID **) _PCP_HIDDEN;
 extern void __dmpostfetch(__pmContext *, __pmResult **) _PCP_HIDDEN;
+extern void __dmfreeprog(ctl_t *) _PCP_HIDDEN;
 extern void __dmdumpexpr(node_t *, int) _PCP_HIDDEN;
 extern char *__dmnode_type_str(int) _PCP_HIDDEN;
 extern int __dmhelptext(pmID, int, char **) _PCP_HIDDEN;
@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 2009,2014 Ken McDonell.  All Rights Reserved.
- * Copyright (c) 2021-2022 Red Hat.
+ * Copyright (c) 2021-2022,2026 Red Hat.
  *
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -27,22 +27,289 @@
 
 extern const int promote[6][6];
 
+/*
+ * Common sub-expressions.
+ *
+ * Nodes that compute the same values from the same operands, within one
+ * derived metric or across all the derived metrics in the context, share
+ * a memo slot.  The first node in a slot to be evaluated for a fetch is
+ * the owner, and the others copy the owner's values rather than
+ * evaluating their operands again.
+ *
+ * Such nodes must be numeric and their values must depend only on the
+ * pmResult for this fetch, so no delta(), rate(), instant() or
+ * matchinst() below them.  The exception is delta() or rate() of such
+ * an expression, where the values also depend on the fetch when the
+ * node was last evaluated ... these nodes share values (and then state)
+ * only if that was the same fetch for both.
+ */
+static int
+pure_expr(node_t *np)
+{
+    if (np == NULL)
+	return 1;
+    switch (np->type) {
+	case N_DELTA:
+	case N_RATE:
+	case N_INSTANT:
+	case N_FILTERINST:
+	case N_PATTERN:
+	    return 0;
+    }
+    return pure_expr(np->left) && pure_expr(np->right);
+}
+
+static int
+shared_expr(node_t *np)
+{
+    switch (np->desc.type) {
+	case PM_TYPE_32:
+	case PM_TYPE_U32:
+	case PM_TYPE_64:
+	case PM_TYPE_U64:
+	case PM_TYPE_FLOAT:
+	case PM_TYPE_DOUBLE:
+	    break;
+	default:
+	    return 0;
+    }
+    switch (np->type) {
+	case N_INTEGER:
+	case N_DOUBLE:
+	case N_DEFINED:
+	case N_ANON:
+	case N_SCALE:
+	case N_COLON:
+	case N_INSTANT:
+	case N_FILTERINST:
+	case N_PATTERN:
+	    /* nothing worth saving, or not safe to share */
+	    return 0;
+	case N_DELTA:
+	case N_RATE:
+	    return pure_expr(np->left);
+    }
+    return pure_expr(np);
+}
+
+/* hash of the shape of an expression */
+static unsigned int
+expr_sig(node_t *np)
+{
+    unsigned int	sig;
+    const char		*p;
+
+    if (np == NULL)
+	return 0;
+    sig = np->type * 31 + np->desc.type;
+    sig = sig * 31 + np->desc.indom;
+    if (np->type == N_NAME)
+	sig = sig * 31 + np->data.info->pmid;
+    else if ((np->type == N_INTEGER || np->type == N_DOUBLE) && np->value != NULL) {
+	for (p = np->value; *p; p++)
+	    sig = sig * 31 + *p;
+    }
+    sig = sig * 31 + expr_sig(np->left);
+    sig = sig * 31 + expr_sig(np->right);
+    return sig;
+}
+
+/* do two expressions compute the same values? */
+static int
+same_expr(node_t *a, node_t *b)
+{
+    if (a == NULL || b == NULL)
+	return a == b;
+    if (a->type != b->type || a->desc.type != b->desc.type ||
+	a->desc.indom != b->desc.indom ||
+	memcmp(&a->desc.units, &b->desc.units, sizeof(pmUnits)) != 0)
+	return 0;
+    if (a->type == N_PATTERN)
+	return 0;
+    if (a->data.info != NULL && b->data.info != NULL) {
+	if (a->data.info->mul_scale != b->data.info->mul_scale ||
+	    a->data.info->div_scale != b->data.info->div_scale)
+	    return 0;
+	if (a->type == N_NAME && a->data.info->pmid != b->data.info->pmid)
+	    return 0;
+	if (a->type == N_DEFINED &&
+	    a->data.info->ivlist[0].value.ul != b->data.info->ivlist[0].value.ul)
+	    return 0;
+    }
+    else if (a->data.info != NULL || b->data.info != NULL)
+	return 0;
+    if (a->type == N_INTEGER || a->type == N_DOUBLE) {
+	if (a->value == NULL || b->value == NULL || strcmp(a->value, b->value) != 0)
+	    return 0;
+    }
+    return same_expr(a->left, b->left) && same_expr(a->right, b->right);
+}
+
+/*
+ * Find (or make) the memo slot for np, -1 if np cannot share values
+ */
+static int
+memo_slot(ctl_t *cp, node_t *np)
+{
+    __pmHashNode	*hp;
+    memo_t		*tmp_memo;
+    unsigned int	sig;
+    int			slot;
+
+    if (!shared_expr(np))
+	return -1;
+    sig = expr_sig(np);
+    for (hp = __pmHashSearch(sig, &cp->memohash); hp != NULL; hp = hp->next) {
+	if (hp->key != sig)
+	    continue;
+	slot = (int)(__psint_t)hp->data;
+	if (same_expr(cp->memo[slot].np, np))
+	    return slot;
+    }
+    if ((tmp_memo = (memo_t *)realloc(cp->memo, (cp->nmemo+1)*sizeof(memo_t))) == NULL) {
+	pmNoMem("memo_slot: memo", (cp->nmemo+1)*sizeof(memo_t), PM_FATAL_ERR);
+	/*NOTREACHED*/
+    }
+    cp->memo = tmp_memo;
+    slot = cp->nmemo++;
+    memset(&cp->memo[slot], 0, sizeof(memo_t));
+    cp->memo[slot].np = np;
+    cp->memo[slot].sig = sig;
+    if (__pmHashAdd(sig, (void *)(__psint_t)slot, &cp->memohash) < 0) {
+	/* slot cannot be found again, so is not shared, but still works */
+	;
+    }
+    return slot;
+}
+
+static int
+newop(dm_t *dmp, int op, node_t *np, int slot)
+{
+    op_t	*tmp_prog;
+
+    if ((tmp_prog = (op_t *)realloc(dmp->prog, (dmp->nop+1)*sizeof(op_t))) == NULL) {
+	pmNoMem("newop: prog", (dmp->nop+1)*sizeof(op_t), PM_FATAL_ERR);
+	/*NOTREACHED*/
+    }
+    dmp->prog = tmp_prog;
+    dmp->prog[dmp->nop].op = op;
+    dmp->prog[dmp->nop].np = np;
+    dmp->prog[dmp->nop].slot = slot;
+    dmp->prog[dmp->nop].skip = -1;
+    dmp->prog[dmp->nop].parent = -1;
+    dmp->prog[dmp->nop].vhint = -1;
+    return dmp->nop++;
+}
+
+/*
+ * Emit the instructions for np and its operands, return the index
+ * of np's OP_EVAL
+ */
+static int
+emit(ctl_t *cp, dm_t *dmp, node_t *np)
+{
+    int		slot;
+    int		probe = -1;
+    int		left = -1;
+    int		right = -1;
+    int		me;
+
+    slot = memo_slot(cp, np);
+    if (slot >= 0)
+	probe = newop(dmp, OP_PROBE, np, slot);
+    if (np->left != NULL)
+	left = emit(cp, dmp, np->left);
+    if (np->right != NULL)
+	right = emit(cp, dmp, np->right);
+    me = newop(dmp, OP_EVAL, np, slot);
+    if (probe >= 0)
+	dmp->prog[probe].skip = me;
+    if (left >= 0)
+	dmp->prog[left].parent = me;
+    if (right >= 0)
+	dmp->prog[right].parent = me;
+    return me;
+}
+
+/*
+ * Compile a bound derived metric expression, once per context
+ */
 static void
-get_pmids(node_t *np, int *cnt, pmID **list)
+compile_expr(ctl_t *cp, dm_t *dmp)
 {
-    assert(np != NULL);
-    if (np->left != NULL) get_pmids(np->left, cnt, list);
-    if (np->right != NULL) get_pmids(np->right, cnt, list);
-    if (np->type == N_NAME) {
-	(*cnt)++;
-	if ((*list = (pmID *)realloc(*list, (*cnt)*sizeof(pmID))) == NULL) {
-	    pmNoMem("__dmprefetch: realloc xtralist", (*cnt)*sizeof(pmID), PM_FATAL_ERR);
-	    /*NOTREACHED*/
+    int		nmemo = cp->nmemo;
+
+    assert(dmp->expr != NULL);
+    emit(cp, dmp, dmp->expr);
+
+    if (pmDebugOptions.derive && pmDebugOptions.appl1) {
+	int	i;
+	int	nprobe = 0;
+	for (i = 0; i < dmp->nop; i++) {
+	    if (dmp->prog[i].op == OP_PROBE)
+		nprobe++;
+	}
+	fprintf(stderr, "compile_expr: %s: %d ops, %d shared of which %d new\n",
+	    dmp->name, dmp->nop, nprobe, cp->nmemo - nmemo);
+    }
+}
+
+void
+__dmfreeprog(ctl_t *cp)
+{
+    int		i;
+
+    for (i = 0; i < cp->nmetric; i++) {
+	if (cp->mlist[i].prog != NULL) {
+	    free(cp->mlist[i].prog);
+	    cp->mlist[i].prog = NULL;
+	    cp->mlist[i].nop = 0;
 	}
-	(*list)[*cnt-1] = np->data.info->pmid;
+    }
+    if (cp->memo != NULL) {
+	free(cp->memo);
+	cp->memo = NULL;
+    }
+    cp->nmemo = 0;
+    __pmHashFree(&cp->memohash);
+    __pmHashFree(&cp->pmidhash);
+    cp->nhashed = 0;
+    if (cp->pre_pmidlist != NULL) {
+	free(cp->pre_pmidlist);
+	cp->pre_pmidlist = NULL;
+    }
+    if (cp->pre_newlist != NULL) {
+	free(cp->pre_newlist);
+	cp->pre_newlist = NULL;
     }
 }
 
+/*
+ * Index of pmid in cp->mlist[], or -1 ... the first one, as for a
+ * linear search, if there are duplicates
+ */
+static int
+dm_lookup(ctl_t *cp, pmID pmid)
+{
+    __pmHashNode	*hp;
+    int			i;
+
+    /* mlist[] is only ever appended to */
+    for ( ; cp->nhashed < cp->nmetric; cp->nhashed++) {
+	i = cp->nhashed;
+	if (__pmHashSearch(cp->mlist[i].pmid, &cp->pmidhash) == NULL &&
+	    __pmHashAdd(cp->mlist[i].pmid, (void *)(__psint_t)i, &cp->pmidhash) < 0)
+	    break;
+    }
+    if ((hp = __pmHashSearch(pmid, &cp->pmidhash)) != NULL)
+	return (int)(__psint_t)hp->data;
+    for (i = cp->nhashed; i < cp->nmetric; i++) {
+	if (cp->mlist[i].pmid == pmid)
+	    return i;
+    }
+    return -1;
+}
+
 /*
  * Walk the pmidlist[] from pmFetch.
  * For each derived metric found in the list add all the operand metrics,
@@ -54,16 +321,23 @@ get_pmids(node_t *np, int *cnt, pmID **list)
  * The derived metric pmIDs are left in the combined list (they will
  * return PM_ERR_NOAGENT from the fetch) to simplify the post-processing
  * of the pmResult in __dmpostfetch()
+ *
+ * Clients usually fetch the same pmidlist[] over and over, so the
+ * results for the last pmidlist[] are kept and reused.
  */
 int
 __dmprefetch(__pmContext *ctxp, int numpmid, const pmID *pmidlist, pmID **newlist)
 {
     int		i;
-    int		j;
     int		m;
+    int		k;
     int		xtracnt = 0;
     pmID	*xtralist = NULL;
     pmID	*list;
+    pmID	pmid;
+    node_t	*np;
+    dm_t	*dmp;
+    __pmHashCtl	seen;
     ctl_t	*cp = (ctl_t *)ctxp->c_dm;
 
     /* if needed, __dminit() called in __dmopencontext beforehand */
@@ -77,77 +351,115 @@ __dmprefetch(__pmContext *ctxp, int numpmid, const pmID *pmidlist, pmID **newlis
      * Ditto for the fast path flag (fetch_has_dm).
      */
     cp->numpmid = numpmid;
-    cp->fetch_has_dm = 0;
 
+    if (cp->pre_pmidlist != NULL && numpmid == cp->pre_numpmid &&
+	cp->nmetric == cp->pre_nmetric &&
+	memcmp(pmidlist, cp->pre_pmidlist, numpmid*sizeof(pmID)) == 0) {
+	/* same as last time */
+	cp->fetch_has_dm = cp->pre_has_dm;
+	if (cp->pre_newcnt > numpmid) {
+	    if ((list = (pmID *)malloc(cp->pre_newcnt*sizeof(pmID))) == NULL) {
+		pmNoMem("__dmprefetch: alloc list", cp->pre_newcnt*sizeof(pmID), PM_FATAL_ERR);
+		/*NOTREACHED*/
+	    }
+	    memcpy(list, cp->pre_newlist, cp->pre_newcnt*sizeof(pmID));
+	    *newlist = list;
+	}
+	return cp->pre_newcnt;
+    }
+
+    cp->fetch_has_dm = 0;
+    __pmHashInit(&seen);
     for (m = 0; m < numpmid; m++) {
 	if (!IS_DERIVED(pmidlist[m]))
 	    continue;
-	for (i = 0; i < cp->nmetric; i++) {
-	    if (pmidlist[m] == cp->mlist[i].pmid) {
-		if ((cp->mlist[i].flags & DM_BIND) == 0)
-		    __dmbind(PM_NOT_LOCKED, ctxp, i, 1);
-		if (cp->mlist[i].expr != NULL) {
-		    get_pmids(cp->mlist[i].expr, &xtracnt, &xtralist);
-		    cp->fetch_has_dm = 1;
+	if ((i = dm_lookup(cp, pmidlist[m])) < 0)
+	    continue;
+	dmp = &cp->mlist[i];
+	if ((dmp->flags & DM_BIND) == 0)
+	    __dmbind(PM_NOT_LOCKED, ctxp, i, 1);
+	if (dmp->expr == NULL)
+	    continue;
+	if (dmp->prog == NULL)
+	    compile_expr(cp, dmp);
+	cp->fetch_has_dm = 1;
+	/*
+	 * Some of the operands may already be in the caller's pmFetch
+	 * list, or repeated (if the same metric operand appears more
+	 * than once as a leaf node in the expression tree, or in more
+	 * than one expression), so only add the new ones
+	 */
+	for (k = 0; k < dmp->nop; k++) {
+	    np = dmp->prog[k].np;
+	    if (dmp->prog[k].op != OP_EVAL || np->type != N_NAME)
+		continue;
+	    pmid = np->data.info->pmid;
+	    if (seen.nodes == 0) {
+		for (i = 0; i < numpmid; i++) {
+		    if (__pmHashSearch(pmidlist[i], &seen) == NULL)
+			__pmHashAdd(pmidlist[i], NULL, &seen);
 		}
-		break;
 	    }
+	    if (__pmHashSearch(pmid, &seen) != NULL)
+		continue;
+	    __pmHashAdd(pmid, NULL, &seen);
+	    xtracnt++;
+	    if ((xtralist = (pmID *)realloc(xtralist, xtracnt*sizeof(pmID))) == NULL) {
+		pmNoMem("__dmprefetch: realloc xtralist", xtracnt*sizeof(pmID), PM_FATAL_ERR);
+		/*NOTREACHED*/
+	    }
+	    xtralist[xtracnt-1] = pmid;
 	}
     }
+    __pmHashFree(&seen);
+
     if (xtracnt == 0) {
-	if (cp->fetch_has_dm)
-	    return numpmid;
-	else
-	    return 0;
+	m = cp->fetch_has_dm ? numpmid : 0;
+	list = NULL;
     }
-
-    /*
-     * Some of the "extra" ones, may already be in the caller's pmFetch 
-     * list, or repeated in xtralist[] (if the same metric operand appears
-     * more than once as a leaf node in the expression tree.
-     * Remove these duplicates
-     */
-    j = 0;
-    for (i = 0; i < xtracnt; i++) {
+    else {
+	if (pmDebugOptions.derive && pmDebugOptions.appl2) {
+	    char	strbuf[20];
+	    fprintf(stderr, "derived metrics prefetch added %d metrics:", xtracnt);
+	    for (i = 0; i < xtracnt; i++)
+		fprintf(stderr, " %s", pmIDStr_r(xtralist[i], strbuf, sizeof(strbuf)));
+	    fputc('\n', stderr);
+	}
+	if ((list = (pmID *)malloc((numpmid+xtracnt)*sizeof(pmID))) == NULL) {
+	    pmNoMem("__dmprefetch: alloc list", (numpmid+xtracnt)*sizeof(pmID), PM_FATAL_ERR);
+	    /*NOTREACHED*/
+	}
 	for (m = 0; m < numpmid; m++) {
-	    if (xtralist[i] == pmidlist[m])
-		/* already in pmFetch list */
-		break;
+	    list[m] = pmidlist[m];
 	}
-	if (m < numpmid) continue;
-	for (m = 0; m < j; m++) {
-	    if (xtralist[i] == xtralist[m])
-	    	/* already in xtralist[] */
-		break;
+	for (i = 0; i < xtracnt; i++) {
+	    list[m++] = xtralist[i];
 	}
-	if (m == j)
-	    xtralist[j++] = xtralist[i];
-    }
-    xtracnt = j;
-    if (xtracnt == 0) {
 	free(xtralist);
-	return numpmid;
+	*newlist = list;
     }
 
-    if (pmDebugOptions.derive && pmDebugOptions.appl2) {
-	char	strbuf[20];
-	fprintf(stderr, "derived metrics prefetch added %d metrics:", xtracnt);
-	for (i = 0; i < xtracnt; i++)
-	    fprintf(stderr, " %s", pmIDStr_r(xtralist[i], strbuf, sizeof(strbuf)));
-	fputc('\n', stderr);
-    }
-    if ((list = (pmID *)malloc((numpmid+xtracnt)*sizeof(pmID))) == NULL) {
-	pmNoMem("__dmprefetch: alloc list", (numpmid+xtracnt)*sizeof(pmID), PM_FATAL_ERR);
-	/*NOTREACHED*/
-    }
-    for (m = 0; m < numpmid; m++) {
-	list[m] = pmidlist[m];
-    }
-    for (i = 0; i < xtracnt; i++) {
-	list[m++] = xtralist[i];
+    /* remember for next time, not fatal if this cannot be done */
+    if (cp->pre_pmidlist != NULL)
+	free(cp->pre_pmidlist);
+    if (cp->pre_newlist != NULL)
+	free(cp->pre_newlist);
+    cp->pre_newlist = NULL;
+    if ((cp->pre_pmidlist = (pmID *)malloc((numpmid+1)*sizeof(pmID))) != NULL) {
+	memcpy(cp->pre_pmidlist, pmidlist, numpmid*sizeof(pmID));
+	if (list != NULL) {
+	    if ((cp->pre_newlist = (pmID *)malloc(m*sizeof(pmID))) != NULL)
+		memcpy(cp->pre_newlist, list, m*sizeof(pmID));
+	    else {
+		free(cp->pre_pmidlist);
+		cp->pre_pmidlist = NULL;
+	    }
+	}
     }
-    free(xtralist);
-    *newlist = list;
+    cp->pre_numpmid = numpmid;
+    cp->pre_nmetric = cp->nmetric;
+    cp->pre_has_dm = cp->fetch_has_dm;
+    cp->pre_newcnt = m;
 
     return m;
 }
@@ -635,6 +947,158 @@ bin_op(int type, int op, pmAtomValue a, int ltype, int lmul, int ldiv, pmAtomVal
     return res;
 }
 
+/*
+ * Arithmetic for n values at once,
+ * res[k] = a[k*astep] <op> b[k*bstep] for k = 0 ... n-1
+ * with the same results as bin_op(), but the switches on type and op
+ * are done once rather than for every value.
+ * astep and bstep are 1, or 0 for a singular operand.
+ */
+#define BATCH_INT(f) \
+    switch (op) { \
+	case N_PLUS: \
+	    for (k = 0; k < n; k++) \
+		res[k].value.f = a[k*astep].value.f + b[k*bstep].value.f; \
+	    return; \
+	case N_MINUS: \
+	    for (k = 0; k < n; k++) \
+		res[k].value.f = a[k*astep].value.f - b[k*bstep].value.f; \
+	    return; \
+	case N_STAR: \
+	    for (k = 0; k < n; k++) \
+		res[k].value.f = a[k*astep].value.f * b[k*bstep].value.f; \
+	    return; \
+    }
+
+/* promote to double and scale, as for PM_TYPE_DOUBLE in bin_op() */
+#define TO_DOUBLE(f) \
+    for (k = 0; k < n; k++) \
+	dst[k].value.d = (((double)src[k*step].value.f) / div) * mul
+
+static void
+to_double(val_t *dst, val_t *src, int step, int n, int type, int mul, int div)
+{
+    int		k;
+
+    switch (type) {
+	case PM_TYPE_32:
+	    TO_DOUBLE(l);
+	    break;
+	case PM_TYPE_U32:
+	    TO_DOUBLE(ul);
+	    break;
+	case PM_TYPE_64:
+	    TO_DOUBLE(ll);
+	    break;
+	case PM_TYPE_U64:
+	    TO_DOUBLE(ull);
+	    break;
+	case PM_TYPE_FLOAT:
+	    TO_DOUBLE(f);
+	    break;
+	case PM_TYPE_DOUBLE:
+	    TO_DOUBLE(d);
+	    break;
+    }
+}
+
+static void
+bin_op_batch(int type, int op, val_t *res, int n,
+	val_t *a, int astep, int ltype, int lmul, int ldiv,
+	val_t *b, int bstep, int rtype, int rmul, int rdiv)
+{
+    val_t	rbuf[64];
+    val_t	*r;
+    double	rd;
+    int		k;
+
+    if (type == PM_TYPE_DOUBLE) {
+	/* left operand promoted into res[], right into r[] */
+	to_double(res, a, astep, n, ltype, lmul, ldiv);
+	if (bstep == 0 || n <= (int)(sizeof(rbuf)/sizeof(rbuf[0])))
+	    r = rbuf;
+	else if ((r = (val_t *)malloc(n*sizeof(val_t))) == NULL) {
+	    pmNoMem("bin_op_batch: r", n*sizeof(val_t), PM_FATAL_ERR);
+	    /*NOTREACHED*/
+	}
+	to_double(r, b, bstep, bstep ? n : 1, rtype, rmul, rdiv);
+	if (bstep == 0) {
+	    rd = r[0].value.d;
+	    switch (op) {
+		case N_PLUS:
+		    for (k = 0; k < n; k++)
+			res[k].value.d = res[k].value.d + rd;
+		    break;
+		case N_MINUS:
+		    for (k = 0; k < n; k++)
+			res[k].value.d = res[k].value.d - rd;
+		    break;
+		case N_STAR:
+		    for (k = 0; k < n; k++)
+			res[k].value.d = res[k].value.d * rd;
+		    break;
+		case N_SLASH:
+		    for (k = 0; k < n; k++) {
+			if (res[k].value.d != 0)
+			    res[k].value.d = res[k].value.d / rd;
+		    }
+		    break;
+	    }
+	}
+	else {
+	    switch (op) {
+		case N_PLUS:
+		    for (k = 0; k < n; k++)
+			res[k].value.d = res[k].value.d + r[k].value.d;
+		    break;
+		case N_MINUS:
+		    for (k = 0; k < n; k++)
+			res[k].value.d = res[k].value.d - r[k].value.d;
+		    break;
+		case N_STAR:
+		    for (k = 0; k < n; k++)
+			res[k].value.d = res[k].value.d * r[k].value.d;
+		    break;
+		case N_SLASH:
+		    for (k = 0; k < n; k++) {
+			if (res[k].value.d != 0)
+			    res[k].value.d = res[k].value.d / r[k].value.d;
+		    }
+		    break;
+	    }
+	}
+	if (r != rbuf)
+	    free(r);
+	return;
+    }
+
+    if (ltype == type && rtype == type) {
+	/* no promotion needed */
+	switch (type) {
+	    case PM_TYPE_32:
+		BATCH_INT(l);
+		break;
+	    case PM_TYPE_U32:
+		BATCH_INT(ul);
+		break;
+	    case PM_TYPE_64:
+		BATCH_INT(ll);
+		break;
+	    case PM_TYPE_U64:
+		BATCH_INT(ull);
+		break;
+	    case PM_TYPE_FLOAT:
+		BATCH_INT(f);
+		break;
+	}
+    }
+
+    for (k = 0; k < n; k++) {
+	res[k].value = bin_op(type, op, a[k*astep].value, ltype, lmul, ldiv,
+			       b[k*bstep].value, rtype, rmul, rdiv);
+    }
+}
+
 /*
  * For regular expression instance matching, the hash list of observed
  * instances could grow without bounds for a dynamic indom.
@@ -675,14 +1139,16 @@ regex_inst_gc(pattern_t *pp)
 }
 
 /*
- * Walk an expression tree, filling in operand values from the
- * pmResult at the leaf nodes and propagating the computed values
- * towards the root node of the tree.
+ * Evaluate one node of an expression tree, filling in operand values
+ * from the pmResult at the leaf nodes, else computing the node's values
+ * from those of its operands, which have already been evaluated without
+ * error.
  */
 static int
-eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
-		pmValueSet **vset, int level)
+eval_expr(__pmContext *ctxp, op_t *op, struct timespec *stamp, int numpmid,
+		pmValueSet **vset)
 {
+    node_t	*np = op->np;
     int		sts;
     int		i;
     int		j;
@@ -691,31 +1157,6 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
     char	strbuf[20];
 
     assert(np != NULL);
-    if (np->left != NULL) {
-	sts = eval_expr(ctxp, np->left, stamp, numpmid, vset, level+1);
-	if (sts < 0) {
-	    if (np->type == N_COUNT) {
-		/* count() ... special case, map errors to 0 */
-		if (np->data.info->ivlist == NULL) {
-		    /* initialize ivlist[] for singular instance first time through */
-		    if ((np->data.info->ivlist = (val_t *)malloc(sizeof(val_t))) == NULL) {
-			pmNoMem("eval_expr: count ivlist", sizeof(val_t), PM_FATAL_ERR);
-			/*NOTREACHED*/
-		    }
-		    np->data.info->ivlist[0].inst = PM_IN_NULL;
-		}
-		np->data.info->numval = 1;
-		np->data.info->ivlist[0].value.l = 0;
-		sts = 1;
-	    }
-	    return sts;
-	}
-    }
-    if (np->right != NULL) {
-	sts = eval_expr(ctxp, np->right, stamp, numpmid, vset, level+1);
-	if (sts < 0) return sts;
-    }
-
     /* mostly, np->left is not NULL ... */
     assert (np->type == N_INTEGER || np->type == N_DOUBLE ||
             np->type == N_NAME || np->type == N_SCALE ||
@@ -1389,86 +1830,93 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 	case N_NAME:
 	    /*
 	     * Extract instance-values from pmResult and store them in
-	     * ivlist[] as <int, pmAtomValue> pairs
+	     * ivlist[] as <int, pmAtomValue> pairs ... the operand is
+	     * usually at the same place in vset[] as last time
 	     */
-	    for (j = 0; j < numpmid; j++) {
-		if (np->data.info->pmid == vset[j]->pmid) {
-		    free_ivlist(np);
-		    np->data.info->numval = vset[j]->numval;
-		    if (np->data.info->numval <= 0)
-			return np->data.info->numval;
-		    if ((np->data.info->ivlist = (val_t *)malloc(np->data.info->numval*sizeof(val_t))) == NULL) {
-			pmNoMem("eval_expr: metric ivlist", np->data.info->numval*sizeof(val_t), PM_FATAL_ERR);
-			/*NOTREACHED*/
-		    }
-		    for (i = 0; i < np->data.info->numval; i++) {
-			np->data.info->ivlist[i].inst = vset[j]->vlist[i].inst;
-			switch (np->desc.type) {
-			    case PM_TYPE_32:
-			    case PM_TYPE_U32:
-				np->data.info->ivlist[i].value.l = vset[j]->vlist[i].value.lval;
-				break;
-			    case PM_TYPE_64:
-			    case PM_TYPE_U64:
-				if (vset[j]->valfmt != PM_VAL_DPTR && vset[j]->valfmt != PM_VAL_SPTR)
-				    return PM_ERR_LOGREC;
-				memcpy((void *)&np->data.info->ivlist[i].value.ll, (void *)vset[j]->vlist[i].value.pval->vbuf, sizeof(__int64_t));
-				break;
-			    case PM_TYPE_FLOAT:
-				if (vset[j]->valfmt == PM_VAL_INSITU) {
-				    /* old style insitu float */
-				    np->data.info->ivlist[i].value.l = vset[j]->vlist[i].value.lval;
-				}
-				else if (vset[j]->valfmt == PM_VAL_DPTR || vset[j]->valfmt == PM_VAL_SPTR) {
-				    assert(vset[j]->vlist[i].value.pval->vtype == PM_TYPE_FLOAT);
-				    memcpy((void *)&np->data.info->ivlist[i].value.f, (void *)vset[j]->vlist[i].value.pval->vbuf, sizeof(float));
-				}
-				else
-				    return PM_ERR_LOGREC;
-				break;
-			    case PM_TYPE_DOUBLE:
-				if (vset[j]->valfmt != PM_VAL_DPTR && vset[j]->valfmt != PM_VAL_SPTR)
-				    return PM_ERR_LOGREC;
-				memcpy((void *)&np->data.info->ivlist[i].value.d, (void *)vset[j]->vlist[i].value.pval->vbuf, sizeof(double));
-				break;
-			    case PM_TYPE_STRING:
-				if (vset[j]->valfmt != PM_VAL_DPTR && vset[j]->valfmt != PM_VAL_SPTR)
-				    return PM_ERR_LOGREC;
-				need = vset[j]->vlist[i].value.pval->vlen-PM_VAL_HDR_SIZE;
-				if ((np->data.info->ivlist[i].value.cp = (char *)malloc(need)) == NULL) {
-				    pmNoMem("eval_expr: string value", vset[j]->vlist[i].value.pval->vlen, PM_FATAL_ERR);
-				    /*NOTREACHED*/
-				}
-				memcpy((void *)np->data.info->ivlist[i].value.cp, (void *)vset[j]->vlist[i].value.pval->vbuf, need);
-				np->data.info->ivlist[i].vlen = need;
-				break;
-			    case PM_TYPE_AGGREGATE:
-			    case PM_TYPE_AGGREGATE_STATIC:
-			    case PM_TYPE_EVENT:
-			    case PM_TYPE_HIGHRES_EVENT:
-				if (vset[j]->valfmt != PM_VAL_DPTR && vset[j]->valfmt != PM_VAL_SPTR)
-				    return PM_ERR_LOGREC;
-				if ((np->data.info->ivlist[i].value.vbp = (pmValueBlock *)malloc(vset[j]->vlist[i].value.pval->vlen)) == NULL) {
-				    pmNoMem("eval_expr: aggregate value", vset[j]->vlist[i].value.pval->vlen, PM_FATAL_ERR);
-				    /*NOTREACHED*/
-				}
-				memcpy(np->data.info->ivlist[i].value.vbp, (void *)vset[j]->vlist[i].value.pval, vset[j]->vlist[i].value.pval->vlen);
-				np->data.info->ivlist[i].vlen = vset[j]->vlist[i].value.pval->vlen;
-				break;
-			    default:
-				/*
-				 * really only PM_TYPE_NOSUPPORT should
-				 * end up here
-				 */
-				return PM_ERR_TYPE;
+	    j = op->vhint;
+	    if (j < 0 || j >= numpmid || vset[j]->pmid != np->data.info->pmid) {
+		for (j = 0; j < numpmid; j++) {
+		    if (np->data.info->pmid == vset[j]->pmid)
+			break;
+		}
+		if (j == numpmid) {
+		    if (pmDebugOptions.derive)
+			fprintf(stderr, "eval_expr: botch: operand %s not in the extended pmResult\n", pmIDStr_r(np->data.info->pmid, strbuf, sizeof(strbuf)));
+		    return PM_ERR_PMID;
+		}
+		op->vhint = j;
+	    }
+	    free_ivlist(np);
+	    np->data.info->numval = vset[j]->numval;
+	    if (np->data.info->numval <= 0)
+		return np->data.info->numval;
+	    if ((np->data.info->ivlist = (val_t *)malloc(np->data.info->numval*sizeof(val_t))) == NULL) {
+		pmNoMem("eval_expr: metric ivlist", np->data.info->numval*sizeof(val_t), PM_FATAL_ERR);
+		/*NOTREACHED*/
+	    }
+	    for (i = 0; i < np->data.info->numval; i++) {
+		np->data.info->ivlist[i].inst = vset[j]->vlist[i].inst;
+		switch (np->desc.type) {
+		    case PM_TYPE_32:
+		    case PM_TYPE_U32:
+			np->data.info->ivlist[i].value.l = vset[j]->vlist[i].value.lval;
+			break;
+		    case PM_TYPE_64:
+		    case PM_TYPE_U64:
+			if (vset[j]->valfmt != PM_VAL_DPTR && vset[j]->valfmt != PM_VAL_SPTR)
+			    return PM_ERR_LOGREC;
+			memcpy((void *)&np->data.info->ivlist[i].value.ll, (void *)vset[j]->vlist[i].value.pval->vbuf, sizeof(__int64_t));
+			break;
+		    case PM_TYPE_FLOAT:
+			if (vset[j]->valfmt == PM_VAL_INSITU) {
+			    /* old style insitu float */
+			    np->data.info->ivlist[i].value.l = vset[j]->vlist[i].value.lval;
 			}
-		    }
-		    return np->data.info->numval;
+			else if (vset[j]->valfmt == PM_VAL_DPTR || vset[j]->valfmt == PM_VAL_SPTR) {
+			    assert(vset[j]->vlist[i].value.pval->vtype == PM_TYPE_FLOAT);
+			    memcpy((void *)&np->data.info->ivlist[i].value.f, (void *)vset[j]->vlist[i].value.pval->vbuf, sizeof(float));
+			}
+			else
+			    return PM_ERR_LOGREC;
+			break;
+		    case PM_TYPE_DOUBLE:
+			if (vset[j]->valfmt != PM_VAL_DPTR && vset[j]->valfmt != PM_VAL_SPTR)
+			    return PM_ERR_LOGREC;
+			memcpy((void *)&np->data.info->ivlist[i].value.d, (void *)vset[j]->vlist[i].value.pval->vbuf, sizeof(double));
+			break;
+		    case PM_TYPE_STRING:
+			if (vset[j]->valfmt != PM_VAL_DPTR && vset[j]->valfmt != PM_VAL_SPTR)
+			    return PM_ERR_LOGREC;
+			need = vset[j]->vlist[i].value.pval->vlen-PM_VAL_HDR_SIZE;
+			if ((np->data.info->ivlist[i].value.cp = (char *)malloc(need)) == NULL) {
+			    pmNoMem("eval_expr: string value", vset[j]->vlist[i].value.pval->vlen, PM_FATAL_ERR);
+			    /*NOTREACHED*/
+			}
+			memcpy((void *)np->data.info->ivlist[i].value.cp, (void *)vset[j]->vlist[i].value.pval->vbuf, need);
+			np->data.info->ivlist[i].vlen = need;
+			break;
+		    case PM_TYPE_AGGREGATE:
+		    case PM_TYPE_AGGREGATE_STATIC:
+		    case PM_TYPE_EVENT:
+		    case PM_TYPE_HIGHRES_EVENT:
+			if (vset[j]->valfmt != PM_VAL_DPTR && vset[j]->valfmt != PM_VAL_SPTR)
+			    return PM_ERR_LOGREC;
+			if ((np->data.info->ivlist[i].value.vbp = (pmValueBlock *)malloc(vset[j]->vlist[i].value.pval->vlen)) == NULL) {
+			    pmNoMem("eval_expr: aggregate value", vset[j]->vlist[i].value.pval->vlen, PM_FATAL_ERR);
+			    /*NOTREACHED*/
+			}
+			memcpy(np->data.info->ivlist[i].value.vbp, (void *)vset[j]->vlist[i].value.pval, vset[j]->vlist[i].value.pval->vlen);
+			np->data.info->ivlist[i].vlen = vset[j]->vlist[i].value.pval->vlen;
+			break;
+		    default:
+			/*
+			 * really only PM_TYPE_NOSUPPORT should
+			 * end up here
+			 */
+			return PM_ERR_TYPE;
 		}
 	    }
-	    if (pmDebugOptions.derive)
-		fprintf(stderr, "eval_expr: botch: operand %s not in the extended pmResult\n", pmIDStr_r(np->data.info->pmid, strbuf, sizeof(strbuf)));
-	    return PM_ERR_PMID;
+	    return np->data.info->numval;
 
 	case N_DEFINED:
 	    /* already setup from check_expr(), nothing to do ... */
@@ -1667,6 +2115,43 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
 		pmNoMem("eval_expr: expr ivlist", np->data.info->numval*sizeof(val_t), PM_FATAL_ERR);
 		/*NOTREACHED*/
 	    }
+	    if (np->type == N_PLUS || np->type == N_MINUS ||
+		np->type == N_STAR || np->type == N_SLASH) {
+		/*
+		 * arithmetic, all at once if the instances line up or
+		 * an operand is singular
+		 */
+		int	lstep = np->left->desc.indom == PM_INDOM_NULL ? 0 : 1;
+		int	rstep = np->right->desc.indom == PM_INDOM_NULL ? 0 : 1;
+
+		if (lstep && rstep) {
+		    if (np->left->data.info->numval != np->right->data.info->numval)
+			lstep = -1;
+		    else {
+			for (k = 0; k < np->data.info->numval; k++) {
+			    if (np->left->data.info->ivlist[k].inst != np->right->data.info->ivlist[k].inst) {
+				lstep = -1;
+				break;
+			    }
+			}
+		    }
+		}
+		if (lstep >= 0) {
+		    bin_op_batch(np->desc.type, np->type,
+			   np->data.info->ivlist, np->data.info->numval,
+			   np->left->data.info->ivlist, lstep, np->left->desc.type,
+			   np->left->data.info->mul_scale, np->left->data.info->div_scale,
+			   np->right->data.info->ivlist, rstep, np->right->desc.type,
+			   np->right->data.info->mul_scale, np->right->data.info->div_scale);
+		    for (k = 0; k < np->data.info->numval; k++) {
+			if (lstep)
+			    np->data.info->ivlist[k].inst = np->left->data.info->ivlist[k].inst;
+			else
+			    np->data.info->ivlist[k].inst = np->right->data.info->ivlist[k*rstep].inst;
+		    }
+		    return np->data.info->numval;
+		}
+	    }
 	    /*
 	     * ivlist[k] = left->ivlist[i] <op> right->ivlist[j]
 	     */
@@ -1783,6 +2268,186 @@ eval_expr(__pmContext *ctxp, node_t *np, struct timespec *stamp, int numpmid,
     /*NOTREACHED*/
 }
 
+/*
+ * count() maps an error for its operand to a count of 0
+ */
+static int
+count_error(node_t *np)
+{
+    if (np->data.info->ivlist == NULL) {
+	/* initialize ivlist[] for singular instance first time through */
+	if ((np->data.info->ivlist = (val_t *)malloc(sizeof(val_t))) == NULL) {
+	    pmNoMem("eval_expr: count ivlist", sizeof(val_t), PM_FATAL_ERR);
+	    /*NOTREACHED*/
+	}
+	np->data.info->ivlist[0].inst = PM_IN_NULL;
+    }
+    np->data.info->numval = 1;
+    np->data.info->ivlist[0].value.l = 0;
+    return 1;
+}
+
+/*
+ * Copy the values (and for delta() and rate() the state for the next
+ * fetch) of owner, an expression of the same shape as np
+ */
+static void
+memo_copy(node_t *np, node_t *owner)
+{
+    info_t	*ip = np->data.info;
+    info_t	*op = owner->data.info;
+
+    switch (np->type) {
+	case N_AVG:
+	case N_COUNT:
+	case N_SUM:
+	case N_MAX:
+	case N_MIN:
+	case N_SCALAR:
+	    /* singular, ivlist[] is kept from one fetch to the next */
+	    if (ip->ivlist == NULL) {
+		if ((ip->ivlist = (val_t *)malloc(sizeof(val_t))) == NULL) {
+		    pmNoMem("memo_copy: aggr ivlist", sizeof(val_t), PM_FATAL_ERR);
+		    /*NOTREACHED*/
+		}
+		ip->ivlist[0].inst = PM_IN_NULL;
+	    }
+	    ip->numval = op->numval;
+	    if (op->ivlist != NULL)
+		ip->ivlist[0] = op->ivlist[0];	/* struct assignment */
+	    return;
+	case N_DELTA:
+	case N_RATE:
+	    ip->stamp = op->stamp;		/* struct assignment */
+	    ip->last_stamp = op->last_stamp;	/* struct assignment */
+	    /* the operand's values become last_ivlist[] next time */
+	    memo_copy(np->left, owner->left);
+	    break;
+    }
+    free_ivlist(np);
+    ip->numval = op->numval;
+    if (op->numval > 0) {
+	if ((ip->ivlist = (val_t *)malloc(op->numval*sizeof(val_t))) == NULL) {
+	    pmNoMem("memo_copy: ivlist", op->numval*sizeof(val_t), PM_FATAL_ERR);
+	    /*NOTREACHED*/
+	}
+	memcpy(ip->ivlist, op->ivlist, op->numval*sizeof(val_t));
+    }
+}
+
+/*
+ * Has the node for an OP_PROBE already been evaluated in this fetch,
+ * or is there another node in the same memo slot with values that can
+ * be copied?
+ */
+static int
+memo_hit(ctl_t *cp, op_t *op)
+{
+    memo_t	*mp = &cp->memo[op->slot];
+    node_t	*np = op->np;
+    int		stateful = (np->type == N_DELTA || np->type == N_RATE);
+
+    if (mp->owner == NULL || mp->fetch != cp->fetchnum)
+	return 0;
+    if (mp->owner == np)
+	return 1;
+    if (mp->sts < 0) {
+	/*
+	 * the error is all there is to share, except that metric
+	 * values are saved for later, and delta() and rate() need
+	 * their operand's values as the state for the next fetch
+	 */
+	return np->type != N_NAME && !stateful;
+    }
+    if (stateful) {
+	/* already been here this fetch? then copying again is harmless */
+	if (np->data.info->fetch != cp->fetchnum) {
+	    if (mp->prev != np->data.info->fetch)
+		return 0;
+	    np->data.info->prevfetch = np->data.info->fetch;
+	    np->data.info->fetch = cp->fetchnum;
+	}
+	else if (mp->prev != np->data.info->prevfetch)
+	    return 0;
+    }
+    memo_copy(np, mp->owner);
+    return 1;
+}
+
+static void
+memo_save(ctl_t *cp, op_t *op, int sts)
+{
+    memo_t	*mp = &cp->memo[op->slot];
+
+    if (mp->owner != NULL && mp->fetch == cp->fetchnum)
+	/* first one this fetch is the owner */
+	return;
+    mp->owner = op->np;
+    mp->fetch = cp->fetchnum;
+    mp->sts = sts;
+    mp->prev = op->np->data.info->prevfetch;
+}
+
+/*
+ * Run the compiled program for a derived metric.
+ *
+ * The ops are the nodes of the expression tree in post-order, so the
+ * operands of each node have been evaluated before the node itself.
+ * When an OP_PROBE hits, the node's values are already known and its
+ * subtree is skipped.  When a node fails, the error is passed up to its
+ * ancestors (which are not evaluated) until count() or the root node.
+ */
+static int
+eval_prog(__pmContext *ctxp, dm_t *dmp, struct timespec *stamp, int numpmid,
+		pmValueSet **vset)
+{
+    ctl_t	*cp = (ctl_t *)ctxp->c_dm;
+    op_t	*op;
+    node_t	*np;
+    int		sts = 0;
+    int		i;
+
+    for (i = 0; i < dmp->nop; i++) {
+	op = &dmp->prog[i];
+	if (op->op == OP_PROBE) {
+	    if (!memo_hit(cp, op)) {
+		np = op->np;
+		if ((np->type == N_DELTA || np->type == N_RATE) &&
+		    np->data.info->fetch != cp->fetchnum) {
+		    np->data.info->prevfetch = np->data.info->fetch;
+		    np->data.info->fetch = cp->fetchnum;
+		}
+		continue;
+	    }
+	    sts = cp->memo[op->slot].sts;
+	    i = op->skip;
+	    op = &dmp->prog[i];
+	}
+	else {
+	    sts = eval_expr(ctxp, op, stamp, numpmid, vset);
+	    if (op->slot >= 0)
+		memo_save(cp, op, sts);
+	}
+	if (sts < 0) {
+	    while ((i = op->parent) >= 0) {
+		op = &dmp->prog[i];
+		if (op->np->type == N_COUNT) {
+		    /* count() ... special case, map errors to 0 */
+		    sts = count_error(op->np);
+		    if (op->slot >= 0)
+			memo_save(cp, op, sts);
+		    break;
+		}
+		if (op->slot >= 0)
+		    memo_save(cp, op, sts);
+	    }
+	    if (i < 0)
+		return sts;
+	}
+    }
+    return sts;
+}
+
 /*
  * Algorithm here is complicated by trying to re-write the pmValueSets
  * in a result structure (either pmResult or pmHighResResult).
@@ -1837,62 +2502,61 @@ __dmpostvalueset(__pmContext *ctxp, struct timespec *stamp, int vnumpmid,
 	 */
 	m = 0;
 	if (IS_DERIVED(vset[j]->pmid)) {
-	    for (m = 0; m < cp->nmetric; m++) {
-		if (vset[j]->pmid == cp->mlist[m].pmid) {
-		    if (cp->mlist[m].expr == NULL) {
-			numval = PM_ERR_PMID;
-		    }
-		    else {
-			rewrite = 1;
-			if (cp->mlist[m].expr->desc.type == PM_TYPE_32 ||
-			    cp->mlist[m].expr->desc.type == PM_TYPE_U32)
-			    valfmt = PM_VAL_INSITU;
-			else
-			    valfmt = PM_VAL_DPTR;
-
-			numval = eval_expr(ctxp, cp->mlist[m].expr,
-						stamp, vnumpmid, vset, 1);
-			if (numval == PM_ERR_PMID)
-			    fails++;
-
-			if (pmDebugOptions.derive && pmDebugOptions.appl2) {
-			    int		k, type = cp->mlist[m].expr->desc.type;
-			    info_t	*info = cp->mlist[m].expr->data.info;
-			    char	strbuf[20];
-	
-			    pmIDStr_r(vset[j]->pmid, strbuf, sizeof(strbuf));
-			    fprintf(stderr, "%s: [%d] root node %s: numval=%d",
-					    "__dmpostvalueset", j, strbuf, numval);
-			    for (k = 0; k < numval; k++) {
-				pmAtomValue value = info->ivlist[k].value;
-
-				fprintf(stderr, " vset[%d]: inst=%d", k,
-						info->ivlist[k].inst);
-				if (type == PM_TYPE_32)
-				    fprintf(stderr, " l=%d", value.l);
-				else if (type == PM_TYPE_U32)
-				    fprintf(stderr, " u=%u", value.ul);
-				else if (type == PM_TYPE_64)
-				    fprintf(stderr, " ll=%"PRIi64, value.ll);
-				else if (type == PM_TYPE_U64)
-				    fprintf(stderr, " ul=%"PRIu64, value.ull);
-				else if (type == PM_TYPE_FLOAT)
-				    fprintf(stderr, " f=%f", (double)value.f);
-				else if (type == PM_TYPE_DOUBLE)
-				    fprintf(stderr, " d=%f", value.d);
-				else if (type == PM_TYPE_STRING)
-				    fprintf(stderr, " cp=%s (len=%d)", value.cp,
-						info->ivlist[k].vlen);
-				else
-				    fprintf(stderr, " vbp="PRINTF_P_PFX"%p (len=%d)",
-						value.vbp, info->ivlist[k].vlen);
-			    }
-			    fputc('\n', stderr);
-			    if (info != NULL)
-				__dmdumpexpr(cp->mlist[m].expr, 1);
+	    if ((m = dm_lookup(cp, vset[j]->pmid)) >= 0) {
+		if (cp->mlist[m].expr == NULL) {
+		    numval = PM_ERR_PMID;
+		}
+		else {
+		    rewrite = 1;
+		    if (cp->mlist[m].expr->desc.type == PM_TYPE_32 ||
+			cp->mlist[m].expr->desc.type == PM_TYPE_U32)
+			valfmt = PM_VAL_INSITU;
+		    else
+			valfmt = PM_VAL_DPTR;
+
+		    if (cp->mlist[m].prog == NULL)
+			compile_expr(cp, &cp->mlist[m]);
+		    numval = eval_prog(ctxp, &cp->mlist[m],
+					    stamp, vnumpmid, vset);
+		    if (numval == PM_ERR_PMID)
+			fails++;
+
+		    if (pmDebugOptions.derive && pmDebugOptions.appl2) {
+			int		k, type = cp->mlist[m].expr->desc.type;
+			info_t	*info = cp->mlist[m].expr->data.info;
+			char	strbuf[20];
+
+			pmIDStr_r(vset[j]->pmid, strbuf, sizeof(strbuf));
+			fprintf(stderr, "%s: [%d] root node %s: numval=%d",
+					"__dmpostvalueset", j, strbuf, numval);
+			for (k = 0; k < numval; k++) {
+			    pmAtomValue value = info->ivlist[k].value;
+
+			    fprintf(stderr, " vset[%d]: inst=%d", k,
+					    info->ivlist[k].inst);
+			    if (type == PM_TYPE_32)
+				fprintf(stderr, " l=%d", value.l);
+			    else if (type == PM_TYPE_U32)
+				fprintf(stderr, " u=%u", value.ul);
+			    else if (type == PM_TYPE_64)
+				fprintf(stderr, " ll=%"PRIi64, value.ll);
+			    else if (type == PM_TYPE_U64)
+				fprintf(stderr, " ul=%"PRIu64, value.ull);
+			    else if (type == PM_TYPE_FLOAT)
+				fprintf(stderr, " f=%f", (double)value.f);
+			    else if (type == PM_TYPE_DOUBLE)
+				fprintf(stderr, " d=%f", value.d);
+			    else if (type == PM_TYPE_STRING)
+				fprintf(stderr, " cp=%s (len=%d)", value.cp,
+					    info->ivlist[k].vlen);
+			    else
+				fprintf(stderr, " vbp="PRINTF_P_PFX"%p (len=%d)",
+					    value.vbp, info->ivlist[k].vlen);
 			}
+			fputc('\n', stderr);
+			if (info != NULL)
+			    __dmdumpexpr(cp->mlist[m].expr, 1);
 		    }
-		    break;
 		}
 	    }
 	}
@@ -2063,6 +2727,7 @@ __dmpostfetch(__pmContext *ctxp, __pmResult **result)
 
     timestamp.tv_sec = rp->timestamp.sec;
     timestamp.tv_nsec = rp->timestamp.nsec;
+    cp->fetchnum++;
     fails = __dmpostvalueset(ctxp, &timestamp, rp->numpmid, rp->vset,
 				newrp->numpmid, newrp->vset);
     if (fails > 0 && pmDebugOptions.derive)
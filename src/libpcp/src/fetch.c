@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 1995-2006,2008 Silicon Graphics, Inc.  All Rights Reserved.
- * Copyright (c) 2021-2022 Red Hat.
+ * Copyright (c) 2021-2022,2026 Red Hat.
  *
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -18,8 +18,8 @@
 #include "internal.h"
 #include "fault.h"
 
-static int
-__pmUpdateProfile(int fd, __pmContext *ctxp, int timeout)
+int
+__pmUpdateProfile(int fd, int from, __pmContext *ctxp, int timeout)
 {
     int		sts;
 
@@ -34,7 +34,7 @@ __pmUpdateProfile(int fd, __pmContext *ctxp, int timeout)
 	            ctxp->c_handle, ctxp->c_slot);
 	    __pmDumpProfile(stderr, PM_INDOM_NULL, ctxp->c_instprof);
 	}
-	if ((sts = __pmSendProfile(fd, __pmPtrToHandle(ctxp),
+	if ((sts = __pmSendProfile(fd, from,
 				   ctxp->c_slot, ctxp->c_instprof)) < 0)
 	    return sts;
 	else
@@ -54,6 +54,8 @@ __pmRecvFetchPDU(int fd, __pmContext *ctxp, int timeout, int pdutype,
 	sts = pinpdu = __pmGetPDU(fd, ANY_SIZE, timeout, &pb);
 	if (sts == PDU_HIGHRES_RESULT && pdutype == PDU_HIGHRES_FETCH)
 	    sts = __pmDecodeHighResResult_ctx(ctxp, pb, result);
+	else if (sts == PDU_DELTA_RESULT && pdutype == PDU_HIGHRES_FETCH)
+	    sts = __pmDecodeDeltaResult_ctx(ctxp, pb, result);
 	else if (sts == PDU_RESULT && pdutype == PDU_FETCH)
 	    sts = __pmDecodeResult_ctx(ctxp, pb, result);
 	else if (sts == PDU_ERROR) {
@@ -201,7 +203,7 @@ __pmFetch(__pmContext *ctxp, int numpmid, pmID *pmidlist, __pmResult **result)
 	    else
 		pdutype = PDU_FETCH;
 	    tout = ctxp->c_pmcd->pc_tout_sec;
-	    if ((sts = __pmUpdateProfile(fd, ctxp, tout)) < 0)
+	    if ((sts = __pmUpdateProfile(fd, __pmPtrToHandle(ctxp), ctxp, tout)) < 0)
 		sts = __pmMapErrno(sts);
 	    else if ((sts = __pmSendFetchPDU(fd, __pmPtrToHandle(ctxp),
 				ctxp->c_slot, numpmid, pmidlist, pdutype)) < 0)
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2013 Red Hat.
+ * Copyright (c) 2013,2026 Red Hat.
  * Copyright (c) 1995-2006 Silicon Graphics, Inc.  All Rights Reserved.
  * 
  * This library is free software; you can redistribute it and/or modify it
@@ -242,8 +242,8 @@ pmNameInDom(pmInDom indom, int inst, char **name)
     return sts;
 }
 
-static int
-inresult_to_lists(pmInResult *result, int **instlist, char ***namelist)
+int
+__pmInResultToLists(pmInResult *result, int **instlist, char ***namelist)
 {
     int n, i, sts, need;
     char *p;
@@ -338,7 +338,7 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
 			PM_UNLOCK(ctxp->c_lock);
 			goto pmapi_return;
 		    }
-		    sts = inresult_to_lists(result, instlist, namelist);
+		    sts = __pmInResultToLists(result, instlist, namelist);
 		}
 		else if (sts == PDU_ERROR)
 		    __pmDecodeError(pb, &sts);
@@ -365,7 +365,7 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":1", PM_FAULT_CALL);
 					       dp->dispatch.version.any.ext);
 	    }
 	    if (sts >= 0)
-		sts = inresult_to_lists(result, instlist, namelist);
+		sts = __pmInResultToLists(result, instlist, namelist);
 	}
 	else {
 	    /* assume PM_CONTEXT_ARCHIVE */
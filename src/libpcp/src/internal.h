@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2022 Red Hat.
+ * Copyright (c) 2012-2022,2026 Red Hat.
  * Copyright (c) 1995-2001 Silicon Graphics, Inc.  All Rights Reserved.
  *
  * This library is free software; you can redistribute it and/or modify it
@@ -32,6 +32,11 @@ extern int __pmConnectWithFNDELAY(int, void *, __pmSockLen) _PCP_HIDDEN;
 
 extern int __pmPtrToHandle(__pmContext *) _PCP_HIDDEN;
 
+/* shared by the synchronous PMAPI routines and async.c */
+extern int __pmUpdateProfile(int, int, __pmContext *, int) _PCP_HIDDEN;
+extern int __pmInResultToLists(pmInResult *, int **, char ***) _PCP_HIDDEN;
+extern void __pmAsyncFree(__pmPMCDCtl *) _PCP_HIDDEN;
+
 extern int __pmGetDate(struct timespec *, char const *, struct timespec const *)  _PCP_HIDDEN;
 
 #ifdef HAVE_NETWORK_BYTEORDER
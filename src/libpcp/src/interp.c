@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015-2017,2022 Red Hat.
+ * Copyright (c) 2015-2017,2022,2026 Red Hat.
  * Copyright (c) 1995,2004 Silicon Graphics, Inc.  All Rights Reserved.
  *
  * This library is free software; you can redistribute it and/or modify it
@@ -1016,6 +1016,125 @@ time_caliper(__pmContext *ctxp, instcntl_t *icp)
     return;
 }
 
+/*
+ * search limits for an unbound instance ... no values before
+ * first_bound() or after last_bound(), combining t_first and t_last
+ * from earlier scans with t_birth and t_death from time_caliper(),
+ * -1 if not known
+ */
+static double
+first_bound(instcntl_t *icp)
+{
+    return icp->t_birth > icp->t_first ? icp->t_birth : icp->t_first;
+}
+
+static double
+last_bound(instcntl_t *icp)
+{
+    if (icp->t_last < 0)
+	return icp->t_death;
+    if (icp->t_death >= 0 && icp->t_death < icp->t_last)
+	return icp->t_death;
+    return icp->t_last;
+}
+
+/*
+ * end of the search for icp, nothing found between t_req and where the
+ * search stopped, so trim t_first or t_last as required
+ */
+static void
+trim_first(instcntl_t *icp, double t_req)
+{
+    if ((IS_UNDEFINED(icp->s_prior) || icp->t_prior > t_req) &&
+	icp->t_first < t_req) {
+	icp->t_first = t_req;
+	SET_SCANNED(icp->s_prior);
+	if (pmDebugOptions.interp)
+	    dumpicp("no values before t_first", icp);
+    }
+}
+
+static void
+trim_last(instcntl_t *icp, double t_req)
+{
+    if (icp->t_next < t_req &&
+	(icp->t_last < 0 || t_req < icp->t_last)) {
+	icp->t_last = t_req;
+	SET_SCANNED(icp->s_next);
+	if (pmDebugOptions.interp) {
+	    char	strbuf[20];
+	    fprintf(stderr, "pmid %s inst %d no values after t_last=%.6f\n",
+		    pmIDStr_r(icp->metric->desc.pmid, strbuf, sizeof(strbuf)), icp->inst, icp->t_last);
+	}
+    }
+}
+
+/*
+ * order for the unbound list ... descending first_bound() when
+ * scanning backwards, ascending last_bound() when scanning forwards
+ * with the instances that have no last_bound() at the end
+ */
+static int
+unbound_before(instcntl_t *a, instcntl_t *b, int mode)
+{
+    double	t_a, t_b;
+
+    if (mode == PM_MODE_BACK)
+	return first_bound(a) >= first_bound(b);
+    t_a = last_bound(a);
+    t_b = last_bound(b);
+    if (t_b < 0)
+	return 1;
+    if (t_a < 0)
+	return 0;
+    return t_a <= t_b;
+}
+
+/*
+ * merge sort the unbound list ... instances are pushed onto the list
+ * as they are found, and sorted once, rather than a sorted insertion
+ * for each one (quadratic for big instance domains)
+ */
+static instcntl_t *
+sort_unbound(instcntl_t *list, int mode)
+{
+    instcntl_t	*a, *b;
+    instcntl_t	*head;
+    instcntl_t	**tailp;
+
+    if (list == NULL || list->unbound == NULL)
+	return list;
+
+    /* split in half ... */
+    a = list;
+    b = list->unbound;
+    while (b != NULL && b->unbound != NULL) {
+	a = a->unbound;
+	b = b->unbound->unbound;
+    }
+    b = a->unbound;
+    a->unbound = NULL;
+
+    /* ... sort each half and merge */
+    a = sort_unbound(list, mode);
+    b = sort_unbound(b, mode);
+    tailp = &head;
+    while (a != NULL && b != NULL) {
+	if (unbound_before(a, b, mode)) {
+	    *tailp = a;
+	    a = a->unbound;
+	}
+	else {
+	    *tailp = b;
+	    b = b->unbound;
+	}
+	tailp = &(*tailp)->unbound;
+    }
+    *tailp = a != NULL ? a : b;
+
+    return head;
+}
+
 /*
  * classes of "unbound" list instcntl_t scanning effort ...
  * counted in nuis[] below
@@ -1039,7 +1158,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
     __pmHashNode	*hp, *ihp;
     pmidcntl_t		*pcp = NULL;	/* initialize to pander to gcc */
     instcntl_t		*icp = NULL;	/* initialize to pander to gcc */
-    instcntl_t		*ub, *ub_prev;
+    instcntl_t		*ub_prev;
     int			back = 0;
     int			forw = 0;
     int			done;
@@ -1050,15 +1169,21 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
     long		nuis[] = { 0, 0, 0, 0, 0, 0, 0, 0 };
 			/* number of unbound items scanned */
 
-    PM_LOCK(__pmLock_extcall);
     if (dowrap == -1) {
-	/* PCP_COUNTER_WRAP in environment enables "counter wrap" logic */
-	if (getenv("PCP_COUNTER_WRAP") == NULL)		/* THREADSAFE */
-	    dowrap = 0;
-	else
-	    dowrap = 1;
+	/*
+	 * one-trip initialization, only take __pmLock_extcall the first
+	 * time, not for every fetch
+	 */
+	PM_LOCK(__pmLock_extcall);
+	if (dowrap == -1) {
+	    /* PCP_COUNTER_WRAP in environment enables "counter wrap" logic */
+	    if (getenv("PCP_COUNTER_WRAP") == NULL)		/* THREADSAFE */
+		dowrap = 0;
+	    else
+		dowrap = 1;
+	}
+	PM_UNLOCK(__pmLock_extcall);
     }
-    PM_UNLOCK(__pmLock_extcall);
 
     t_req = __pmTimestampSub(&ctxp->c_origin, __pmLogStartTime(ctxp->c_archctl));
     if (pmDebugOptions.interp) {
@@ -1341,21 +1466,10 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	    (IS_MARK(icp->s_next) && icp->t_prior == t_req)) {
 	    back++;
 	    icp->search = 1;
-	    /* Add it to the unbound list in descending order of t_first */
-	    ub_prev = NULL;
-	    for (ub = (instcntl_t *)ctxp->c_archctl->ac_unbound;
-		 ub != NULL;
-		 ub = ub->unbound) {
-		nuis[NUIS_FIRST]++;
-		if (icp->t_first >= ub->t_first)
-		    break;
-		ub_prev = ub;
-	    }
-	    if (ub_prev)
-		ub_prev->unbound = icp;
-	    else
-		ctxp->c_archctl->ac_unbound = icp;
-	    icp->unbound = ub;
+	    /* Add it to the unbound list, sorted below */
+	    nuis[NUIS_FIRST]++;
+	    icp->unbound = (instcntl_t *)ctxp->c_archctl->ac_unbound;
+	    ctxp->c_archctl->ac_unbound = icp;
 	    if (pmDebugOptions.interp)
 		dumpicp("search back", icp);
 	}
@@ -1366,6 +1480,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	 * at least one metric requires a bound from earlier in the log ...
 	 * position ourselves, ... and search
 	 */
+	ctxp->c_archctl->ac_unbound = sort_unbound((instcntl_t *)ctxp->c_archctl->ac_unbound, PM_MODE_BACK);
 	sts = __pmLogChangeVol(ctxp->c_archctl, ctxp->c_archctl->ac_vol);
 	if (sts < 0)
 	    goto all_done;
@@ -1404,38 +1519,39 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	    /*
 	     * Forget about those that can never be found from here
 	     * in this direction. The unbound list is sorted in order of
-	     * descending t_first. We can abandon the traversal once t_first is
-	     * less than t_this. Trim the list as instances are resolved.
+	     * descending first_bound(). We can abandon the traversal once
+	     * that is less than t_this. Trim the list as instances are
+	     * resolved, here or by update_bounds(). There may still be a
+	     * value at t_birth in another record with this timestamp, so
+	     * only forget once we are before t_birth.
 	     */
 	    ub_prev = NULL;
 	    for (icp = (instcntl_t *)ctxp->c_archctl->ac_unbound; icp != NULL; icp = icp->unbound) {
 		nuis[NUIS_FIRST_FORGET]++;
-		if (icp->t_first < t_this)
+		if (first_bound(icp) < t_this)
 		    break;
 		if (icp->search) {
+		    if ((icp->t_first < 0 || t_this > icp->t_first) &&
+			(icp->t_birth < 0 || t_this >= icp->t_birth)) {
+			ub_prev = icp;
+			continue;
+		    }
 		    icp->search = 0;
 		    SET_SCANNED(icp->s_prior);
+		    trim_first(icp, t_req);
 		    done++;
-		    /* Remove this item from the list. */
-		    if (ub_prev)
-			ub_prev->unbound = icp->unbound;
-		    else
-			ctxp->c_archctl->ac_unbound = icp->unbound;
 		}
+		/* Remove this item from the list. */
+		if (ub_prev)
+		    ub_prev->unbound = icp->unbound;
 		else
-		    ub_prev = icp;
+		    ctxp->c_archctl->ac_unbound = icp->unbound;
 	    }
 	}
 	/* end of search, trim t_first as required */
 	for (icp = (instcntl_t *)ctxp->c_archctl->ac_unbound; icp != NULL; icp = icp->unbound) {
 	    nuis[NUIS_FIRST_TRIM]++;
-	    if ((IS_UNDEFINED(icp->s_prior) || icp->t_prior > t_req) &&
-		icp->t_first < t_req) {
-		icp->t_first = t_req;
-		SET_SCANNED(icp->s_prior);
-		if (pmDebugOptions.interp)
-		    dumpicp("no values before t_first", icp);
-	    }
+	    trim_first(icp, t_req);
 	    icp->search = 0;
 	}
     }
@@ -1487,21 +1603,10 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	    forw++;
 	    icp->search = 1;
 
-	    /* Add it to the unbound list in ascending order of t_last */
-	    ub_prev = NULL;
-	    for (ub = (instcntl_t *)ctxp->c_archctl->ac_unbound;
-		 ub != NULL;
-		 ub = ub->unbound) {
-		nuis[NUIS_LAST]++;
-		if (icp->t_last <= ub->t_last)
-		    break;
-		ub_prev = ub;
-	    }
-	    if (ub_prev)
-		ub_prev->unbound = icp;
-	    else
-		ctxp->c_archctl->ac_unbound = icp;
-	    icp->unbound = ub;
+	    /* Add it to the unbound list, sorted below */
+	    nuis[NUIS_LAST]++;
+	    icp->unbound = (instcntl_t *)ctxp->c_archctl->ac_unbound;
+	    ctxp->c_archctl->ac_unbound = icp;
 	    if (pmDebugOptions.interp)
 		dumpicp("search forw", icp);
 	}
@@ -1512,6 +1617,7 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	 * at least one metric requires a bound from later in the log ...
 	 * position ourselves ... and search
 	 */
+	ctxp->c_archctl->ac_unbound = sort_unbound((instcntl_t *)ctxp->c_archctl->ac_unbound, PM_MODE_FORW);
 	sts = __pmLogChangeVol(ctxp->c_archctl, ctxp->c_archctl->ac_vol);
 	if (sts < 0)
 	    goto all_done;
@@ -1550,43 +1656,41 @@ __pmLogFetchInterp(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult *
 	    /*
 	     * Forget about those that can never be found from here
 	     * in this direction. The unbound list is sorted in order of
-	     * ascending t_last. We can abandon the traversal once t_last
-	     * is greater than than t_this. Trim the list as instances are
-	     * resolved.
+	     * ascending last_bound(), with those that have none at the
+	     * end. We can abandon the traversal once that is greater than
+	     * t_this or unknown. Trim the list as instances are resolved,
+	     * here or by update_bounds().
 	     */
 	    ub_prev = NULL;
 	    for (icp = (instcntl_t *)ctxp->c_archctl->ac_unbound; icp != NULL; icp = icp->unbound) {
+		double	t_bound = last_bound(icp);
+
 		nuis[NUIS_LAST_FORGET]++;
-		if (icp->t_last > t_this)
+		if (t_bound < 0 || t_bound > t_this)
 		    break;
-		if (icp->search && icp->t_last >= 0) {
+		if (icp->search) {
+		    if ((icp->t_last < 0 || t_this < icp->t_last) &&
+			(icp->t_death < 0 || t_this <= icp->t_death)) {
+			ub_prev = icp;
+			continue;
+		    }
 		    icp->search = 0;
 		    SET_SCANNED(icp->s_next);
+		    trim_last(icp, t_req);
 		    done++;
-		    /* Remove this item from the list. */
-		    if (ub_prev)
-			ub_prev->unbound = icp->unbound;
-		    else
-			ctxp->c_archctl->ac_unbound = icp->unbound;
 		}
+		/* Remove this item from the list. */
+		if (ub_prev)
+		    ub_prev->unbound = icp->unbound;
 		else
-		    ub_prev = icp;
+		    ctxp->c_archctl->ac_unbound = icp->unbound;
 	    }
 	}
 
 	/* end of search, trim t_last as required */
 	for (icp = (instcntl_t *)ctxp->c_archctl->ac_unbound; icp != NULL; icp = icp->unbound) {
 	    nuis[NUIS_LAST_TRIM]++;
-	    if (icp->t_next < t_req &&
-		(icp->t_last < 0 || t_req < icp->t_last)) {
-		icp->t_last = t_req;
-		SET_SCANNED(icp->s_next);
-		if (pmDebugOptions.interp) {
-		    char	strbuf[20];
-		    fprintf(stderr, "pmid %s inst %d no values after t_last=%.6f\n",
-			    pmIDStr_r(icp->metric->desc.pmid, strbuf, sizeof(strbuf)), icp->inst, icp->t_last);
-		}
-	    }
+	    trim_last(icp, t_req);
 	    icp->search = 0;
 	}
     }
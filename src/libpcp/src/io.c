@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017-2018,2020 Red Hat.
+ * Copyright (c) 2017-2018,2020,2026 Red Hat.
  * 
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -25,6 +25,10 @@
 #include "internal.h"
 
 extern __pm_fops __pm_stdio;
+#if defined(HAVE_SYS_MMAN_H) && !defined(IS_MINGW)
+#define HAVE_MMAP_HANDLER 1
+extern __pm_fops __pm_mmap;
+#endif
 #if HAVE_TRANSPARENT_DECOMPRESSION && HAVE_LZMA_DECOMPRESSION
 extern __pm_fops __pm_xz;
 #endif
@@ -425,10 +429,36 @@ __pmAccess(const char *path, int amode)
     return access(path, amode);
 }
 
+#ifdef HAVE_MMAP_HANDLER
+static int	do_mmap = -1;
+
+/*
+ * Uncompressed files opened read-only are mapped into memory only if
+ * $PCP_MMAP is set ... a file truncated while mapped raises SIGBUS in
+ * the reader, so this is opt-in.
+ */
+static int
+use_mmap(void)
+{
+    int		sts;
+
+    PM_LOCK(__pmLock_extcall);
+    if (do_mmap == -1) {
+	/* one-trip initialization */
+	do_mmap = getenv("PCP_MMAP") != NULL;		/* THREADSAFE */
+    }
+    sts = do_mmap;
+    PM_UNLOCK(__pmLock_extcall);
+    return sts;
+}
+#endif
+
 /*
  * Open a PCP file with given mode and return a __pmFILE. An i/o
  * handler is automatically chosen based on filename suffix, e.g. .xz, .gz,
- * etc. The stdio pass-thru handler will be chosen for other files.
+ * etc. If $PCP_MMAP is set, the mmap handler will be chosen for other
+ * files opened read-only, if they can be mapped, else the stdio
+ * pass-thru handler.
  * The stdio handler is the only handler currently supporting write operations.
  * Return a valid __pmFILE pointer on success or NULL on failure.
  */
@@ -499,6 +529,22 @@ __pmFopen(const char *path, const char *mode)
     	return NULL;
 
     memset(f, 0, sizeof(__pmFILE));
+
+#ifdef HAVE_MMAP_HANDLER
+    if (handler == &__pm_stdio && mode[0] == 'r' && mode[1] == '\0' &&
+	use_mmap()) {
+	/*
+	 * Try mapping the file first, this fails for anything that is
+	 * not a regular file and then stdio is used as usual.
+	 */
+	f->fops = &__pm_mmap;
+	if (f->fops->__pmopen(f, path, mode) != NULL) {
+	    if (pmDebugOptions.log)
+		fprintf(stderr, "__pmFopen(\"%s\", \"%s\"): mmap\n", path, mode);
+	    goto done;
+	}
+    }
+#endif
     f->fops = handler;
 
     /*
@@ -712,6 +758,17 @@ __pmSetvbuf(__pmFILE *f, char *buf, int mode, size_t size)
     return f->fops->__pmsetvbuf(f, buf, mode, size);
 }
 
+/*
+ * Access pattern hint, only some handlers make use of it.
+ */
+int
+__pmFadvise(__pmFILE *f, int advice)
+{
+    if (f->fops->__pmadvise == NULL)
+	return 0;
+    return f->fops->__pmadvise(f, advice);
+}
+
 /*
  * Deallocate and close a PCP file that was previously opened
  * with __pmFopen(). Return 0 for success.
@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * Read-only i/o handler for uncompressed files, using a memory mapping
+ * of the whole file, so a read or getc is a copy from the mapping and
+ * a seek or tell is just arithmetic on the position, with no system
+ * calls and no stdio buffer in between.
+ *
+ * An archive may be read while pmlogger is still appending to it, so
+ * when a read or a seek relative to the end would go past the end of
+ * the mapping, the file size is checked again and if the file has grown
+ * it is mapped again.  A file that is truncated while mapped cannot be
+ * detected without a system call per read, and touching the mapping
+ * past the new end raises SIGBUS, so __pmFopen() only uses this handler
+ * when $PCP_MMAP is set.
+ *
+ * The open method fails for anything that is not a regular file or
+ * cannot be mapped, and __pmFopen() uses the stdio handler instead.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include "pmapi.h"
+#include "libpcp.h"
+#include "internal.h"
+
+typedef struct {
+    int		fd;
+    char	*base;		/* start of mapping, NULL if nothing mapped */
+    size_t	size;		/* bytes mapped */
+    int		eof;
+    int		err;
+    int		advice;		/* PM_FADV_* last applied */
+} mmap_ctl_t;
+
+static void
+mmap_madvise(mmap_ctl_t *mp)
+{
+#ifdef MADV_SEQUENTIAL
+    int		advice;
+
+    if (mp->base == NULL)
+	return;
+    switch (mp->advice) {
+	case PM_FADV_SEQUENTIAL:
+	    advice = MADV_SEQUENTIAL;
+	    break;
+	case PM_FADV_RANDOM:
+	    advice = MADV_RANDOM;
+	    break;
+	default:
+	    advice = MADV_NORMAL;
+	    break;
+    }
+    /* only a hint, so errors do not matter */
+    (void)madvise(mp->base, mp->size, advice);
+#else
+    (void)mp;
+#endif
+}
+
+/*
+ * map the file again if it is now bigger than the current mapping,
+ * return 1 if there is more to read, else 0
+ */
+static int
+mmap_grow(mmap_ctl_t *mp)
+{
+    struct stat	sbuf;
+    char	*base;
+
+    if (fstat(mp->fd, &sbuf) < 0 || sbuf.st_size <= (off_t)mp->size)
+	return 0;
+    if ((off_t)(size_t)sbuf.st_size != sbuf.st_size)
+	/* too big for the address space, keep what we have */
+	return 0;
+    base = mmap(NULL, (size_t)sbuf.st_size, PROT_READ, MAP_SHARED, mp->fd, 0);
+    if (base == MAP_FAILED)
+	return 0;
+    if (mp->base != NULL)
+	munmap(mp->base, mp->size);
+    mp->base = base;
+    mp->size = (size_t)sbuf.st_size;
+    if (mp->advice != PM_FADV_NORMAL)
+	mmap_madvise(mp);
+    if (pmDebugOptions.log)
+	fprintf(stderr, "mmap_grow: fd=%d remapped %zu bytes\n",
+		mp->fd, mp->size);
+    return 1;
+}
+
+static void *
+mmap_open(__pmFILE *f, const char *path, const char *mode)
+{
+    mmap_ctl_t	*mp;
+    struct stat	sbuf;
+    int		fd;
+
+    if (mode[0] != 'r' || mode[1] != '\0')
+	return NULL;
+    if ((fd = open(path, O_RDONLY)) < 0)
+	return NULL;
+    if (fstat(fd, &sbuf) < 0 || !S_ISREG(sbuf.st_mode) ||
+	(off_t)(size_t)sbuf.st_size != sbuf.st_size) {
+	close(fd);
+	return NULL;
+    }
+    if ((mp = (mmap_ctl_t *)calloc(1, sizeof(mmap_ctl_t))) == NULL) {
+	close(fd);
+	return NULL;
+    }
+    mp->fd = fd;
+    mp->advice = PM_FADV_NORMAL;
+    if (sbuf.st_size > 0) {
+	mp->base = mmap(NULL, (size_t)sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (mp->base == MAP_FAILED) {
+	    free(mp);
+	    close(fd);
+	    return NULL;
+	}
+	mp->size = (size_t)sbuf.st_size;
+    }
+
+    f->priv = (void *)mp;
+    f->position = 0;
+
+    return f;
+}
+
+static void *
+mmap_fdopen(__pmFILE *f, int fd, const char *mode)
+{
+    /* Not implemented, __pmFdopen() always uses stdio */
+    (void)f;
+    (void)fd;
+    (void)mode;
+    return NULL;
+}
+
+static int
+mmap_seek(__pmFILE *f, off_t offset, int whence)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+
+    switch (whence) {
+	case SEEK_SET:
+	    break;
+	case SEEK_CUR:
+	    offset += f->position;
+	    break;
+	case SEEK_END:
+	    mmap_grow(mp);
+	    offset += (off_t)mp->size;
+	    break;
+	default:
+	    setoserror(EINVAL);
+	    return -1;
+    }
+    if (offset < 0) {
+	setoserror(EINVAL);
+	return -1;
+    }
+    f->position = offset;
+    mp->eof = 0;
+    return 0;
+}
+
+static void
+mmap_rewind(__pmFILE *f)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+
+    f->position = 0;
+    mp->eof = mp->err = 0;
+}
+
+static off_t
+mmap_tell(__pmFILE *f)
+{
+    return f->position;
+}
+
+static int
+mmap_getc(__pmFILE *f)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+
+    if (f->position >= (off_t)mp->size &&
+	(!mmap_grow(mp) || f->position >= (off_t)mp->size)) {
+	mp->eof = 1;
+	return EOF;
+    }
+    return (unsigned char)mp->base[f->position++];
+}
+
+static size_t
+mmap_read(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+    size_t	want;
+    size_t	avail;
+
+    if (size == 0 || nmemb == 0)
+	return 0;
+    want = size * nmemb;
+    avail = f->position < (off_t)mp->size ? mp->size - f->position : 0;
+    if (want > avail && mmap_grow(mp))
+	avail = f->position < (off_t)mp->size ? mp->size - f->position : 0;
+    if (want > avail) {
+	mp->eof = 1;
+	want = avail;
+    }
+    if (want > 0) {
+	memcpy(ptr, &mp->base[f->position], want);
+	f->position += want;
+    }
+    return want / size;
+}
+
+static size_t
+mmap_write(void *ptr, size_t size, size_t nmemb, __pmFILE *f)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+
+    /* Read only, like stdio for a stream opened with mode "r" */
+    (void)ptr;
+    (void)size;
+    (void)nmemb;
+    mp->err = 1;
+    setoserror(EBADF);
+    return 0;
+}
+
+static int
+mmap_flush(__pmFILE *f)
+{
+    /* nothing is buffered */
+    (void)f;
+    return 0;
+}
+
+static int
+mmap_fsync(__pmFILE *f)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+    return fsync(mp->fd);
+}
+
+static int
+mmap_fileno(__pmFILE *f)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+    return mp->fd;
+}
+
+static off_t
+mmap_lseek(__pmFILE *f, off_t offset, int whence)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+    return lseek(mp->fd, offset, whence);
+}
+
+static int
+mmap_fstat(__pmFILE *f, struct stat *buf)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+    return fstat(mp->fd, buf);
+}
+
+static int
+mmap_feof(__pmFILE *f)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+    return mp->eof;
+}
+
+static int
+mmap_ferror(__pmFILE *f)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+    return mp->err;
+}
+
+static void
+mmap_clearerr(__pmFILE *f)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+    mp->eof = mp->err = 0;
+}
+
+static int
+mmap_setvbuf(__pmFILE *f, char *buf, int mode, size_t size)
+{
+    /* nothing is buffered */
+    (void)f;
+    (void)buf;
+    (void)mode;
+    (void)size;
+    return 0;
+}
+
+static int
+mmap_advise(__pmFILE *f, int advice)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+
+    if (advice != mp->advice) {
+	mp->advice = advice;
+	mmap_madvise(mp);
+    }
+    return 0;
+}
+
+static int
+mmap_close(__pmFILE *f)
+{
+    mmap_ctl_t	*mp = (mmap_ctl_t *)f->priv;
+    int		sts;
+
+    if (mp->base != NULL)
+	munmap(mp->base, mp->size);
+    sts = close(mp->fd);
+    free(mp);
+    return sts;
+}
+
+__pm_fops __pm_mmap = {
+    /*
+     * mmap - read only, no compression
+     */
+    .__pmopen = mmap_open,
+    .__pmfdopen = mmap_fdopen,
+    .__pmseek = mmap_seek,
+    .__pmrewind = mmap_rewind,
+    .__pmtell = mmap_tell,
+    .__pmfgetc = mmap_getc,
+    .__pmread = mmap_read,
+    .__pmwrite = mmap_write,
+    .__pmflush = mmap_flush,
+    .__pmfsync = mmap_fsync,
+    .__pmfileno = mmap_fileno,
+    .__pmlseek = mmap_lseek,
+    .__pmfstat = mmap_fstat,
+    .__pmfeof = mmap_feof,
+    .__pmferror = mmap_ferror,
+    .__pmclearerr = mmap_clearerr,
+    .__pmsetvbuf = mmap_setvbuf,
+    .__pmadvise = mmap_advise,
+    .__pmclose = mmap_close
+};
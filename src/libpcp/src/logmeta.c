@@ -1568,18 +1568,22 @@ pmNameInDomArchive(pmInDom indom, int inst, char **name)
  * Indoms larger than HASH_THRESHOLD will use a hash table
  * to search the instance and name lists to be returned.
  * Smaller indoms will use the regular linear search.
+ *
+ * The hash table is allocated for each call, as only the context
+ * is locked and other threads may be doing the same thing for
+ * their own contexts.
  */
 #define HASH_THRESHOLD	16
 #define HASH_SIZE	509 /* prime */
 
-static struct {
+typedef struct {
     int			len;
     int			max;
     int			*list;
-} ihash[HASH_SIZE];
+} ihash_t;
 
 static int
-find_add_ihash(int id)
+find_add_ihash(ihash_t *ihash, int id)
 {
     int			*tmp, j, i = id % HASH_SIZE; 
 
@@ -1606,13 +1610,13 @@ find_add_ihash(int id)
 }
 
 static void
-reset_ihash(void)
+free_ihash(ihash_t *ihash)
 {
     int			i;
 
-    /* invalidate all entries, but don't free the memory */
     for (i = 0; i < HASH_SIZE; i++)
-    	ihash[i].len = 0;
+	free(ihash[i].list);
+    free(ihash);
 }
 
 /*
@@ -1634,7 +1638,7 @@ pmGetInDomArchive_ctx(__pmContext *ctxp, pmInDom indom, int **instlist, char ***
     int			*ilist = NULL;
     char		**nlist = NULL;
     char		**olist;
-    int			big_indom = 0;
+    ihash_t		*ihash = NULL;
     int			need_unlock = 0;
 
     /* avoid ambiguity when no instances or errors */
@@ -1671,17 +1675,17 @@ pmGetInDomArchive_ctx(__pmContext *ctxp, pmInDom indom, int **instlist, char ***
 	    __pmLogUndeltaInDom(indom, idp);
 	}
 	if (idp->numinst > HASH_THRESHOLD) {
-	    big_indom = 1;
-	    reset_ihash();
+	    if ((ihash = (ihash_t *)calloc(HASH_SIZE, sizeof(ihash_t))) == NULL)
+		pmNoMem("pmGetInDomArchive: ihash", HASH_SIZE * sizeof(ihash_t), PM_FATAL_ERR);
 	    break;
 	}
     }
 
     for (idp = (__pmLogInDom *)hp->data; idp != NULL; idp = idp->next) {
 	for (j = 0; j < idp->numinst; j++) {
-	    if (big_indom) {
+	    if (ihash != NULL) {
 		/* big indom - use a hash table */
-		i = find_add_ihash(idp->instlist[j]) ? 0 : numinst;
+		i = find_add_ihash(ihash, idp->instlist[j]) ? 0 : numinst;
 	    }
 	    else {
 		/* small indom - linear search */
@@ -1723,6 +1727,8 @@ PM_FAULT_POINT("libpcp/" __FILE__ ":9", PM_FAULT_ALLOC);
 	p += strlen(nlist[i]) + 1;
     }
     free(nlist);
+    if (ihash != NULL)
+	free_ihash(ihash);
     *instlist = ilist;
     *namelist = olist;
     n = numinst;
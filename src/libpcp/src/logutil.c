@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2017,2020-2022 Red Hat.
+ * Copyright (c) 2012-2017,2020-2022,2026 Red Hat.
  * Copyright (c) 1995-2002,2004 Silicon Graphics, Inc.  All Rights Reserved.
  *
  * This library is free software; you can redistribute it and/or modify it
@@ -243,6 +243,16 @@ __pmLogName(const char *base, int vol)
 
 __pmFILE *
 __pmLogNewFile(const char *base, int vol)
+{
+    return __pmLogNewFileBuf(base, vol, 0);
+}
+
+/*
+ * As for __pmLogNewFile(), but with full buffering of bufsize bytes
+ * rather than unbuffered I/O when bufsize is not zero.
+ */
+__pmFILE *
+__pmLogNewFileBuf(const char *base, int vol, size_t bufsize)
 {
     char	fname[MAXPATHLEN];
     __pmFILE	*f;
@@ -271,8 +281,13 @@ __pmLogNewFile(const char *base, int vol)
      * Want unbuffered I/O for all files of the archive, so a single
      * fwrite() maps to one logical record for each of the metadata
      * records, the index records and the data (pmResult) records.
+     * A writer that does its own flushing (pmlogger -b) may instead
+     * ask for a buffer, which must be set here before any other I/O.
      */
-    __pmSetvbuf(f, NULL, _IONBF, 0);
+    if (bufsize > 0)
+	__pmSetvbuf(f, NULL, _IOFBF, bufsize);
+    else
+	__pmSetvbuf(f, NULL, _IONBF, 0);
 
     if ((save_error = __pmSetVersionIPC(__pmFileno(f), PDU_VERSION)) < 0) {
 	char	errmsg[PM_MAXERRMSGLEN];
@@ -303,8 +318,8 @@ __pmLogCreate(const char *host, const char *base, int log_version,
     lcp->tifp = lcp->mdfp = acp->ac_mfp = NULL;
 
     if ((lcp->tifp = __pmLogNewFile(base, PM_LOG_VOL_TI)) != NULL) {
-	if ((lcp->mdfp = __pmLogNewFile(base, PM_LOG_VOL_META)) != NULL) {
-	    if ((acp->ac_mfp = __pmLogNewFile(base, 0)) != NULL) {
+	if ((lcp->mdfp = __pmLogNewFileBuf(base, PM_LOG_VOL_META, lcp->bufsize)) != NULL) {
+	    if ((acp->ac_mfp = __pmLogNewFileBuf(base, 0, lcp->bufsize)) != NULL) {
 		char	*tz, tzbuf[MAXIMUM(PM_TZ_MAXLEN, PM_MAX_TIMEZONELEN)];
 		size_t	bytes;
 
@@ -1480,6 +1495,12 @@ __pmLogRead_ctx(__pmContext *ctxp, int mode, __pmFILE *peekf, __pmResult **resul
     }
 
 again:
+    /*
+     * read-ahead only helps going forwards, this is a no-op unless the
+     * hint changes and the volume is memory mapped
+     */
+    __pmFadvise(f, mode == PM_MODE_BACK ? PM_FADV_RANDOM : PM_FADV_SEQUENTIAL);
+
     n = (int)__pmFread(&head, 1, sizeof(head), f);
     head = ntohl(head); /* swab head */
     if (n != sizeof(head)) {
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2014,2021-2022 Red Hat.
+ * Copyright (c) 2012-2014,2021-2022,2026 Red Hat.
  * Copyright (c) 1995-2000 Silicon Graphics, Inc.  All Rights Reserved.
  *
  * This library is free software; you can redistribute it and/or modify it
@@ -932,3 +932,283 @@ __pmDecodeHighResResult(__pmPDU *pdubuf, __pmResult **result)
 {
     return __pmDecodeHighResResult_ctx(NULL, pdubuf, result);
 }
+
+/*
+ * PDU for a delta-encoded pmHighResResult (PDU_DELTA_RESULT), sent in
+ * place of PDU_HIGHRES_RESULT when the client asked for PDU_FLAG_DELTA.
+ *
+ * The PDU_HIGHRES_RESULT is encoded word by word (after the header)
+ * relative to the last one sent for the same context, as a series of
+ * runs: the number of words unchanged, the number of words that
+ * follow, then for each of those the difference from the same word
+ * last time.  Each of these is a varint, and the differences are
+ * zig-zag encoded first, so a counter that moved a little costs a
+ * byte or two and a value that did not change costs nothing.
+ *
+ * If there is no last result, or it is a different size (metrics,
+ * instances or the length of some value have changed), the encoding
+ * is relative to a result of all zeroes, so base is 0.  The receiver
+ * checks base against the serial of its own last result, and any
+ * mismatch fails the decode rather than producing the wrong values.
+ *
+ * length sizes the receiver's copy of the last result before any of
+ * the runs are checked, so it is bounded by DELTA_MAXLEN, and bigger
+ * results are sent as a plain PDU_HIGHRES_RESULT instead.
+ */
+typedef struct {
+    __pmPDUHdr		hdr;
+    int			serial;		/* serial number of this result */
+    int			base;		/* serial number it is relative to */
+    int			length;		/* bytes in the PDU_HIGHRES_RESULT */
+    int			nbytes;		/* bytes of runs in data[] */
+    __pmPDU		data[1];	/* runs of varints */
+} delta_result_t;
+
+#define DELTA_HDR	(sizeof(delta_result_t) - sizeof(__pmPDU))
+#define DELTA_MAXLEN	(16 * 1024 * 1024)
+#define DELTA_WORD(p, i) ((p) == NULL ? 0 : (p)[i])
+
+static unsigned char *
+put_varint(unsigned char *p, __uint32_t value)
+{
+    while (value >= 0x80) {
+	*p++ = (value & 0x7f) | 0x80;
+	value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+static unsigned char *
+get_varint(unsigned char *p, unsigned char *end, __uint32_t *value)
+{
+    __uint32_t	v = 0;
+    int		shift;
+
+    for (shift = 0; p < end && shift < 32; shift += 7) {
+	v |= (__uint32_t)(*p & 0x7f) << shift;
+	if ((*p++ & 0x80) == 0) {
+	    *value = v;
+	    return p;
+	}
+    }
+    return NULL;
+}
+
+void
+__pmResetResultDelta(__pmResultDelta *dp)
+{
+    /* serial continues, so a result is never mistaken for an older one */
+    if (dp->pdu != NULL)
+	free(dp->pdu);
+    dp->pdu = NULL;
+    dp->len = 0;
+}
+
+/*
+ * Keep a copy of the last result (PDU_HIGHRES_RESULT format) as the
+ * base for the next delta
+ */
+static int
+delta_keep(__pmResultDelta *dp, const __pmPDU *pdubuf, int len)
+{
+    __pmPDU	*pdu;
+
+    if (dp->len != len) {
+	if ((pdu = (__pmPDU *)realloc(dp->pdu, len)) == NULL) {
+	    __pmResetResultDelta(dp);
+	    return -oserror();
+	}
+	dp->pdu = pdu;
+	dp->len = len;
+    }
+    if (pdubuf != NULL)
+	memcpy(dp->pdu, pdubuf, len);
+    else
+	memset(dp->pdu, 0, len);
+    return 0;
+}
+
+int
+__pmSendDeltaResult(int fd, int from, const __pmResult *result, __pmResultDelta *dp)
+{
+    __pmPDU		*pdubuf;
+    __pmPDU		*base;
+    __pmPDU		*outbuf;
+    delta_result_t	*pp;
+    unsigned char	*p;
+    __uint32_t		diff;
+    size_t		need;
+    int			len, nwords, skip, count;
+    int			i, sts;
+
+    if (pmDebugOptions.pdu)
+	__pmPrintResult_ctx(NULL, stderr, result);
+    if ((sts = __pmEncodeHighResResult(result, &pdubuf)) < 0)
+	return sts;
+    len = ((__pmPDUHdr *)pdubuf)->len;
+    if (len > DELTA_MAXLEN) {
+	/* too big for the receiver to keep, the next delta starts over */
+	__pmResetResultDelta(dp);
+	((__pmPDUHdr *)pdubuf)->from = from;
+	sts = __pmXmitPDU(fd, pdubuf);
+	__pmUnpinPDUBuf(pdubuf);
+	return sts;
+    }
+    nwords = len / sizeof(__pmPDU);
+    base = (dp->pdu != NULL && dp->len == len) ? dp->pdu : NULL;
+
+    /* worst case, 5 bytes for each word and 10 for each run */
+    need = DELTA_HDR + nwords * 5 + (nwords / 2 + 1) * 10;
+    if ((outbuf = __pmFindPDUBuf((int)need)) == NULL) {
+	sts = -oserror();
+	__pmUnpinPDUBuf(pdubuf);
+	return sts;
+    }
+    pp = (delta_result_t *)outbuf;
+    p = (unsigned char *)pp->data;
+    i = sizeof(__pmPDUHdr) / sizeof(__pmPDU);
+    while (i < nwords) {
+	for (skip = 0; i < nwords && pdubuf[i] == DELTA_WORD(base, i); i++)
+	    skip++;
+	if (i == nwords)
+	    break;
+	/* a run continues over a single unchanged word, cheaper than a new run */
+	for (count = 1; i + count < nwords; count++) {
+	    if (pdubuf[i+count] == DELTA_WORD(base, i+count) &&
+		(i + count + 1 == nwords ||
+		 pdubuf[i+count+1] == DELTA_WORD(base, i+count+1)))
+		break;
+	}
+	p = put_varint(p, skip);
+	p = put_varint(p, count);
+	for ( ; count > 0; count--, i++) {
+	    diff = ntohl(pdubuf[i]) - ntohl(DELTA_WORD(base, i));
+	    p = put_varint(p, (diff << 1) ^ (__uint32_t)((__int32_t)diff >> 31));
+	}
+    }
+
+    pp->nbytes = (int)(p - (unsigned char *)pp->data);
+    while ((p - (unsigned char *)pp->data) % sizeof(__pmPDU))
+	*p++ = '~';	/* buffer end */
+    pp->hdr.len = (int)(p - (unsigned char *)outbuf);
+    pp->hdr.type = PDU_DELTA_RESULT;
+    pp->hdr.from = from;
+    pp->base = htonl(base == NULL ? 0 : dp->serial);
+    dp->serial = (dp->serial == INT_MAX) ? 1 : dp->serial + 1;
+    pp->serial = htonl(dp->serial);
+    pp->length = htonl(len);
+    pp->nbytes = htonl(pp->nbytes);
+
+    sts = __pmXmitPDU(fd, outbuf);
+    __pmUnpinPDUBuf(outbuf);
+    if (sts >= 0)
+	delta_keep(dp, pdubuf, len);
+    __pmUnpinPDUBuf(pdubuf);
+    return sts;
+}
+
+/*
+ * Internal variant of __pmDecodeDeltaResult() with the last result
+ * for the context, or none
+ */
+static int
+DecodeDeltaResult(__pmContext *ctxp, __pmPDU *pdubuf, __pmResultDelta *dp,
+		__pmResult **result)
+{
+    delta_result_t	*pp;
+    __pmPDUHdr		*php;
+    __pmPDU		*newbuf;
+    unsigned char	*p, *end;
+    __uint32_t		skip, count, diff;
+    int			serial, base, len, nbytes, nwords;
+    int			i, sts;
+
+    pp = (delta_result_t *)pdubuf;
+    if (pp->hdr.len < (int)DELTA_HDR) {
+	if (pmDebugOptions.pdu && pmDebugOptions.desperate)
+	    fprintf(stderr, "%s: Bad: len=%d smaller than min %d\n",
+			    "__pmDecodeDeltaResult", pp->hdr.len, (int)DELTA_HDR);
+	return PM_ERR_IPC;
+    }
+    serial = ntohl(pp->serial);
+    base = ntohl(pp->base);
+    len = ntohl(pp->length);
+    nbytes = ntohl(pp->nbytes);
+    if (serial <= 0 || base < 0 || nbytes < 0 ||
+	nbytes > pp->hdr.len - (int)DELTA_HDR ||
+	len < (int)(sizeof(highres_result_t) - (sizeof(__pmPDU) * 2)) ||
+	len > DELTA_MAXLEN || len % sizeof(__pmPDU) != 0) {
+	if (pmDebugOptions.pdu && pmDebugOptions.desperate)
+	    fprintf(stderr, "%s: Bad: serial=%d base=%d length=%d nbytes=%d\n",
+			    "__pmDecodeDeltaResult", serial, base, len, nbytes);
+	return PM_ERR_IPC;
+    }
+    if (base != 0 && (base != dp->serial || dp->len != len)) {
+	/* a result was lost along the way, the sender must start again */
+	if (pmDebugOptions.pdu)
+	    fprintf(stderr, "%s: result %d is relative to %d, last result %d\n",
+			    "__pmDecodeDeltaResult", serial, base, dp->serial);
+	__pmResetResultDelta(dp);
+	return PM_ERR_IPC;
+    }
+    if (base == 0 && (sts = delta_keep(dp, NULL, len)) < 0)
+	return sts;
+
+    nwords = len / sizeof(__pmPDU);
+    i = sizeof(__pmPDUHdr) / sizeof(__pmPDU);
+    p = (unsigned char *)pp->data;
+    end = p + nbytes;
+    while (p < end) {
+	if ((p = get_varint(p, end, &skip)) == NULL ||
+	    (p = get_varint(p, end, &count)) == NULL ||
+	    skip > nwords - i || count > nwords - i - skip)
+	    goto bad;
+	for (i += skip; count > 0; count--, i++) {
+	    if ((p = get_varint(p, end, &diff)) == NULL)
+		goto bad;
+	    diff = (diff >> 1) ^ -(diff & 1);
+	    dp->pdu[i] = htonl(ntohl(dp->pdu[i]) + diff);
+	}
+    }
+    dp->serial = serial;
+
+    /* decode a copy, as decoding changes the PDU buffer */
+    if ((newbuf = __pmFindPDUBuf(len)) == NULL)
+	return -oserror();
+    memcpy(newbuf, dp->pdu, len);
+    php = (__pmPDUHdr *)newbuf;
+    php->len = len;
+    php->type = PDU_HIGHRES_RESULT;
+    php->from = pp->hdr.from;
+    sts = __pmDecodeHighResResult_ctx(ctxp, newbuf, result);
+    __pmUnpinPDUBuf(newbuf);
+    return sts;
+
+bad:
+    if (pmDebugOptions.pdu && pmDebugOptions.desperate)
+	fprintf(stderr, "%s: Bad: runs overflow result of length %d\n",
+			"__pmDecodeDeltaResult", len);
+    __pmResetResultDelta(dp);
+    return PM_ERR_IPC;
+}
+
+int
+__pmDecodeDeltaResult_ctx(__pmContext *ctxp, __pmPDU *pdubuf, __pmResult **result)
+{
+    int		sts;
+
+    PM_ASSERT_IS_LOCKED(ctxp->c_lock);
+
+    sts = DecodeDeltaResult(ctxp, pdubuf, &ctxp->c_pmcd->pc_delta, result);
+    if (sts < 0)
+	/* resend the profile, then pmcd starts again with no last result */
+	ctxp->c_sent = 0;
+    return sts;
+}
+
+int
+__pmDecodeDeltaResult(__pmPDU *pdubuf, __pmResultDelta *dp, __pmResult **result)
+{
+    return DecodeDeltaResult(NULL, pdubuf, dp, result);
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2015,2017,2021 Red Hat.
+ * Copyright (c) 2012-2015,2017,2021,2026 Red Hat.
  * Copyright (c) 1995-2005 Silicon Graphics, Inc.  All Rights Reserved.
  *
  * This library is free software; you can redistribute it and/or modify it
@@ -376,6 +376,7 @@ __pmPDUTypeStr_r(int type, char *buf, int buflen)
     case PDU_HIGHRES_RESULT:	res = "HIGHRES_RESULT"; break;
     case PDU_DESC_IDS:		res = "DESC_IDS"; break;
     case PDU_DESCS:		res = "DESCS"; break;
+    case PDU_DELTA_RESULT:	res = "DELTA_RESULT"; break;
     default:			res = NULL; break;
     }
     if (res)
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012 Red Hat.
+ * Copyright (c) 2012,2026 Red Hat.
  * Copyright (c) 2007-2008 Aconex.  All Rights Reserved.
  * Copyright (c) 1997,2005 Silicon Graphics, Inc.  All Rights Reserved.
  * 
@@ -269,7 +269,7 @@ QmcContext::addMetric(QmcMetric *metric)
 }
 
 int
-QmcContext::fetch(bool update)
+QmcContext::fetch(bool update, pmResult *prefetched)
 {
     int i, sts;
     pmResult *result;
@@ -322,8 +322,14 @@ QmcContext::fetch(bool update)
 	    cerr << "QmcContext::fetch: fetching context " << *this << Qt::endl;
 	}
 
-	sts = pmFetch(my.pmids.size(), 
-		      (pmID *)(my.pmids.toVector().data()), &result);
+	if (prefetched) {
+	    result = prefetched;
+	    prefetched = NULL;
+	    sts = 0;
+	}
+	else
+	    sts = pmFetch(my.pmids.size(), 
+			  (pmID *)(my.pmids.toVector().data()), &result);
 	if (sts >= 0) {
 	    my.previousTime = my.currentTime;
 	    my.currentTime = result->timestamp;
@@ -370,6 +376,8 @@ QmcContext::fetch(bool update)
 	cerr << "QmcContext::fetch: nothing to fetch" << Qt::endl;
     }
 
+    if (prefetched)
+	pmFreeResult(prefetched);
     return sts;
 }
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012 Red Hat.
+ * Copyright (c) 2012,2026 Red Hat.
  * Copyright (c) 2007 Aconex.  All Rights Reserved.
  * Copyright (c) 1998-2005 Silicon Graphics, Inc.  All Rights Reserved.
  * 
@@ -45,6 +45,9 @@ public:
     pmID id(unsigned int index) const	// Access to each unique pmID
 	{ return my.pmids[index]; }
 
+    QList<pmID> const& ids() const	// All unique pmIDs, as fetched
+	{ return my.pmids; }
+
     QmcDesc const& desc(pmID pmid) const
 	{ return *(my.descCache.value(pmid)); }
     QmcDesc& desc(pmID pmid)		// Access to each descriptor
@@ -81,7 +84,9 @@ public:
 
     void addMetric(QmcMetric* metric);	// Add a metric using this context
 
-    int fetch(bool update);		// Fetch metrics using this context
+    // Fetch metrics using this context, or take the values from the
+    // <prefetched> result for the ids() instead (and free it)
+    int fetch(bool update, pmResult *prefetched = NULL);
 
     struct timeval const& timeStamp() const
 	{ return my.currentTime; }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2013-2016, Red Hat.
+ * Copyright (c) 2013-2016,2026, Red Hat.
  * Copyright (c) 2007 Aconex.  All Rights Reserved.
  * Copyright (c) 1997-2005 Silicon Graphics, Inc.  All Rights Reserved.
  * 
@@ -40,6 +40,7 @@ QmcGroup::QmcGroup(bool restrictArchives)
     my.tzUser = -1;
     my.tzGroupIndex = 0;
     my.timeEndReal = 0.0;
+    my.prefetch = NULL;
 
     // Get timezone from environment
     if (tzLocalInit == false) {
@@ -66,6 +67,8 @@ QmcGroup::QmcGroup(bool restrictArchives)
 
 QmcGroup::~QmcGroup()
 {
+    if (my.prefetch)
+	delete my.prefetch;
     for (int i = 0; i < my.contexts.size(); i++)
 	if (my.contexts[i])
 	    delete my.contexts[i];
@@ -204,6 +207,10 @@ QmcGroup::use(int type, const QString &theSource, int flags)
 
 	my.contexts.append(newContext);
 	my.use = my.contexts.size() - 1;
+	if (my.prefetch && type == PM_CONTEXT_ARCHIVE) {
+	    prefetchContext(my.use);
+	    useContext();
+	}
 
 	if (pmDebugOptions.pmc) {
 	    QTextStream cerr(stderr);
@@ -469,7 +476,7 @@ QmcGroup::addMetric(pmMetricSpec *theMetric, double theScale, bool active)
 }
 
 int
-QmcGroup::fetch(bool update)
+QmcGroup::fetch(bool update, bool forward)
 {
     int sts = 0;
 
@@ -478,8 +485,35 @@ QmcGroup::fetch(bool update)
 	cerr << "QmcGroup::fetch: " << numContexts() << " contexts" << Qt::endl;
     }
 
-    for (unsigned int i = 0; i < numContexts(); i++)
-	my.contexts[i]->fetch(update);
+    // QmcMetric::update() fills in this row
+    if (update && my.store.enabled())
+	my.store.push(forward);
+
+    if (my.prefetch && my.deferred.size() < (int)numContexts())
+	my.deferred.resize(numContexts());
+
+    for (unsigned int i = 0; i < numContexts(); i++) {
+	QmcContext *context = my.contexts[i];
+	pmResult *prefetched = NULL;
+
+	if (my.prefetch && context->source().type() == PM_CONTEXT_ARCHIVE) {
+	    my.prefetch->setPMIDs(i, context->ids());
+	    if ((prefetched = my.prefetch->take(i)) != NULL)
+		my.deferred[i] = true;
+	    else if (my.deferred[i]) {
+		// not prefetched (yet), catch up and fetch directly
+		struct timeval when;
+		my.prefetch->position(&when);
+		setContextMode(i, my.prefetch->mode(), &when,
+			       my.prefetch->interval());
+		my.deferred[i] = false;
+	    }
+	}
+	context->fetch(update, prefetched);
+    }
+
+    if (my.prefetch)
+	my.prefetch->advance();
 
     if (numContexts())
 	sts = useContext();
@@ -492,33 +526,104 @@ QmcGroup::fetch(bool update)
     return sts;
 }
 
+int
+QmcGroup::setContextMode(unsigned int index, int mode,
+			 const struct timeval *when, int interval)
+{
+    QmcContext *context = my.contexts[index];
+    int sts;
+
+    sts = pmUseContext(context->handle());
+    if (sts < 0) {
+	pmprintf("%s: Error: Unable to switch to context for %s: %s\n",
+		 pmGetProgname(), context->source().sourceAscii(),
+		 pmErrStr(sts));
+	return sts;
+    }
+    sts = pmSetMode(mode, when, interval);
+    if (sts < 0) {
+	pmprintf("%s: Error: Unable to set context mode for %s: %s\n",
+		 pmGetProgname(), context->source().sourceAscii(),
+		 pmErrStr(sts));
+    }
+    return sts;
+}
+
 int
 QmcGroup::setArchiveMode(int mode, const struct timeval *when, int interval)
 {
     int sts, result = 0;
 
+    // Each context is positioned on its first fetch that misses the
+    // prefetched samples, so seeking costs nothing until then
+    if (my.prefetch && my.prefetch->seek(mode, when, interval)) {
+	my.deferred.fill(true, numContexts());
+	return 0;
+    }
+    my.deferred.fill(false, numContexts());
+
     for (unsigned int i = 0; i < numContexts(); i++) {
 	if (my.contexts[i]->source().type() != PM_CONTEXT_ARCHIVE)
 	    continue;
-
-	sts = pmUseContext(my.contexts[i]->handle());
-	if (sts < 0) {
-	    pmprintf("%s: Error: Unable to switch to context for %s: %s\n",
-		     pmGetProgname(), my.contexts[i]->source().sourceAscii(),
-		     pmErrStr(sts));
-	    result = sts;
-	    continue;
-	}
-	sts = pmSetMode(mode, when, interval);
-	if (sts < 0) {
-	    pmprintf("%s: Error: Unable to set context mode for %s: %s\n",
-		     pmGetProgname(), my.contexts[i]->source().sourceAscii(),
-		     pmErrStr(sts));
+	if ((sts = setContextMode(i, mode, when, interval)) < 0)
 	    result = sts;
-	}
     }
     sts = useContext();
     if (sts < 0)
 	result = sts;
     return result;
 }
+
+void
+QmcGroup::prefetchContext(unsigned int index)
+{
+    QmcContext *context = my.contexts[index];
+    int sts;
+
+    if ((sts = pmUseContext(context->handle())) >= 0 &&
+	(sts = pmDupContext()) >= 0) {
+	// all instances, the profile of the original context may change
+	pmAddProfile(PM_INDOM_NULL, 0, NULL);
+	my.prefetch->addContext(index, sts);
+    }
+    else {
+	pmprintf("%s: Warning: Unable to prefetch samples for %s: %s\n",
+		 pmGetProgname(), context->source().sourceAscii(),
+		 pmErrStr(sts));
+    }
+}
+
+void
+QmcGroup::setArchivePrefetch(int samples)
+{
+    struct timeval when;
+    int i;
+
+    if (samples <= 0) {
+	if (my.prefetch == NULL)
+	    return;
+	// bring the contexts up to the position of the next fetch
+	my.prefetch->position(&when);
+	for (i = 0; i < my.deferred.size(); i++) {
+	    if (my.deferred[i])
+		setContextMode(i, my.prefetch->mode(), &when,
+			       my.prefetch->interval());
+	}
+	my.deferred.clear();
+	delete my.prefetch;
+	my.prefetch = NULL;
+    }
+    else if (my.prefetch) {
+	my.prefetch->setSamples(samples);
+	return;
+    }
+    else {
+	my.prefetch = new QmcPrefetch(samples);
+	for (i = 0; i < (int)numContexts(); i++)
+	    if (my.contexts[i]->source().type() == PM_CONTEXT_ARCHIVE)
+		prefetchContext(i);
+	my.prefetch->start();
+    }
+    if (numContexts())
+	useContext();
+}
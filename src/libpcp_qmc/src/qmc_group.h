@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2013, Red Hat.
+ * Copyright (c) 2013,2026, Red Hat.
  * Copyright (c) 2007 Aconex.  All Rights Reserved.
  * Copyright (c) 1998-2005 Silicon Graphics, Inc.  All Rights Reserved.
  * 
@@ -19,6 +19,8 @@
 #include "qmc.h"
 #include "qmc_config.h"
 #include "qmc_context.h"
+#include "qmc_store.h"
+#include "qmc_prefetch.h"
 
 class QmcGroup
 {
@@ -55,11 +57,27 @@ public:
 
     // Fetch all the metrics in this group
     // By default, do all rate conversions and counter wraps
-    int fetch(bool update = true);
+    // If a store history is set, the updated values are added as the
+    // newest (forward) or oldest row of the store
+    int fetch(bool update = true, bool forward = true);
+
+    // Keep the values of the last <samples> fetches in a columnar store
+    // shared by all metrics in the group (zero, the default, disables it)
+    void setStoreHistory(int samples) { my.store.setCapacity(samples); }
+    int storeHistory() const { return my.store.capacity(); }
+    QmcValueStore &store() { return my.store; }
+    const QmcValueStore &store() const { return my.store; }
 
     // Set the archive position and mode
     int setArchiveMode(int mode, const struct timeval *when, int interval);
 
+    // Fetch up to <samples> archive samples ahead of the position on a
+    // background thread, from duplicates of the archive contexts (zero,
+    // the default, disables it).  Only interpolation mode is prefetched.
+    void setArchivePrefetch(int samples);
+    int archivePrefetch() const
+	{ return my.prefetch ? my.prefetch->samples() : 0; }
+
     int useTZ();			// Use TZ of current context as default
     int useTZ(const QString &tz);	// Use this TZ as default
     int useLocalTZ();			// Use local TZ as default
@@ -91,6 +109,9 @@ private:
 	struct timeval timeStart;	// Start of first archive
 	struct timeval timeEnd;		// End of last archive
 	double timeEndReal;		// End of last archive
+	QmcValueStore store;		// Values from recent fetches
+	QmcPrefetch *prefetch;		// Archive prefetch thread, if any
+	QVector<bool> deferred;		// pmSetMode left to the prefetch
     } my;
 
     // Timezone for localhost from environment
@@ -100,6 +121,9 @@ private:
     static QString localHost;	// name of localhost
 
     int useContext();
+    int setContextMode(unsigned int index, int mode,
+		       const struct timeval *when, int interval);
+    void prefetchContext(unsigned int index);
 };
 
 #endif	// QMC_GROUP_H
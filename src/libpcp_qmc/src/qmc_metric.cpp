@@ -1,6 +1,7 @@
 /*
  * Copyright (c) 1997,2005 Silicon Graphics, Inc.  All Rights Reserved.
  * Copyright (c) 2007 Aconex.  All Rights Reserved.
+ * Copyright (c) 2026 Red Hat.
  * 
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License as published
@@ -14,6 +15,7 @@
  */
 
 #include <strings.h>
+#include <qset.h>
 #include "qmc_metric.h"
 #include "qmc_group.h"
 
@@ -26,6 +28,8 @@ QmcMetricValue::QmcMetricValue()
     my.currentError = PM_ERR_VALUE;
     my.previousError = PM_ERR_VALUE;
     my.instance = PM_ERR_INST;
+    my.column = -1;
+    my.currentColumn = -1;
 }
 
 QmcMetricValue::QmcMetricValue(QmcMetricValue const& base)
@@ -38,6 +42,8 @@ QmcMetricValue::QmcMetricValue(QmcMetricValue const& base)
     my.error = base.my.error;
     my.currentError = base.my.currentError;
     my.previousError = base.my.previousError;
+    my.column = base.my.column;
+    my.currentColumn = base.my.currentColumn;
 }
 
 QmcMetricValue const&
@@ -52,6 +58,8 @@ QmcMetricValue::operator=(QmcMetricValue const& rhs)
 	my.error = rhs.my.error;
 	my.currentError = rhs.my.currentError;
 	my.previousError = rhs.my.previousError;
+	my.column = rhs.my.column;
+	my.currentColumn = rhs.my.currentColumn;
     }
     return *this;
 }
@@ -119,6 +127,8 @@ QmcMetric::~QmcMetric()
     if (hasInstances())
 	for (int i = 0; i < my.values.size(); i++)
 	    indom()->removeRef(my.values[i].instance());
+    for (int i = 0; i < my.values.size(); i++)
+	releaseColumns(my.values[i]);
 }
 
 void
@@ -550,9 +560,47 @@ QmcMetric::update()
 	}
     }
 
+    storeValues();
+
     return err;
 }
 
+//
+// Add the values from this fetch to the group store, each instance
+// getting its own columns the first time through
+//
+void
+QmcMetric::storeValues()
+{
+    QmcValueStore &store = my.group->store();
+
+    if (!store.enabled())
+	return;
+
+    for (int i = 0; i < my.values.size(); i++) {
+	QmcMetricValue &value = my.values[i];
+
+	if (value.column() < 0)
+	    value.setColumns(store.addColumn(), store.addColumn());
+	if (value.error() >= 0)
+	    store.setValue(value.column(), value.value());
+	if (value.currentError() >= 0)
+	    store.setValue(value.currentColumn(), value.currentValue());
+    }
+}
+
+void
+QmcMetric::releaseColumns(QmcMetricValue &value)
+{
+    if (value.column() < 0)
+	return;
+
+    QmcValueStore &store = my.group->store();
+    store.removeColumn(value.column());
+    store.removeColumn(value.currentColumn());
+    value.setColumns(-1, -1);
+}
+
 void
 QmcMetric::dumpAll() const
 {
@@ -1228,10 +1276,20 @@ QmcMetric::updateIndom(void)
 	    }
 
 	// Need to set all error flags to avoid problems with rate conversion
-	if (j == oldValues.size())
+	if (j == oldValues.size()) {
 	    my.values[i].setAllErrors(PM_ERR_VALUE);
+	    my.values[i].setColumns(-1, -1);
+	}
     }
 
+    // Release the store columns of instances that have gone away
+    QSet<int> kept;
+    for (i = 0; i < my.values.size(); i++)
+	kept.insert(my.values[i].column());
+    for (i = 0; i < oldValues.size(); i++)
+	if (!kept.contains(oldValues[i].column()))
+	    releaseColumns(oldValues[i]);
+
     if (pmDebugOptions.pmc) {
 	QTextStream cerr(stderr);
 	cerr << "QmcMetric::updateIndom: " << spec(true) << ": Had " 
@@ -1266,5 +1324,6 @@ QmcMetric::removeInst(uint index)
 {
     Q_ASSERT(hasInstances());
     indom()->removeRef(my.values[index].instance());
+    releaseColumns(my.values[index]);
     my.values.removeAt(index);
 }
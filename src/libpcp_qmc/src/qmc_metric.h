@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2014 Red Hat, Inc.
+ * Copyright (c) 2012-2014,2026 Red Hat, Inc.
  * Copyright (c) 2007 Aconex.  All Rights Reserved.
  * Copyright (c) 1998-2005 Silicon Graphics, Inc.  All Rights Reserved.
  * 
@@ -134,6 +134,12 @@ public:
     void extractEventRecords(QmcContext *context, int recordCount, pmResult **result);
     void dumpEventRecords(QTextStream &os, int instid) const;
 
+    // Group store columns holding value() and currentValue()
+    int column() const { return my.column; }
+    int currentColumn() const { return my.currentColumn; }
+    void setColumns(int column, int currentColumn)
+	{ my.column = column; my.currentColumn = currentColumn; }
+
 private:
     void resetCurrentValue()
 	{ my.currentValue = 0.0; my.stringValue = QString(); my.eventRecords.clear(); }
@@ -146,6 +152,8 @@ private:
 	double currentValue;
 	int currentError;
 	int previousError;
+	int column;
+	int currentColumn;
 	QString stringValue;
 	QVector<QmcEventRecord> eventRecords;
     } my;
@@ -256,6 +264,13 @@ public:
     int currentError(int index) const	// Current raw error code
 	{ return my.values[index].currentError(); }
 
+    // Columns in the group store (see QmcGroup::setStoreHistory) for
+    // the rate-converted and raw values, or -1 until the first update
+    int valueColumn(int index) const
+	{ return my.values[index].column(); }
+    int currentColumn(int index) const
+	{ return my.values[index].currentColumn(); }
+
     void shiftValues();		// Shift values in preparation for next fetch
 
     void setError(int sts);	// Set error code for all instances
@@ -318,6 +333,8 @@ private:
     void setupDesc(QmcGroup *group, pmMetricSpec *theMetric);
     void setupIndom(pmMetricSpec *theMetric);
     void setupValues(int num);
+    void storeValues();
+    void releaseColumns(QmcMetricValue &value);
 
     void extractNumericMetric(pmValueSet const *vset, pmValue const *v, QmcMetricValue &vref);
     void extractArrayMetric(pmValueSet const *vset, pmValue const *v, QmcMetricValue &vref);
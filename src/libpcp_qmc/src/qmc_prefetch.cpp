@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#include <qtextstream.h>
+#include <qvector.h>
+#include <pcp/pmapi.h>
+#include <pcp/libpcp.h>
+#include "qmc_prefetch.h"
+
+QmcPrefetch::QmcPrefetch(int samples)
+{
+    my.quit = false;
+    my.active = false;
+    my.samples = samples;
+    my.mode = 0;
+    my.interval = 0;
+    my.origin.tv_sec = 0;
+    my.origin.tv_usec = 0;
+    my.step = 0;
+    my.position = 0;
+    my.generation = 0;
+}
+
+QmcPrefetch::~QmcPrefetch()
+{
+    my.lock.lock();
+    my.quit = true;
+    my.work.wakeAll();
+    my.lock.unlock();
+    wait();
+
+    for (int i = 0; i < my.contexts.size(); i++) {
+	discard(my.contexts[i], true);
+	pmDestroyContext(my.contexts[i].handle);
+    }
+}
+
+void
+QmcPrefetch::setSamples(int samples)
+{
+    QMutexLocker locker(&my.lock);
+
+    my.samples = samples;
+    for (int i = 0; i < my.contexts.size(); i++)
+	discard(my.contexts[i], false);
+    my.work.wakeAll();
+}
+
+void
+QmcPrefetch::addContext(unsigned int index, int handle)
+{
+    QMutexLocker locker(&my.lock);
+    Context context;
+
+    context.index = index;
+    context.handle = handle;
+    my.contexts.append(context);
+}
+
+void
+QmcPrefetch::setPMIDs(unsigned int index, const QList<pmID> &pmids)
+{
+    QMutexLocker locker(&my.lock);
+
+    for (int i = 0; i < my.contexts.size(); i++) {
+	Context &context = my.contexts[i];
+	if (context.index != index || context.pmids == pmids)
+	    continue;
+	// results from the old list no longer match the caller's
+	// indexing of the metrics in each result
+	context.pmids = pmids;
+	discard(context, true);
+	my.work.wakeAll();
+    }
+}
+
+//
+// Microseconds between positions for a pmSetMode(3) interval
+//
+static qint64
+intervalToUsec(int mode, int interval)
+{
+    qint64 usec = interval;
+
+    switch (PM_XTB_GET(mode)) {
+    case PM_TIME_NSEC:
+	return usec / 1000;
+    case PM_TIME_USEC:
+	return usec;
+    case PM_TIME_SEC:
+	return usec * 1000000;
+    case PM_TIME_MIN:
+	return usec * 60 * 1000000;
+    case PM_TIME_HOUR:
+	return usec * 3600 * 1000000;
+    default:			// milliseconds, also without a time base
+	return usec * 1000;
+    }
+}
+
+static qint64
+timevalToUsec(const struct timeval *tv)
+{
+    return (qint64)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+bool
+QmcPrefetch::seek(int mode, const struct timeval *when, int interval)
+{
+    QMutexLocker locker(&my.lock);
+    qint64 step = intervalToUsec(mode, interval);
+    qint64 offset, position;
+    int i;
+
+    my.generation++;
+
+    if ((mode & __PM_MODE_MASK) != PM_MODE_INTERP || step == 0) {
+	my.active = false;
+	for (i = 0; i < my.contexts.size(); i++)
+	    discard(my.contexts[i], true);
+	return false;
+    }
+
+    // Moving along the current grid keeps the samples already fetched,
+    // so long as the new time is within 5% of the interval of a position
+    if (my.active && mode == my.mode && interval == my.interval) {
+	offset = timevalToUsec(when) - timevalToUsec(&my.origin);
+	position = (offset + (offset < 0 ? -1 : 1) * (step < 0 ? -step : step) / 2) / step;
+	offset -= position * step;
+	if ((offset < 0 ? -offset : offset) <= (step < 0 ? -step : step) / 20) {
+	    my.position = position;
+	    for (i = 0; i < my.contexts.size(); i++)
+		discard(my.contexts[i], false);
+	    my.work.wakeAll();
+	    return true;
+	}
+    }
+
+    my.active = true;
+    my.mode = mode;
+    my.interval = interval;
+    my.origin = *when;
+    my.step = step;
+    my.position = 0;
+    for (i = 0; i < my.contexts.size(); i++)
+	discard(my.contexts[i], true);
+    my.work.wakeAll();
+    return true;
+}
+
+void
+QmcPrefetch::position(struct timeval *when)
+{
+    QMutexLocker locker(&my.lock);
+
+    gridTime(my.position, when);
+}
+
+pmResult *
+QmcPrefetch::take(unsigned int index)
+{
+    QMutexLocker locker(&my.lock);
+    pmResult *result = NULL;
+
+    if (!my.active)
+	return NULL;
+
+    for (int i = 0; i < my.contexts.size(); i++) {
+	Context &context = my.contexts[i];
+	if (context.index != index)
+	    continue;
+	QMap<qint64, pmResult *>::iterator it = context.results.find(my.position);
+	if (it != context.results.end()) {
+	    result = it.value();	// NULL if the prefetch failed
+	    context.results.erase(it);
+	}
+	break;
+    }
+    return result;
+}
+
+void
+QmcPrefetch::advance()
+{
+    QMutexLocker locker(&my.lock);
+
+    if (!my.active)
+	return;
+
+    my.position++;
+    for (int i = 0; i < my.contexts.size(); i++)
+	discard(my.contexts[i], false);
+    my.work.wakeAll();
+}
+
+bool
+QmcPrefetch::inWindow(qint64 position) const
+{
+    return position >= my.position && position < my.position + my.samples;
+}
+
+void
+QmcPrefetch::gridTime(qint64 position, struct timeval *when) const
+{
+    qint64 usec = timevalToUsec(&my.origin) + position * my.step;
+
+    when->tv_sec = usec / 1000000;
+    when->tv_usec = usec % 1000000;
+    if (when->tv_usec < 0) {
+	when->tv_usec += 1000000;
+	when->tv_sec--;
+    }
+}
+
+void
+QmcPrefetch::discard(Context &context, bool all)
+{
+    QMap<qint64, pmResult *>::iterator it = context.results.begin();
+
+    while (it != context.results.end()) {
+	if (!all && inWindow(it.key())) {
+	    ++it;
+	    continue;
+	}
+	if (it.value())
+	    pmFreeResult(it.value());
+	it = context.results.erase(it);
+    }
+}
+
+//
+// Find the nearest position in the window that is yet to be fetched for
+// some context, and how many positions from there are also missing
+//
+bool
+QmcPrefetch::nextMissing(int &index, qint64 &position, int &count) const
+{
+    qint64 p, end = my.position + my.samples;
+
+    if (!my.active || my.quit)
+	return false;
+
+    for (p = my.position; p < end; p++) {
+	for (int i = 0; i < my.contexts.size(); i++) {
+	    const Context &context = my.contexts[i];
+	    if (context.pmids.isEmpty() || context.results.contains(p))
+		continue;
+	    index = i;
+	    position = p;
+	    for (count = 1; p + count < end; count++)
+		if (context.results.contains(p + count))
+		    break;
+	    return true;
+	}
+    }
+    return false;
+}
+
+void
+QmcPrefetch::run()
+{
+    QVector<pmID> pmids;
+    struct timeval when;
+    unsigned int generation;
+    qint64 position;
+    pmResult *result;
+    int i, c, count, handle, mode, interval, sts;
+
+    my.lock.lock();
+    while (!my.quit) {
+	if (!nextMissing(c, position, count)) {
+	    my.work.wait(&my.lock);
+	    continue;
+	}
+
+	// the lock is not held while fetching, so take copies
+	handle = my.contexts[c].handle;
+	pmids = my.contexts[c].pmids.toVector();
+	generation = my.generation;
+	gridTime(position, &when);
+	mode = my.mode;
+	interval = my.interval;
+	my.lock.unlock();
+
+	if (pmDebugOptions.pmc) {
+	    QTextStream cerr(stderr);
+	    cerr << "QmcPrefetch::run: " << count << " samples for context "
+		 << handle << " from position " << position << Qt::endl;
+	}
+
+	if ((sts = pmUseContext(handle)) >= 0)
+	    sts = pmSetMode(mode, &when, interval);
+
+	for (i = 0; ; ) {
+	    result = NULL;
+	    if (sts >= 0 &&
+		(sts = pmFetch(pmids.size(), pmids.data(), &result)) < 0)
+		result = NULL;
+
+	    my.lock.lock();
+	    if (my.quit || my.generation != generation ||
+		my.contexts[c].pmids.toVector() != pmids ||
+		!inWindow(position + i) ||
+		my.contexts[c].results.contains(position + i)) {
+		if (result)
+		    pmFreeResult(result);
+		break;
+	    }
+	    // failures are recorded too (as NULL) so the position is not
+	    // tried again here; the group fetches for itself instead
+	    my.contexts[c].results.insert(position + i, result);
+	    if (result == NULL || ++i == count)
+		break;
+	    my.lock.unlock();
+	}
+    }
+    my.lock.unlock();
+}
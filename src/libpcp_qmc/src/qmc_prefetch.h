@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#ifndef QMC_PREFETCH_H
+#define QMC_PREFETCH_H
+
+#include "qmc.h"
+
+#include <qlist.h>
+#include <qmap.h>
+#include <qmutex.h>
+#include <qthread.h>
+#include <qwaitcondition.h>
+
+//
+// Fetch archive samples ahead of the position of a group on a thread
+// of its own, using duplicates of the group's archive
+// contexts, so that time navigation in an interactive client is not held
+// up by archive i/o.  Positions lie on the grid set by pmSetMode(3) in
+// interpolation mode, numbered from zero at the time of the last seek in
+// the direction of travel.  Results are taken without waiting; when one
+// is not ready yet the caller fetches for itself.
+//
+class QmcPrefetch : public QThread
+{
+public:
+    QmcPrefetch(int samples);
+    ~QmcPrefetch();		// stops the thread, destroys the contexts
+
+    int samples() const { return my.samples; }
+    void setSamples(int samples);
+
+    // Prefetch for group context <index> with <handle>, a duplicate of
+    // that context which from here on belongs to the prefetch thread
+    void addContext(unsigned int index, int handle);
+
+    // The metrics fetched for group context <index>
+    void setPMIDs(unsigned int index, const QList<pmID> &pmids);
+
+    // The next fetch is at <when> and each <interval> thereafter, in the
+    // terms of pmSetMode(3).  Returns false for a mode other than
+    // interpolation, which cannot be prefetched.
+    bool seek(int mode, const struct timeval *when, int interval);
+
+    // The mode, interval and time of the next fetch (following a seek)
+    int mode() const { return my.mode; }
+    int interval() const { return my.interval; }
+    void position(struct timeval *when);
+
+    // Result of the next fetch for group context <index>, if it has been
+    // prefetched already (the caller frees it), else NULL
+    pmResult *take(unsigned int index);
+
+    // The group has fetched, move on to the next position
+    void advance();
+
+protected:
+    void run();
+
+private:
+    typedef struct {
+	unsigned int index;		// Index of context in the group
+	int handle;			// Duplicate context for the thread
+	QList<pmID> pmids;		// Metrics fetched
+	QMap<qint64, pmResult *> results;	// Prefetched, by position
+    } Context;
+
+    bool inWindow(qint64 position) const;
+    bool nextMissing(int &context, qint64 &position, int &count) const;
+    void discard(Context &context, bool all);
+    void gridTime(qint64 position, struct timeval *when) const;
+
+    struct {
+	QMutex lock;
+	QWaitCondition work;		// Signalled when there is work
+	bool quit;
+	bool active;			// A seek() in interpolation mode
+
+	int samples;			// Window ahead of the position
+	int mode;			// As for pmSetMode
+	int interval;			// As for pmSetMode
+	struct timeval origin;		// Time of grid position 0
+	qint64 step;			// Microseconds between positions
+	qint64 position;		// Position of the next fetch
+	unsigned int generation;	// Incremented on each seek()
+
+	QList<Context> contexts;
+    } my;
+};
+
+#endif	// QMC_PREFETCH_H
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+
+#include "qmc_store.h"
+
+QmcValueStore::QmcValueStore()
+{
+    my.capacity = 0;
+    my.count = 0;
+    my.head = 0;
+    my.current = -1;
+}
+
+void
+QmcValueStore::setCapacity(int rows)
+{
+    int keep, i, j;
+
+    if (rows < 0)
+	rows = 0;
+    if (rows == my.capacity)
+	return;
+
+    keep = qMin(my.count, rows);
+    for (i = 0; i < my.columns.size(); i++) {
+	QVector<double> &column = my.columns[i];
+	QVector<double> resized(rows, qQNaN());
+	for (j = 0; j < keep; j++)
+	    resized[j] = column[slot(j)];
+	column.swap(resized);
+    }
+    my.capacity = rows;
+    my.count = keep;
+    my.head = 0;
+    my.current = -1;
+}
+
+void
+QmcValueStore::clear()
+{
+    for (int i = 0; i < my.columns.size(); i++)
+	my.columns[i].fill(qQNaN());
+    my.count = 0;
+    my.head = 0;
+    my.current = -1;
+}
+
+int
+QmcValueStore::addColumn()
+{
+    int column;
+
+    if (my.unused.size()) {
+	column = my.unused.takeLast();
+	my.columns[column].fill(qQNaN());
+    }
+    else {
+	column = my.columns.size();
+	my.columns.append(QVector<double>(my.capacity, qQNaN()));
+    }
+    return column;
+}
+
+void
+QmcValueStore::removeColumn(int column)
+{
+    // freed columns keep their storage, ready for the next addColumn
+    if (column >= 0 && column < my.columns.size() &&
+	!my.unused.contains(column))
+	my.unused.append(column);
+}
+
+void
+QmcValueStore::push(bool forward)
+{
+    int row;
+
+    if (my.capacity == 0)
+	return;
+
+    if (forward) {
+	my.head = (my.head + my.capacity - 1) % my.capacity;
+	if (my.count < my.capacity)
+	    my.count++;
+	row = 0;
+    }
+    else if (my.count < my.capacity) {
+	row = my.count++;
+    }
+    else {
+	my.head = (my.head + 1) % my.capacity;
+	row = my.count - 1;
+    }
+
+    my.current = slot(row);
+    for (int i = 0; i < my.columns.size(); i++)
+	my.columns[i][my.current] = qQNaN();
+}
+
+void
+QmcValueStore::moveRow(int row, int oldrow)
+{
+    if (row < 0 || row >= my.count || row == oldrow)
+	return;
+    if (oldrow < 0 || oldrow >= my.count) {
+	clearRow(row);
+	return;
+    }
+
+    int to = slot(row), from = slot(oldrow);
+    for (int i = 0; i < my.columns.size(); i++)
+	my.columns[i][to] = my.columns[i][from];
+}
+
+void
+QmcValueStore::clearRow(int row)
+{
+    if (row < 0 || row >= my.count)
+	return;
+
+    int to = slot(row);
+    for (int i = 0; i < my.columns.size(); i++)
+	my.columns[i][to] = qQNaN();
+}
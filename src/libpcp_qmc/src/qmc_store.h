@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#ifndef QMC_STORE_H
+#define QMC_STORE_H
+
+#include <qlist.h>
+#include <qvector.h>
+#include <qnumeric.h>
+
+//
+// Columnar store for the values of the last <capacity> fetches of a
+// group.  Each metric value (instance) owns a column, and each fetch
+// adds a row; rows are numbered from 0 (the newest) to count()-1 (the
+// oldest).  Rows live in a ring, so adding a row never moves the others
+// and slot() maps a row to its (stable) position in each column, which
+// clients may use to index arrays of their own that parallel a column.
+//
+class QmcValueStore
+{
+public:
+    QmcValueStore();
+
+    bool enabled() const { return my.capacity > 0; }
+    int capacity() const { return my.capacity; }
+    int count() const { return my.count; }
+
+    // Change the number of rows retained, keeping the newest rows.
+    // Slots are renumbered, rows are not.
+    void setCapacity(int rows);
+
+    // Discard all rows (columns are kept)
+    void clear();
+
+    // Allocate a column, initially all missing values (NaN), and
+    // return it to the free list once it is no longer needed
+    int addColumn();
+    void removeColumn(int column);
+
+    // Add a row at the newest (forward) or oldest (backward) end,
+    // discarding a row from the other end once the store is full.
+    // Subsequent setValue() calls fill in this row, and any column
+    // not set keeps a missing value (NaN) for the row.
+    void push(bool forward = true);
+    void setValue(int column, double value)
+	{ if (column >= 0 && column < my.columns.size() && my.current >= 0)
+	      my.columns[column][my.current] = value; }
+
+    // Position of <row> within every column
+    int slot(int row) const
+	{ return my.capacity ? (my.head + row) % my.capacity : row; }
+
+    double value(int column, int row) const
+	{ return (column < 0 || column >= my.columns.size() ||
+		  row < 0 || row >= my.count) ? qQNaN() :
+		  my.columns[column][slot(row)]; }
+
+    // Copy all values for <oldrow> into <row>, or missing values if
+    // there is no <oldrow> yet, or mark all values for <row> missing
+    void moveRow(int row, int oldrow);
+    void clearRow(int row);
+
+private:
+    struct {
+	int capacity;			// maximum number of rows
+	int count;			// rows currently held
+	int head;			// slot holding row 0
+	int current;			// slot for the row being filled
+	QVector<QVector<double> > columns;
+	QList<int> unused;		// columns available for reuse
+    } my;
+};
+
+#endif	// QMC_STORE_H
@@ -14,6 +14,7 @@
 #include "discover.h"
 #include "slots.h"
 #include "util.h"
+#include "mmv_dev.h"
 #include <dirent.h>
 #include <fnmatch.h>
 #include <sys/stat.h>
@@ -37,6 +38,17 @@ static pmDiscover *discover_hashtable[PM_DISCOVER_HASHTAB_SIZE];
 /* number of archives or directories currently being monitored */
 static uint64_t monitored;
 
+/* undecoded metadata bytes and throttled change events, all sources */
+static uint64_t backlog_bytes;
+static uint64_t backlog_events;
+
+/* largest lag between a decoded record and its decoding, all sources */
+static uint64_t decode_lag;
+static pmDiscover *decode_lag_source;
+
+/* per-source metrics instance identifiers */
+static unsigned int sources_serial;
+
 
 /* FNV string hash algorithm. Return unsigned in range 0 .. limit-1 */
 static unsigned int
@@ -190,6 +202,245 @@ pmDiscoverTraverseArg(unsigned int flags, void (*callback)(pmDiscover *, void *)
     return count;
 }
 
+/*
+ * Account for the undecoded backlog (bytes appended to metadata but
+ * not decoded yet, and change events deferred by throttling) of one
+ * source, maintaining totals across all sources for export.
+ */
+static void
+pmDiscoverSetBacklog(pmDiscover *p, uint64_t bytes, uint64_t events)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+
+    backlog_bytes = backlog_bytes - p->meta_backlog + bytes;
+    backlog_events = backlog_events - p->backlog + events;
+    p->meta_backlog = bytes;
+    p->backlog = events;
+    if (data) {
+	mmv_set(data->map, data->metrics[DISCOVER_BACKLOG_BYTES], &backlog_bytes);
+	mmv_set(data->map, data->metrics[DISCOVER_BACKLOG_EVENTS], &backlog_events);
+	mmv_set(data->sources_map, p->metrics[SOURCE_META_BACKLOG], &bytes);
+	mmv_set(data->sources_map, p->metrics[SOURCE_LOGVOL_BACKLOG], &events);
+    }
+}
+
+static void
+max_decode_lag_callback(pmDiscover *p)
+{
+    if (p->lag >= decode_lag) {
+	decode_lag = p->lag;
+	decode_lag_source = p;
+    }
+}
+
+static void
+pmDiscoverMaxDecodeLag(pmDiscoverModule *module)
+{
+    discoverModuleData	*data = getDiscoverModuleData(module);
+
+    decode_lag = 0;
+    decode_lag_source = NULL;
+    pmDiscoverTraverse(PM_DISCOVER_FLAGS_DATAVOL|PM_DISCOVER_FLAGS_META,
+			max_decode_lag_callback);
+    if (data)
+	mmv_set(data->map, data->metrics[DISCOVER_DECODE_LAG], &decode_lag);
+}
+
+/*
+ * Record the lag (milliseconds) between the timestamp of the most
+ * recently decoded result for a source and the time it was decoded,
+ * and maintain the largest such lag across all sources for export.
+ */
+static void
+pmDiscoverSetDecodeLag(pmDiscover *p, uint64_t lag)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+
+    p->lag = lag;
+    if (data)
+	mmv_set(data->sources_map, p->metrics[SOURCE_DECODE_LAG], &lag);
+    if (lag >= decode_lag) {
+	decode_lag = lag;
+	decode_lag_source = p;
+	if (data)
+	    mmv_set(data->map, data->metrics[DISCOVER_DECODE_LAG], &decode_lag);
+    } else if (decode_lag_source == p) {
+	/* previous maximum has improved - find the new one */
+	pmDiscoverMaxDecodeLag(p->module);
+    }
+}
+
+typedef struct sources {
+    pmDiscover		**list;
+    unsigned int	count;
+} sources_t;
+
+static void
+sources_clear_callback(pmDiscover *p)
+{
+    memset(p->metrics, 0, sizeof(p->metrics));
+}
+
+static void
+sources_add_callback(pmDiscover *p, void *arg)
+{
+    sources_t		*sources = (sources_t *)arg;
+
+    /* only archives being decoded, with names fitting an MMV instance */
+    if (p->ctx < 0 || strlen(p->context.name) >= MMV_STRINGMAX)
+	return;
+    if (sources->list)
+	sources->list[sources->count] = p;
+    sources->count++;
+}
+
+/*
+ * Find the value of each source for one per-source metric.  Values of
+ * a metric are laid out contiguously in instance order, so the first
+ * lookup locates them all - unless the last instance shows otherwise,
+ * in which case fall back to a lookup for every instance.
+ */
+static void
+sources_lookup(void *map, const char *name, int metric, sources_t *sources)
+{
+    mmv_disk_value_t	*first, *last;
+    unsigned int	i, n = sources->count;
+
+    if (n == 0)
+	return;
+    first = (mmv_disk_value_t *)mmv_lookup_value_desc(map, name,
+				sources->list[0]->context.name);
+    last = (mmv_disk_value_t *)mmv_lookup_value_desc(map, name,
+				sources->list[n-1]->context.name);
+    if (first && last == first + (n - 1)) {
+	for (i = 0; i < n; i++)
+	    sources->list[i]->metrics[metric] = (pmAtomValue *)(first + i);
+    } else {
+	for (i = 0; i < n; i++)
+	    sources->list[i]->metrics[metric] = mmv_lookup_value_desc(map,
+				name, sources->list[i]->context.name);
+    }
+}
+
+/*
+ * Per-source backlog and decode lag metrics.  The instances of an MMV
+ * file are fixed when it is created, so the file is recreated whenever
+ * sources have come or gone - from a timer, so that the many changes
+ * from one directory rescan are batched into a single rebuild.
+ */
+static void
+sources_rebuild(discoverModuleData *data)
+{
+    pmUnits		countunits = MMV_UNITS(0,0,1,0,0,0);
+    pmUnits		msecunits = MMV_UNITS(0,1,0,0,PM_TIME_MSEC,0);
+    pmUnits		bytesunits = MMV_UNITS(1,0,0,PM_SPACE_BYTE,0,0);
+    mmv_registry_t	*registry;
+    sources_t		sources = {0};
+    pmDiscover		*p;
+    unsigned int	i;
+    void		*map;
+
+    if (data->sources_registry) {
+	mmv_stats_free(data->sources_registry);
+	data->sources_registry = NULL;
+	data->sources_map = NULL;
+    }
+    pmDiscoverTraverse(PM_DISCOVER_FLAGS_ALL, sources_clear_callback);
+    data->sources_changed = 0;
+
+    pmDiscoverTraverseArg(PM_DISCOVER_FLAGS_META, sources_add_callback, &sources);
+    if (sources.count &&
+	(sources.list = calloc(sources.count, sizeof(pmDiscover *))) == NULL)
+	return;
+    sources.count = 0;
+    pmDiscoverTraverseArg(PM_DISCOVER_FLAGS_META, sources_add_callback, &sources);
+
+    registry = mmv_stats_registry(data->sources_file,
+				data->sources_cluster, MMV_FLAG_PROCESS);
+    if (registry == NULL) {
+	free(sources.list);
+	return;
+    }
+    mmv_stats_add_indom(registry, 1,
+	"monitored archives",
+	"Archives currently being decoded by discovery, by archive name");
+    for (i = 0; i < sources.count; i++)
+	mmv_stats_add_instance(registry, 1, sources.list[i]->instid,
+				sources.list[i]->context.name);
+
+    mmv_stats_add_metric(registry, "metadata.backlog", 1,
+	MMV_TYPE_U64, MMV_SEM_INSTANT, bytesunits, 1,
+	"metadata bytes written but not yet decoded for each archive",
+	"Bytes appended to the metadata of each monitored archive which\n"
+	"have not yet been decoded, such as partially written records");
+
+    mmv_stats_add_metric(registry, "logvol.backlog", 2,
+	MMV_TYPE_U64, MMV_SEM_INSTANT, countunits, 1,
+	"deferred filesystem changes for each archive",
+	"Number of filesystem change callbacks for each monitored archive\n"
+	"that were throttled and have not yet been processed");
+
+    mmv_stats_add_metric(registry, "logvol.decode_lag", 3,
+	MMV_TYPE_U64, MMV_SEM_INSTANT, msecunits, 1,
+	"decode lag for each archive",
+	"Difference between the time a result record was decoded and its\n"
+	"timestamp, from the most recent decoding of each monitored archive");
+
+    if ((map = mmv_stats_start(registry)) == NULL) {
+	mmv_stats_free(registry);
+	free(sources.list);
+	return;
+    }
+    data->sources_registry = registry;
+    data->sources_map = map;
+
+    sources_lookup(map, "metadata.backlog", SOURCE_META_BACKLOG, &sources);
+    sources_lookup(map, "logvol.backlog", SOURCE_LOGVOL_BACKLOG, &sources);
+    sources_lookup(map, "logvol.decode_lag", SOURCE_DECODE_LAG, &sources);
+
+    for (i = 0; i < sources.count; i++) {
+	p = sources.list[i];
+	mmv_set(map, p->metrics[SOURCE_META_BACKLOG], &p->meta_backlog);
+	mmv_set(map, p->metrics[SOURCE_LOGVOL_BACKLOG], &p->backlog);
+	mmv_set(map, p->metrics[SOURCE_DECODE_LAG], &p->lag);
+    }
+    free(sources.list);
+}
+
+/* a source has come or gone, rebuild per-source metrics on next timer */
+static void
+pmDiscoverSourcesChanged(pmDiscover *p)
+{
+    discoverModuleData	*data = getDiscoverModuleData(p->module);
+
+    if (data)
+	data->sources_changed = 1;
+}
+
+/* timer callback - rebuild per-source metrics if sources have changed */
+void
+pmDiscoverSourcesRefresh(void *arg)
+{
+    discoverModuleData	*data = getDiscoverModuleData((pmDiscoverModule *)arg);
+
+    if (data && data->sources_file && data->sources_changed)
+	sources_rebuild(data);
+}
+
+void
+pmDiscoverSourcesClose(pmDiscoverModule *module)
+{
+    discoverModuleData	*data = getDiscoverModuleData(module);
+
+    if (data == NULL)
+	return;
+    if (data->sources_registry) {
+	mmv_stats_free(data->sources_registry);
+	data->sources_registry = NULL;
+	data->sources_map = NULL;
+    }
+    pmDiscoverTraverse(PM_DISCOVER_FLAGS_ALL, sources_clear_callback);
+}
 
 /*
  * Traverse and purge deleted entries
@@ -215,6 +466,11 @@ pmDiscoverPurgeDeleted(void)
 		else
 		    discover_hashtable[i] = next;
 		pmDiscoverInvokeClosedCallBacks(p);
+		pmDiscoverSetBacklog(p, 0, 0);
+		if (decode_lag_source == p)	/* p no longer in hash table */
+		    pmDiscoverMaxDecodeLag(p->module);
+		if (p->ctx >= 0)	/* drop its per-source metrics instance */
+		    pmDiscoverSourcesChanged(p);
 		pmDiscoverFree(p);
 		count++;
 	    }
@@ -287,13 +543,21 @@ pmDiscoverArchives(const char *dir, pmDiscoverModule *module, void *arg)
 	if (pmDebugOptions.discovery)
 	    fprintf(stderr, "pmDiscoverArchives: readdir found %s\n", path);
 
-	if (stat(path, &statbuf) < 0) {
+	s = &statbuf;
+	s->st_mode = 0;
+#ifdef _DIRENT_HAVE_D_TYPE
+	/* avoid a stat call per entry where readdir reports the type */
+	if (dent->d_type == DT_REG)
+	    s->st_mode = S_IFREG;
+	else if (dent->d_type == DT_DIR)
+	    s->st_mode = S_IFDIR;
+#endif
+	if (s->st_mode == 0 && stat(path, s) < 0) {
 	    if (pmDebugOptions.discovery)
 		fprintf(stderr, "pmDiscoverArchives: stat failed %s, err %d\n", path, errno);
 	    continue;
 	}
 
-	s = &statbuf;
 	if (S_ISREG(s->st_mode)) {
 	    if ((suffix = strsuffix(path, ".meta")) != NULL) {
 		/*
@@ -341,8 +605,15 @@ pmDiscoverArchives(const char *dir, pmDiscoverModule *module, void *arg)
 	}
 	else if (S_ISDIR(s->st_mode)) {
 	    /*
-	     * Recurse into subdir
+	     * Recurse into subdir, unless it is already being tracked -
+	     * such directories are monitored (and rescanned) separately
+	     * on their own change events, so a change in one directory
+	     * rescans only that directory and any new subdirectories.
 	     */
+	    if ((a = pmDiscoverLookup(path)) != NULL &&
+		(a->flags & PM_DISCOVER_FLAGS_DIRECTORY) &&
+		(a->flags & PM_DISCOVER_FLAGS_NEW) == 0)
+		continue;
 	    pmDiscoverArchives(path, module, arg);
 	}
     }
@@ -1155,6 +1426,8 @@ pmDiscoverNewSource(pmDiscover *p, int context)
     int			len, nsets;
 
     p->ctx = context;
+    p->instid = sources_serial++;
+    pmDiscoverSourcesChanged(p);
     host = pmGetContextHostName_r(context, hostname, sizeof(hostname));
     if ((nsets = pmGetContextLabels(&labelset)) > 0) {
 	pmwebapi_source_hash(hash, labelset->json, labelset->jsonlen);
@@ -1198,14 +1471,16 @@ archive_dir_lock_path(pmDiscover *p)
 }
 
 /*
- * Process metadata records until EOF. That can span multiple
- * callbacks if we get a partial record read.
+ * Process metadata records appended since the last decoded offset,
+ * through to the current end of file.  A partially written record is
+ * left in place (offset rewound) and completed on a later callback,
+ * once the writer has appended the remainder.
  */
 static void
 process_metadata(pmDiscover *p)
 {
     discoverModuleData	*data = getDiscoverModuleData(p->module);
-    int			partial = 0;
+    int			partial = 0, locked;
     __pmTimestamp	stamp;
     pmDesc		desc;
     off_t		off;
@@ -1220,7 +1495,6 @@ process_metadata(pmDiscover *p)
     __pmLogHdr		hdr;
     sds			msg, source;
     char		*lock_path;
-    int			deleted;
     struct stat		sbuf;
     static uint32_t	*buf = NULL;
     static int		buflen = 0;
@@ -1235,38 +1509,47 @@ process_metadata(pmDiscover *p)
 	fprintf(stderr, "process_metadata: %s in progress %s\n",
 		p->context.name, pmDiscoverFlagsStr(p));
     mmv_inc(data->map, data->metrics[DISCOVER_META_CALLBACKS]);
+
+    /*
+     * One fstat on the open descriptor per callback (rather than a
+     * stat of the path per record) gives both the current length of
+     * the file and whether it has since been unlinked (compressed).
+     */
+    if (fstat(p->fd, &sbuf) < 0 || sbuf.st_nlink == 0) {
+	p->flags |= PM_DISCOVER_FLAGS_DELETED;
+	return;
+    }
     lock_path = archive_dir_lock_path(p);
+    locked = (lock_path && access(lock_path, F_OK) == 0);
+
     for (;;) {
-	if (lock_path && access(lock_path, F_OK) == 0)
+	if (locked)	/* archive directory locked, e.g. pmlogger_daily */
 	    break;
 	mmv_inc(data->map, data->metrics[DISCOVER_META_LOOPS]);
-	off = lseek(p->fd, 0, SEEK_CUR);
-	nb = read(p->fd, &hdr, sizeof(__pmLogHdr));
+	off = p->meta_offset = lseek(p->fd, 0, SEEK_CUR);
+	if (off >= sbuf.st_size)
+	    break;	/* no appended data beyond the last decoded record */
 
-	deleted = is_deleted(p, &sbuf);
-	if (nb <= 0 || deleted) {
-	    /* we're at EOF or an error, or deleted. But may still be part way through a record */
-	    if (deleted)
-	    	p->flags |= PM_DISCOVER_FLAGS_DELETED;
-	    break;
-	}
+	nb = read(p->fd, &hdr, sizeof(__pmLogHdr));
+	if (nb <= 0)
+	    break;	/* EOF or an error */
 
 	if (nb != sizeof(__pmLogHdr)) {
 	    /* rewind so we can wait for more data on the next change CallBack */
 	    lseek(p->fd, off, SEEK_SET);
 	    partial = 1;
 	    mmv_inc(data->map, data->metrics[DISCOVER_META_PARTIAL_READS]);
-	    continue;
+	    break;
 	}
 
 	hdr.len = ntohl(hdr.len);
 	hdr.type = ntohl(hdr.type);
-	if (hdr.len <= 0) {
-	    /* rewind and wait for more data, as above */
+	if (hdr.len <= 0 || off + hdr.len > sbuf.st_size) {
+	    /* record not yet completely written, rewind and wait as above */
 	    lseek(p->fd, off, SEEK_SET);
 	    partial = 1;
 	    mmv_inc(data->map, data->metrics[DISCOVER_META_PARTIAL_READS]);
-	    continue;
+	    break;
 	}
 
 	/* record length: see __pmLogLoadMeta() */
@@ -1289,7 +1572,7 @@ process_metadata(pmDiscover *p)
 	    lseek(p->fd, off, SEEK_SET);
 	    partial = 1;
 	    mmv_inc(data->map, data->metrics[DISCOVER_META_PARTIAL_READS]);
-	    continue;
+	    break;
 	}
 
 	if (pmDebugOptions.discovery)
@@ -1419,6 +1702,10 @@ process_metadata(pmDiscover *p)
 	/* flag that all available metadata has now been read */
 	p->flags &= ~PM_DISCOVER_FLAGS_META_IN_PROGRESS;
 
+    /* bytes of metadata written but not yet decoded, e.g. partial record */
+    pmDiscoverSetBacklog(p, sbuf.st_size > p->meta_offset ?
+			sbuf.st_size - p->meta_offset : 0, p->backlog);
+
     if (lock_path)
     	free(lock_path);
 
@@ -1453,14 +1740,41 @@ process_logvol(pmDiscover *p)
     __pmTimestamp	stamp;
     __pmContext		*ctxp;
     __pmArchCtl		*acp;
+    struct timespec	now, last = {0};
+    struct stat		sbuf;
     char		*lock_path;
-    int			oldcurvol;
+    int			oldcurvol, curvol, maxvol, locked;
     int			sts;
+    off_t		size;
 
     mmv_inc(data->map, data->metrics[DISCOVER_LOGVOL_CALLBACKS]);
+
+    /*
+     * Tail the open data volume: unless bytes have been appended since
+     * it was last decoded through to its end, or a later volume has been
+     * added, there is nothing new to fetch.  This avoids a fetch attempt
+     * (and re-reading any partially written record) per change event.
+     */
+    if ((ctxp = __pmHandleToPtr(p->ctx)) == NULL)
+	return;
+    acp = ctxp->c_archctl;
+    if (acp->ac_mfp == NULL || __pmFstat(acp->ac_mfp, &sbuf) < 0)
+	size = -1;
+    else
+	size = sbuf.st_size;
+    curvol = acp->ac_curvol;
+    maxvol = acp->ac_log->maxvol;
+    PM_UNLOCK(ctxp->c_lock);
+    if (size >= 0 && size == p->logvol_size &&
+	curvol == p->logvol && curvol >= maxvol) {
+	p->flags &= ~PM_DISCOVER_FLAGS_DATAVOL_READY;
+	return;
+    }
+
     lock_path = archive_dir_lock_path(p);
+    locked = (lock_path && access(lock_path, F_OK) == 0);
     for (;;) {
-	if (lock_path && access(lock_path, F_OK) == 0)
+	if (locked)	/* archive directory locked, e.g. pmlogger_daily */
 	    break;
 	mmv_inc(data->map, data->metrics[DISCOVER_LOGVOL_LOOPS]);
 	pmUseContext(p->ctx);
@@ -1523,6 +1837,7 @@ process_logvol(pmDiscover *p)
 	 */
 	stamp.sec = r->timestamp.tv_sec;
 	stamp.nsec = r->timestamp.tv_nsec;
+	last = r->timestamp;
 	bump_logvol_decode_stats(data, r);
 	pmDiscoverInvokeValuesCallBack(p, &stamp, r);
 	pmFreeHighResResult(r);
@@ -1540,6 +1855,23 @@ process_logvol(pmDiscover *p)
     /* datavol is now up-to-date and at EOF */
     p->flags &= ~PM_DISCOVER_FLAGS_DATAVOL_READY;
 
+    /* remember where the tail is, unless the volume changed meanwhile */
+    if ((ctxp = __pmHandleToPtr(p->ctx)) != NULL) {
+	acp = ctxp->c_archctl;
+	p->logvol = acp->ac_curvol;
+	p->logvol_size = (locked || acp->ac_curvol != curvol) ? -1 : size;
+	PM_UNLOCK(ctxp->c_lock);
+    }
+
+    /* all deferred change events for this source are now processed */
+    if (p->backlog)
+	pmDiscoverSetBacklog(p, p->meta_backlog, 0);
+    if (last.tv_sec) {
+	pmtimespecNow(&now);
+	pmDiscoverSetDecodeLag(p, now.tv_sec < last.tv_sec ? 0 :
+		pmtimespecSub(&now, &last) * 1000);
+    }
+
     if (lock_path)
     	free(lock_path);
 }
@@ -1678,9 +2010,12 @@ print_callback(pmDiscover *p)
 
 	if (p->ctx >= 0 && (ctxp = __pmHandleToPtr(p->ctx)) != NULL) {
 	    acp = ctxp->c_archctl;
-	    fprintf(stderr, "    ARCHIVE %s fd=%d ctx=%d maxvol=%d ac_curvol=%d ac_offset=%ld %s\n",
+	    fprintf(stderr, "    ARCHIVE %s fd=%d ctx=%d maxvol=%d ac_curvol=%d ac_offset=%ld "
+		"meta_offset=%lld backlog=%llu/%llu lag=%llums %s\n",
 		p->context.name, p->fd, p->ctx, acp->ac_log->maxvol, acp->ac_curvol,
-		acp->ac_offset, pmDiscoverFlagsStr(p));
+		acp->ac_offset, (long long)p->meta_offset,
+		(unsigned long long)p->meta_backlog, (unsigned long long)p->backlog,
+		(unsigned long long)p->lag, pmDiscoverFlagsStr(p));
 	    PM_UNLOCK(ctxp->c_lock);
 	} else {
 	    /* no context yet - probably PM_DISCOVER_FLAGS_NEW */
@@ -1727,6 +2062,8 @@ changed_callback(pmDiscover *p)
 	if (time(&now) - p->lastcb < throttle || 
 	    redisSlotsInflightRequests(data->slots) > 1000000) {
 	    mmv_inc(data->map, data->metrics[DISCOVER_THROTTLE_CALLBACKS]);
+	    if (p->flags & (PM_DISCOVER_FLAGS_META|PM_DISCOVER_FLAGS_DATAVOL))
+		pmDiscoverSetBacklog(p, p->meta_backlog, p->backlog + 1);
 	    return; /* throttled */
 	}
     }
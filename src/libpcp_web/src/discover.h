@@ -69,6 +69,14 @@ typedef enum pmDiscoverFlags {
 struct pmDiscover;
 typedef void (*pmDiscoverChangeCallBack)(struct pmDiscover *);
 
+/* per-source metrics, one instance per archive being decoded */
+enum {
+    SOURCE_META_BACKLOG,
+    SOURCE_LOGVOL_BACKLOG,
+    SOURCE_DECODE_LAG,
+    NUM_SOURCE_METRIC
+};
+
 /*
  * Path to file or directory, possibly monitored (internals)
  */
@@ -85,6 +93,14 @@ typedef struct pmDiscover {
     uv_fs_event_t		*event_handle;	/* uv fs_notify event handle */ 
 #endif
     time_t			lastcb;		/* time last callback processed */
+    off_t			meta_offset;	/* last decoded metadata offset */
+    int				logvol;		/* last decoded data volume */
+    off_t			logvol_size;	/* its size when last decoded */
+    uint64_t			meta_backlog;	/* metadata bytes not decoded */
+    uint64_t			backlog;	/* change events throttled */
+    uint64_t			lag;		/* decode lag (milliseconds) */
+    unsigned int		instid;		/* per-source metrics instance */
+    pmAtomValue			*metrics[NUM_SOURCE_METRIC];
     struct stat			statbuf;	/* stat buffer */
     void			*baton;		/* private internal lib data */
     void			*data;		/* opaque user data pointer */
@@ -133,6 +149,9 @@ enum {
     DISCOVER_THROTTLE,
     DISCOVER_META_PARTIAL_READS,
     DISCOVER_DECODE_RESULT_ERRORS,
+    DISCOVER_BACKLOG_BYTES,
+    DISCOVER_BACKLOG_EVENTS,
+    DISCOVER_DECODE_LAG,
     NUM_DISCOVER_METRIC
 };
 
@@ -147,6 +166,13 @@ typedef struct discoverModuleData {
     pmAtomValue			*metrics[NUM_DISCOVER_METRIC];
     void			*map;
 
+    char			*sources_file;	/* per-source metrics file */
+    int				sources_cluster; /* and its MMV cluster */
+    int				sources_timer;	/* batched rebuild timer */
+    unsigned int		sources_changed; /* boolean, rebuild needed */
+    mmv_registry_t		*sources_registry;
+    void			*sources_map;
+
     struct dict			*config;	/* configuration dict */
     uv_loop_t			*events;	/* event library loop */
     redisSlots			*slots;		/* server slots data */
@@ -165,5 +191,7 @@ extern discoverModuleData *getDiscoverModuleData(pmDiscoverModule *);
 extern int pmDiscoverRegister(const char *,
 		pmDiscoverModule *, pmDiscoverCallBacks *, void *);
 extern void pmDiscoverUnregister(int);
+extern void pmDiscoverSourcesRefresh(void *);
+extern void pmDiscoverSourcesClose(pmDiscoverModule *);
 
 #endif /* SERIES_DISCOVER_H */
@@ -45,6 +45,25 @@ server_cache_metric(seriesLoadBaton *baton,
     redis_series_metric(baton->slots, metric, timestamp, meta, data, baton);
 }
 
+/* cache a completed rollup bucket for this metric, then reset it */
+static void
+server_cache_rollup(seriesLoadBaton *baton, metric_t *metric, unsigned int tier)
+{
+    int			i;
+
+    redis_series_rollup(baton->slots, metric, tier, baton);
+
+    if (metric->desc.indom == PM_INDOM_NULL) {
+	if (metric->rollup)
+	    memset(&metric->rollup[tier], 0, sizeof(rollup_t));
+    } else if (metric->u.vlist) {
+	for (i = 0; i < metric->u.vlist->listcount; i++) {
+	    if (metric->u.vlist->value[i].rollup)
+		memset(&metric->u.vlist->value[i].rollup[tier], 0, sizeof(rollup_t));
+	}
+    }
+}
+
 /* cache a mark record (discontinuity) for metrics from this source */
 static void
 server_cache_mark(seriesLoadBaton *baton, sds timestamp, int data)
@@ -111,7 +130,8 @@ load_prepare_metric(const char *name, void *arg)
 
 /*
  * Iterate over an instance domain and extract names and labels
- * for each instance.
+ * for each instance.  Sources without a PMAPI context (such as
+ * remote-write clients) supply these via the discovery callbacks.
  */
 static void
 get_instance_metadata(seriesLoadBaton *baton, pmInDom indom, int force_refresh)
@@ -120,7 +140,11 @@ get_instance_metadata(seriesLoadBaton *baton, pmInDom indom, int force_refresh)
     domain_t		*dp;
     indom_t		*ip;
 
-    if (indom != PM_INDOM_NULL) {
+    if (indom != PM_INDOM_NULL && cp->context < 0) {
+	dp = pmwebapi_add_domain(cp, pmInDom_domain(indom));
+	if ((ip = pmwebapi_add_indom(cp, dp, indom)) != NULL)
+	    ip->updated = 0;
+    } else if (indom != PM_INDOM_NULL) {
 	if ((dp = pmwebapi_add_domain(cp, pmInDom_domain(indom))))
 	    pmwebapi_add_domain_labels(cp, dp);
 	if ((ip = pmwebapi_add_indom(cp, dp, indom)) != NULL) {
@@ -141,6 +165,10 @@ get_metric_metadata(seriesLoadBaton *baton, metric_t *metric)
 {
     context_t		*context = &baton->pmapi.context;
 
+    if (context->context < 0) {	/* no PMAPI context, labels discovered */
+	pmwebapi_metric_hash(metric);
+	return;
+    }
     if (metric->cluster) {
 	if (metric->cluster->domain)
 	    pmwebapi_add_domain_labels(context, metric->cluster->domain);
@@ -165,6 +193,8 @@ new_metric(seriesLoadBaton *baton, pmValueSet *vsp)
     char		**nameall = NULL;
     int			count = 0, sts, i;
 
+    if (context->context < 0)	/* no PMAPI context, metric not discovered */
+	return NULL;
     if ((sts = pmUseContext(context->context)) < 0) {
 	fprintf(stderr, "%s: failed to use context for PMID %s: %s\n",
 		"new_metric",
@@ -435,6 +465,137 @@ pmwebapi_add_valueset(metric_t *metric, pmValueSet *vsp)
     return count;
 }
 
+static int
+rollup_atom_value(int type, pmAtomValue *atom, double *value)
+{
+    switch (type) {
+    case PM_TYPE_32:
+	*value = atom->l;
+	break;
+    case PM_TYPE_U32:
+	*value = atom->ul;
+	break;
+    case PM_TYPE_64:
+	*value = atom->ll;
+	break;
+    case PM_TYPE_U64:
+	*value = atom->ull;
+	break;
+    case PM_TYPE_FLOAT:
+	*value = atom->f;
+	break;
+    case PM_TYPE_DOUBLE:
+	*value = atom->d;
+	break;
+    default:
+	return -1;
+    }
+    return 0;
+}
+
+static void
+rollup_accumulate(rollup_t *rollup, unsigned int ntiers, double value)
+{
+    unsigned int	i;
+
+    for (i = 0; i < ntiers; i++, rollup++) {
+	if (rollup->count == 0 || value < rollup->min)
+	    rollup->min = value;
+	if (rollup->count == 0 || value > rollup->max)
+	    rollup->max = value;
+	rollup->sum += value;
+	rollup->count++;
+    }
+}
+
+/*
+ * Maintain the optional downsampled rollup tiers for numeric metrics.
+ * When a sample falls into a new bucket for any tier, the previous
+ * (now complete) bucket is written out before accumulating this one.
+ */
+static void
+series_rollup_update(seriesLoadBaton *baton, metric_t *metric,
+		struct timespec *stamp)
+{
+    rollupTier		*tiers;
+    unsigned int	i, ntiers;
+    __int64_t		bucket;
+    value_t		*value;
+    double		data;
+    int			type = metric->desc.type;
+
+    if ((ntiers = redisRollupTiers(&tiers)) == 0)
+	return;
+    if (metric->error < 0 || metric->updated == 0)
+	return;
+    if (type < PM_TYPE_32 || type > PM_TYPE_DOUBLE)
+	return;		/* not a numeric metric type */
+
+    if (metric->rollup_bucket == NULL &&
+	(metric->rollup_bucket = calloc(ntiers, sizeof(__int64_t))) == NULL)
+	return;
+    for (i = 0; i < ntiers; i++) {
+	bucket = stamp->tv_sec - (stamp->tv_sec % tiers[i].seconds);
+	if (metric->rollup_bucket[i] == bucket)
+	    continue;
+	if (metric->rollup_bucket[i] != 0)
+	    server_cache_rollup(baton, metric, i);
+	metric->rollup_bucket[i] = bucket;
+    }
+
+    if (metric->desc.indom == PM_INDOM_NULL) {
+	if (rollup_atom_value(type, &metric->u.atom, &data) < 0)
+	    return;
+	if (metric->rollup == NULL &&
+	    (metric->rollup = calloc(ntiers, sizeof(rollup_t))) == NULL)
+	    return;
+	rollup_accumulate(metric->rollup, ntiers, data);
+    } else if (metric->u.vlist) {
+	for (i = 0; i < metric->u.vlist->listcount; i++) {
+	    value = &metric->u.vlist->value[i];
+	    if (value->updated == 0 ||
+		rollup_atom_value(type, &value->atom, &data) < 0)
+		continue;
+	    if (value->rollup == NULL &&
+		(value->rollup = calloc(ntiers, sizeof(rollup_t))) == NULL)
+		continue;
+	    rollup_accumulate(value->rollup, ntiers, data);
+	}
+    }
+}
+
+/*
+ * Write out the current (partial) bucket of each rollup tier for all
+ * metrics of this source as it is closing - at the end of an archive,
+ * or when a discovered source goes away - so the values ingested last
+ * are also available from the rollup tiers.
+ */
+static void
+series_rollup_flush(seriesLoadBaton *baton)
+{
+    context_t		*cp = &baton->pmapi.context;
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    metric_t		*metric;
+    unsigned int	i, ntiers;
+
+    if ((ntiers = redisRollupTiers(NULL)) == 0 || cp->pmids == NULL)
+	return;
+    iterator = dictGetIterator(cp->pmids);
+    while ((entry = dictNext(iterator)) != NULL) {
+	metric = (metric_t *)dictGetVal(entry);
+	if (metric->rollup_bucket == NULL)
+	    continue;
+	for (i = 0; i < ntiers; i++) {
+	    if (metric->rollup_bucket[i] == 0)
+		continue;
+	    server_cache_rollup(baton, metric, i);
+	    metric->rollup_bucket[i] = 0;
+	}
+    }
+    dictReleaseIterator(iterator);
+}
+
 static void
 series_cache_update(seriesLoadBaton *baton, struct dict *exclude)
 {
@@ -500,6 +661,10 @@ series_cache_update(seriesLoadBaton *baton, struct dict *exclude)
 
 	/* initiate writes to backend caching servers (Redis) */
 	server_cache_metric(baton, metric, timestamp, write_meta, write_data);
+
+	/* accumulate values into any rollup tiers, writing completed buckets */
+	if (write_data)
+	    series_rollup_update(baton, metric, &result->timestamp);
     }
 
 out:
@@ -607,6 +772,7 @@ fetch_archive_done(uv_work_t *req, int status)
     if (sts < 0) {
 	if (sts != PM_ERR_EOL)
 	    baton->error = sts;
+	series_rollup_flush(baton);
 	doneSeriesGetContext(context, "fetch_archive_done");
     }
 
@@ -1265,6 +1431,9 @@ pmSeriesDiscoverClosed(pmDiscoverEvent *event, void *arg)
 
     (void)arg;
 
+    /* complete any partially filled rollup buckets for this source */
+    series_rollup_flush(baton);
+
     /* release pmSeriesDiscoverSource reference on load and context batons */
     doneSeriesLoadBaton(baton, "pmSeriesDiscoverSource");
 }
@@ -108,10 +108,18 @@ typedef struct cluster {
     pmLabelSet		*labelset;
 } cluster_t;
 
+typedef struct rollup {
+    double		sum;		/* total over current bucket */
+    double		min;		/* smallest value in bucket */
+    double		max;		/* largest value in bucket */
+    unsigned int	count;		/* samples in current bucket */
+} rollup_t;
+
 typedef struct value {
     int			inst;		/* internal instance identifier */
     unsigned int	updated;	/* last sample modified value */
     pmAtomValue		atom;		/* most recent sampled value */
+    rollup_t		*rollup;	/* per-tier accumulators or NULL */
 } value_t;
 
 typedef struct valuelist {
@@ -139,6 +147,8 @@ typedef struct metric {
 	pmAtomValue	atom;		/* singleton value (PM_IN_NULL) */
 	valuelist_t	*vlist;		/* instance values and metadata */
     } u;
+    __int64_t		*rollup_bucket;	/* start of current bucket per tier */
+    rollup_t		*rollup;	/* singleton per-tier accumulators */
 } metric_t;
 
 struct seriesGetContext;
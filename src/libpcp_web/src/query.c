@@ -25,6 +25,7 @@
 #include "slots.h"
 #include "maps.h"
 #include <math.h>
+#include <float.h>
 #include <fnmatch.h>
 
 #define SHA1SZ		20	/* internal sha1 hash buffer size in bytes */
@@ -72,6 +73,9 @@ static void series_pattern_match(seriesQueryBaton *, node_t *);
 static int series_union(series_set_t *, series_set_t *);
 static int series_intersect(series_set_t *, series_set_t *);
 static int series_calculate(node_t *, int, void *);
+static void series_prepare_time_request(seriesQueryBaton *, seriesGetSID *, int);
+static void series_value_set_store(series_value_set_t *);
+static void series_column_free(series_column_t *);
 static void series_redis_hash_expression(seriesQueryBaton *, char *, int);
 static void series_node_get_metric_name(seriesQueryBaton *, seriesGetSID *, series_sample_set_t *);
 static void series_node_get_desc(seriesQueryBaton *, sds, series_sample_set_t *);
@@ -134,6 +138,7 @@ freeSeriesQueryNode(node_t *np)
 	    sdsfree(np->value_set.series_values[i].series_desc.source);
 	    sdsfree(np->value_set.series_values[i].series_desc.type);
 	    sdsfree(np->value_set.series_values[i].series_desc.units);
+	    series_column_free(np->value_set.series_values[i].column);
 	}
 	free(np->value_set.series_values);
     }
@@ -1546,6 +1551,32 @@ series_query_expr_reply(redisClusterAsyncContext *c, void *r, void *arg)
     series_query_end_phase(baton);
 }
 
+/*
+ * Check that a rollup tier reply covers the start of the query time
+ * window - i.e. rollups were being written for this series at that
+ * time and the bucket has not since been trimmed from the stream.
+ */
+static int
+series_rollup_covers(seriesQueryBaton *baton, seriesGetSID *sid,
+		redisReply *reply)
+{
+    timing_t		*tp = &baton->query.timing;
+    redisReply		*first;
+    pmTimespec		ts;
+    sds			stamp;
+    int			sts;
+
+    if (reply->elements == 0)
+	return 0;
+    first = reply->element[0];
+    if (first->type != REDIS_REPLY_ARRAY || first->elements < 1)
+	return 0;
+    stamp = sdsempty();
+    sts = extract_time(baton, sid->name, first->element[0], &stamp, &ts);
+    sdsfree(stamp);
+    return (sts == 0 && ts.tv_sec <= tp->start.tv_sec);
+}
+
 static void
 series_prepare_time_reply(
 	redisClusterAsyncContext *c, void *r, void *arg)
@@ -1564,6 +1595,13 @@ series_prepare_time_reply(
 			sid->name, redis_reply_type(reply));
 	batoninfo(baton, PMLOG_RESPONSE, msg);
 	baton->error = -EPROTO;
+    } else if (sid->rollup && !series_rollup_covers(baton, sid, reply)) {
+	/* rollups are missing for (part of) this time window, use raw values */
+	if (pmDebugOptions.series)
+	    fprintf(stderr, "series_prepare_time_reply: sid %s rollup fallback\n",
+			    sid->name);
+	series_prepare_time_request(baton, sid, -1);
+	return;
     } else {
 	if (reply->elements > 0) {
 	    /* reply is a normal time series */
@@ -1604,36 +1642,112 @@ series_value_count_only(timing_t *tp)
     return tp->count;
 }
 
+/*
+ * Select the rollup tier from which values for this time window should
+ * be read, if any - for interval queries from a given start time, the
+ * coarsest tier whose bucket width does not exceed the interval.  When
+ * the tier turns out not to cover the window (series_rollup_covers),
+ * the raw values are used instead.
+ */
+static int
+series_rollup_tier(timing_t *tp)
+{
+    if (tp->delta.tv_sec == 0 && tp->delta.tv_nsec == 0)
+	return -1;
+    if (tp->start.tv_sec == 0 && tp->start.tv_nsec == 0)
+	return -1;
+    if (series_value_count_only(tp) || redisRollupTiers(NULL) == 0)
+	return -1;
+    return redisRollupTier(&tp->delta);
+}
+
+/*
+ * Request the values of one series for the query time window, either
+ * bucket averages from a rollup tier (tier >= 0) or raw values.  The
+ * rollup range starts at the bucket holding the start time and, when
+ * a sample count is given, is limited to as many buckets as can span
+ * that many sampling intervals.
+ */
 static void
-series_prepare_time(seriesQueryBaton *baton, series_set_t *result)
+series_prepare_time_request(seriesQueryBaton *baton, seriesGetSID *sid, int tier)
 {
     timing_t		*tp = &baton->query.timing;
-    unsigned char	*series = result->series;
-    seriesGetSID	*sid;
-    char		buffer[64], revbuf[64];
-    sds			start, end, key, cmd;
-    unsigned int	i, revlen = 0, reverse = 0;
+    rollupTier		*tiers;
+    struct timespec	start = tp->start;
+    unsigned long long	buckets;
+    unsigned int	cntlen = 0, reverse;
+    char		buffer[64], cntbuf[64];
+    sds			key, cmd;
 
     /* if only 'count' is requested, work back from most recent value */
-    if ((reverse = series_value_count_only(tp)) != 0) {
-	revlen = pmsprintf(revbuf, sizeof(revbuf), "%u", reverse);
-	start = sdsnew("+");
+    if ((reverse = series_value_count_only(tp)) != 0)
+	cntlen = pmsprintf(cntbuf, sizeof(cntbuf), "%u", reverse);
+
+    if (tier >= 0) {
+	redisRollupTiers(&tiers);
+	key = sdscatfmt(sdsempty(), "pcp:rollup:%S:avg:series:%S",
+			tiers[tier].name, sid->name);
+	start.tv_sec -= start.tv_sec % tiers[tier].seconds;
+	start.tv_nsec = 0;
+	if (tp->count) {
+	    buckets = tp->delta.tv_sec / tiers[tier].seconds + 1;
+	    buckets = buckets * tp->count + 1;
+	    cntlen = pmsprintf(cntbuf, sizeof(cntbuf), "%llu", buckets);
+	}
+	sid->rollup = tier + 1;
     } else {
-	start = sdsnew(timespec_stream_str(&tp->start, buffer, sizeof(buffer)));
+	key = sdscatfmt(sdsempty(), "pcp:values:series:%S", sid->name);
+	sid->rollup = 0;
     }
 
-    if (pmDebugOptions.series)
-	fprintf(stderr, "START: %s\n", start);
+    /* X[REV]RANGE key t1 t2 [count N] */
+    if (reverse) {
+	cmd = redis_command(6);
+	cmd = redis_param_str(cmd, XREVRANGE, XREVRANGE_LEN);
+	cmd = redis_param_sds(cmd, key);
+	cmd = redis_param_str(cmd, "+", 1);
+	cmd = redis_param_str(cmd, "-", 1);
+    } else {
+	cmd = redis_command(cntlen ? 6 : 4);
+	cmd = redis_param_str(cmd, XRANGE, XRANGE_LEN);
+	cmd = redis_param_sds(cmd, key);
+	timespec_stream_str(&start, buffer, sizeof(buffer));
+	cmd = redis_param_str(cmd, buffer, strlen(buffer));
+	if (tp->end.tv_sec) {
+	    timespec_stream_str(&tp->end, buffer, sizeof(buffer));
+	    cmd = redis_param_str(cmd, buffer, strlen(buffer));
+	} else {
+	    /* "+" means "no end" - to the most recent */
+	    cmd = redis_param_str(cmd, "+", 1);
+	}
+    }
+    if (cntlen) {
+	cmd = redis_param_str(cmd, "COUNT", sizeof("COUNT")-1);
+	cmd = redis_param_str(cmd, cntbuf, cntlen);
+    }
+    sdsfree(key);
+    redisSlotsRequest(baton->slots, cmd, series_prepare_time_reply, sid);
+    sdsfree(cmd);
+}
 
-    if (reverse)
-	end = sdsnew("-");
-    else if (tp->end.tv_sec)
-	end = sdsnew(timespec_stream_str(&tp->end, buffer, sizeof(buffer)));
-    else
-	end = sdsnew("+");	/* "+" means "no end" - to the most recent */
+static void
+series_prepare_time(seriesQueryBaton *baton, series_set_t *result)
+{
+    timing_t		*tp = &baton->query.timing;
+    unsigned char	*series = result->series;
+    seriesGetSID	*sid;
+    char		buffer[64];
+    unsigned int	i, reverse = series_value_count_only(tp);
+    int			tier = series_rollup_tier(tp);
 
-    if (pmDebugOptions.series)
-	fprintf(stderr, "END: %s\n", end);
+    if (pmDebugOptions.series) {
+	fprintf(stderr, "START: %s\n", reverse ? "+" :
+		timespec_stream_str(&tp->start, buffer, sizeof(buffer)));
+	fprintf(stderr, "END: %s\n", reverse ? "-" : !tp->end.tv_sec ? "+" :
+		timespec_stream_str(&tp->end, buffer, sizeof(buffer)));
+	if (tier >= 0)
+	    fprintf(stderr, "ROLLUP: tier %d\n", tier);
+    }
 
     /*
      * Query cache for the time series range (groups of instance:value
@@ -1646,30 +1760,8 @@ series_prepare_time(seriesQueryBaton *baton, series_set_t *result)
 	initSeriesGetSID(sid, buffer, 1, baton);
 	seriesBatonReference(baton, "series_prepare_time");
 
-	key = sdscatfmt(sdsempty(), "pcp:values:series:%S", sid->name);
-
-	/* X[REV]RANGE key t1 t2 [count N] */
-	if (reverse) {
-	    cmd = redis_command(6);
-	    cmd = redis_param_str(cmd, XREVRANGE, XREVRANGE_LEN);
-	} else {
-	    cmd = redis_command(4);
-	    cmd = redis_param_str(cmd, XRANGE, XRANGE_LEN);
-	}
-	cmd = redis_param_sds(cmd, key);
-	cmd = redis_param_sds(cmd, start);
-	cmd = redis_param_sds(cmd, end);
-	if (reverse) {
-	    cmd = redis_param_str(cmd, "COUNT", sizeof("COUNT")-1);
-	    cmd = redis_param_str(cmd, revbuf, revlen);
-	}
-	sdsfree(key);
-	redisSlotsRequest(baton->slots, cmd,
-				series_prepare_time_reply, sid);
-	sdsfree(cmd);
+	series_prepare_time_request(baton, sid, tier);
     }
-    sdsfree(start);
-    sdsfree(end);
 }
 
 static void
@@ -2599,6 +2691,7 @@ series_node_values_report(seriesQueryBaton *baton, node_t *np)
     sds		series;
     int		i, j, k;
 
+    series_value_set_store(&np->value_set);
     for (i = 0; i < np->value_set.num_series; i++) {
 	series = np->value_set.series_values[i].sid->name;
 	for (j = 0; j < np->value_set.series_values[i].num_samples; j++) {
@@ -2610,6 +2703,336 @@ series_node_values_report(seriesQueryBaton *baton, node_t *np)
     }
 }
 
+/*
+ * Allocate an empty column of n_samples rows by n_instances values.
+ */
+static series_column_t *
+series_column_alloc(unsigned int n_samples, unsigned int n_instances,
+		const char *format)
+{
+    series_column_t	*column;
+    size_t		rows = n_samples ? n_samples : 1;
+    size_t		cols = n_instances ? n_instances : 1;
+
+    if ((column = calloc(1, sizeof(series_column_t))) == NULL)
+	return NULL;
+    if ((column->valid = calloc(rows, sizeof(unsigned char))) == NULL) {
+	free(column);
+	return NULL;
+    }
+    if ((column->values = calloc(rows * cols, sizeof(double))) == NULL) {
+	free(column->valid);
+	free(column);
+	return NULL;
+    }
+    column->num_samples = n_samples;
+    column->num_instances = n_instances;
+    column->format = format;
+    return column;
+}
+
+static void
+series_column_free(series_column_t *column)
+{
+    if (column == NULL)
+	return;
+    free(column->values);
+    free(column->valid);
+    free(column);
+}
+
+static inline double *
+series_column_row(series_column_t *column, unsigned int sample)
+{
+    return column->values + (size_t)sample * column->num_instances;
+}
+
+static void
+series_column_nomem(seriesQueryBaton *baton, const char *func)
+{
+    sds			msg;
+
+    infofmt(msg, "%s: out of memory for sample values\n", func);
+    batoninfo(baton, PMLOG_ERROR, msg);
+    baton->error = -ENOMEM;
+}
+
+/*
+ * Typed column of a sample set.  On first use by a kernel operator all
+ * values are parsed from their strings, once, into a series_column_t;
+ * the column then stays with the sample set and each kernel operator
+ * produces a column for the next (e.g. avg(rate(...))), so there is no
+ * intermediate string formatting and re-parsing.
+ * Samples with an instance count differing from the first sample are
+ * flagged invalid (and reported) - kernels skip these rows, and their
+ * value strings are never replaced.
+ * Returns NULL for an empty sample set, or when out of memory.
+ */
+static series_column_t *
+series_column_get(seriesQueryBaton *baton, series_sample_set_t *set)
+{
+    series_instance_set_t	*sample;
+    series_column_t		*column;
+    unsigned int		n_samples, n_instances, j, k;
+    double			*row;
+    sds				msg;
+
+    if (set->column != NULL)
+	return set->column;
+    if (set->num_samples <= 0)
+	return NULL;
+    n_samples = set->num_samples;
+    n_instances = set->series_sample[0].num_instances;
+    if ((column = series_column_alloc(n_samples, n_instances, NULL)) == NULL) {
+	series_column_nomem(baton, "series_column_get");
+	return NULL;
+    }
+
+    for (j = 0; j < n_samples; j++) {
+	sample = &set->series_sample[j];
+	if (sample->num_instances != n_instances) {
+	    if (pmDebugOptions.query && pmDebugOptions.desperate) {
+		infofmt(msg, "number of instances in each sample are not equal\n");
+		batoninfo(baton, PMLOG_ERROR, msg);
+	    }
+	    continue;
+	}
+	column->valid[j] = 1;
+	row = series_column_row(column, j);
+	for (k = 0; k < n_instances; k++)
+	    row[k] = strtod(sample->series_instance[k].data, NULL);
+    }
+    set->column = column;
+    return column;
+}
+
+/* all rows of a column have the instance count of the first sample */
+static int
+series_column_complete(series_column_t *column)
+{
+    unsigned int	j;
+
+    for (j = 0; j < column->num_samples; j++)
+	if (!column->valid[j])
+	    return 0;
+    return 1;
+}
+
+/*
+ * Format computed values of a sample set column back into the value
+ * strings, and release the column.  Done once, for the output node or
+ * before an operator that works on the value strings.
+ */
+static void
+series_column_store(series_sample_set_t *set)
+{
+    series_column_t	*column = set->column;
+    pmSeriesValue	*value;
+    unsigned int	j, k;
+    double		*row;
+    char		str[512];
+
+    if (column == NULL)
+	return;
+    for (j = 0; column->format && j < column->num_samples; j++) {
+	if ((int)j >= set->num_samples)
+	    break;
+	if (!column->valid[j])
+	    continue;
+	row = series_column_row(column, j);
+	for (k = 0; k < column->num_instances; k++) {
+	    if (k >= set->series_sample[j].num_instances)
+		break;
+	    value = &set->series_sample[j].series_instance[k];
+	    pmsprintf(str, sizeof(str), column->format, row[k]);
+	    sdsfree(value->data);
+	    value->data = sdsnew(str);
+	}
+    }
+    series_column_free(column);
+    set->column = NULL;
+}
+
+static void
+series_value_set_store(series_value_set_t *value_set)
+{
+    int			i;
+
+    for (i = 0; i < value_set->num_series; i++)
+	series_column_store(&value_set->series_values[i]);
+}
+
+/*
+ * Numeric kernels over contiguous double arrays - simple loops with
+ * no aliasing or per-element branching on strings, amenable to the
+ * compilers auto-vectorisation.
+ */
+static inline double
+series_kernel_sum(const double *values, unsigned int count)
+{
+    double		sum = 0.0;
+    unsigned int	k;
+
+    for (k = 0; k < count; k++)
+	sum += values[k];
+    return sum;
+}
+
+static inline void
+series_kernel_accumulate(double *sums, const double *values, unsigned int count)
+{
+    unsigned int	k;
+
+    for (k = 0; k < count; k++)
+	sums[k] += values[k];
+}
+
+/* index of the first maximum (maximum != 0) or minimum value */
+static inline unsigned int
+series_kernel_extreme(const double *values, unsigned int count, int maximum)
+{
+    unsigned int	k, index = 0;
+
+    for (k = 1; k < count; k++) {
+	if (maximum ? (values[index] < values[k]) : (values[index] > values[k]))
+	    index = k;
+    }
+    return index;
+}
+
+/* count of values outside [low, high], including NaN */
+static inline size_t
+series_kernel_outside(const double *values, size_t count, double low, double high)
+{
+    size_t		k, outside = 0;
+
+    for (k = 0; k < count; k++)
+	outside += !(values[k] >= low && values[k] <= high);
+    return outside;
+}
+
+static inline void
+series_kernel_scale(double *values, size_t count, double mult)
+{
+    size_t		k;
+
+    for (k = 0; k < count; k++)
+	values[k] *= mult;
+}
+
+/* values of an operand as extracted for the result type */
+static void
+series_kernel_extract(double *out, const double *in, size_t count, int type)
+{
+    size_t		k;
+
+    switch (type) {
+    case PM_TYPE_FLOAT:
+	for (k = 0; k < count; k++)
+	    out[k] = (float)in[k];
+	break;
+    case PM_TYPE_DOUBLE:
+	memcpy(out, in, count * sizeof(double));
+	break;
+    default:	/* integer types */
+	for (k = 0; k < count; k++)
+	    out[k] = trunc(in[k]);
+	break;
+    }
+}
+
+/* left = left (operator) right, over all values */
+static void
+series_kernel_binary(double *left, const double *right, size_t count, int ope_type)
+{
+    size_t		k;
+
+    switch (ope_type) {
+    case N_PLUS:
+	for (k = 0; k < count; k++)
+	    left[k] += right[k];
+	break;
+    case N_MINUS:
+	for (k = 0; k < count; k++)
+	    left[k] -= right[k];
+	break;
+    case N_STAR:
+	for (k = 0; k < count; k++)
+	    left[k] *= right[k];
+	break;
+    case N_SLASH:
+	for (k = 0; k < count; k++)
+	    left[k] /= right[k];
+	break;
+    }
+}
+
+/* results rounded to the result type - float precision, no -0 integers */
+static void
+series_kernel_result(double *values, size_t count, int type)
+{
+    size_t		k;
+
+    switch (type) {
+    case PM_TYPE_FLOAT:
+	for (k = 0; k < count; k++)
+	    values[k] = (float)values[k];
+	break;
+    case PM_TYPE_DOUBLE:
+	break;
+    default:	/* integer types */
+	for (k = 0; k < count; k++)
+	    values[k] += 0.0;
+	break;
+    }
+}
+
+/*
+ * Per-column (instance) index of the first maximum or minimum value
+ * across all valid rows (samples), starting from the first row.
+ */
+static int
+series_column_extreme(series_column_t *column, int maximum, unsigned int *index)
+{
+    unsigned int	n_instances = column->num_instances;
+    unsigned int	j, k;
+    double		*best, *row;
+
+    memset(index, 0, n_instances * sizeof(unsigned int));
+    if (n_instances == 0)
+	return 0;
+    if ((best = malloc(n_instances * sizeof(double))) == NULL)
+	return -ENOMEM;
+    memcpy(best, series_column_row(column, 0), n_instances * sizeof(double));
+    for (j = 1; j < column->num_samples; j++) {
+	if (!column->valid[j])
+	    continue;
+	row = series_column_row(column, j);
+	for (k = 0; k < n_instances; k++) {
+	    if (maximum ? (best[k] < row[k]) : (best[k] > row[k])) {
+		best[k] = row[k];
+		index[k] = j;
+	    }
+	}
+    }
+    free(best);
+    return 0;
+}
+
+/*
+ * Copy one value into a kernel result - the value string is copied
+ * only while it is current, otherwise it is formatted from the result
+ * column when that is stored.
+ */
+static void
+series_kernel_value(pmSeriesValue *out, pmSeriesValue *in, const char *format)
+{
+    out->timestamp = sdsnew(in->timestamp);
+    out->series = sdsnew(in->series);
+    out->data = format ? sdsempty() : sdsnew(in->data);
+    out->ts = in->ts;
+}
+
 static int
 series_rate_check(pmSeriesDesc desc)
 {
@@ -2627,30 +3050,32 @@ static void
 series_calculate_rate(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+    series_sample_set_t	*set;
+    series_column_t	*column;
     pmSeriesValue	s_pmval, t_pmval;
-    unsigned int	n_instances, n_samples, i, j, k;
-    double		s_data, t_data, mult;
-    char		str[256];
+    unsigned int	n_instances = 0, n_samples, i, j, k;
+    double		*s_data, *t_data, mult;
     sds			msg, expr;
     int			sts;
     pmUnits		units = {0};
 
     np->value_set = np->left->value_set;
     for (i = 0; i < np->value_set.num_series; i++) {
-	n_samples = np->value_set.series_values[i].num_samples;
-	if (series_rate_check(np->value_set.series_values[i].series_desc) == 0) {
-	    n_instances = (n_samples == 0) ? 0 :
-		np->value_set.series_values[i].series_sample[0].num_instances;
+	set = &np->value_set.series_values[i];
+	n_samples = set->num_samples;
+	if (series_rate_check(set->series_desc) == 0) {
+	    if ((column = series_column_get(baton, set)) == NULL)
+		n_samples = 0;
+	    else
+		n_instances = column->num_instances;
 	    for (j = 1; j < n_samples; j++) {
-		if (np->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
-		    if (pmDebugOptions.query && pmDebugOptions.desperate)
-			fprintf(stderr, "Error: number of instances in each sample are not equal %d != %d.\n",
-				np->value_set.series_values[i].series_sample[j].num_instances, n_instances);
+		if (!column->valid[j] || !column->valid[j-1])
 		    continue;
-		}
+		t_data = series_column_row(column, j-1);
+		s_data = series_column_row(column, j);
 		for (k = 0; k < n_instances; k++) {
-		    t_pmval = np->value_set.series_values[i].series_sample[j-1].series_instance[k];
-		    s_pmval = np->value_set.series_values[i].series_sample[j].series_instance[k];
+		    t_pmval = set->series_sample[j-1].series_instance[k];
+		    s_pmval = set->series_sample[j].series_instance[k];
 		    if (strcmp(s_pmval.series, t_pmval.series) != 0) {
 			/* TODO: two SIDs of the instances' names between samples are different, report error. */
 			if (pmDebugOptions.query) {
@@ -2660,307 +3085,186 @@ series_calculate_rate(node_t *np, void *arg)
 		    }
 
 		    /* compute rate/sec from delta value and delta timestamp */
-		    s_data = strtod(s_pmval.data, NULL);
-		    t_data = strtod(t_pmval.data, NULL);
-		    pmsprintf(str, sizeof(str), "%.6lf", (t_data - s_data) / pmTimespec_delta(&t_pmval.ts, &s_pmval.ts));
-
-		    sdsfree(np->value_set.series_values[i].series_sample[j-1].series_instance[k].data);
-		    sdsfree(np->value_set.series_values[i].series_sample[j-1].series_instance[k].timestamp);
-		    np->value_set.series_values[i].series_sample[j-1].series_instance[k].data = sdsnew(str);
-		    np->value_set.series_values[i].series_sample[j-1].series_instance[k].timestamp =
-		    	sdsnew(np->value_set.series_values[i].series_sample[j].series_instance[k].timestamp);
-		    np->value_set.series_values[i].series_sample[j-1].series_instance[k].ts =
-		    	np->value_set.series_values[i].series_sample[j].series_instance[k].ts;
+		    t_data[k] = (t_data[k] - s_data[k]) / pmTimespec_delta(&t_pmval.ts, &s_pmval.ts);
+
+		    sdsfree(set->series_sample[j-1].series_instance[k].timestamp);
+		    set->series_sample[j-1].series_instance[k].timestamp =
+		    	sdsnew(set->series_sample[j].series_instance[k].timestamp);
+		    set->series_sample[j-1].series_instance[k].ts =
+		    	set->series_sample[j].series_instance[k].ts;
 		}
 		if (j == n_samples-1) {
 		    /* Free the last sample */
 		    for (k = 0; k < n_instances; k++) {
-			sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].timestamp);
-			sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].series);
-			sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].data);
+			sdsfree(set->series_sample[j].series_instance[k].timestamp);
+			sdsfree(set->series_sample[j].series_instance[k].series);
+			sdsfree(set->series_sample[j].series_instance[k].data);
 		    }
-		    np->value_set.series_values[i].num_samples -= 1;
+		    set->num_samples -= 1;
+		    column->num_samples -= 1;
 		}
 	    }
+	    if (column)
+		column->format = "%.6lf";
 	} else {
 	    expr = series_expr_canonical(np->left, i);
 	    infofmt(msg, "Can't rate convert '%s', counter semantics required\n", expr);
 	    sdsfree(expr);
 	    batoninfo(baton, PMLOG_ERROR, msg);
 	    baton->error = -EPROTO;
-	    np->value_set.series_values[i].num_samples = -n_samples;
+	    set->num_samples = -n_samples;
 	}
-	sdsfree(np->value_set.series_values[i].series_desc.type);
-	sdsfree(np->value_set.series_values[i].series_desc.semantics);
-	if ((sts = pmParseUnitsStr(
-			np->value_set.series_values[i].series_desc.units,
+	sdsfree(set->series_desc.type);
+	sdsfree(set->series_desc.semantics);
+	if ((sts = pmParseUnitsStr(set->series_desc.units,
 			&units, &mult, &msg)) < 0) {
 	    free(msg);
 	}
-	sdsfree(np->value_set.series_values[i].series_desc.units);
+	sdsfree(set->series_desc.units);
 	units.dimTime -= 1;
 	units.scaleTime = PM_TIME_SEC;
-	np->value_set.series_values[i].series_desc.type = sdsnew("double");
-	np->value_set.series_values[i].series_desc.semantics = sdsnew("instant");
-	np->value_set.series_values[i].series_desc.units = sdsnew(pmUnitsStr(&units));
+	set->series_desc.type = sdsnew("double");
+	set->series_desc.semantics = sdsnew("instant");
+	set->series_desc.units = sdsnew(pmUnitsStr(&units));
     }
 }
 
 /*
- * Compare and pick the max instance value(s) among samples.
+ * Compare and pick the max (maximum != 0) or min instance value(s)
+ * among samples, for each sample.
  */
 static void
-series_calculate_time_domain_max(node_t *np, void *arg)
+series_calculate_time_domain_extreme(node_t *np, void *arg, int maximum)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		max_data, data;
-    int			max_pointer;
-    sds			msg;
-    pmSeriesValue	inst;
+    series_sample_set_t	*set, *out;
+    series_instance_set_t *sample;
+    series_column_t	*column, *result;
+    unsigned int	n_series, n_samples, i, j;
+    unsigned int	pointer;
 
     n_series = np->left->value_set.num_series;
-    np->value_set.num_series = n_series;
-    np->value_set.series_values = (series_sample_set_t *)calloc(n_series, sizeof(series_sample_set_t));
-    for (i = 0; i < n_series; i++) {
-	n_samples = np->left->value_set.series_values[i].num_samples;
-	if (n_samples > 0) {
-	    np->value_set.series_values[i].num_samples = n_samples;
-	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(n_samples, sizeof(series_instance_set_t));
-	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
-
-	    for (j = 0; j < n_samples; j++) {
-		np->value_set.series_values[i].series_sample[j].num_instances = 1;
-		np->value_set.series_values[i].series_sample[j].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue));
-
-		max_pointer = 0;
-		max_data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[0].data);
-		for (k = 1; k < n_instances; k++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
-			if (pmDebugOptions.query && pmDebugOptions.desperate) {
-			    infofmt(msg, "number of instances in each sample are not equal\n");
-			    batoninfo(baton, PMLOG_ERROR, msg);
-			}
-			continue;
-		    }                
-		    data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		    if (max_data < data) {
-			max_data = data;
-			max_pointer = k;
-		    }
-		}
-		inst = np->left->value_set.series_values[i].series_sample[j].series_instance[max_pointer];
-
-		np->value_set.series_values[i].series_sample[j].series_instance[0].timestamp = sdsnew(inst.timestamp);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].series = sdsnew(inst.series);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].data = sdsnew(inst.data);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].ts = inst.ts;
-	    }
-        } else {
-	    np->value_set.series_values[i].num_samples = 0;
-	}
-	np->value_set.series_values[i].sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
-	np->value_set.series_values[i].sid->name = sdsnew(np->left->value_set.series_values[i].sid->name);
-	np->value_set.series_values[i].baton = np->left->value_set.series_values[i].baton;
-	np->value_set.series_values[i].series_desc.indom = sdsnew(np->left->value_set.series_values[i].series_desc.indom);
-	np->value_set.series_values[i].series_desc.pmid = sdsnew(np->left->value_set.series_values[i].series_desc.pmid);
-	np->value_set.series_values[i].series_desc.semantics = sdsnew(np->left->value_set.series_values[i].series_desc.semantics);
-	np->value_set.series_values[i].series_desc.source = sdsnew(np->left->value_set.series_values[i].series_desc.source);
-	np->value_set.series_values[i].series_desc.type = sdsnew(np->left->value_set.series_values[i].series_desc.type);
-	np->value_set.series_values[i].series_desc.units = sdsnew(np->left->value_set.series_values[i].series_desc.units);
+    if ((np->value_set.series_values = (series_sample_set_t *)calloc(n_series ? n_series : 1, sizeof(series_sample_set_t))) == NULL) {
+	series_column_nomem(baton, "series_calculate_time_domain_extreme");
+	return;
     }
-}
-
-/*
- * Compare and pick the maximal instance value(s) among samples for each metric.
- */
-static void
-series_calculate_max(node_t *np, void *arg)
-{
-    seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		max_data, data;
-    int			max_pointer;
-    sds			msg;
-
-    n_series = np->left->value_set.num_series;
     np->value_set.num_series = n_series;
-    np->value_set.series_values = (series_sample_set_t *)calloc(n_series, sizeof(series_sample_set_t));
     for (i = 0; i < n_series; i++) {
-	n_samples = np->left->value_set.series_values[i].num_samples;
-	if (n_samples > 0) {
-	    np->value_set.series_values[i].num_samples = 1;
-	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
-	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
-	    np->value_set.series_values[i].series_sample[0].num_instances = n_instances;
-	    np->value_set.series_values[i].series_sample[0].series_instance = (pmSeriesValue *)calloc(n_instances, sizeof(pmSeriesValue));
-	    for (k = 0; k < n_instances; k++) {
-		max_pointer = 0;
-		max_data = atof(np->left->value_set.series_values[i].series_sample[0].series_instance[k].data);
-		for (j = 1; j < n_samples; j++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
-			if (pmDebugOptions.query && pmDebugOptions.desperate) {
-			    infofmt(msg, "number of instances in each sample are not equal\n");
-			    batoninfo(baton, PMLOG_ERROR, msg);
-			}
-			continue;
-		    }
-		    data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		    if (max_data < data) {
-			max_data = data;
-			max_pointer = j;
-		    }
-		}
-		np->value_set.series_values[i].series_sample[0].series_instance[k].timestamp = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[max_pointer].series_instance[k].timestamp);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].series = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[max_pointer].series_instance[k].series);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].data = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[max_pointer].series_instance[k].data);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].ts = 
-			np->left->value_set.series_values[i].series_sample[max_pointer].series_instance[k].ts;
+	set = &np->left->value_set.series_values[i];
+	out = &np->value_set.series_values[i];
+	n_samples = set->num_samples > 0 ? set->num_samples : 0;
+	if (n_samples > 0 && (column = series_column_get(baton, set)) != NULL) {
+	    result = series_column_alloc(n_samples, 1, column->format);
+	    out->series_sample = (series_instance_set_t *)calloc(n_samples, sizeof(series_instance_set_t));
+	    if (result == NULL || out->series_sample == NULL) {
+		series_column_nomem(baton, "series_calculate_time_domain_extreme");
+		series_column_free(result);
+		free(out->series_sample);
+		out->series_sample = NULL;
+		n_samples = 0;
 	    }
-	} else {
-	    np->value_set.series_values[i].num_samples = 0;
-	}
-	np->value_set.series_values[i].sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
-	np->value_set.series_values[i].sid->name = sdsnew(np->left->value_set.series_values[i].sid->name);
-	np->value_set.series_values[i].baton = np->left->value_set.series_values[i].baton;
-	np->value_set.series_values[i].series_desc.indom = sdsnew(np->left->value_set.series_values[i].series_desc.indom);
-	np->value_set.series_values[i].series_desc.pmid = sdsnew(np->left->value_set.series_values[i].series_desc.pmid);
-	np->value_set.series_values[i].series_desc.semantics = sdsnew(np->left->value_set.series_values[i].series_desc.semantics);
-	np->value_set.series_values[i].series_desc.source = sdsnew(np->left->value_set.series_values[i].series_desc.source);
-	np->value_set.series_values[i].series_desc.type = sdsnew(np->left->value_set.series_values[i].series_desc.type);
-	np->value_set.series_values[i].series_desc.units = sdsnew(np->left->value_set.series_values[i].series_desc.units);
-    }
-}
-
-/*
- * Compare and pick the minimal value(s) among samples for each metric across time.
- */
-static void
-series_calculate_time_domain_min(node_t *np, void *arg)
-{
-    seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		min_data, data;
-    int			min_pointer;
-    sds			msg;
-    pmSeriesValue	inst;
-
-    n_series = np->left->value_set.num_series;
-    np->value_set.num_series = n_series;
-    np->value_set.series_values = (series_sample_set_t *)calloc(n_series, sizeof(series_sample_set_t));
-    for (i = 0; i < n_series; i++) {
-	n_samples = np->left->value_set.series_values[i].num_samples;
-	if (n_samples > 0) {
-	    np->value_set.series_values[i].num_samples = n_samples;
-	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(n_samples, sizeof(series_instance_set_t));
-	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
-
+	    out->num_samples = n_samples;
+	    out->column = result;
 	    for (j = 0; j < n_samples; j++) {
-		np->value_set.series_values[i].series_sample[j].num_instances = 1;
-		np->value_set.series_values[i].series_sample[j].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue));
-
-		min_pointer = 0;
-		min_data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[0].data);
-		for (k = 1; k < n_instances; k++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
-			if (pmDebugOptions.query && pmDebugOptions.desperate) {
-			    infofmt(msg, "number of instances in each sample are not equal\n");
-			    batoninfo(baton, PMLOG_ERROR, msg);
-			}
-			continue;
-		    }                
-		    data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		    if (min_data > data) {
-			min_data = data;
-			min_pointer = k;
-		    }
+		sample = &set->series_sample[j];
+		if (sample->num_instances <= 0)
+		    continue;
+		if ((out->series_sample[j].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue))) == NULL) {
+		    series_column_nomem(baton, "series_calculate_time_domain_extreme");
+		    continue;
+		}
+		out->series_sample[j].num_instances = 1;
+
+		if (column->valid[j]) {
+		    pointer = series_kernel_extreme(series_column_row(column, j),
+						column->num_instances, maximum);
+		    result->values[j] = series_column_row(column, j)[pointer];
+		    result->valid[j] = 1;
+		    series_kernel_value(&out->series_sample[j].series_instance[0],
+				&sample->series_instance[pointer], result->format);
+		} else {
+		    /* invalid rows keep their current value strings */
+		    series_kernel_value(&out->series_sample[j].series_instance[0],
+				&sample->series_instance[0], NULL);
 		}
-		inst = np->left->value_set.series_values[i].series_sample[j].series_instance[min_pointer];
-
-		np->value_set.series_values[i].series_sample[j].series_instance[0].timestamp = sdsnew(inst.timestamp);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].series = sdsnew(inst.series);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].data = sdsnew(inst.data);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].ts = inst.ts;
 	    }
-        } else {
-	    np->value_set.series_values[i].num_samples = 0;
-	}
-	np->value_set.series_values[i].sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
-	np->value_set.series_values[i].sid->name = sdsnew(np->left->value_set.series_values[i].sid->name);
-	np->value_set.series_values[i].baton = np->left->value_set.series_values[i].baton;
-	np->value_set.series_values[i].series_desc.indom = sdsnew(np->left->value_set.series_values[i].series_desc.indom);
-	np->value_set.series_values[i].series_desc.pmid = sdsnew(np->left->value_set.series_values[i].series_desc.pmid);
-	np->value_set.series_values[i].series_desc.semantics = sdsnew(np->left->value_set.series_values[i].series_desc.semantics);
-	np->value_set.series_values[i].series_desc.source = sdsnew(np->left->value_set.series_values[i].series_desc.source);
-	np->value_set.series_values[i].series_desc.type = sdsnew(np->left->value_set.series_values[i].series_desc.type);
-	np->value_set.series_values[i].series_desc.units = sdsnew(np->left->value_set.series_values[i].series_desc.units);
-    }
-}
-
-/*
- * Compare and pick the minimal instance value(s) among samples for each metric.
- */
-static void
-series_calculate_min(node_t *np, void *arg)
-{
-    seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
-    unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		min_data, data;
-    int			min_pointer;
-    sds			msg;
-
-    n_series = np->left->value_set.num_series;
-    np->value_set.num_series = n_series;
-    np->value_set.series_values = (series_sample_set_t *)calloc(n_series, sizeof(series_sample_set_t));
-    for (i = 0; i < n_series; i++) {
-	n_samples = np->left->value_set.series_values[i].num_samples;
-	if (n_samples > 0) {
-	    np->value_set.series_values[i].num_samples = 1;
-	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
-	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
-	    np->value_set.series_values[i].series_sample[0].num_instances = n_instances;
-	    np->value_set.series_values[i].series_sample[0].series_instance = (pmSeriesValue *)calloc(n_instances, sizeof(pmSeriesValue));
-	    for (k = 0; k < n_instances; k++) {
-		min_pointer = 0;
-		min_data = atof(np->left->value_set.series_values[i].series_sample[0].series_instance[k].data);
-		for (j = 1; j < n_samples; j++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
-			if (pmDebugOptions.query && pmDebugOptions.desperate) {
-			    infofmt(msg, "number of instances in each sample are not equal\n");
-			    batoninfo(baton, PMLOG_ERROR, msg);
-			}
-			continue;
-		    }
-		    data = atof(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		    if (min_data > data) {
-			min_data = data;
-			min_pointer = j;
-		    }
+	} else {
+	    out->num_samples = 0;
+	}
+	out->sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
+	out->sid->name = sdsnew(set->sid->name);
+	out->baton = set->baton;
+	out->series_desc.indom = sdsnew(set->series_desc.indom);
+	out->series_desc.pmid = sdsnew(set->series_desc.pmid);
+	out->series_desc.semantics = sdsnew(set->series_desc.semantics);
+	out->series_desc.source = sdsnew(set->series_desc.source);
+	out->series_desc.type = sdsnew(set->series_desc.type);
+	out->series_desc.units = sdsnew(set->series_desc.units);
+    }
+}
+
+/*
+ * Compare and pick the maximal (maximum != 0) or minimal instance
+ * value(s) among samples for each metric.
+ */
+static void
+series_calculate_extreme(node_t *np, void *arg, int maximum)
+{
+    seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
+    series_sample_set_t	*set, *out;
+    series_column_t	*column, *result;
+    pmSeriesValue	*values;
+    unsigned int	n_series, n_instances, i, k;
+    unsigned int	*pointer;
+
+    n_series = np->left->value_set.num_series;
+    if ((np->value_set.series_values = (series_sample_set_t *)calloc(n_series ? n_series : 1, sizeof(series_sample_set_t))) == NULL) {
+	series_column_nomem(baton, "series_calculate_extreme");
+	return;
+    }
+    np->value_set.num_series = n_series;
+    for (i = 0; i < n_series; i++) {
+	set = &np->left->value_set.series_values[i];
+	out = &np->value_set.series_values[i];
+	out->num_samples = 0;
+	if (set->num_samples > 0 && (column = series_column_get(baton, set)) != NULL) {
+	    n_instances = column->num_instances;
+	    result = series_column_alloc(1, n_instances, column->format);
+	    pointer = (unsigned int *)calloc(n_instances ? n_instances : 1, sizeof(unsigned int));
+	    values = (pmSeriesValue *)calloc(n_instances ? n_instances : 1, sizeof(pmSeriesValue));
+	    out->series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
+	    if (result == NULL || pointer == NULL || values == NULL || out->series_sample == NULL) {
+		series_column_nomem(baton, "series_calculate_extreme");
+		series_column_free(result);
+		free(out->series_sample);
+		out->series_sample = NULL;
+		free(values);
+	    } else {
+		if (series_column_extreme(column, maximum, pointer) < 0)
+		    memset(pointer, 0, n_instances * sizeof(unsigned int));
+		for (k = 0; k < n_instances; k++) {
+		    result->values[k] = series_column_row(column, pointer[k])[k];
+		    series_kernel_value(&values[k],
+			&set->series_sample[pointer[k]].series_instance[k],
+			result->format);
 		}
-		np->value_set.series_values[i].series_sample[0].series_instance[k].timestamp = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[min_pointer].series_instance[k].timestamp);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].series = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[min_pointer].series_instance[k].series);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].data = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[min_pointer].series_instance[k].data);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].ts = 
-			np->left->value_set.series_values[i].series_sample[min_pointer].series_instance[k].ts;
+		result->valid[0] = 1;
+		out->num_samples = 1;
+		out->series_sample[0].num_instances = n_instances;
+		out->series_sample[0].series_instance = values;
+		out->column = result;
 	    }
-	} else {
-	    np->value_set.series_values[i].num_samples = 0;
+	    free(pointer);
 	}
-	np->value_set.series_values[i].sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
-	np->value_set.series_values[i].sid->name = sdsnew(np->left->value_set.series_values[i].sid->name);
-	np->value_set.series_values[i].baton = np->left->value_set.series_values[i].baton;
-	np->value_set.series_values[i].series_desc.indom = sdsnew(np->left->value_set.series_values[i].series_desc.indom);
-	np->value_set.series_values[i].series_desc.pmid = sdsnew(np->left->value_set.series_values[i].series_desc.pmid);
-	np->value_set.series_values[i].series_desc.semantics = sdsnew(np->left->value_set.series_values[i].series_desc.semantics);
-	np->value_set.series_values[i].series_desc.source = sdsnew(np->left->value_set.series_values[i].series_desc.source);
-	np->value_set.series_values[i].series_desc.type = sdsnew(np->left->value_set.series_values[i].series_desc.type);
-	np->value_set.series_values[i].series_desc.units = sdsnew(np->left->value_set.series_values[i].series_desc.units);
+	out->sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
+	out->sid->name = sdsnew(set->sid->name);
+	out->baton = set->baton;
+	out->series_desc.indom = sdsnew(set->series_desc.indom);
+	out->series_desc.pmid = sdsnew(set->series_desc.pmid);
+	out->series_desc.semantics = sdsnew(set->series_desc.semantics);
+	out->series_desc.source = sdsnew(set->series_desc.source);
+	out->series_desc.type = sdsnew(set->series_desc.type);
+	out->series_desc.units = sdsnew(set->series_desc.units);
     }
 }
 
@@ -3052,6 +3356,35 @@ series_pmAtomValue_conv_str(int type, char *str, pmAtomValue *val, int max_len)
     return 0;
 }
 
+/*
+ * Multiply the typed column of a sample set by mult - rescale(), for
+ * which mult is as pmConvScale() multiplies each double, and a scalar
+ * multiplication.  Returns 1 for the caller to work on the value
+ * strings instead, for a column with inconsistent rows or when bounded
+ * and a result would not be finite.
+ */
+static int
+series_multiply_kernel(seriesQueryBaton *baton, series_sample_set_t *set,
+		double mult, int bounded, const char *format)
+{
+    series_column_t	*column;
+    size_t		count;
+
+    if (set->num_samples <= 0)
+	return 1;
+    if ((column = series_column_get(baton, set)) == NULL)
+	return -ENOMEM;
+    if (!series_column_complete(column))
+	return 1;
+    count = (size_t)column->num_samples * column->num_instances;
+    if (bounded && series_kernel_outside(column->values, count,
+		-DBL_MAX / fabs(mult), DBL_MAX / fabs(mult)) != 0)
+	return 1;
+    series_kernel_scale(column->values, count, mult);
+    column->format = format;
+    return 0;
+}
+
 /* 
  * The left child node of L_RESCALE should contains a set of time
  * series values.  And the right child node should be L_SCALE, which
@@ -3096,24 +3429,34 @@ series_calculate_rescale(node_t *np, void *arg)
 	    np->value_set.series_values[i].num_samples = -np->value_set.series_values[i].num_samples;
 	    return;
 	}
-	type = PM_TYPE_DOUBLE;
-	for (j = 0; j < np->value_set.series_values[i].num_samples; j++) {
-	    for (k = 0; k < np->value_set.series_values[i].series_sample[j].num_instances; k++) {
-		if (series_extract_value(type, 
-			np->value_set.series_values[i].series_sample[j].series_instance[k].data, &ival) != 0 ) {
-		    /* TODO: error report for extracting values from string fail */
-		    fprintf(stderr, "Extract values from string fail\n");
-		    return;
-		}
-		if ((sts = pmConvScale(type, &ival, &iunit, &oval, &np->right->meta.units)) != 0) {
-		    /* TODO: rescale error report */
-		    fprintf(stderr, "rescale error\n");
-		    return;
+	oval.d = 1.0;
+	if (pmConvScale(PM_TYPE_DOUBLE, &oval, &iunit, &oval, &np->right->meta.units) < 0)
+	    sts = 1;
+	else if ((sts = series_multiply_kernel(baton, &np->value_set.series_values[i],
+			oval.d, 1, "%e")) < 0)
+	    return;
+	if (sts > 0) {
+	    /* values not representable in the column, use the value strings */
+	    series_column_store(&np->value_set.series_values[i]);
+	    type = PM_TYPE_DOUBLE;
+	    for (j = 0; j < np->value_set.series_values[i].num_samples; j++) {
+		for (k = 0; k < np->value_set.series_values[i].series_sample[j].num_instances; k++) {
+		    if (series_extract_value(type, 
+			    np->value_set.series_values[i].series_sample[j].series_instance[k].data, &ival) != 0 ) {
+			/* TODO: error report for extracting values from string fail */
+			fprintf(stderr, "Extract values from string fail\n");
+			return;
+		    }
+		    if ((sts = pmConvScale(type, &ival, &iunit, &oval, &np->right->meta.units)) != 0) {
+			/* TODO: rescale error report */
+			fprintf(stderr, "rescale error\n");
+			return;
+		    }
+		    if ((str_len = series_pmAtomValue_conv_str(type, str_val, &oval, sizeof(str_val))) == 0)
+			return;
+		    sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].data);
+		    np->value_set.series_values[i].series_sample[j].series_instance[k].data = sdsnewlen(str_val, str_len);
 		}
-		if ((str_len = series_pmAtomValue_conv_str(type, str_val, &oval, sizeof(str_val))) == 0)
-		    return;
-		sdsfree(np->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		np->value_set.series_values[i].series_sample[j].series_instance[k].data = sdsnewlen(str_val, str_len);
 	    }
 	}
 	sdsfree(np->value_set.series_values[i].series_desc.units);
@@ -3669,76 +4012,74 @@ series_calculate_time_domain_statistical(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
     nodetype_t		func = np->type;
-    unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		sum_data, data;
-    char		sum_data_str[64];
-    sds			msg;
+    series_sample_set_t	*set, *out;
+    series_column_t	*column, *result;
+    unsigned int	n_series, n_samples, n_instances, i, j;
+    double		sum_data;
 
     assert(func == N_SUM_SAMPLE || func == N_AVG_SAMPLE);
 
     n_series = np->left->value_set.num_series;
+    if ((np->value_set.series_values = (series_sample_set_t *)calloc(n_series ? n_series : 1, sizeof(series_sample_set_t))) == NULL) {
+	series_column_nomem(baton, "series_calculate_time_domain_statistical");
+	return;
+    }
     np->value_set.num_series = n_series;
-    np->value_set.series_values = (series_sample_set_t *)calloc(n_series, sizeof(series_sample_set_t));
     for (i = 0; i < n_series; i++) {
-	n_samples = np->left->value_set.series_values[i].num_samples;
-	if (n_samples > 0) {
-	    np->value_set.series_values[i].num_samples = n_samples;
-	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(n_samples, sizeof(series_instance_set_t));
-	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
+	set = &np->left->value_set.series_values[i];
+	out = &np->value_set.series_values[i];
+	n_samples = set->num_samples > 0 ? set->num_samples : 0;
+	if (n_samples > 0 && (column = series_column_get(baton, set)) != NULL) {
+	    result = series_column_alloc(n_samples, 1, "%le");
+	    out->series_sample = (series_instance_set_t *)calloc(n_samples, sizeof(series_instance_set_t));
+	    if (result == NULL || out->series_sample == NULL) {
+		series_column_nomem(baton, "series_calculate_time_domain_statistical");
+		series_column_free(result);
+		free(out->series_sample);
+		out->series_sample = NULL;
+		n_samples = 0;
+	    }
+	    out->num_samples = n_samples;
+	    out->column = result;
+	    n_instances = column->num_instances;
 	    for (j = 0; j < n_samples; j++) {
-		np->value_set.series_values[i].series_sample[j].num_instances = 1;
-		np->value_set.series_values[i].series_sample[j].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue));
-		
-		sum_data = 0.0;
-		for (k = 0; k < n_instances; k++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
-			if (pmDebugOptions.query && pmDebugOptions.desperate) {
-			    infofmt(msg, "number of instances in each sample are not equal\n");
-			    batoninfo(baton, PMLOG_ERROR, msg);
-			}
-			continue;
-		    }
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
-		    sum_data += data;
-		}
-		np->value_set.series_values[i].series_sample[j].series_instance[0].timestamp = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[j].series_instance[0].timestamp);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].series = 
-			sdsnew(0);
-		switch (func) {
-		case N_SUM_SAMPLE:
-		    pmsprintf(sum_data_str, sizeof(sum_data_str), "%le", sum_data);
-		    break;
-		case N_AVG_SAMPLE:
-		    pmsprintf(sum_data_str, sizeof(sum_data_str), "%le", sum_data / n_instances);
-		    break;
-		default:
-		    /* .. TODO: standard deviation, variance, mode, median, etc */
-		    sum_data_str[0] = '\0';	/* for coverity */
-		    assert(0);
-		    break;
+		if (set->series_sample[j].num_instances <= 0)
+		    continue;
+		if ((out->series_sample[j].series_instance = (pmSeriesValue *)calloc(1, sizeof(pmSeriesValue))) == NULL) {
+		    series_column_nomem(baton, "series_calculate_time_domain_statistical");
+		    continue;
 		}
+		out->series_sample[j].num_instances = 1;
 
-		np->value_set.series_values[i].series_sample[j].series_instance[0].data = sdsnew(sum_data_str);
-		np->value_set.series_values[i].series_sample[j].series_instance[0].ts = 
-		np->left->value_set.series_values[i].series_sample[j].series_instance[0].ts;
+		sum_data = 0.0;
+		if (column->valid[j])
+		    sum_data = series_kernel_sum(series_column_row(column, j), n_instances);
+		result->values[j] = (func == N_AVG_SAMPLE) ? sum_data / n_instances : sum_data;
+		result->valid[j] = 1;
+
+		out->series_sample[j].series_instance[0].timestamp = 
+			sdsnew(set->series_sample[j].series_instance[0].timestamp);
+		out->series_sample[j].series_instance[0].series = sdsnew(0);
+		out->series_sample[j].series_instance[0].data = sdsempty();
+		out->series_sample[j].series_instance[0].ts = 
+			set->series_sample[j].series_instance[0].ts;
 	    }
 	} else {
-	    np->value_set.series_values[i].num_samples = 0;
+	    out->num_samples = 0;
 	}
-	np->value_set.series_values[i].sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
-	np->value_set.series_values[i].sid->name = sdsnew(np->left->value_set.series_values[i].sid->name);
-	np->value_set.series_values[i].baton = np->left->value_set.series_values[i].baton;
-	np->value_set.series_values[i].series_desc.indom = sdsnew(np->left->value_set.series_values[i].series_desc.indom);
-	np->value_set.series_values[i].series_desc.pmid = sdsnew(np->left->value_set.series_values[i].series_desc.pmid);
-	np->value_set.series_values[i].series_desc.source = sdsnew(np->left->value_set.series_values[i].series_desc.source);
-	np->value_set.series_values[i].series_desc.type = sdsnew("double");
-	np->value_set.series_values[i].series_desc.units = sdsnew(np->left->value_set.series_values[i].series_desc.units);
+	out->sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
+	out->sid->name = sdsnew(set->sid->name);
+	out->baton = set->baton;
+	out->series_desc.indom = sdsnew(set->series_desc.indom);
+	out->series_desc.pmid = sdsnew(set->series_desc.pmid);
+	out->series_desc.source = sdsnew(set->series_desc.source);
+	out->series_desc.type = sdsnew("double");
+	out->series_desc.units = sdsnew(set->series_desc.units);
 
 	if (func == N_AVG_SAMPLE) {
-	    np->value_set.series_values[i].series_desc.semantics = sdsnew("instance");
+	    out->series_desc.semantics = sdsnew("instance");
 	} else {
-	    np->value_set.series_values[i].series_desc.semantics = sdsnew(np->left->value_set.series_values[i].series_desc.semantics);
+	    out->series_desc.semantics = sdsnew(set->series_desc.semantics);
 	}
     }
 }
@@ -3751,78 +4092,73 @@ series_calculate_statistical(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
     nodetype_t		func = np->type;
+    series_sample_set_t	*set, *out;
+    series_column_t	*column, *result;
+    pmSeriesValue	*values, *inst;
     unsigned int	n_series, n_samples, n_instances, i, j, k;
-    double		sum_data, data;
-    char		sum_data_str[64];
-    sds			msg;
 
     assert(func == N_SUM || func == N_AVG || func == N_SUM_INST || func == N_AVG_INST);
 
     n_series = np->left->value_set.num_series;
+    if ((np->value_set.series_values = (series_sample_set_t *)calloc(n_series ? n_series : 1, sizeof(series_sample_set_t))) == NULL) {
+	series_column_nomem(baton, "series_calculate_statistical");
+	return;
+    }
     np->value_set.num_series = n_series;
-    np->value_set.series_values = (series_sample_set_t *)calloc(n_series, sizeof(series_sample_set_t));
     for (i = 0; i < n_series; i++) {
-	n_samples = np->left->value_set.series_values[i].num_samples;
-	if (n_samples > 0) {
-	    np->value_set.series_values[i].num_samples = 1;
-	    np->value_set.series_values[i].series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
-	    n_instances = np->left->value_set.series_values[i].series_sample[0].num_instances;
-	    np->value_set.series_values[i].series_sample[0].num_instances = n_instances;
-	    np->value_set.series_values[i].series_sample[0].series_instance = (pmSeriesValue *)calloc(n_instances, sizeof(pmSeriesValue));
-	    for (k = 0; k < n_instances; k++) {
-		sum_data = 0.0;
-		for (j = 0; j < n_samples; j++) {
-		    if (np->left->value_set.series_values[i].series_sample[j].num_instances != n_instances) {
-			if (pmDebugOptions.query && pmDebugOptions.desperate) {
-			    infofmt(msg, "number of instances in each sample are not equal\n");
-			    batoninfo(baton, PMLOG_ERROR, msg);
-			}
-			continue;
-		    }
-		    data = strtod(np->left->value_set.series_values[i].series_sample[j].series_instance[k].data, NULL);
-		    sum_data += data;
+	set = &np->left->value_set.series_values[i];
+	out = &np->value_set.series_values[i];
+	n_samples = set->num_samples > 0 ? set->num_samples : 0;
+	out->num_samples = 0;
+	if (n_samples > 0 && (column = series_column_get(baton, set)) != NULL) {
+	    n_instances = column->num_instances;
+	    result = series_column_alloc(1, n_instances, "%le");
+	    values = (pmSeriesValue *)calloc(n_instances ? n_instances : 1, sizeof(pmSeriesValue));
+	    out->series_sample = (series_instance_set_t *)calloc(1, sizeof(series_instance_set_t));
+	    if (result == NULL || values == NULL || out->series_sample == NULL) {
+		series_column_nomem(baton, "series_calculate_statistical");
+		series_column_free(result);
+		free(out->series_sample);
+		out->series_sample = NULL;
+		free(values);
+	    } else {
+		for (j = 0; j < column->num_samples; j++) {
+		    if (column->valid[j])
+			series_kernel_accumulate(result->values,
+				series_column_row(column, j), n_instances);
 		}
-		np->value_set.series_values[i].series_sample[0].series_instance[k].timestamp = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[0].series_instance[k].timestamp);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].series = 
-			sdsnew(np->left->value_set.series_values[i].series_sample[0].series_instance[k].series);
-		switch (func) {
-		case N_SUM:
-		case N_SUM_INST:
-		    pmsprintf(sum_data_str, sizeof(sum_data_str), "%le", sum_data);
-		    break;
-		case N_AVG:
-		case N_AVG_INST:
-		    pmsprintf(sum_data_str, sizeof(sum_data_str), "%le", sum_data / n_samples);
-		    break;
-		default:
-		    /* .. TODO: standard deviation, variance, mode, median, etc */
-		    sum_data_str[0] = '\0';	/* for coverity */
-		    assert(0);
-		    break;
+		if (func == N_AVG || func == N_AVG_INST) {
+		    for (k = 0; k < n_instances; k++)
+			result->values[k] /= n_samples;
 		}
-
-		np->value_set.series_values[i].series_sample[0].series_instance[k].data = sdsnew(sum_data_str);
-		np->value_set.series_values[i].series_sample[0].series_instance[k].ts = 
-			np->left->value_set.series_values[i].series_sample[0].series_instance[k].ts;
+		result->valid[0] = 1;
+		for (k = 0; k < n_instances; k++) {
+		    inst = &set->series_sample[0].series_instance[k];
+		    values[k].timestamp = sdsnew(inst->timestamp);
+		    values[k].series = sdsnew(inst->series);
+		    values[k].data = sdsempty();
+		    values[k].ts = inst->ts;
+		}
+		out->num_samples = 1;
+		out->series_sample[0].num_instances = n_instances;
+		out->series_sample[0].series_instance = values;
+		out->column = result;
 	    }
-	} else {
-	    np->value_set.series_values[i].num_samples = 0;
 	}
-	np->value_set.series_values[i].sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
-	np->value_set.series_values[i].sid->name = sdsnew(np->left->value_set.series_values[i].sid->name);
-	np->value_set.series_values[i].baton = np->left->value_set.series_values[i].baton;
-
-	np->value_set.series_values[i].series_desc.indom = sdsnew(np->left->value_set.series_values[i].series_desc.indom);
-	np->value_set.series_values[i].series_desc.pmid = sdsnew(np->left->value_set.series_values[i].series_desc.pmid);
-	np->value_set.series_values[i].series_desc.source = sdsnew(np->left->value_set.series_values[i].series_desc.source);
-	np->value_set.series_values[i].series_desc.type = sdsnew("double");
-	np->value_set.series_values[i].series_desc.units = sdsnew(np->left->value_set.series_values[i].series_desc.units);
+	out->sid = (seriesGetSID *)calloc(1, sizeof(seriesGetSID));
+	out->sid->name = sdsnew(set->sid->name);
+	out->baton = set->baton;
+
+	out->series_desc.indom = sdsnew(set->series_desc.indom);
+	out->series_desc.pmid = sdsnew(set->series_desc.pmid);
+	out->series_desc.source = sdsnew(set->series_desc.source);
+	out->series_desc.type = sdsnew("double");
+	out->series_desc.units = sdsnew(set->series_desc.units);
 	
 	if (func == N_AVG || func == N_AVG_INST) {
-	    np->value_set.series_values[i].series_desc.semantics = sdsnew("instance");
+	    out->series_desc.semantics = sdsnew("instance");
 	} else {
-	    np->value_set.series_values[i].series_desc.semantics = sdsnew(np->left->value_set.series_values[i].series_desc.semantics);
+	    out->series_desc.semantics = sdsnew(set->series_desc.semantics);
 	}
     }
 }
@@ -4424,6 +4760,25 @@ calculate_slash(int *type, pmAtomValue *l_val, pmAtomValue *r_val, pmAtomValue *
     return 0;
 }
 
+/* type of the result of a binary arithmetic operator */
+static int
+series_binary_type(int ope_type, int l_type, int r_type)
+{
+    if (l_type == PM_TYPE_DOUBLE || r_type == PM_TYPE_DOUBLE)
+	return PM_TYPE_DOUBLE;
+    if (ope_type == N_SLASH)
+	return PM_TYPE_DOUBLE;
+    if (l_type == PM_TYPE_FLOAT || r_type == PM_TYPE_FLOAT)
+	return PM_TYPE_FLOAT;
+    if (l_type == PM_TYPE_U64 || r_type == PM_TYPE_U64)
+	return PM_TYPE_U64;
+    if (l_type == PM_TYPE_64 || r_type == PM_TYPE_64)
+	return PM_TYPE_64;
+    if (l_type == PM_TYPE_U32 || r_type == PM_TYPE_U32)
+	return PM_TYPE_U32;
+    return PM_TYPE_32;	/* both are PM_TYPE_32 */
+}
+
 static void
 series_calculate_order_binary(int ope_type, int l_type, int r_type, int *otype,
 	pmAtomValue *l_val, pmAtomValue *r_val,
@@ -4435,21 +4790,7 @@ series_calculate_order_binary(int ope_type, int l_type, int r_type, int *otype,
     int			str_len;
     char		str_val[256];
 
-    if (l_type == PM_TYPE_DOUBLE || r_type == PM_TYPE_DOUBLE) {
-	*otype = PM_TYPE_DOUBLE;
-    } else if (ope_type == N_SLASH) {
-	*otype = PM_TYPE_DOUBLE;
-    } else if (l_type == PM_TYPE_FLOAT || r_type == PM_TYPE_FLOAT) {
-	*otype = PM_TYPE_FLOAT;
-    } else if (l_type == PM_TYPE_U64 || r_type == PM_TYPE_U64) {
-	*otype = PM_TYPE_U64;
-    } else if (l_type == PM_TYPE_64 || r_type == PM_TYPE_64) {
-	*otype = PM_TYPE_64;
-    } else if (l_type == PM_TYPE_U32 || r_type == PM_TYPE_U32) {
-	*otype = PM_TYPE_U32;
-    } else { /* both are PM_TYPE_32 */
-	*otype = PM_TYPE_32;
-    }
+    *otype = series_binary_type(ope_type, l_type, r_type);
 
     /* Extract series values */
     series_extract_value(*otype, r_data->data, r_val);
@@ -4506,13 +4847,139 @@ series_binary_meta_update(node_t *left, pmUnits *large_units, int *l_sem, int *r
     left->value_set.series_values[0].series_desc.semantics = sdsnew(pmSemStr(o_sem));
 }
 
+/*
+ * Range of the values a column holds exactly for a value type - for
+ * the 64 bit integer types, that of the integers exact in a double.
+ */
+static void
+series_type_range(int type, double *low, double *high)
+{
+    switch (type) {
+    case PM_TYPE_32:
+	*low = INT32_MIN;
+	*high = INT32_MAX;
+	break;
+    case PM_TYPE_U32:
+	*low = 0;
+	*high = UINT32_MAX;
+	break;
+    case PM_TYPE_64:
+	*low = -9007199254740991.0;	/* 2^53 - 1 */
+	*high = 9007199254740991.0;
+	break;
+    case PM_TYPE_U64:
+	*low = 0;
+	*high = 9007199254740991.0;
+	break;
+    case PM_TYPE_FLOAT:
+	*low = -FLT_MAX;
+	*high = FLT_MAX;
+	break;
+    default:
+	*low = -DBL_MAX;
+	*high = DBL_MAX;
+	break;
+    }
+}
+
+/*
+ * Scale factor of an operand to the larger units.  As for pmConvScale
+ * on each value, a failed conversion leaves the values unchanged and
+ * clears the larger units.
+ */
+static double
+series_binary_scale(pmUnits *units, pmUnits *large_units)
+{
+    pmAtomValue		val;
+
+    val.d = 1.0;
+    if (pmConvScale(PM_TYPE_DOUBLE, &val, units, &val, large_units) < 0) {
+	memset(large_units, 0, sizeof(*large_units));
+	return 1.0;
+    }
+    return val.d;
+}
+
+/*
+ * Binary arithmetic operator over the typed columns of two sample sets,
+ * the result column replacing that of the left set.  Values are typed
+ * as series_calculate_order_binary() does for each pair of strings -
+ * integer results are exact, being computed in a double only within
+ * +/- 2^53.  Returns 1 for the caller to work on the value strings
+ * instead, when there are no values, for inconsistent rows, or when an
+ * operand or result is out of range of the result type (overflow,
+ * unsigned underflow, division by zero).
+ */
+static int
+series_binary_kernel(seriesQueryBaton *baton, int ope_type,
+	series_sample_set_t *lset, series_sample_set_t *rset,
+	int l_type, int r_type, int *otype,
+	pmUnits *l_units, pmUnits *r_units, pmUnits *large_units)
+{
+    series_column_t	*lcol, *rcol, *result;
+    double		*rvalues, l_mult, r_mult, low, high;
+    size_t		count;
+    int			type;
+
+    if (lset->num_samples <= 0 || rset->num_samples <= 0)
+	return 1;
+    if ((lcol = series_column_get(baton, lset)) == NULL ||
+	(rcol = series_column_get(baton, rset)) == NULL)
+	return -ENOMEM;
+    if (lcol->num_samples != rcol->num_samples ||
+	lcol->num_instances != rcol->num_instances ||
+	!series_column_complete(lcol) || !series_column_complete(rcol))
+	return 1;
+    if ((count = (size_t)lcol->num_samples * lcol->num_instances) == 0)
+	return 1;
+
+    type = series_binary_type(ope_type, l_type, r_type);
+    series_type_range(type, &low, &high);
+    if (series_kernel_outside(lcol->values, count, low, high) != 0 ||
+	series_kernel_outside(rcol->values, count, low, high) != 0)
+	return 1;
+    /* scales differ only for operands promoted to PM_TYPE_DOUBLE */
+    l_mult = series_binary_scale(l_units, large_units);
+    r_mult = series_binary_scale(r_units, large_units);
+
+    result = series_column_alloc(lcol->num_samples, lcol->num_instances,
+			(type == PM_TYPE_FLOAT || type == PM_TYPE_DOUBLE) ?
+			"%e" : "%.0f");
+    rvalues = malloc(count * sizeof(double));
+    if (result == NULL || rvalues == NULL) {
+	series_column_nomem(baton, "series_binary_kernel");
+	series_column_free(result);
+	free(rvalues);
+	return -ENOMEM;
+    }
+    series_kernel_extract(result->values, lcol->values, count, type);
+    series_kernel_extract(rvalues, rcol->values, count, type);
+    if (l_mult != 1.0)
+	series_kernel_scale(result->values, count, l_mult);
+    if (r_mult != 1.0)
+	series_kernel_scale(rvalues, count, r_mult);
+    series_kernel_binary(result->values, rvalues, count, ope_type);
+    free(rvalues);
+
+    if (series_kernel_outside(result->values, count, low, high) != 0) {
+	series_column_free(result);
+	return 1;
+    }
+    series_kernel_result(result->values, count, type);
+    memset(result->valid, 1, lcol->num_samples);
+    series_column_free(lcol);
+    lset->column = result;
+    *otype = type;
+    return 0;
+}
+
 static void
 series_calculate_plus(node_t *np, void *arg)
 {
     seriesQueryBaton	*baton = (seriesQueryBaton *)arg;
     node_t		*left = np->left, *right = np->right;
     int			l_type, r_type, otype=PM_TYPE_UNKNOWN;
-    int			l_sem, r_sem, j, k;
+    int			l_sem, r_sem, sts, j, k;
     unsigned int	num_samples, num_instances;
     pmAtomValue		l_val, r_val;
     pmUnits		l_units = {0}, r_units = {0}, large_units = {0};
@@ -4528,22 +4995,31 @@ series_calculate_plus(node_t *np, void *arg)
 		right->value_set.series_values[0].series_desc.indom) != 0)
 	return;
 
-    num_samples = left->value_set.series_values[0].num_samples;
-
-    for (j = 0; j < num_samples; j++) {
-	num_instances = left->value_set.series_values[0].series_sample[j].num_instances;
-	if (num_instances != right->value_set.series_values[0].series_sample[j].num_instances) {
-	    infofmt(msg, "Number of instances of two metrics are inconsistent.\n");
-	    batoninfo(baton, PMLOG_ERROR, msg);
-	    baton->error = -EPROTO;
-	    return;
-	}
-	for (k = 0; k < num_instances; k++) {
-	    series_calculate_order_binary(N_PLUS, l_type, r_type, &otype, 
-		&l_val, &r_val, 
-		left->value_set.series_values[0].series_sample[j].series_instance + k,
-		right->value_set.series_values[0].series_sample[j].series_instance + k,
-		&l_units, &r_units, &large_units, calculate_plus);
+    if ((sts = series_binary_kernel(baton, N_PLUS,
+		&left->value_set.series_values[0], &right->value_set.series_values[0],
+		l_type, r_type, &otype, &l_units, &r_units, &large_units)) < 0)
+	return;
+    if (sts > 0) {
+	/* values not representable in the columns, use the value strings */
+	series_column_store(&left->value_set.series_values[0]);
+	series_column_store(&right->value_set.series_values[0]);
+	num_samples = left->value_set.series_values[0].num_samples;
+
+	for (j = 0; j < num_samples; j++) {
+	    num_instances = left->value_set.series_values[0].series_sample[j].num_instances;
+	    if (num_instances != right->value_set.series_values[0].series_sample[j].num_instances) {
+		infofmt(msg, "Number of instances of two metrics are inconsistent.\n");
+		batoninfo(baton, PMLOG_ERROR, msg);
+		baton->error = -EPROTO;
+		return;
+	    }
+	    for (k = 0; k < num_instances; k++) {
+		series_calculate_order_binary(N_PLUS, l_type, r_type, &otype, 
+		    &l_val, &r_val, 
+		    left->value_set.series_values[0].series_sample[j].series_instance + k,
+		    right->value_set.series_values[0].series_sample[j].series_instance + k,
+		    &l_units, &r_units, &large_units, calculate_plus);
+	    }
 	}
     }
     /*
@@ -4567,7 +5043,7 @@ series_calculate_minus(node_t *np, void *arg)
     pmAtomValue		l_val, r_val;
     pmUnits		l_units = {0}, r_units = {0}, large_units = {0};
     int			l_type, r_type, otype=PM_TYPE_UNKNOWN;
-    int			l_sem, r_sem;
+    int			l_sem, r_sem, sts;
     sds			msg;
 
     if (left->value_set.num_series == 0 || right->value_set.num_series == 0)
@@ -4580,22 +5056,31 @@ series_calculate_minus(node_t *np, void *arg)
 		right->value_set.series_values[0].series_desc.indom) != 0)
 	return;
 
-    num_samples = left->value_set.series_values[0].num_samples;
-
-    for (j = 0; j < num_samples; j++) {
-	num_instances = left->value_set.series_values[0].series_sample[j].num_instances;
-	if (num_instances != right->value_set.series_values[0].series_sample[j].num_instances) {
-	    infofmt(msg, "Number of instances of two metrics are inconsistent.\n");
-	    batoninfo(baton, PMLOG_ERROR, msg);
-	    baton->error = -EPROTO;
-	    return;
-	}
-	for (k = 0; k < num_instances; k++) {
-	    series_calculate_order_binary(N_MINUS, l_type, r_type, &otype, 
-		&l_val, &r_val, 
-		left->value_set.series_values[0].series_sample[j].series_instance + k,
-		right->value_set.series_values[0].series_sample[j].series_instance + k,
-		&l_units, &r_units, &large_units, calculate_minus);
+    if ((sts = series_binary_kernel(baton, N_MINUS,
+		&left->value_set.series_values[0], &right->value_set.series_values[0],
+		l_type, r_type, &otype, &l_units, &r_units, &large_units)) < 0)
+	return;
+    if (sts > 0) {
+	/* values not representable in the columns, use the value strings */
+	series_column_store(&left->value_set.series_values[0]);
+	series_column_store(&right->value_set.series_values[0]);
+	num_samples = left->value_set.series_values[0].num_samples;
+
+	for (j = 0; j < num_samples; j++) {
+	    num_instances = left->value_set.series_values[0].series_sample[j].num_instances;
+	    if (num_instances != right->value_set.series_values[0].series_sample[j].num_instances) {
+		infofmt(msg, "Number of instances of two metrics are inconsistent.\n");
+		batoninfo(baton, PMLOG_ERROR, msg);
+		baton->error = -EPROTO;
+		return;
+	    }
+	    for (k = 0; k < num_instances; k++) {
+		series_calculate_order_binary(N_MINUS, l_type, r_type, &otype, 
+		    &l_val, &r_val, 
+		    left->value_set.series_values[0].series_sample[j].series_instance + k,
+		    right->value_set.series_values[0].series_sample[j].series_instance + k,
+		    &l_units, &r_units, &large_units, calculate_minus);
+	    }
 	}
     }
     /*
@@ -4619,7 +5104,7 @@ series_calculate_star(node_t *np, void *arg)
     pmAtomValue		l_val, r_val;
     pmUnits		l_units = {0}, r_units = {0}, large_units = {0};
     int			l_type, r_type, otype=PM_TYPE_UNKNOWN;
-    int			l_sem, r_sem, int_operand, is_int;
+    int			l_sem, r_sem, int_operand, is_int, sts;
     sds			msg;
     double		data, double_operand;
     char		new_data[64];
@@ -4647,21 +5132,30 @@ series_calculate_star(node_t *np, void *arg)
 	}
 	n_series = node->value_set.num_series;
 	for (i = 0; i < n_series; i++) {
-	    num_samples = node->value_set.series_values[i].num_samples;
-	    for (j = 0; j < num_samples; j++) {
-	    	num_instances = node->value_set.series_values[i].series_sample[j].num_instances;
-	    	for (k = 0; k < num_instances; k++) {
-		    data = atof(node->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		    if (node->type == N_INTEGER && is_int) {
-			pmsprintf(new_data, sizeof(new_data), "%d", atoi(node->value_set.series_values[i].series_sample[j].series_instance[k].data) * int_operand);
-		    } else if (is_int) {
-			pmsprintf(new_data, sizeof(new_data), "%le", data * int_operand);
-		    } else {
-			pmsprintf(new_data, sizeof(new_data), "%le", data * double_operand);
+	    if (node->type == N_INTEGER && is_int)
+		sts = 1;	/* integer results, see below */
+	    else if ((sts = series_multiply_kernel(baton, &node->value_set.series_values[i],
+			is_int ? (double)int_operand : double_operand, 0, "%le")) < 0)
+		return;
+	    if (sts > 0) {
+		/* values not representable in the columns, use the value strings */
+		series_column_store(&node->value_set.series_values[i]);
+		num_samples = node->value_set.series_values[i].num_samples;
+		for (j = 0; j < num_samples; j++) {
+		    num_instances = node->value_set.series_values[i].series_sample[j].num_instances;
+		    for (k = 0; k < num_instances; k++) {
+			data = atof(node->value_set.series_values[i].series_sample[j].series_instance[k].data);
+			if (node->type == N_INTEGER && is_int) {
+			    pmsprintf(new_data, sizeof(new_data), "%d", atoi(node->value_set.series_values[i].series_sample[j].series_instance[k].data) * int_operand);
+			} else if (is_int) {
+			    pmsprintf(new_data, sizeof(new_data), "%le", data * int_operand);
+			} else {
+			    pmsprintf(new_data, sizeof(new_data), "%le", data * double_operand);
+			}
+			sdsfree(node->value_set.series_values[i].series_sample[j].series_instance[k].data);
+			node->value_set.series_values[i].series_sample[j].series_instance[k].data = sdsnew(new_data);
 		    }
-		    sdsfree(node->value_set.series_values[i].series_sample[j].series_instance[k].data);
-		    node->value_set.series_values[i].series_sample[j].series_instance[k].data = sdsnew(new_data);
-	    	}
+		}
 	    }
 	    if (!is_int) {
 		sdsfree(node->value_set.series_values[i].series_desc.type);
@@ -4682,22 +5176,31 @@ series_calculate_star(node_t *np, void *arg)
 		right->value_set.series_values[i].series_desc.indom) != 0)
 	        return;
 
-	    num_samples = left->value_set.series_values[i].num_samples;
-
-	    for (j = 0; j < num_samples; j++) {
-		num_instances = left->value_set.series_values[i].series_sample[j].num_instances;
-		if (num_instances != right->value_set.series_values[i].series_sample[j].num_instances) {
-		    infofmt(msg, "Number of instances of two metrics are inconsistent.\n");
-		    batoninfo(baton, PMLOG_ERROR, msg);
-		    baton->error = -EPROTO;
-		    return;
-		}
-		for (k = 0; k < num_instances; k++) {
-		    series_calculate_order_binary(N_STAR, l_type, r_type, &otype, 
-			&l_val, &r_val, 
-			left->value_set.series_values[i].series_sample[j].series_instance + k,
-			right->value_set.series_values[i].series_sample[j].series_instance + k,
-			&l_units, &r_units, &large_units, calculate_star);
+	    if ((sts = series_binary_kernel(baton, N_STAR,
+			&left->value_set.series_values[i], &right->value_set.series_values[i],
+			l_type, r_type, &otype, &l_units, &r_units, &large_units)) < 0)
+		return;
+	    if (sts > 0) {
+		/* values not representable in the columns, use the value strings */
+		series_column_store(&left->value_set.series_values[i]);
+		series_column_store(&right->value_set.series_values[i]);
+		num_samples = left->value_set.series_values[i].num_samples;
+
+		for (j = 0; j < num_samples; j++) {
+		    num_instances = left->value_set.series_values[i].series_sample[j].num_instances;
+		    if (num_instances != right->value_set.series_values[i].series_sample[j].num_instances) {
+			infofmt(msg, "Number of instances of two metrics are inconsistent.\n");
+			batoninfo(baton, PMLOG_ERROR, msg);
+			baton->error = -EPROTO;
+			return;
+		    }
+		    for (k = 0; k < num_instances; k++) {
+			series_calculate_order_binary(N_STAR, l_type, r_type, &otype, 
+			    &l_val, &r_val, 
+			    left->value_set.series_values[i].series_sample[j].series_instance + k,
+			    right->value_set.series_values[i].series_sample[j].series_instance + k,
+			    &l_units, &r_units, &large_units, calculate_star);
+		    }
 		}
 	    }
 	    /*
@@ -4724,7 +5227,7 @@ series_calculate_slash(node_t *np, void *arg)
     pmAtomValue		l_val, r_val;
     pmUnits		l_units = {0}, r_units = {0}, large_units = {0};
     int			l_type, r_type, otype=PM_TYPE_UNKNOWN;
-    int			l_sem, r_sem;
+    int			l_sem, r_sem, sts;
     sds			msg;
 
     if (left->value_set.num_series == 0 || right->value_set.num_series == 0)
@@ -4737,22 +5240,31 @@ series_calculate_slash(node_t *np, void *arg)
 		right->value_set.series_values[0].series_desc.indom) != 0)
 	return;
 
-    num_samples = left->value_set.series_values[0].num_samples;
-
-    for (j = 0; j < num_samples; j++) {
-	num_instances = left->value_set.series_values[0].series_sample[j].num_instances;
-	if (num_instances != right->value_set.series_values[0].series_sample[j].num_instances) {
-	    infofmt(msg, "Number of instances of two metrics are inconsistent.\n");
-	    batoninfo(baton, PMLOG_ERROR, msg);
-	    baton->error = -EPROTO;
-	    return;
-	}
-	for (k = 0; k < num_instances; k++) {
-	    series_calculate_order_binary(N_SLASH, l_type, r_type, &otype, 
-		&l_val, &r_val, 
-		left->value_set.series_values[0].series_sample[j].series_instance + k,
-		right->value_set.series_values[0].series_sample[j].series_instance + k,
-		&l_units, &r_units, &large_units, calculate_slash);
+    if ((sts = series_binary_kernel(baton, N_SLASH,
+		&left->value_set.series_values[0], &right->value_set.series_values[0],
+		l_type, r_type, &otype, &l_units, &r_units, &large_units)) < 0)
+	return;
+    if (sts > 0) {
+	/* values not representable in the columns, use the value strings */
+	series_column_store(&left->value_set.series_values[0]);
+	series_column_store(&right->value_set.series_values[0]);
+	num_samples = left->value_set.series_values[0].num_samples;
+
+	for (j = 0; j < num_samples; j++) {
+	    num_instances = left->value_set.series_values[0].series_sample[j].num_instances;
+	    if (num_instances != right->value_set.series_values[0].series_sample[j].num_instances) {
+		infofmt(msg, "Number of instances of two metrics are inconsistent.\n");
+		batoninfo(baton, PMLOG_ERROR, msg);
+		baton->error = -EPROTO;
+		return;
+	    }
+	    for (k = 0; k < num_instances; k++) {
+		series_calculate_order_binary(N_SLASH, l_type, r_type, &otype, 
+		    &l_val, &r_val, 
+		    left->value_set.series_values[0].series_sample[j].series_instance + k,
+		    right->value_set.series_values[0].series_sample[j].series_instance + k,
+		    &l_units, &r_units, &large_units, calculate_slash);
+	    }
 	}
     }
     /*
@@ -4787,23 +5299,55 @@ series_calculate(node_t *np, int level, void *arg)
     if ((sts = series_calculate(np->right, level+1, arg)) < 0)
 	return sts;
 
+    /*
+     * Typed columns are passed directly between the kernel operators,
+     * the other operators work on the value strings - store them first.
+     */
+    switch (np->type) {
+    case N_RESCALE:
+    case N_PLUS:
+    case N_MINUS:
+    case N_STAR:
+    case N_SLASH:
+    case N_RATE:
+    case N_MAX:
+    case N_MAX_INST:
+    case N_MAX_SAMPLE:
+    case N_MIN:
+    case N_MIN_INST:
+    case N_MIN_SAMPLE:
+    case N_AVG:
+    case N_SUM:
+    case N_AVG_INST:
+    case N_SUM_INST:
+    case N_AVG_SAMPLE:
+    case N_SUM_SAMPLE:
+	break;
+    default:
+	if (np->left)
+	    series_value_set_store(&np->left->value_set);
+	if (np->right)
+	    series_value_set_store(&np->right->value_set);
+	break;
+    }
+
     switch ((sts = np->type)) {
     case N_RATE:
 	series_calculate_rate(np, arg);
 	break;
     case N_MAX:
     case N_MAX_INST:
-	series_calculate_max(np, arg);
+	series_calculate_extreme(np, arg, 1);
 	break;
     case N_MAX_SAMPLE:
-	series_calculate_time_domain_max(np, arg);
+	series_calculate_time_domain_extreme(np, arg, 1);
 	break;
     case N_MIN:
     case N_MIN_INST:
-	series_calculate_min(np, arg);
+	series_calculate_extreme(np, arg, 0);
 	break;
     case N_MIN_SAMPLE:
-	series_calculate_time_domain_min(np, arg);
+	series_calculate_time_domain_extreme(np, arg, 0);
 	break;
     case N_RESCALE:
 	series_calculate_rescale(np, arg);
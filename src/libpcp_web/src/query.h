@@ -107,6 +107,7 @@ typedef struct seriesGetSID {
     sds			metric;		/* back-pointer for instance series */
     /* various flags */
     unsigned int	freed : 1;	/* freed individually on completion */
+    unsigned int	rollup : 4;	/* values read from rollup tier+1 */
     void		*baton;
 } seriesGetSID;
 
@@ -136,6 +137,8 @@ typedef struct series_sample_set {
     /* Number of series samples */
     int				num_samples;
     series_instance_set_t	*series_sample;
+    /* Typed values, while passed between calculation kernels */
+    struct series_column	*column;
 } series_sample_set_t;
 
 typedef struct series_value_set {
@@ -144,6 +147,22 @@ typedef struct series_value_set {
     series_sample_set_t		*series_values;
 } series_value_set_t;
 
+/*
+ * Typed, columnar view of one series_sample_set_t - values are parsed
+ * from strings once, into a samples x instances array of doubles that
+ * is aligned on the sample timestamps, for the numeric query kernels.
+ * A NULL format means the values are as parsed and the value strings
+ * are current, otherwise the strings of valid rows are stale until the
+ * column is stored back using this format.
+ */
+typedef struct series_column {
+    unsigned int		num_samples;	/* rows, one per timestamp */
+    unsigned int		num_instances;	/* columns, from first sample */
+    unsigned char		*valid;		/* row instance count matched */
+    double			*values;	/* row-major, num_samples rows */
+    const char			*format;	/* computed values format */
+} series_column_t;
+
 
 typedef struct timing {
     /* input string */
@@ -31,6 +31,13 @@ static sds		streamexpire;
 static sds		DEFAULT_CURSORCOUNT;
 static sds		DEFAULT_MAXSTREAMLEN;
 static sds		DEFAULT_STREAMEXPIRE;
+static sds		rollupexpire;
+static sds		DEFAULT_ROLLUPEXPIRE;
+static rollupTier	rollup_tiers[MAX_ROLLUP_TIERS];
+static unsigned int	rollup_ntiers;
+
+static const char	*rollup_stats[] = { "avg", "min", "max", "count" };
+static const int	num_rollup_stats = sizeof(rollup_stats) / sizeof(rollup_stats[0]);
 
 static void
 initRedisSlotsBaton(redisSlotsBaton *baton,
@@ -1148,6 +1155,146 @@ redis_series_streamed(sds stamp, metric_t *metric, void *arg)
     }
 }
 
+static sds
+series_rollup_value(rollup_t *rollup, int stat)
+{
+    switch (stat) {
+    case 0:	/* avg */
+	return sdscatprintf(sdsempty(), "%e", rollup->sum / rollup->count);
+    case 1:	/* min */
+	return sdscatprintf(sdsempty(), "%e", rollup->min);
+    case 2:	/* max */
+	return sdscatprintf(sdsempty(), "%e", rollup->max);
+    default:	/* count */
+	break;
+    }
+    return sdscatfmt(sdsempty(), "%u", rollup->count);
+}
+
+/*
+ * Stream the completed bucket of the given rollup tier for all names
+ * of this metric - one stream for each statistic, with instance:value
+ * pairs in the same form as the raw values stream, timestamped at the
+ * start of the bucket.  Caller resets the accumulators afterward.
+ */
+void
+redis_series_rollup(redisSlots *slots, metric_t *metric, unsigned int tier,
+		void *arg)
+{
+    seriesLoadBaton		*load = (seriesLoadBaton *)arg;
+    redisStreamBaton		*baton;
+    rollupTier			*rp = &rollup_tiers[tier];
+    rollup_t			*rollup;
+    instance_t			*inst;
+    value_t			*v;
+    struct timespec		bucket = {0};
+    unsigned int		count;
+    char			ts[64], hashbuf[42];
+    sds				cmd, key, name, stamp, stream, msg;
+    int				i, j, stat;
+
+    bucket.tv_sec = metric->rollup_bucket[tier];
+    stamp = sdsnew(timespec_stream_str(&bucket, ts, sizeof(ts)));
+    name = sdsempty();
+
+    for (i = 0; i < metric->numnames; i++) {
+	pmwebapi_hash_str(metric->names[i].hash, hashbuf, sizeof(hashbuf));
+
+	for (stat = 0; stat < num_rollup_stats; stat++) {
+	    count = 6;	/* XADD key MAXLEN ~ len stamp */
+	    stream = sdsempty();
+	    if (metric->desc.indom == PM_INDOM_NULL) {
+		rollup = metric->rollup ? &metric->rollup[tier] : NULL;
+		if (rollup && rollup->count) {
+		    sdsclear(name);
+		    stream = series_stream_append(stream, name,
+				series_rollup_value(rollup, stat));
+		    count += 2;
+		}
+	    } else if (metric->u.vlist) {
+		for (j = 0; j < metric->u.vlist->listcount; j++) {
+		    v = &metric->u.vlist->value[j];
+		    if (v->rollup == NULL || v->rollup[tier].count == 0)
+			continue;
+		    if ((inst = dictFetchValue(metric->indom->insts, &v->inst)) == NULL)
+			continue;
+		    name = sdscpylen(name, (const char *)inst->name.hash,
+				sizeof(inst->name.hash));
+		    stream = series_stream_append(stream, name,
+				series_rollup_value(&v->rollup[tier], stat));
+		    count += 2;
+		}
+	    }
+	    if (count == 6) {	/* no values accumulated in this bucket */
+		sdsfree(stream);
+		continue;
+	    }
+
+	    if ((baton = malloc(sizeof(redisStreamBaton))) == NULL) {
+		sdsfree(stream);
+		infofmt(msg, "OOM creating rollup stream baton");
+		batoninfo(load, PMLOG_ERROR, msg);
+		goto out;
+	    }
+	    initRedisStreamBaton(baton, slots, stamp, hashbuf, load);
+	    seriesBatonReferences(load, 2, "redis_series_rollup");
+
+	    key = sdscatfmt(sdsempty(), "pcp:rollup:%S:%s:series:%s",
+				rp->name, rollup_stats[stat], hashbuf);
+	    cmd = redis_command(count);
+	    cmd = redis_param_str(cmd, XADD, XADD_LEN);
+	    cmd = redis_param_sds(cmd, key);
+	    cmd = redis_param_str(cmd, "MAXLEN", sizeof("MAXLEN")-1);
+	    cmd = redis_param_str(cmd, "~", 1);
+	    cmd = redis_param_sds(cmd, rp->maxlen);
+	    cmd = redis_param_sds(cmd, stamp);
+	    cmd = redis_param_raw(cmd, stream);
+	    sdsfree(stream);
+	    redisSlotsRequest(slots, cmd, redis_series_stream_callback, baton);
+	    sdsfree(cmd);
+
+	    cmd = redis_command(3);	/* EXPIRE key timer */
+	    cmd = redis_param_str(cmd, EXPIRE, EXPIRE_LEN);
+	    cmd = redis_param_sds(cmd, key);
+	    cmd = redis_param_sds(cmd, rollupexpire);
+	    sdsfree(key);
+	    redisSlotsRequest(slots, cmd, redis_series_timer_callback, load);
+	    sdsfree(cmd);
+	}
+    }
+out:
+    sdsfree(name);
+    sdsfree(stamp);
+}
+
+unsigned int
+redisRollupTiers(rollupTier **tiers)
+{
+    if (tiers)
+	*tiers = rollup_tiers;
+    return rollup_ntiers;
+}
+
+/*
+ * Select the coarsest rollup tier that still satisfies the requested
+ * sampling interval, if any - returns the tier index, else -1 (in
+ * which case raw samples must be used).
+ */
+int
+redisRollupTier(struct timespec *interval)
+{
+    unsigned int	i;
+    int			tier = -1;
+
+    for (i = 0; i < rollup_ntiers; i++) {
+	if (rollup_tiers[i].seconds > interval->tv_sec)
+	    continue;
+	if (tier < 0 || rollup_tiers[i].seconds > rollup_tiers[tier].seconds)
+	    tier = i;
+    }
+    return tier;
+}
+
 void
 redis_series_mark(redisSlots *redis, sds timestamp, int data, void *arg)
 {
@@ -1521,6 +1668,44 @@ pmSeriesSetMetricRegistry(pmSeriesModule *module, mmv_registry_t *registry)
     return -ENOMEM;
 }
 
+/*
+ * Parse the comma-separated list of rollup tier intervals, such as
+ * "1m,1h,1d" - the retained stream length of each tier is derived
+ * from the rollup expiry time and the tier bucket width.
+ */
+static void
+redisRollupsInit(sds option)
+{
+    struct timeval	interval;
+    unsigned long long	expire = strtoull(rollupexpire, NULL, 10);
+    unsigned int	seconds;
+    sds			*names, maxlen;
+    char		*errmsg;
+    int			i, nnames = 0;
+
+    names = sdssplitlen(option, sdslen(option), ",", 1, &nnames);
+    for (i = 0; i < nnames && rollup_ntiers < MAX_ROLLUP_TIERS; i++) {
+	names[i] = sdstrim(names[i], " ");
+	if (sdslen(names[i]) == 0)
+	    continue;
+	if (pmParseInterval(names[i], &interval, &errmsg) < 0) {
+	    pmNotifyErr(LOG_ERR, "bad pmseries stream.rollups interval: %s",
+			errmsg);
+	    free(errmsg);
+	    continue;
+	}
+	if ((seconds = interval.tv_sec) == 0)
+	    continue;
+	maxlen = sdscatfmt(sdsempty(), "%U",
+			(unsigned long long)(expire / seconds) + 1);
+	rollup_tiers[rollup_ntiers].name = sdsdup(names[i]);
+	rollup_tiers[rollup_ntiers].seconds = seconds;
+	rollup_tiers[rollup_ntiers].maxlen = maxlen;
+	rollup_ntiers++;
+    }
+    sdsfreesplitres(names, nnames);
+}
+
 static void
 redisSeriesInit(struct dict *config)
 {
@@ -1546,6 +1731,17 @@ redisSeriesInit(struct dict *config)
 	else	/* default value: 1 day (without changes) */
 	    streamexpire = DEFAULT_STREAMEXPIRE = sdsnew("86400");
     }
+
+    if (!rollupexpire) {
+	if ((option = pmIniFileLookup(config, "pmseries", "stream.rollups.expire")))
+	    rollupexpire = option;
+	else	/* default value: 90 days (without changes) */
+	    rollupexpire = DEFAULT_ROLLUPEXPIRE = sdsnew("7776000");
+    }
+
+    if (!rollup_ntiers &&
+	(option = pmIniFileLookup(config, "pmseries", "stream.rollups")))
+	redisRollupsInit(option);
 }
 
 static void
@@ -1563,6 +1759,15 @@ redisSeriesClose(void)
 	sdsfree(DEFAULT_STREAMEXPIRE);
 	DEFAULT_STREAMEXPIRE = NULL;
     }
+    if (DEFAULT_ROLLUPEXPIRE) {
+	sdsfree(DEFAULT_ROLLUPEXPIRE);
+	DEFAULT_ROLLUPEXPIRE = NULL;
+    }
+    while (rollup_ntiers > 0) {
+	rollup_ntiers--;
+	sdsfree(rollup_tiers[rollup_ntiers].name);
+	sdsfree(rollup_tiers[rollup_ntiers].maxlen);
+    }
 }
 
 void
@@ -1780,6 +1985,8 @@ pmDiscoverSetupMetrics(pmDiscoverModule *module)
     pmUnits		nounits = MMV_UNITS(0,0,0,0,0,0);
     pmUnits		countunits = MMV_UNITS(0,0,1,0,0,0);
     pmUnits		secondsunits = MMV_UNITS(0,1,0,0,PM_TIME_SEC,0);
+    pmUnits		msecunits = MMV_UNITS(0,1,0,0,PM_TIME_MSEC,0);
+    pmUnits		bytesunits = MMV_UNITS(1,0,0,PM_SPACE_BYTE,0,0);
     void		*map;
 
     if (data == NULL || data->registry == NULL)
@@ -1892,6 +2099,24 @@ pmDiscoverSetupMetrics(pmDiscoverModule *module)
 	"error result records decoded for monitored archives",
 	"Total errors in result records decoded for monitored archives");
 
+    mmv_stats_add_metric(data->registry, "metadata.backlog", 22,
+	MMV_TYPE_U64, MMV_SEM_INSTANT, bytesunits, MMV_INDOM_NULL,
+	"metadata bytes written but not yet decoded for monitored archives",
+	"Total bytes appended to the metadata of all monitored archives which\n"
+	"have not yet been decoded, such as partially written records");
+
+    mmv_stats_add_metric(data->registry, "logvol.backlog", 23,
+	MMV_TYPE_U64, MMV_SEM_INSTANT, countunits, MMV_INDOM_NULL,
+	"deferred filesystem changes for monitored archives",
+	"Number of filesystem change callbacks for monitored archives that\n"
+	"were throttled and have not yet been processed");
+
+    mmv_stats_add_metric(data->registry, "logvol.decode_lag", 24,
+	MMV_TYPE_U64, MMV_SEM_INSTANT, msecunits, MMV_INDOM_NULL,
+	"largest decode lag for monitored archives",
+	"Largest difference between the time a result record was decoded and\n"
+	"its timestamp, from the most recent decoding of each monitored archive");
+
     data->map = map = mmv_stats_start(data->registry);
     metrics = data->metrics;
 
@@ -1937,6 +2162,12 @@ pmDiscoverSetupMetrics(pmDiscoverModule *module)
 				    map, "metadata.partial_reads", NULL);
     metrics[DISCOVER_DECODE_RESULT_ERRORS] = mmv_lookup_value_desc(
 				    map, "logvol.decode.result_errors", NULL);
+    metrics[DISCOVER_BACKLOG_BYTES] = mmv_lookup_value_desc(
+				    map, "metadata.backlog", NULL);
+    metrics[DISCOVER_BACKLOG_EVENTS] = mmv_lookup_value_desc(
+				    map, "logvol.backlog", NULL);
+    metrics[DISCOVER_DECODE_LAG] = mmv_lookup_value_desc(
+				    map, "logvol.decode_lag", NULL);
 }
 
 int
@@ -1951,6 +2182,22 @@ pmDiscoverSetMetricRegistry(pmDiscoverModule *module, mmv_registry_t *registry)
     return -ENOMEM;
 }
 
+int
+pmDiscoverSetSourceMetrics(pmDiscoverModule *module, const char *file, int cluster)
+{
+    discoverModuleData	*data = getDiscoverModuleData(module);
+
+    if (data) {
+	if (data->sources_file)
+	    free(data->sources_file);
+	data->sources_file = file ? strdup(file) : NULL;
+	data->sources_cluster = cluster;
+	data->sources_timer = -1;
+	return 0;
+    }
+    return -ENOMEM;
+}
+
 int
 pmDiscoverSetup(pmDiscoverModule *module, pmDiscoverCallBacks *cbs, void *arg)
 {
@@ -2013,6 +2260,10 @@ pmDiscoverSetup(pmDiscoverModule *module, pmDiscoverCallBacks *cbs, void *arg)
 	logdir = fallback;
 
     pmDiscoverSetupMetrics(module);
+    if (data->sources_file) {
+	data->sources_changed = 1;
+	data->sources_timer = pmWebTimerRegister(pmDiscoverSourcesRefresh, module);
+    }
 
     if (access(logdir, F_OK) == 0) {
 	sts = pmDiscoverRegister(logdir, module, cbs, arg);
@@ -2032,6 +2283,12 @@ pmDiscoverClose(pmDiscoverModule *module)
 
     if (discover) {
 	pmDiscoverUnregister(discover->handle);
+	if (discover->sources_file) {
+	    if (discover->sources_timer >= 0)
+		pmWebTimerRelease(discover->sources_timer);
+	    pmDiscoverSourcesClose(module);
+	    free(discover->sources_file);
+	}
 	if (discover->slots && !discover->shareslots)
 	    redisSlotsFree(discover->slots);
 	for (i = 0; i < discover->exclude_names; i++)
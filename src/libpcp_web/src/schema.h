@@ -115,6 +115,23 @@ extern void redisGlobalsClose(void);
 extern void redis_series_source(redisSlots *, void *);
 extern void redis_series_mark(redisSlots *, sds, int, void *);
 extern void redis_series_metric(redisSlots *, metric_t *, sds, int, int, void *);
+extern void redis_series_rollup(redisSlots *, metric_t *, unsigned int, void *);
+
+/*
+ * Optional downsampled rollup tiers for time series values, from the
+ * pmseries stream.rollups setting (e.g. "1m,1h,1d").  Each completed
+ * bucket is streamed as avg, min, max and count values per instance.
+ */
+#define MAX_ROLLUP_TIERS	8
+
+typedef struct rollupTier {
+    sds			name;		/* as configured, e.g. "1h" */
+    unsigned int	seconds;	/* bucket width in seconds */
+    sds			maxlen;		/* stream length to retain */
+} rollupTier;
+
+extern unsigned int redisRollupTiers(rollupTier **);
+extern int redisRollupTier(struct timespec *);
 
 /*
  * Asynchronous schema load baton structures
@@ -1121,10 +1121,17 @@ pmwebapi_free_metric(metric_t *metric)
     if (metric->desc.indom == PM_INDOM_NULL) {
 	pmwebapi_release_value(type, &metric->u.atom);
     } else if (metric->u.vlist) {
-	for (i = 0; i < metric->u.vlist->listcount; i++)
+	for (i = 0; i < metric->u.vlist->listcount; i++) {
 	    pmwebapi_release_value(type, &metric->u.vlist->value[i].atom);
+	    if (metric->u.vlist->value[i].rollup)
+		free(metric->u.vlist->value[i].rollup);
+	}
 	free(metric->u.vlist);
     }
+    if (metric->rollup_bucket)
+	free(metric->rollup_bucket);
+    if (metric->rollup)
+	free(metric->rollup);
 
     memset(metric, 0, sizeof(*metric));
     free(metric);
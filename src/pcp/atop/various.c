@@ -8,7 +8,7 @@
 ** time-of-day, the cpu-time consumption and the memory-occupation. 
 **
 ** Copyright (C) 2000-2010 Gerlof Langeveld
-** Copyright (C) 2015-2021 Red Hat.
+** Copyright (C) 2015-2021,2026 Red Hat.
 **
 ** This program is free software; you can redistribute it and/or modify it
 ** under the terms of the GNU General Public License as published by the
@@ -883,16 +883,138 @@ setup_globals(pmOptions *opts)
 	setup_step_mode(0);
 }
 
+/*
+** Index of the instance identifiers in each value set of the current
+** result, so that per-instance extraction (for each of possibly tens
+** of thousands of processes) need not search the value set.  A value
+** set is indexed on first use, and the index is reset on each fetch.
+*/
+struct instmap {
+	pmValueSet	*values;	/* value set indexed, or NULL */
+	unsigned int	mask;		/* hash table size, less one */
+	unsigned int	size;		/* allocated hash table size */
+	int		*slots;		/* value position+1, zero if empty */
+};
+
+static struct {
+	pmResult	*result;	/* result being indexed */
+	int		nmaps;
+	struct instmap	*maps;		/* one for each value set */
+} instindex;
+
+static void
+reset_instance_index(pmResult *result)
+{
+	size_t	size;
+	int	i;
+
+	if (result->numpmid > instindex.nmaps)
+	{
+		size = result->numpmid * sizeof(struct instmap);
+		instindex.maps = (struct instmap *)realloc(instindex.maps, size);
+		ptrverify(instindex.maps, "reset_instance_index [%ld]\n", (long)size);
+		memset(&instindex.maps[instindex.nmaps], 0,
+			(result->numpmid - instindex.nmaps) * sizeof(struct instmap));
+		instindex.nmaps = result->numpmid;
+	}
+	for (i = 0; i < instindex.nmaps; i++)
+		instindex.maps[i].values = NULL;
+	instindex.result = result;
+}
+
+static inline unsigned int
+hash_instance(int inst, unsigned int mask)
+{
+	unsigned int	key = (unsigned int)inst * 2654435761U;
+
+	return (key ^ (key >> 16)) & mask;
+}
+
+static void
+build_instance_map(struct instmap *map, pmValueSet *values)
+{
+	unsigned int	size, i;
+	int		j;
+
+	for (size = 64; size < 2 * (unsigned int)values->numval; size <<= 1)
+		;
+	if (size > map->size)
+	{
+		map->slots = (int *)realloc(map->slots, size * sizeof(int));
+		ptrverify(map->slots, "build_instance_map [%ld]\n",
+				(long)(size * sizeof(int)));
+		map->size = size;
+	}
+	map->mask = size - 1;
+	memset(map->slots, 0, size * sizeof(int));
+
+	/* earlier duplicates are found first, as with a linear search */
+	for (j = 0; j < values->numval; j++)
+	{
+		i = hash_instance(values->vlist[j].inst, map->mask);
+		while (map->slots[i] != 0)
+			i = (i + 1) & map->mask;
+		map->slots[i] = j + 1;
+	}
+	map->values = values;
+}
+
+/*
+** position of instance "inst" in the value set of a result, or -1
+*/
+static int
+lookup_instance(pmResult *result, int value, int inst)
+{
+	pmValueSet	*values = result->vset[value];
+	struct instmap	*map;
+	unsigned int	i;
+	int		pos;
+
+	if (values->numval <= 16)	/* not worth indexing */
+	{
+		for (pos = 0; pos < values->numval; pos++)
+			if (values->vlist[pos].inst == inst)
+				return pos;
+		return -1;
+	}
+
+	if (result != instindex.result)
+		reset_instance_index(result);
+	map = &instindex.maps[value];
+	if (map->values != values)
+		build_instance_map(map, values);
+
+	for (i = hash_instance(inst, map->mask); (pos = map->slots[i]) != 0;
+	     i = (i + 1) & map->mask)
+	{
+		if (values->vlist[pos-1].inst == inst)
+			return pos - 1;
+	}
+	return -1;
+}
+
+/*
+** position of instance "inst" in the value set of a result, trying
+** the position "offset" (usually that of the same instance in other
+** metrics with the same instance domain) first, or -1 if not present
+*/
+static int
+instance_offset(pmResult *result, int value, int inst, int offset)
+{
+	pmValueSet	*values = result->vset[value];
+
+	if (offset >= 0 && offset < values->numval &&
+	    values->vlist[offset].inst == inst)
+		return offset;
+	return lookup_instance(result, value, inst);
+}
+
 int
 get_instance_index(pmResult *result, int value, int inst)
 {
-	pmValueSet *values = result->vset[value];
-	int i;
+	int	i = lookup_instance(result, value, inst);
 
-	for (i = 0; i < values->numval; i++)
-		if (values->vlist[i].inst == inst)
-			return i;
-	return 0;	/* not found, pick the start */
+	return i < 0 ? 0 : i;	/* not found, pick the start */
 }
 
 /*
@@ -927,23 +1049,10 @@ extract_integer_inst(pmResult *result, pmDesc *descs, int value, int inst, int o
 
 	if (values->numval <= 0)
 		return 0;
-	if (offset < values->numval && values->vlist[offset].inst == inst)
-	{
-		pmExtractValue(values->valfmt, &values->vlist[offset],
-			descs[value].type, &atom, PM_TYPE_32);
-		return atom.l;
-	}
-
-	for (i = 0; i < values->numval; i++)
-	{
-		if (values->vlist[i].inst != inst)
-			continue;
-		pmExtractValue(values->valfmt, &values->vlist[i],
-			descs[value].type, &atom, PM_TYPE_32);
-		break;
-	}
-	if (i == values->numval)
+	if ((i = instance_offset(result, value, inst, offset)) < 0)
 		return 0;
+	pmExtractValue(values->valfmt, &values->vlist[i],
+			descs[value].type, &atom, PM_TYPE_32);
 	return atom.l;
 }
 
@@ -982,23 +1091,10 @@ extract_ucount_t_inst(pmResult *result, pmDesc *descs, int value, int inst, int
 
 	if (values->numval <= 0)
 		return (unsigned long long)-1;
-	if (offset < values->numval && values->vlist[offset].inst == inst)
-	{
-		pmExtractValue(values->valfmt, &values->vlist[offset],
-			descs[value].type, &atom, PM_TYPE_U64);
-		return atom.ull;
-	}
-
-	for (i = 0; i < values->numval; i++)
-	{
-		if (values->vlist[i].inst != inst)
-			continue;
-		pmExtractValue(values->valfmt, &values->vlist[i],
-			descs[value].type, &atom, PM_TYPE_U64);
-		break;
-	}
-	if (i == values->numval)
+	if ((i = instance_offset(result, value, inst, offset)) < 0)
 		return (unsigned long long)-1;
+	pmExtractValue(values->valfmt, &values->vlist[i],
+			descs[value].type, &atom, PM_TYPE_U64);
 	return atom.ull;
 }
 
@@ -1011,22 +1107,10 @@ extract_count_t_inst(pmResult *result, pmDesc *descs, int value, int inst, int o
 
 	if (values->numval <= 0)
 		return 0;
-	if (offset < values->numval && values->vlist[offset].inst == inst)
-	{
-		pmExtractValue(values->valfmt, &values->vlist[offset],
-			descs[value].type, &atom, PM_TYPE_U64);
-		return atom.ll;
-	}
-
-	for (i = 0; i < values->numval; i++)
-	{
-		if (values->vlist[i].inst != inst)
-			continue;
-		pmExtractValue(values->valfmt, &values->vlist[i],
-			descs[value].type, &atom, PM_TYPE_64);
-		break;
-	}
-	if (i == values->numval)
+	if ((i = instance_offset(result, value, inst, offset)) < 0)
+		return 0;
+	if (pmExtractValue(values->valfmt, &values->vlist[i],
+			descs[value].type, &atom, PM_TYPE_64) < 0)
 		return 0;
 	return atom.ll;
 }
@@ -1064,24 +1148,10 @@ extract_string_inst(pmResult *result, pmDesc *descs, int value, char *buffer, in
 
 	if (values->numval <= 0)
 		return NULL;
-	if (offset < values->numval && values->vlist[offset].inst == inst)
-	{
-		pmExtractValue(values->valfmt, &values->vlist[offset],
-			descs[value].type, &atom, PM_TYPE_STRING);
-		goto copyout;
-	}
-
-	for (i = 0; i < values->numval; i++)
-	{
-		if (values->vlist[i].inst != inst)
-			continue;
-		pmExtractValue(values->valfmt, &values->vlist[i],
-			descs[value].type, &atom, PM_TYPE_STRING);
-		break;
-	}
-	if (values->numval == i)
+	if ((i = instance_offset(result, value, inst, offset)) < 0)
 		return NULL;
-copyout:
+	pmExtractValue(values->valfmt, &values->vlist[i],
+			descs[value].type, &atom, PM_TYPE_STRING);
 	strncpy(buffer, atom.cp, buflen);
 	free(atom.cp);
 	if (buflen > 1)	/* might be a single character - e.g. process state */
@@ -1098,23 +1168,10 @@ extract_float_inst(pmResult *result, pmDesc *descs, int value, int inst, int off
 
 	if (values->numval <= 0)
 		return -1;
-	if (offset < values->numval && values->vlist[offset].inst == inst)
-	{
-		pmExtractValue(values->valfmt, &values->vlist[offset],
-			descs[value].type, &atom, PM_TYPE_FLOAT);
-		return atom.f;
-	}
-
-	for (i = 0; i < values->numval; i++)
-	{
-		if (values->vlist[i].inst != inst)
-			continue;
-		pmExtractValue(values->valfmt, &values->vlist[i],
-			descs[value].type, &atom, PM_TYPE_FLOAT);
-		break;
-	}
-	if (i == values->numval)
+	if ((i = instance_offset(result, value, inst, offset)) < 0)
 		return -1;
+	pmExtractValue(values->valfmt, &values->vlist[i],
+			descs[value].type, &atom, PM_TYPE_FLOAT);
 	return atom.f;
 }
 
@@ -1210,6 +1267,7 @@ fetch_metrics(const char *purpose, int nmetrics, pmID *pmids, pmResult **result)
 		cleanstop(1);
 	}
 	rp = *result;
+	reset_instance_index(rp);
 	if (rp->numpmid == 0)	/* mark record */
 		sampflags |= RRMARK;
 	if (pmDebugOptions.appl1)
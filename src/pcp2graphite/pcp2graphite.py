@@ -72,7 +72,7 @@ class PCP2Graphite(object):
                      'type_prefer', 'precision_force', 'limit_filter', 'limit_filter_force',
                      'live_filter', 'rank', 'invert_filter', 'predicate', 'names_change',
                      'speclocal', 'instances', 'ignore_incompat', 'ignore_unknown',
-                     'omit_flat')
+                     'omit_flat', 'workers')
 
         # Ignored for pmrep(1) compatibility
         self.keys_ignore = (
@@ -103,6 +103,7 @@ class PCP2Graphite(object):
         self.ignore_incompat = 0
         self.ignore_unknown = 0
         self.names_change = 0 # ignore
+        self.workers = 0 # single process
         self.instances = []
         self.live_filter = 0
         self.rank = 0
@@ -166,6 +167,7 @@ class PCP2Graphite(object):
         opts.pmSetLongOption("check", 0, "C", "", "check config and metrics and exit")
         opts.pmSetLongOption("derived", 1, "e", "FILE|DFNT", "derived metrics definitions")
         opts.pmSetLongOption("daemonize", 0, "", "", "daemonize on startup")
+        opts.pmSetLongOption("workers", 1, "", "N", "worker processes for archive replay")
         opts.pmSetLongOptionDebug()        # -D/--debug
         opts.pmSetLongOptionVersion()      # -V/--version
         opts.pmSetLongOptionHelp()         # -?/--help
@@ -219,6 +221,8 @@ class PCP2Graphite(object):
         """ Perform setup for individual command line option """
         if opt == 'daemonize':
             self.daemonize = 1
+        elif opt == 'workers':
+            self.workers = optarg
         elif opt == 'K':
             if not self.speclocal or not self.speclocal.startswith(";"):
                 self.speclocal = ";" + optarg
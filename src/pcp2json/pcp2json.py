@@ -66,7 +66,7 @@ class PCP2JSON(object):
                      'type_prefer', 'precision_force', 'limit_filter', 'limit_filter_force',
                      'live_filter', 'rank', 'invert_filter', 'predicate', 'names_change',
                      'speclocal', 'instances', 'ignore_incompat', 'ignore_unknown',
-                     'omit_flat', 'include_labels')
+                     'omit_flat', 'include_labels', 'workers')
 
         # Ignored for pmrep(1) compatibility
         self.keys_ignore = (
@@ -97,6 +97,7 @@ class PCP2JSON(object):
         self.ignore_incompat = 0
         self.ignore_unknown = 0
         self.names_change = 0 # ignore
+        self.workers = 0 # single process
         self.instances = []
         self.live_filter = 0
         self.rank = 0
@@ -166,6 +167,7 @@ class PCP2JSON(object):
         opts.pmSetLongOption("output-file", 1, "F", "OUTFILE", "output file")
         opts.pmSetLongOption("derived", 1, "e", "FILE|DFNT", "derived metrics definitions")
         opts.pmSetLongOption("daemonize", 0, "", "", "daemonize on startup")
+        opts.pmSetLongOption("workers", 1, "", "N", "worker processes for archive replay")
         opts.pmSetLongOptionDebug()        # -D/--debug
         opts.pmSetLongOptionVersion()      # -V/--version
         opts.pmSetLongOptionHelp()         # -?/--help
@@ -221,6 +223,8 @@ class PCP2JSON(object):
         """ Perform setup for individual command line option """
         if opt == 'daemonize':
             self.daemonize = 1
+        elif opt == 'workers':
+            self.workers = optarg
         elif opt == 'K':
             if not self.speclocal or not self.speclocal.startswith(";"):
                 self.speclocal = ";" + optarg
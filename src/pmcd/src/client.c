@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2018 Red Hat.
+ * Copyright (c) 2012-2018,2026 Red Hat.
  * Copyright (c) 1995-2001,2004 Silicon Graphics, Inc.  All Rights Reserved.
  * 
  * This program is free software; you can redistribute it and/or modify it
@@ -116,6 +116,9 @@ AcceptNewClient(int reqfd)
     client[i].status.connected = 1;
     client[i].status.attributes = 0;
     client[i].status.changes = 0;
+    client[i].status.pipeline = 0;
+    client[i].status.delta = 0;
+    client[i].tag = FROM_ANON;
     memset(&client[i].attrs, 0, sizeof(__pmHashCtl));
 
     /*
@@ -216,6 +219,15 @@ DeleteClient(ClientInfo *cp)
 	}
     }
     __pmHashClear(hcp);
+    hcp = &cp->delta;
+    for (i = 0; i < hcp->hsize; i++) {
+	for (hp = hcp->hash[i]; hp != NULL; hp = hp->next) {
+	    __pmResetResultDelta((__pmResultDelta *)hp->data);
+	    free(hp->data);
+	    hp->data = NULL;
+	}
+    }
+    __pmHashClear(hcp);
     __pmFreeAttrsSpec(&cp->attrs);
     __pmHashClear(&cp->attrs);
     __pmSockAddrFree(cp->addr);
@@ -223,6 +235,8 @@ DeleteClient(ClientInfo *cp)
     cp->status.connected = 0;
     cp->status.attributes = 0;
     cp->status.changes = 0;
+    cp->status.pipeline = 0;
+    cp->status.delta = 0;
     cp->fd = -1;
 
     NotifyEndContext(cp-client);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2018 Red Hat.
+ * Copyright (c) 2012-2018,2026 Red Hat.
  * Copyright (c) 1995 Silicon Graphics, Inc.  All Rights Reserved.
  * 
  * This program is free software; you can redistribute it and/or modify it
@@ -22,18 +22,22 @@ typedef struct {
 	unsigned int	connected : 1;	/* Client connected */
 	unsigned int	changes : 6;	/* PMCD_* bits for changes since last fetch */
 	unsigned int	attributes: 1;	/* Connection attributes have changed */
+	unsigned int	pipeline : 1;	/* Client asked for tagged replies */
+	unsigned int	delta : 1;	/* Client asked for delta results */
     } status;
     /* There is a profile associated with each client context.
      * The context slot number (not the context number) sent with each
      * profile/fetch is used as the key to the profile hash table.
      */
     __pmHashCtl		profile;	/* Client context profile pointers */
+    __pmHashCtl		delta;		/* Last result for each context */
     unsigned int	denyOps;	/* Disallowed operations for client */
     __pmPDUInfo		pduInfo;
     unsigned int	seq;		/* Client sequence number (pmdapmcd) */
     time_t		start;		/* Time client connected (pmdapmcd) */
     __pmSockAddr	*addr;		/* Network address of client */
     __pmHashCtl		attrs;		/* Connection attributes (tuples) */
+    int			tag;		/* "from" for replies to current request */
 } ClientInfo;
 
 PMCD_DATA extern ClientInfo *client;		/* Array of clients */
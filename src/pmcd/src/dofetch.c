@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2019,2021-2022 Red Hat.
+ * Copyright (c) 2012-2019,2021-2022,2026 Red Hat.
  * Copyright (c) 1995 Silicon Graphics, Inc.  All Rights Reserved.
  *
  * This program is free software; you can redistribute it and/or modify it
@@ -361,6 +361,30 @@ ExtractState(void *timestamp)
     return (int)byte;
 }
 
+/*
+ * Send a fetch result relative to the last one sent for the same
+ * client context, for clients that asked for PDU_FLAG_DELTA
+ */
+static int
+SendDeltaResult(ClientInfo *cip, int ctxnum, __pmResult *result)
+{
+    __pmResultDelta	*dp;
+    __pmHashNode	*hp;
+
+    if ((hp = __pmHashSearch(ctxnum, &cip->delta)) != NULL)
+	dp = (__pmResultDelta *)hp->data;
+    else {
+	if ((dp = (__pmResultDelta *)calloc(1, sizeof(*dp))) == NULL ||
+	    __pmHashAdd(ctxnum, dp, &cip->delta) < 0) {
+	    /* no last result, the client copes with a full one */
+	    if (dp != NULL)
+		free(dp);
+	    return __pmSendHighResResult(cip->fd, cip->tag, result);
+	}
+    }
+    return __pmSendDeltaResult(cip->fd, cip->tag, result, dp);
+}
+
 /*
  * Handle both the original and high resolution fetch PDU requests.
  * The input handling and PMDA interactions are the same, difference
@@ -604,15 +628,19 @@ HandleFetch(ClientInfo *cip, __pmPDU* pb, int pdutype)
     sts = 0;
     if (cip->status.changes) {
 	/* notify client of PMCD state change */
-	sts = __pmSendError(cip->fd, FROM_ANON, (int)cip->status.changes);
+	sts = __pmSendError(cip->fd, cip->tag, (int)cip->status.changes);
 	if (sts > 0)
 	    sts = 0;
 	cip->status.changes = 0;
     }
-    if (sts == 0)
-	sts = (pdutype == PDU_HIGHRES_FETCH) ?
-		__pmSendHighResResult(cip->fd, FROM_ANON, endResult) :
-		__pmSendResult(cip->fd, FROM_ANON, endResult);
+    if (sts == 0) {
+	if (pdutype == PDU_HIGHRES_FETCH && cip->status.delta)
+	    sts = SendDeltaResult(cip, ctxnum, endResult);
+	else if (pdutype == PDU_HIGHRES_FETCH)
+	    sts = __pmSendHighResResult(cip->fd, cip->tag, endResult);
+	else
+	    sts = __pmSendResult(cip->fd, cip->tag, endResult);
+    }
 
     if (sts < 0) {
 	pmcd_trace(TR_XMIT_ERR, cip->fd, pdutype, sts);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2014,2017-2022 Red Hat.
+ * Copyright (c) 2012-2014,2017-2022,2026 Red Hat.
  * Copyright (c) 1995-2002 Silicon Graphics, Inc.  All Rights Reserved.
  *
  * This program is free software; you can redistribute it and/or modify it
@@ -115,7 +115,7 @@ DoText(ClientInfo *cp, __pmPDU* pb)
 
     if (sts >= 0) {
 	pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_TEXT, ident);
-	sts = __pmSendText(cp->fd, FROM_ANON, ident, buffer);
+	sts = __pmSendText(cp->fd, cp->tag, ident, buffer);
 	if (sts < 0 && ap->ipcType != AGENT_DSO) {
 	    pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_TEXT, sts);
 	    CleanupClient(cp, sts);
@@ -154,6 +154,13 @@ DoProfile(ClientInfo *cp, __pmPDU *pb)
 	    }
 	}
 
+	/* The next result for the context is not relative to an earlier
+	 * one, which is also how a client that has lost track of delta
+	 * results starts again
+	 */
+	if ((hp = __pmHashSearch(ctxnum, &cp->delta)) != NULL)
+	    __pmResetResultDelta((__pmResultDelta *)hp->data);
+
 	/* "Invalidate" any references to the client context's profile in the
 	 * agents to which the old profile was last sent
 	 */
@@ -270,7 +277,7 @@ DoDesc(ClientInfo *cp, __pmPDU *pb)
 	return sts;
 
     pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_DESC, (int)desc.pmid);
-    sts = __pmSendDesc(cp->fd, FROM_ANON, &desc);
+    sts = __pmSendDesc(cp->fd, cp->tag, &desc);
     if (sts < 0) {
 	pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_DESC, sts);
 	CleanupClient(cp, sts);
@@ -299,7 +306,7 @@ DoDescIDs(ClientInfo *cp, __pmPDU *pb)
 	goto done;
 
     pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_DESCS, numids);
-    sts = __pmSendDescs(cp->fd, FROM_ANON, numids, desclist);
+    sts = __pmSendDescs(cp->fd, cp->tag, numids, desclist);
     if (sts < 0) {
 	pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_DESCS, sts);
 	CleanupClient(cp, sts);
@@ -385,7 +392,7 @@ DoInstance(ClientInfo *cp, __pmPDU *pb)
 
     if (sts >= 0) {
 	pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_INSTANCE, (int)(inresult->indom));
-	sts = __pmSendInstance(cp->fd, FROM_ANON, inresult);
+	sts = __pmSendInstance(cp->fd, cp->tag, inresult);
 	if (sts < 0) {
 	    pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_INSTANCE, sts);
 	    CleanupClient(cp, sts);
@@ -624,7 +631,7 @@ response:
 	pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_LABEL, (int)ident);
 	if (nsets > 1 && !(type & PM_LABEL_INSTANCES))
 	    nsets = 1;
-	sts = __pmSendLabel(cp->fd, FROM_ANON, ident, type, sets, nsets);
+	sts = __pmSendLabel(cp->fd, cp->tag, ident, type, sets, nsets);
 	if (sts < 0) {
 	    pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_LABEL, sts);
 	    CleanupClient(cp, sts);
@@ -726,7 +733,7 @@ DoPMNSIDs(ClientInfo *cp, __pmPDU *pb)
     numnames = sts;
 
     pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_PMNS_NAMES, numnames);
-    if ((sts = __pmSendNameList(cp->fd, FROM_ANON, numnames, (const char **)namelist, NULL)) < 0){
+    if ((sts = __pmSendNameList(cp->fd, cp->tag, numnames, (const char **)namelist, NULL)) < 0){
 	pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_PMNS_NAMES, sts);
 	CleanupClient(cp, sts);
     	goto fail;
@@ -872,7 +879,7 @@ DoPMNSNames(ClientInfo *cp, __pmPDU *pb)
     }
 
     pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_PMNS_IDS, numok);
-    if ((sts = __pmSendIDList(cp->fd, FROM_ANON, numids, idlist, numok)) < 0) {
+    if ((sts = __pmSendIDList(cp->fd, cp->tag, numids, idlist, numok)) < 0) {
 	pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_PMNS_IDS, sts);
 	CleanupClient(cp, sts);
     }
@@ -999,7 +1006,7 @@ DoPMNSChild(ClientInfo *cp, __pmPDU *pb)
 
     numnames = sts;
     pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_PMNS_NAMES, numnames);
-    if ((sts = __pmSendNameList(cp->fd, FROM_ANON, numnames, (const char **)offspring, statuslist)) < 0) {
+    if ((sts = __pmSendNameList(cp->fd, cp->tag, numnames, (const char **)offspring, statuslist)) < 0) {
 	pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_PMNS_NAMES, sts);
 	CleanupClient(cp, sts);
     }
@@ -1292,7 +1299,7 @@ check:
 	goto done;
 
     pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_PMNS_NAMES, travNL_num);
-    if ((sts = __pmSendNameList(cp->fd, FROM_ANON, travNL_num, (const char **)travNL, NULL)) < 0) {
+    if ((sts = __pmSendNameList(cp->fd, cp->tag, travNL_num, (const char **)travNL, NULL)) < 0) {
 	pmcd_trace(TR_XMIT_ERR, cp->fd, PDU_PMNS_NAMES, sts);
 	CleanupClient(cp, sts);
 	goto done;
@@ -1403,6 +1410,8 @@ DoCreds(ClientInfo *cp, __pmPDU *pb)
 			{ PDU_FLAG_LABELS,	"LABELS" },
 			{ PDU_FLAG_HIGHRES,	"HIGHRES" },
 			{ PDU_FLAG_DESCS,	"DESCS" },
+			{ PDU_FLAG_PIPELINE,	"PIPELINE" },
+			{ PDU_FLAG_DELTA,	"DELTA" },
 		    };
 		    int	n;
 		    int	first = 1;
@@ -1444,6 +1453,24 @@ DoCreds(ClientInfo *cp, __pmPDU *pb)
     if (CheckCertRequired(cp) && (flags & PDU_FLAG_SECURE) == 0)
 	return PM_ERR_NEEDCLIENTCERT;
 
+    /*
+     * client may pipeline requests, and wants each reply tagged with
+     * the "from" of the request ... nothing to negotiate beyond that
+     */
+    if (flags & PDU_FLAG_PIPELINE) {
+	cp->status.pipeline = 1;
+	flags &= ~PDU_FLAG_PIPELINE;
+    }
+
+    /*
+     * client wants each fetch result relative to the last one for the
+     * same context, see __pmSendDeltaResult()
+     */
+    if (flags & PDU_FLAG_DELTA) {
+	cp->status.delta = 1;
+	flags &= ~PDU_FLAG_DELTA;
+    }
+
     if (sts >= 0 && flags) {
 	/*
 	 * new client has arrived; may want encryption, authentication, etc
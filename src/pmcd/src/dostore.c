@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2013,2019,2022 Red Hat.
+ * Copyright (c) 2012-2013,2019,2022,2026 Red Hat.
  * Copyright (c) 1995-2002 Silicon Graphics, Inc.  All Rights Reserved.
  *
  * This program is free software; you can redistribute it and/or modify it
@@ -300,7 +300,7 @@ DoStore(ClientInfo *cp, __pmPDU* pb)
 	/* send PDU_ERROR, even if result was 0 */
 	int ss;
 	pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_ERROR, 0);
-	ss = __pmSendError(cp->fd, FROM_ANON, 0);
+	ss = __pmSendError(cp->fd, cp->tag, 0);
 	if (ss < 0)
 	    CleanupClient(cp, ss);
     }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2017,2021-2022 Red Hat.
+ * Copyright (c) 2012-2017,2021-2022,2026 Red Hat.
  * Copyright (c) 1995-2001,2004 Silicon Graphics, Inc.  All Rights Reserved.
  *
  * This program is free software; you can redistribute it and/or modify it
@@ -328,6 +328,13 @@ HandleClientInput(__pmFdSet *fdsPtr)
 	if (pmDebugOptions.appl0)
 	    ShowClients(stderr);
 
+	/*
+	 * requests are handled in the order they arrive, but a client
+	 * that pipelines requests may also want each reply tagged with
+	 * the "from" of its request, see DoCreds()
+	 */
+	cp->tag = cp->status.pipeline ? php->from : FROM_ANON;
+
 	switch (php->type) {
 	    case PDU_PROFILE:
 		sts = (cp->denyOps & PMCD_OP_FETCH) ?
@@ -408,7 +415,7 @@ HandleClientInput(__pmFdSet *fdsPtr)
 	    /* Make sure client still alive before sending. */
 	    if (cp->status.connected) {
 		pmcd_trace(TR_XMIT_PDU, cp->fd, PDU_ERROR, sts);
-		sts = __pmSendError(cp->fd, FROM_ANON, sts);
+		sts = __pmSendError(cp->fd, cp->tag, sts);
 		if (sts < 0)
 		    pmNotifyErr(LOG_ERR, "HandleClientInput: "
 			"error sending Error PDU to client[%d] %s\n", i, pmErrStr(sts));
@@ -706,6 +713,8 @@ CheckNewClient(__pmFdSet * fdset, int rfd, int family)
 	    cp->pduInfo.features |= PDU_FLAG_DESCS;
 	    cp->pduInfo.features |= PDU_FLAG_LABELS;
 	    cp->pduInfo.features |= PDU_FLAG_HIGHRES;
+	    cp->pduInfo.features |= PDU_FLAG_PIPELINE;
+	    cp->pduInfo.features |= PDU_FLAG_DELTA;
 	    if (__pmServerHasFeature(PM_SERVER_FEATURE_SECURE))
 		cp->pduInfo.features |= (PDU_FLAG_SECURE | PDU_FLAG_SECURE_ACK);
 	    if (__pmServerHasFeature(PM_SERVER_FEATURE_COMPRESS))
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2017, Red Hat.  All Rights Reserved.
+ * Copyright (c) 2012-2017,2026, Red Hat.  All Rights Reserved.
  * Copyright (c) 2007-2008, Aconex.  All Rights Reserved.
  * Copyright (c) 2006, Ken McDonell.  All Rights Reserved.
  * 
@@ -38,6 +38,9 @@ GroupControl::init(int samples, int visible,
 {
     my.samples = samples;
     my.visible = visible;
+    setStoreHistory(samples);
+    if (isArchiveSource())
+	setArchivePrefetch(samples);
 
     if (isArchiveSource()) {
 	my.pmtimeState = QmcTime::StoppedState;
@@ -341,6 +344,7 @@ GroupControl::adjustLiveWorldViewForward(QmcTime::Packet *packet)
 	    }
 	    console->post("Saved live data (oi=%d/i=%d) for %s", oi, i,
 						timeString(position));
+	    store().moveRow(i, oi);
 	    for (int j = 0; j < gadgetCount(); j++)
 		my.gadgetsList.at(j)->preserveSample(i, oi);
 	    my.timeData[i] = my.timeData[oi];
@@ -352,13 +356,14 @@ GroupControl::adjustLiveWorldViewForward(QmcTime::Packet *packet)
 	if (i == 0) {	// refreshGadgets() finishes up last one
 	    console->post("Fetching data[%d] at %s", i, timeString(position));
 	    my.timeData[i] = position;
-	    fetch();
+	    fetch(true, true);
 	}
 	else if (preserve == false) {
 #if DESPERATE
 	    console->post("No live data for %s", timeString(position));
 #endif
 	    my.timeData[i] = position;
+	    store().clearRow(i);
 	    for (int j = 0; j < gadgetCount(); j++)
 		my.gadgetsList.at(j)->punchoutSample(i);
 	}
@@ -416,7 +421,7 @@ GroupControl::adjustArchiveWorldViewForward(QmcTime::Packet *packet, bool setup)
 	pmtimevalFromReal(position, &timeval);
 	setArchiveMode(setmode, &timeval, delta);
 	console->post("Fetching data[%d] at %s", i, timeString(position));
-	fetch();
+	fetch(true, true);
 	if (i == 0)		// refreshGadgets() finishes up last one
 	    break;
 	console->post("GroupControl::adjustArchiveWorldViewForward: "
@@ -478,7 +483,7 @@ GroupControl::adjustArchiveWorldViewBackward(QmcTime::Packet *packet, bool setup
 	pmtimevalFromReal(position, &timeval);
 	setArchiveMode(setmode, &timeval, -delta);
 	console->post("Fetching data[%d] at %s", i, timeString(position));
-	fetch();
+	fetch(true, false);
 	if (i == last)		// refreshGadgets() finishes up last one
 	    break;
 	console->post("GroupControl::adjustArchiveWorldViewBackward: "
@@ -563,7 +568,7 @@ GroupControl::step(QmcTime::Packet *packet)
 	my.timeData.push_back(my.realPosition - torange(my.delta, last));
     }
 
-    fetch();
+    fetch(true, packet->state != QmcTime::BackwardState);
 
     bool active = isActive(packet);
     if (isActive(packet))
@@ -596,6 +601,9 @@ GroupControl::setSampleHistory(int v)
     console->post("GroupControl::setSampleHistory (%d -> %d)", my.samples, v);
     if (my.samples != v) {
 	my.samples = v;
+	setStoreHistory(v);
+	if (isArchiveSource())
+	    setArchivePrefetch(v);
 
 	double right = my.realPosition;
 	my.timeData.clear();
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2018, Red Hat. All Rights Reserved.
+ * Copyright (c) 2012-2018,2026, Red Hat. All Rights Reserved.
  * Copyright (c) 2012, Nathan Scott.  All Rights Reserved.
  * Copyright (c) 2007, Aconex.  All Rights Reserved.
  * 
@@ -29,7 +29,13 @@ SamplingItem::SamplingItem(Chart *parent,
     my.chart = parent;
     my.info = QString();
 
-    // initialize the pcp data and item data arrays
+    // sampled values are kept in the group store, with the metric value
+    // converted to chart units as it is read (factor is set on update)
+    my.store = &parent->tab()->group()->store();
+    my.rateConvert = true;
+    my.factor = qQNaN();
+
+    // initialize the item data array
     my.dataCount = 0;
     resetValues(samples, 0.0, 0.0);
 
@@ -69,86 +75,80 @@ SamplingItem::curve(void)
 }
 
 void
-SamplingItem::resetValues(int values, double, double)
+SamplingItem::resetValues(int, double, double)
 {
-    // Reset sizes of pcp data array and the plot data array
-    my.data.resize(values);
-    my.itemData.resize(values);
-    if (my.dataCount > values)
-	my.dataCount = values;
+    // The group store has just been resized (the sample history changed)
+    // which renumbers its slots, so rebuild the plot data array to match
+    my.itemData.fill(qQNaN(), my.store->capacity());
+    if (my.dataCount > my.store->count())
+	my.dataCount = my.store->count();
+    copyRawDataArray();
 }
 
 void
-SamplingItem::preserveSample(int index, int oldindex)
+SamplingItem::preserveSample(int index, int)
 {
-    if (my.dataCount > oldindex)
-	my.itemData[index] = my.data[index] = my.data[oldindex];
-    else
-	my.itemData[index] = my.data[index] = qQNaN();
+    // the group has already moved the sample within its store
+    plotData(index) = data(index);
 }
 
 void
 SamplingItem::punchoutSample(int index)
 {
-    my.data[index] = my.itemData[index] = qQNaN();
+    plotData(index) = qQNaN();
 }
 
-void
-SamplingItem::updateValues(bool forward,
-		bool rateConvert, pmUnits *units, int sampleHistory, int,
-		double, double, double)
+//
+// Sample <index> (zero is the most recent) from the group store,
+// rate-converted unless disabled for this chart, and in chart units
+//
+double
+SamplingItem::data(int index) const
 {
-    pmAtomValue	scaled, raw;
     QmcMetric	*metric = ChartItem::my.metric;
-    double	value;
-    int		sz;
+    int		column;
 
-    if (metric->numValues() < 1 || metric->error(0)) {
-	value = qQNaN();
-    } else {
-	// convert raw value to current chart scale
-	int	sts;
-	raw.d = rateConvert ? metric->value(0) : metric->currentValue(0);
-	sts = pmConvScale(PM_TYPE_DOUBLE, &raw, &ChartItem::my.units, &scaled, units);
-	if (sts < 0) {
-	    /* should never happen */
-	    if (pmDebugOptions.value) {
-		fprintf(stderr, "SamplingItem::updateValues: Botch: %s (%s) scale conversion from %s", 
-		    pmIDStr(metric->metricID()), metric->name().toStdString().c_str(), pmUnitsStr(&ChartItem::my.units));
-		fprintf(stderr, " to %s failed: %s\n", pmUnitsStr(units), pmErrStr(sts));
-	    }
-	    value = 0;
-	}
-	else
-	    value = scaled.d * my.scale;
-    }
+    if (index >= my.dataCount || metric->numValues() < 1)
+	return qQNaN();
+    column = my.rateConvert ? metric->valueColumn(0) : metric->currentColumn(0);
+    return my.store->value(column, index) * my.factor;
+}
 
-    // sz will be the number of previous samples we want to keep.
-    if (my.dataCount < sampleHistory)
-	sz = qMax(0, (int)(my.dataCount));
-    else
-	sz = qMax(0, (int)((my.dataCount - 1)));
-
-    if (forward) {
-	// Keep sz samples and add the new sample to the beginning.
-	my.data.resize(sz);
-	my.itemData.resize(sz);
-	my.data.push_front(value);
-	my.itemData.push_front(value);
-    } else {
-	// Keep sz samples and add the new sample to the end.
-	if (my.dataCount) {
-	    my.data.pop_front();
-	    my.itemData.pop_front();
+void
+SamplingItem::setUnits(const pmUnits *units)
+{
+    pmAtomValue	scaled, raw;
+    int		sts;
+
+    // conversion between units is a constant factor, so find it once
+    raw.d = 1.0;
+    sts = pmConvScale(PM_TYPE_DOUBLE, &raw, &ChartItem::my.units, &scaled, units);
+    if (sts < 0) {
+	/* should never happen */
+	if (pmDebugOptions.value) {
+	    QmcMetric *metric = ChartItem::my.metric;
+	    fprintf(stderr, "SamplingItem::setUnits: Botch: %s (%s) scale conversion from %s", 
+		pmIDStr(metric->metricID()), metric->name().toStdString().c_str(), pmUnitsStr(&ChartItem::my.units));
+	    fprintf(stderr, " to %s failed: %s\n", pmUnitsStr(units), pmErrStr(sts));
 	}
-	my.data.resize(sz);
-	my.itemData.resize(sz);
-	my.data.push_back(value);
-	my.itemData.push_back(value);
+	my.factor = 0;
     }
+    else
+	my.factor = scaled.d * my.scale;
+    my.units = *units;
+}
 
-    if (my.dataCount < sampleHistory)
-	my.dataCount++;
+void
+SamplingItem::updateValues(bool,
+		bool rateConvert, pmUnits *units, int sampleHistory, int,
+		double, double, double)
+{
+    // QmcGroup::fetch has added the new sample to the group store
+    // already, rate-converted, so only the chart units need tracking
+    if (qIsNaN(my.factor) || memcmp(&my.units, units, sizeof(pmUnits)) != 0)
+	setUnits(units);
+    my.rateConvert = rateConvert;
+    my.dataCount = qMin(my.store->count(), sampleHistory);
 }
 
 void
@@ -159,18 +159,16 @@ SamplingItem::rescaleValues(const pmUnits *old_units, const pmUnits *new_units)
     console->post("Chart::rescaleValues change units from %s to %s",
 			pmUnitsStr(old_units), pmUnitsStr(new_units));
 
+    // raw values convert as they are read, only plotted values change
+    setUnits(new_units);
+
     for (int i = my.dataCount - 1; i >= 0; i--) {
 	int	sts = 0;
-	new_av.d = 0;
-	if (my.data[i] != qQNaN()) {
-	    old_av.d = my.data[i];
-	    sts = pmConvScale(PM_TYPE_DOUBLE, &old_av, old_units, &new_av, new_units);
-	    my.data[i] = new_av.d;
-	}
-	if (my.itemData[i] != qQNaN()) {
-	    old_av.d = my.itemData[i];
+	if (!qIsNaN(plotData(i))) {
+	    old_av.d = plotData(i);
+	    new_av.d = 0;
 	    sts = pmConvScale(PM_TYPE_DOUBLE, &old_av, old_units, &new_av, new_units);
-	    my.itemData[i] = new_av.d;
+	    plotData(i) = new_av.d;
 	}
 	if (sts < 0) {
 	    /* should never happen */
@@ -193,7 +191,7 @@ SamplingItem::replot(int history, const QVector<double> &timeData)
     // non-deprecated instance of setSamples.
     my.samples.clear();
     for (int i = 0; i < count; ++i) {
-	QPointF sample(timeData[i], my.itemData[i]);
+	QPointF sample(timeData[i], plotData(i));
 	my.samples.push_back(sample);
     }
     my.curve->setSamples(my.samples);
@@ -291,7 +289,7 @@ SamplingItem::updateCursor(const QPointF &, int index)
     GroupControl		*group = my.chart->tab()->group();
     const QVector<double>	&timeData = group->timeAxisData();
     Q_ASSERT(index < my.dataCount);
-    QPointF curvePoint( timeData[index], my.itemData[index]);
+    QPointF curvePoint( timeData[index], plotData(index));
 
     // Now get the point info.
     my.info = my.chart->pointValueText(curvePoint);
@@ -308,7 +306,7 @@ SamplingItem::copyRawDataPoint(int index)
 {
     if (index < 0)
 	index = my.dataCount - 1;
-    my.itemData[index] = my.data[index];
+    plotData(index) = data(index);
 }
 
 int
@@ -317,23 +315,13 @@ SamplingItem::maximumDataCount(int maximum)
     return qMax(maximum, my.dataCount);
 }
 
-void
-SamplingItem::truncateData(int offset)
-{
-    for (int index = my.dataCount + 1; index < offset; index++) {
-	my.data[index] = 0;
-	// don't re-set dataCount ... so we don't plot these values,
-	// we just want them to count 0 towards any Stack aggregation
-    }
-}
-
 double
 SamplingItem::sumData(int index, double sum)
 {
     if (index < 0)
 	index = my.dataCount - 1;
-    if (index < my.dataCount && !qIsNaN(my.data[index]))
-	sum += my.data[index];
+    if (index < my.dataCount && !qIsNaN(data(index)))
+	sum += data(index);
     return sum;
 }
 
@@ -341,16 +329,16 @@ void
 SamplingItem::copyRawDataArray(void)
 {
     for (int index = 0; index < my.dataCount; index++)
-	my.itemData[index] = my.data[index];
+	plotData(index) = data(index);
 }
 
 void
 SamplingItem::copyDataPoint(int index)
 {
     if (hidden() || index >= my.dataCount)
-	my.itemData[index] = qQNaN();
+	plotData(index) = qQNaN();
     else
-	my.itemData[index] = my.data[index];
+	plotData(index) = data(index);
 }
 
 void
@@ -359,10 +347,10 @@ SamplingItem::setPlotUtil(int index, double sum)
     if (index < 0)
 	index = my.dataCount - 1;
     if (hidden() || sum == 0.0 ||
-	index >= my.dataCount || qIsNaN(my.data[index]))
-	my.itemData[index] = 0.0;
+	index >= my.dataCount || qIsNaN(data(index)))
+	plotData(index) = 0.0;
     else
-	my.itemData[index] = 100.0 * my.data[index] / sum;
+	plotData(index) = 100.0 * data(index) / sum;
 }
 
 double
@@ -370,11 +358,11 @@ SamplingItem::setPlotStack(int index, double sum)
 {
     if (index < 0)
 	index = my.dataCount - 1;
-    if (!hidden() && !qIsNaN(my.itemData[index])) {
-	sum += my.itemData[index];
-	my.itemData[index] = sum;
+    if (!hidden() && !qIsNaN(plotData(index))) {
+	sum += plotData(index);
+	plotData(index) = sum;
     } else
-	my.itemData[index] = 0.0;
+	plotData(index) = 0.0;
     return sum;
 }
 
@@ -383,11 +371,11 @@ SamplingItem::setDataStack(int index, double sum)
 {
     if (index < 0)
 	index = my.dataCount - 1;
-    if (hidden() || qIsNaN(my.data[index])) {
-	my.itemData[index] = qQNaN();
+    if (hidden() || qIsNaN(data(index))) {
+	plotData(index) = qQNaN();
     } else {
-	sum += my.data[index];
-	my.itemData[index] = sum;
+	sum += data(index);
+	plotData(index) = sum;
     }
     return sum;
 }
@@ -495,14 +483,8 @@ SamplingEngine::addItem(QmcMetric *mp, pmMetricSpec *msp, pmDesc *desc, const QS
 				my.chart->my.style,
 				sampleHistory, existingItemCount);
 
-    // Find current max count for all plot items
-    int i, size = 0;
-    for (i = 0; i < existingItemCount; i++)
-	size = samplingItem(i)->maximumDataCount(size);
-    // Zero any plot from there to end, so Stack<->Line transitions work
-    for (i = 0; i < existingItemCount; i++)
-	samplingItem(i)->truncateData(size);
-
+    // No need to pad the data of existing plot items for Stack<->Line
+    // transitions, samples beyond those an item has are missing (NaN)
     return item;
 }
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2018, Red Hat.
+ * Copyright (c) 2012-2018,2026, Red Hat.
  * Copyright (c) 2012, Nathan Scott.  All Rights Reserved.
  * Copyright (c) 2007, Aconex.  All Rights Reserved.
  * 
@@ -20,6 +20,7 @@
 #include <qwt_plot.h>
 #include <qwt_plot_curve.h>
 #include <qwt_scale_engine.h>
+#include <qmc_store.h>
 #include "chart.h"
 
 class SamplingCurve : public ChartCurve
@@ -62,20 +63,26 @@ public:
     void copyRawDataPoint(int index);
     void copyDataPoint(int index);
     int maximumDataCount(int maximum);
-    void truncateData(int offset);
     double sumData(int index, double sum);
     void setPlotUtil(int index, double sum);
     double setPlotStack(int index, double sum);
     double setDataStack(int index, double sum);
 
 private:
+    double data(int index) const;
+    double &plotData(int index) { return my.itemData[my.store->slot(index)]; }
+    void setUnits(const pmUnits *units);
+
     struct {
 	Chart *chart;
 	SamplingCurve *curve;
 	QString info;
 	double scale;
-	QVector<double> data;
-	QVector<double> itemData;
+	double factor;		// metric units to chart units, times scale
+	pmUnits units;		// chart units that factor converts to
+	bool rateConvert;
+	QmcValueStore *store;	// shared sample values for the group
+	QVector<double> itemData;	// plotted values, indexed by store slot
 	QVector<QPointF> samples;
 	int dataCount;
     } my;
@@ -19,6 +19,7 @@
 #include "stats.h"
 #include "pmcd/src/pmcd.h"
 #include "pmcd/src/client.h"
+#include "pmlogger/src/logstats.h"
 #include <sys/stat.h>
 #if defined(IS_SOLARIS)
 #include <sys/systeminfo.h>
@@ -138,6 +139,8 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(1,23), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
 /* pdu_in.descs */
     { PMDA_PMID(1,24), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pdu_in.delta_result */
+    { PMDA_PMID(1,25), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
 
 /* pdu_out.error */
     { PMDA_PMID(2,0), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
@@ -187,6 +190,8 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(2,23), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
 /* pdu_out.descs */
     { PMDA_PMID(2,24), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pdu_out.delta_result */
+    { PMDA_PMID(2,25), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
 
 /* pmlogger.port */
     { PMDA_PMID(3,0), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
@@ -196,6 +201,16 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(3,2), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
 /* pmlogger.host */
     { PMDA_PMID(3,3), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
+/* pmlogger.write.bufsize */
+    { PMDA_PMID(3,4), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(1,0,0,PM_SPACE_BYTE,0,0) },
+/* pmlogger.write.records */
+    { PMDA_PMID(3,5), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pmlogger.write.bytes */
+    { PMDA_PMID(3,6), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(1,0,0,PM_SPACE_BYTE,0,0) },
+/* pmlogger.write.flushes */
+    { PMDA_PMID(3,7), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pmlogger.write.batch_max */
+    { PMDA_PMID(3,8), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_INSTANT, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
 
 /* agent.type */
     { PMDA_PMID(4,0), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
@@ -226,6 +241,12 @@ static pmDesc	desctab[] = {
     { PMDA_PMID(5,8), PM_TYPE_FLOAT, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,-1,1,0,PM_TIME_SEC,PM_COUNT_ONE) },
 /* pmie.eval.actual */
     { PMDA_PMID(5,9), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pmie.eval.late */
+    { PMDA_PMID(5,10), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,0,1,0,0,PM_COUNT_ONE) },
+/* pmie.eval.late_max */
+    { PMDA_PMID(5,11), PM_TYPE_U32, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,1,0,0,PM_TIME_MSEC,0) },
+/* pmie.eval.lateness */
+    { PMDA_PMID(5,12), PM_TYPE_U64, PM_INDOM_NULL, PM_SEM_COUNTER, PMDA_PMUNITS(0,1,0,0,PM_TIME_MSEC,0) },
 
 /* client.whoami */
     { PMDA_PMID(6,0), PM_TYPE_STRING, PM_INDOM_NULL, PM_SEM_DISCRETE, PMDA_PMUNITS(0,0,0,0,0,0) },
@@ -547,7 +568,8 @@ refresh_pmie_indom(void)
 				fullpath, osstrerror());
 		    continue;
 		}
-		if (statbuf.st_size != sizeof(pmiestats_t))
+		if (statbuf.st_size != sizeof(pmiestats_t) &&
+		    statbuf.st_size != PMIE_STATS_V1_SIZE)
 		    continue;
 		if  ((endp = strdup(dp->d_name)) == NULL) {
 		    pmNoMem("pmie iname", strlen(dp->d_name), PM_RECOV_ERR);
@@ -573,7 +595,8 @@ refresh_pmie_indom(void)
 		    free(endp);
 		    continue;
 		}
-		else if (((pmiestats_t *)ptr)->version != 1) {
+		else if (((pmiestats_t *)ptr)->version != 1 &&
+			 ((pmiestats_t *)ptr)->version != 2) {
 		    pmNotifyErr(LOG_WARNING, "incompatible pmie version: %s",
 				fullpath);
 		    __pmMemoryUnmap(ptr, statbuf.st_size);
@@ -1330,6 +1353,39 @@ fetch_client_metric(int item, ClientInfo *cp)
     return NULL;
 }
 
+/*
+ * Read the write instrumentation file for a pmlogger, see
+ * pmlogger/src/buffer.c ... if none, report zeroes.  The
+ * primary pmlogger instance (pid 0) is found by its port.
+ */
+static void
+logger_stats(__pmLogPort *lpp, int nports, int j, pmloggerstats_t *lsp)
+{
+    char	path[MAXPATHLEN];
+    int		sep = pmPathSeparator();
+    int		pid = lpp[j].pid;
+    int		k, fd;
+
+    memset(lsp, 0, sizeof(*lsp));
+    if (pid == PM_LOG_PRIMARY_PID) {
+	for (k = 0; k < nports; k++) {
+	    if (lpp[k].pid != PM_LOG_PRIMARY_PID && lpp[k].port == lpp[j].port) {
+		pid = lpp[k].pid;
+		break;
+	    }
+	}
+	if (k == nports)
+	    return;
+    }
+    pmsprintf(path, sizeof(path), "%s%c%s%c%d",
+	     pmGetConfig("PCP_TMP_DIR"), sep, PMLOGGER_STATS_SUBDIR, sep, pid);
+    if ((fd = open(path, O_RDONLY)) < 0)
+	return;
+    if (read(fd, lsp, sizeof(*lsp)) != sizeof(*lsp) || lsp->version != 1)
+	memset(lsp, 0, sizeof(*lsp));
+    close(fd);
+}
+
 static int
 pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 {
@@ -1348,6 +1404,7 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
     pmDesc		*dp = NULL;	/* initialize to pander to gcc */
     pmAtomValue		atom;
     __pmLogPort		*lpp;
+    pmloggerstats_t	lstats;
 
     if (numpmid > maxnpmids) {
 	if (res != NULL)
@@ -1599,7 +1656,7 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 			atom.ul = __pmPDUCntOut[item-1];
 		    break;
 
-	    case 3:	/* pmlogger control port, pmcd_host, archive and host */
+	    case 3:	/* pmlogger control port, pmcd_host, archive, host, write.* */
 		    /* find all ports.  localhost => no recursive pmcd access */
 		    nports = __pmLogFindPort("localhost", PM_LOG_ALL_PIDS, &lpp);
 		    if (nports < 0) {
@@ -1637,6 +1694,26 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 				    host = hostnameinfo();
                                 atom.cp = host;
 				break;
+			    case 4:		/* pmlogger.write.bufsize */
+				logger_stats(lpp, nports, j, &lstats);
+				atom.ul = lstats.bufsize;
+				break;
+			    case 5:		/* pmlogger.write.records */
+				logger_stats(lpp, nports, j, &lstats);
+				atom.ull = lstats.records;
+				break;
+			    case 6:		/* pmlogger.write.bytes */
+				logger_stats(lpp, nports, j, &lstats);
+				atom.ull = lstats.bytes;
+				break;
+			    case 7:		/* pmlogger.write.flushes */
+				logger_stats(lpp, nports, j, &lstats);
+				atom.ull = lstats.flushes;
+				break;
+			    case 8:		/* pmlogger.write.batch_max */
+				logger_stats(lpp, nports, j, &lstats);
+				atom.ul = lstats.batch_max;
+				break;
 			    default:
 				sts = atom.l = PM_ERR_PMID;
 				break;
@@ -1753,6 +1830,15 @@ pmcd_fetch(int numpmid, pmID pmidlist[], pmResult **resp, pmdaExt *pmda)
 			case 9:		/* pmie.eval.actual */
 			    atom.ul = pmie->eval_actual;
 			    break;
+			case 10:	/* pmie.eval.late */
+			    atom.ul = pmie->version > 1 ? pmie->eval_late : 0;
+			    break;
+			case 11:	/* pmie.eval.late_max */
+			    atom.ul = pmie->version > 1 ? pmie->late_max : 0;
+			    break;
+			case 12:	/* pmie.eval.lateness */
+			    atom.ull = pmie->version > 1 ? pmie->lateness : 0;
+			    break;
 			default:
 			    sts = atom.l = PM_ERR_PMID;
 			    break;
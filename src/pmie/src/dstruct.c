@@ -68,6 +68,7 @@ int		systemd;			/* systemd mode, notify service manager */
 int		agent;				/* secret agent mode? */
 int		applet;				/* applet mode? */
 int		dowrap;				/* counter wrap? default no */
+int		fetchthreads = 1;		/* concurrent per-host fetch threads */
 int		doexit;				/* time to exit stage left? */
 int		dorotate;			/* is a log rotation pending? */
 int		inrun;				/* parsing done, in run() */
@@ -320,12 +321,11 @@ sleepTight(Task *t)
  * value
  ***********************************************************************/
 
-void
-newRingBfr(Expr *x)
+/* size of the values for one sample in the ring buffer */
+size_t
+ringSize(Expr *x)
 {
     size_t  sz;
-    char    *p;
-    int     i;
 
     switch (x->sem) {
 
@@ -342,8 +342,18 @@ newRingBfr(Expr *x)
 	    break;
     }
 
-    sz *= x->tspan;
-    if (x->ring) free(x->ring);
+    return sz * x->tspan;
+}
+
+void
+newRingBfr(Expr *x)
+{
+    size_t  sz = ringSize(x);
+    char    *p;
+    int     i;
+
+    if (x->ring && !x->packed) free(x->ring);
+    x->packed = 0;
     x->ring = zalloc(x->nsmpls * sz);
     p = (char *)x->ring;
     for (i = 0; i < x->nsmpls; i++) {
@@ -361,8 +371,9 @@ newStringBfr(Expr *x, size_t length, char *bfr)
 	x->tspan = (int)length;
 	x->nvals = (int)length;
     }
-    if (x->ring)
+    if (x->ring && !x->packed)
 	free(x->ring);
+    x->packed = 0;
     x->ring = bfr;
     x->smpls[0].ptr = (void *) bfr;
 }
@@ -712,7 +723,10 @@ freeExpr(Expr *x)
 	     */
 	    free(x->metrics);
 	}
-	if (x->ring) free(x->ring);
+	if (x->ring && !x->packed) free(x->ring);
+	if (x->prog) free(x->prog);
+	/* after the operands, whose rings may be within the block */
+	if (x->block) free(x->block);
 	free(x);
     }
 }
@@ -1378,6 +1392,10 @@ dumpTask(Task *t)
 	fputc('\n', stderr);
 	    fprintf(stderr, "  via=%s (%s)\n", symName(h->conn), h->down ? "down" : "up");
     }
+    fprintf(stderr, "  lateness: max=%.3f histogram=", t->late_max);
+    for (i = 0; i < PMIE_LATE_BUCKETS; i++)
+	fprintf(stderr, "%s%u", i ? "," : "", t->late[i]);
+    fputc('\n', stderr);
     fprintf(stderr, "  rules:\n");
     for (i = 0; i < t->nrules; i++) {
 	fprintf(stderr, "    %s\n", symName(t->rules[i]));
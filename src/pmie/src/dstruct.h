@@ -125,6 +125,15 @@ typedef struct expr {
     int   	    sem;	/* value semantics, see below */
     pmUnits	    units;	/* value units, as in pmDesc */
 
+    /* flattened evaluation, see compileRules() */
+    struct expr	    **prog;	/* postorder operators, evaluated in turn */
+    int		    nprog;	/* number of operators in prog */
+    int		    nref;	/* number of references to this Expr */
+    void	    *block;	/* packed value block of prog, owned here */
+    unsigned int    flat : 1;	/* evaluated by an enclosing prog */
+    unsigned int    packed : 1;	/* ring is within a prog's value block */
+    unsigned int    kern : 4;	/* inline kernel in an enclosing prog */
+
     /* value buffer */
     void    	    *ring;	/* base address of value ring buffer */
     Sample	    smpls[1];	/* array dynamically allocated */
@@ -198,6 +207,7 @@ typedef struct host {
     Symbol          name;       /* host machine */
     Symbol          conn;       /* host machine connection */
     int	    	    down;	/* host is not delivering metrics */
+    int		    status;	/* first pmFetch error from last taskFetch */
     Metric	    *waits;	/* wait list of Metrics */
     Metric          *duds;	/* bad Metrics discovered during evaluation */
 } Host;
@@ -216,6 +226,9 @@ typedef struct task {
     Symbol	  *rules;	/* array of rules to be evaluated */
     Host          *hosts;	/* fetches to be executed and waiting */
     __pmResult	  *rslt;	/* for secret agent mode */
+    unsigned int  sched;	/* enqueue order, breaks eval time ties */
+    RealTime	  late_max;	/* maximum evaluation lateness */
+    unsigned int  late[PMIE_LATE_BUCKETS];	/* lateness histogram */
 } Task;
 
 /* value semantics - as in pmDesc plus following */
@@ -345,6 +358,7 @@ void freeTask(Task *);
  * ring buffer management
  ***********************************************************************/
 
+size_t ringSize(Expr *);
 void newRingBfr(Expr *);
 void newStringBfr(Expr *, size_t, char *);
 void rotate(Expr *);
@@ -412,6 +426,7 @@ extern int	   systemd;	/* systemd mode, notify service manager */
 extern int         agent;	/* secret agent mode? */
 extern int         applet;	/* applet mode? */
 extern int	   dowrap;	/* counter wrap? default no */
+extern int	   fetchthreads; /* concurrent per-host fetch threads */
 extern int	   doexit;	/* signalled its time to exit */
 extern int	   dorotate;	/* log rotation was requested */
 extern int	   inrun;	/* parsing done, in run() */
@@ -31,37 +31,87 @@
  * scheduling
  ***********************************************************************/
 
+/*
+ * Tasks awaiting evaluation are held in a binary min-heap ordered by
+ * scheduled evaluation time, so enqueue and dequeue are O(log n) in
+ * the number of Tasks.  Ties go to the most recently enqueued Task,
+ * the same order that insertion into a sorted task list produced.
+ */
+static Task	**heap;		/* heap[0] is the next Task due */
+static int	nheap;
+static int	maxheap;
+static unsigned int sequence;	/* enqueue order */
+
+/* is Task a due for evaluation ahead of Task b? */
+static int
+before(Task *a, Task *b)
+{
+    if (a->eval != b->eval)
+	return a->eval < b->eval;
+    return (int)(a->sched - b->sched) > 0;
+}
+
 /* enter Task into task queue */
 static void
 enque(Task *t)
 {
-    Task	*q;
-
-    q = taskq;
-    if (q == NULL) {
-	taskq = t;
-	t->next = NULL;
-	t->prev = NULL;
-    }
-    else {
-	while (q) {
-	    if (t->eval <= q->eval) {
-		t->next = q;
-		t->prev = q->prev;
-		if (q->prev) q->prev->next = t;
-		else taskq = t;
-		q->prev = t;
-		break;
-	    }
-	    if (q->next == NULL) {
-		q->next = t;
-		t->next = NULL;
-		t->prev = q;
-		break;
-	    }
-	    q = q->next;
-	}
+    int		i, parent;
+
+    if (nheap == maxheap) {
+	maxheap = maxheap ? maxheap * 2 : 32;
+	heap = (Task **)ralloc(heap, maxheap * sizeof(Task *));
+    }
+    t->sched = sequence++;
+    for (i = nheap++; i > 0; i = parent) {
+	parent = (i - 1) / 2;
+	if (!before(t, heap[parent]))
+	    break;
+	heap[i] = heap[parent];
     }
+    heap[i] = t;
+}
+
+/* remove the next Task due from task queue */
+static Task *
+deque(void)
+{
+    Task	*t, *tail;
+    int		i, child;
+
+    t = heap[0];
+    tail = heap[--nheap];
+    for (i = 0; (child = 2 * i + 1) < nheap; i = child) {
+	if (child + 1 < nheap && before(heap[child + 1], heap[child]))
+	    child++;
+	if (!before(heap[child], tail))
+	    break;
+	heap[i] = heap[child];
+    }
+    heap[i] = tail;
+    return t;
+}
+
+/* account for the delay between scheduled and actual evaluation */
+static void
+lateness(Task *t, RealTime late)
+{
+    RealTime	bound = 0.001;
+    int		i;
+
+    if (late < 0)
+	late = 0;
+    for (i = 0; i < PMIE_LATE_BUCKETS - 1 && late >= bound; i++)
+	bound *= 10;
+    t->late[i]++;
+    if (late > t->late_max)
+	t->late_max = late;
+
+    perf->late_hist[i]++;
+    if (i > 0)
+	perf->eval_late++;
+    perf->lateness += (unsigned long long)(late * 1000);
+    if (late * 1000 > perf->late_max)
+	perf->late_max = (unsigned int)(late * 1000);
 }
 
 
@@ -198,6 +248,69 @@ enable(Task *t)
 
 int	showTimeFlag = 0;	/* set when -e used on the command line */
 
+static char	*ruledone;	/* rules of current Task already evaluated */
+static int	rulemax;	/* allocated size of ruledone */
+
+/* evaluate a rule expression */
+static void
+evalRule(Expr *x)
+{
+    curr = x;
+    if (curr->op < NOP) {
+	if (curr->prog)
+	    evalProg(curr);
+	else
+	    (curr->eval)(curr);
+	perf->eval_actual++;
+    }
+}
+
+/*
+ * find the one Host all Metrics in an expression are fetched from,
+ * returns 0 if the expression refers to more than one Host
+ */
+static int
+exprHost(Expr *x, Host **hp)
+{
+    Metric	*m;
+    int		i;
+
+    if (x == NULL)
+	return 1;
+    if (x->op == CND_FETCH) {
+	for (m = x->metrics, i = 0; i < x->hdom; m++, i++) {
+	    if (*hp == NULL)
+		*hp = m->host;
+	    else if (*hp != m->host)
+		return 0;
+	}
+	return 1;
+    }
+    return exprHost(x->arg1, hp) && exprHost(x->arg2, hp);
+}
+
+/*
+ * called as each Host's concurrent fetch completes - evaluate now
+ * the rules that refer only to that Host, rather than waiting for
+ * the slowest Host in the Task
+ */
+static void
+hostReady(Task *task, Host *h)
+{
+    Symbol	*s;
+    Host	*rh;
+    int		i;
+
+    s = task->rules;
+    for (i = 0; i < task->nrules; i++, s++) {
+	rh = NULL;
+	if (ruledone[i] || !exprHost(symValue(*s), &rh) || rh != h)
+	    continue;
+	evalRule(symValue(*s));
+	ruledone[i] = 1;
+    }
+}
+
 /* evaluate Task */
 static void
 eval(Task *task)
@@ -211,17 +324,21 @@ eval(Task *task)
 	dumpTask(task);
     }
 
-    /* fetch metrics */
-    taskFetch(task);
+    if (task->nrules > rulemax) {
+	rulemax = task->nrules;
+	ruledone = (char *) ralloc(ruledone, rulemax);
+    }
+    if (task->nrules > 0)
+	memset(ruledone, 0, task->nrules);
 
-    /* evaluate rule expressions */
+    /* fetch metrics, single Host rules may be evaluated as Hosts complete */
+    taskFetch(task, hostReady);
+
+    /* evaluate remaining rule expressions, in order */
     s = task->rules;
     for (i = 0; i < task->nrules; i++) {
-	curr = symValue(*s);
-	if (curr->op < NOP) {
-	    (curr->eval)(curr);
-	    perf->eval_actual++;
-	}
+	if (!ruledone[i])
+	    evalRule(symValue(*s));
 	s++;
     }
 
@@ -319,6 +436,280 @@ clobber(Expr *x)
     }
 }
 
+/***********************************************************************
+ * flattened evaluation
+ *
+ * Before the first evaluation, each maximal subtree of operators that
+ * evaluate all of their operands unconditionally (everything except
+ * rules, rulesets and actions) is lowered into an array of its Exprs
+ * in postorder, held by the subtree root.  Running the array replaces
+ * the recursive descent through EVALARG (see fun.h) and the value
+ * rings of the subtree are repacked into one contiguous block, so
+ * evaluation walks memory in order; the block is owned by the subtree
+ * root and released with it in freeExpr().  The per-operator kernels
+ * are the arity-specialised ones chosen by findEval(), looked up
+ * through each Expr at run time so reshaping after a reconnect is
+ * still honoured.  The scalar (_1_1) arithmetic and relational
+ * kernels, by far the most common in rules, are expanded inline by
+ * evalProg() rather than called through the Expr.  Subtrees shared by
+ * more than one parent (boolean macros) are left as separate programs,
+ * so are still evaluated once per reference.  The APPL3 debug flag
+ * disables all of this, for comparison with recursive evaluation.
+ ***********************************************************************/
+
+/* operator evaluates all its operands first, unconditionally? */
+static int
+straight(Expr *x)
+{
+    if (x->op == CND_OR && x->arg1 != NULL && x->arg1->op == RULE)
+	/* ruleset clause list, walked by ruleset() itself */
+	return 0;
+    return x->op >= CND_FETCH && x->op < ACT_SEQ &&
+	   x->op != CND_RULESET && x->op != CND_OTHER;
+}
+
+/* scalar kernels expanded inline by evalProg(), indexed by Expr kern */
+#define K_CALL	0	/* not inline, call through Expr eval */
+#define K_ADD	1
+#define K_SUB	2
+#define K_MUL	3
+#define K_DIV	4
+#define K_EQ	5
+#define K_NEQ	6
+#define K_LT	7
+#define K_LTE	8
+#define K_GT	9
+#define K_GTE	10
+
+static Eval	*kernels[] = {
+    NULL,
+    cndAdd_1_1, cndSub_1_1, cndMul_1_1, cndDiv_1_1,
+    cndEq_1_1, cndNeq_1_1, cndLt_1_1, cndLte_1_1, cndGt_1_1, cndGte_1_1,
+};
+
+/* inline kernel for the current evaluator of x, if any */
+static unsigned int
+kernel(Expr *x)
+{
+    unsigned int	k;
+
+    for (k = K_CALL + 1; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+	if (x->eval == kernels[k])
+	    return k;
+    return K_CALL;
+}
+
+/* count references to each operator reachable from x */
+static void
+countRefs(Expr *x)
+{
+    if (x == NULL || x->op >= NOP)
+	return;
+    if (x->nref++ > 0)
+	return;
+    countRefs(x->arg1);
+    countRefs(x->arg2);
+}
+
+static void compile(Expr *);
+
+/* append x and its unshared straight operands to the program of root */
+static void
+lower(Expr *root, Expr *x)
+{
+    Expr	*arg;
+    int		i;
+
+    for (i = 0; i < 2; i++) {
+	arg = (i == 0) ? x->arg1 : x->arg2;
+	if (arg == NULL || arg->op >= NOP)
+	    continue;
+	if (straight(arg) && arg->nref == 1 && arg->parent == x) {
+	    arg->flat = 1;
+	    lower(root, arg);
+	}
+	else
+	    compile(arg);
+    }
+    root->prog = (Expr **) ralloc(root->prog, (root->nprog + 1) * sizeof(Expr *));
+    root->prog[root->nprog++] = x;
+    x->kern = kernel(x);
+}
+
+/* repack value rings of the operators in a program into one block */
+static void
+pack(Expr *root)
+{
+    Expr	*x;
+    size_t	sz;
+    size_t	total = 0;
+    char	*block;
+    char	*base;
+    int		i, j;
+
+    for (i = 0; i < root->nprog; i++) {
+	x = root->prog[i];
+	sz = x->nsmpls * ringSize(x);
+	x->packed = 0;
+	if (x->ring == NULL || sz == 0)
+	    continue;
+	/* only rings laid out by newRingBfr() can be safely moved */
+	for (j = 0; j < x->nsmpls; j++) {
+	    if ((char *)x->smpls[j].ptr < (char *)x->ring ||
+		(char *)x->smpls[j].ptr >= (char *)x->ring + sz)
+		break;
+	}
+	if (j < x->nsmpls)
+	    continue;
+	x->packed = 1;
+	total += (sz + sizeof(double) - 1) & ~(sizeof(double) - 1);
+    }
+    if (total == 0)
+	return;
+
+    block = base = (char *) zalloc(total);
+    root->block = base;
+    for (i = 0; i < root->nprog; i++) {
+	x = root->prog[i];
+	if (!x->packed)
+	    continue;
+	sz = x->nsmpls * ringSize(x);
+	memcpy(block, x->ring, sz);
+	for (j = 0; j < x->nsmpls; j++)
+	    x->smpls[j].ptr = block + ((char *)x->smpls[j].ptr - (char *)x->ring);
+	free(x->ring);
+	x->ring = block;
+	block += (sz + sizeof(double) - 1) & ~(sizeof(double) - 1);
+    }
+    if (pmDebugOptions.appl1)
+	fprintf(stderr, "pack: prog " PRINTF_P_PFX "%p %zd value bytes at " PRINTF_P_PFX "%p\n",
+		root, total, base);
+}
+
+/* build programs for all straight subtrees reachable from x */
+static void
+compile(Expr *x)
+{
+    if (x == NULL || x->op >= NOP || x->flat || x->prog != NULL)
+	return;
+    if (!straight(x)) {
+	compile(x->arg1);
+	compile(x->arg2);
+	return;
+    }
+    lower(x, x);
+    if (x->nprog == 1) {
+	/* lone operator, nothing to be gained */
+	free(x->prog);
+	x->prog = NULL;
+	x->nprog = 0;
+	return;
+    }
+    pack(x);
+    if (pmDebugOptions.appl1) {
+	fprintf(stderr, "compile: prog " PRINTF_P_PFX "%p with %d operators\n",
+		x, x->nprog);
+    }
+}
+
+/* lower all rule expressions into flattened programs */
+static void
+compileRules(void)
+{
+    Task	*t;
+    int		i;
+
+    if (pmDebugOptions.appl3)
+	return;
+
+    for (t = taskq; t != NULL; t = t->next) {
+	for (i = 0; i < t->nrules; i++)
+	    countRefs(symValue(t->rules[i]));
+    }
+    for (t = taskq; t != NULL; t = t->next) {
+	for (i = 0; i < t->nrules; i++)
+	    compile(symValue(t->rules[i]));
+    }
+}
+
+/*
+ * evaluate the operators of a flattened program in order - the inline
+ * kernels match the @FUN_1_1 skeleton in binary.sk, and are bypassed
+ * if the evaluator has changed since compile() or when tracing
+ */
+void
+evalProg(Expr *x)
+{
+    Expr	**p = x->prog;
+    Expr	**end = p + x->nprog;
+    Expr	*arg1;
+    Expr	*arg2;
+    Sample	*is1;
+    Sample	*is2;
+    Sample	*os;
+    double	iv1;
+    double	iv2;
+
+    for ( ; p < end; p++) {
+	x = *p;
+	if (x->kern == K_CALL || x->eval != kernels[x->kern] ||
+	    pmDebugOptions.appl2) {
+	    (x->eval)(x);
+	    continue;
+	}
+
+	arg1 = x->arg1;
+	arg2 = x->arg2;
+	EVALARG(arg1)
+	EVALARG(arg2)
+	ROTATE(x)
+
+	if (arg1->valid && arg2->valid) {
+	    is1 = &arg1->smpls[0];
+	    is2 = &arg2->smpls[0];
+	    os = &x->smpls[0];
+	    iv1 = *(double *)is1->ptr;
+	    iv2 = *(double *)is2->ptr;
+	    switch (x->kern) {
+	    case K_ADD:
+		*(double *)os->ptr = iv1 + iv2;
+		break;
+	    case K_SUB:
+		*(double *)os->ptr = iv1 - iv2;
+		break;
+	    case K_MUL:
+		*(double *)os->ptr = iv1 * iv2;
+		break;
+	    case K_DIV:
+		*(double *)os->ptr = iv1 / iv2;
+		break;
+	    case K_EQ:
+		*(Boolean *)os->ptr = (iv1 == iv2);
+		break;
+	    case K_NEQ:
+		*(Boolean *)os->ptr = (iv1 != iv2);
+		break;
+	    case K_LT:
+		*(Boolean *)os->ptr = (iv1 < iv2);
+		break;
+	    case K_LTE:
+		*(Boolean *)os->ptr = (iv1 <= iv2);
+		break;
+	    case K_GT:
+		*(Boolean *)os->ptr = (iv1 > iv2);
+		break;
+	    case K_GTE:
+		*(Boolean *)os->ptr = (iv1 >= iv2);
+		break;
+	    }
+	    os->stamp = (is1->stamp > is2->stamp) ? is1->stamp : is2->stamp;
+	    x->valid++;
+	}
+	else x->valid = 0;
+    }
+}
+
+
 /***********************************************************************
  * exported functions
  ***********************************************************************/
@@ -836,6 +1227,10 @@ run(void)
 
     inrun = 1;
 
+    /* interactive mode may add rules between runs, so stay recursive */
+    if (!interactive)
+	compileRules();
+
     /* initialize task scheduling */
     t = taskq;
     while (t) {
@@ -845,16 +1240,25 @@ run(void)
 	else
 	    t->retry = 0;
 	t->tick = 0;
+	if (t->next == NULL)
+	    break;
 	t = t->next;
     }
 
+    /* enqueue from the tail, so taskq order breaks the initial ties */
+    nheap = 0;
+    for (; t != NULL; t = t->prev)
+	enque(t);
+
     /* evaluate and reschedule */
-    t = taskq;
     for (;;) {
+	t = deque();
 	now = t->eval;
 	if (now > stop)
 	    break;
 	sleepTight(t);
+	if (!archives)
+	    lateness(t, getReal() - t->eval);
 	if (t->retry)
 	    enable(t);
 	reflectTime(t->delta);
@@ -898,10 +1302,7 @@ run(void)
 		t->eval = now + t->delta;
 	    }
 	}
-	taskq = t->next;
-	if (taskq) taskq->prev = NULL;
 	enque(t);
-	t = taskq;
     }
 
     if (!quiet)
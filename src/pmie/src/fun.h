@@ -25,7 +25,12 @@
 #include "andor.h"
 
 #define ROTATE(x)  if ((x)->nsmpls > 1) rotate(x);
-#define EVALARG(x) if ((x)->op < NOP) ((x)->eval)(x);
+#define EVALARG(x) if ((x)->op < NOP && !(x)->flat) { \
+			if ((x)->prog) evalProg(x); else ((x)->eval)(x); }
+
+/* evaluate a flattened program, see compileRules() in eval.c */
+void evalProg(Expr *);
+
 
 /* expression evaluator function prototypes */
 void rule(Expr *);
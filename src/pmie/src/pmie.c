@@ -101,6 +101,7 @@ static pmLongOptions longopts[] = {
     { "", 0, 'H', NULL }, /* was: no DNS lookup on the default hostname */
     { "", 1, 'j', "FILE", "stomp protocol (JMS) file" },
     { "logfile", 1, 'l', "FILE", "send status and error messages to FILE" },
+    { "fetch-threads", 1, 'N', "N", "fetch from up to N hosts concurrently [default 1]" },
     { "username", 1, 'U', "USER", "run as named USER in daemon mode [default pcp]" },
     PMAPI_OPTIONS_HEADER("Reporting options"),
     { "buffer", 0, 'b', 0, "one line buffered output stream, stdout on stderr" },
@@ -116,7 +117,7 @@ static pmLongOptions longopts[] = {
 
 static pmOptions opts = {
     .flags = PM_OPTFLAG_STDOUT_TZ,
-    .short_options = "a:A:bc:CdD:efFHh:j:l:n:O:PqS:t:T:U:vVWXxzZ:?",
+    .short_options = "a:A:bc:CdD:efFHh:j:l:n:N:O:PqS:t:T:U:vVWXxzZ:?",
     .long_options = longopts,
     .short_usage = "[options] [filename ...]",
     .override = override,
@@ -379,7 +380,7 @@ startmonitor(void)
     strncpy(perf->defaultfqdn, "(uninitialized)", sizeof(perf->defaultfqdn));
     perf->defaultfqdn[sizeof(perf->defaultfqdn)-1] = '\0';
 
-    perf->version = 1;
+    perf->version = 2;
 }
 
 
@@ -473,6 +474,7 @@ getargs(int argc, char *argv[])
     char		*subopts;
     char		*subopt;
     char		*msg = NULL;
+    char		*endnum;
     int			checkFlag = 0;
     int			foreground = 0;
     int			primary = 0;
@@ -590,6 +592,15 @@ getargs(int argc, char *argv[])
 	    isdaemon = 1;
 	    break;
 
+	case 'N':			/* concurrent host fetches */
+	    fetchthreads = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || fetchthreads < 1) {
+		pmprintf("%s: -N requires a positive numeric argument\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
 	case 'U': 			/* run as named user */
 	    username = opts.optarg;
 	    isdaemon = 1;
@@ -44,7 +44,9 @@ main(int argc, char **argv)
 	    fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
 	    return 1;
 	}
-	if ((sts = read(fd, &stats, sizeof(stats))) != sizeof(stats)) {
+	memset(&stats, 0, sizeof(stats));
+	if ((sts = read(fd, &stats, sizeof(stats))) != sizeof(stats) &&
+	    sts != PMIE_STATS_V1_SIZE) {
 	    fprintf(stderr, "%s: read %d != %d as expected\n", argv[1], sts, (int)sizeof(stats));
 	}
 	else {
@@ -74,6 +76,15 @@ main(int argc, char **argv)
 	    printf("%s:eval_unknown=%d\n", p, stats.eval_unknown);
 	    printf("%s:eval_actual=%d\n", p, stats.eval_actual);
 	    printf("%s:version=%d\n", p, stats.version);
+	    if (stats.version > 1) {
+		int	i;
+
+		printf("%s:eval_late=%u\n", p, stats.eval_late);
+		printf("%s:late_max=%u\n", p, stats.late_max);
+		printf("%s:lateness=%llu\n", p, stats.lateness);
+		for (i = 0; i < PMIE_LATE_BUCKETS; i++)
+		    printf("%s:late_hist[%d]=%u\n", p, i, stats.late_hist[i]);
+	    }
 	}
 	argc--;
 	argv++;
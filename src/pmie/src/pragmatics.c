@@ -36,6 +36,9 @@
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 extern char	*clientid;
 
@@ -1012,90 +1015,224 @@ mark_all(Host *hdown)
     }
 }
 
-/* execute fetches for given Task */
-void
-taskFetch(Task *t)
+/*
+ * execute fetches for a single Host, then sort and distribute the
+ * pmValueSets to requesting Metrics - only touches state belonging
+ * to this Host, so may be run concurrently for different Hosts;
+ * returns the first pmFetch failure (live mode) for the caller to
+ * report, and leaves subsequent Fetches for this Host unfetched
+ */
+static int
+hostFetch(Host *h)
 {
-    Host	*h;
     Fetch	*f;
     Profile	*p;
     Metric	*m;
     pmResult	*r;
     pmValueSet	**v;
     int		i;
-    int		sts;
+    int		sts = 0;
 
-    /* do all fetches, quick as you can */
-    h = t->hosts;
-    while (h) {
-	f = h->fetches;
-	while (f) {
-	    if (f->result) pmFreeResult(f->result);
-	    if (! h->down) {
-		pmUseContext(f->handle);
-		if ((sts = pmFetch(f->npmids, f->pmids, &f->result)) < 0) {
-		    if (archives) {
-			if (sts == PM_ERR_LOGREC) {
-			    fprintf(stderr, "%s: pmFetch failed: %s\n", pmGetProgname(),
-				    pmErrStr(sts));
-			    exit(1);
-			}
-		    }
-		    else {
-			pmNotifyErr(LOG_ERR, "pmFetch from %s failed: %s\n",
-				symName(f->host->name), pmErrStr(sts));
-			host_state_changed(symName(f->host->conn), STATE_LOSTCONN);
-			h->down = 1;
-			mark_all(h);
+    f = h->fetches;
+    while (f) {
+	if (f->result) pmFreeResult(f->result);
+	f->result = NULL;
+	if (! h->down && sts >= 0) {
+	    pmUseContext(f->handle);
+	    if ((sts = pmFetch(f->npmids, f->pmids, &f->result)) < 0) {
+		f->result = NULL;
+		if (archives) {
+		    if (sts == PM_ERR_LOGREC) {
+			fprintf(stderr, "%s: pmFetch failed: %s\n", pmGetProgname(),
+				pmErrStr(sts));
+			exit(1);
 		    }
-		    f->result = NULL;
+		    sts = 0;
 		}
 	    }
-	    else
-		f->result = NULL;
-	    f = f->next;
 	}
-	h = h->next;
+	f = f->next;
     }
+    if (h->down || sts < 0)
+	return sts;
 
     /* sort and distribute pmValueSets to requesting Metrics */
-    h = t->hosts;
-    while (h) {
-	if (! h->down) {
-	    f = h->fetches;
-	    while (f && (r = f->result)) {
-		/* sort all vlists in result r */
-		v = r->vset;
-		for (i = 0; i < r->numpmid; i++) {
-		    if ((*v)->numval > 0) {
-			qsort((*v)->vlist, (size_t)(*v)->numval,
-			      sizeof(pmValue), compair);
-		    }
-		    v++;
-		}
+    f = h->fetches;
+    while (f && (r = f->result)) {
+	/* sort all vlists in result r */
+	v = r->vset;
+	for (i = 0; i < r->numpmid; i++) {
+	    if ((*v)->numval > 0) {
+		qsort((*v)->vlist, (size_t)(*v)->numval,
+		      sizeof(pmValue), compair);
+	    }
+	    v++;
+	}
 
-		/* distribute pmValueSets to Metrics */
-		p = f->profiles;
-		while (p) {
-		    m = p->metrics;
-		    while (m) {
-			for (i = 0; i < r->numpmid; i++) {
-			    if (m->desc.pmid == r->vset[i]->pmid) {
-				if (r->vset[i]->numval > 0) {
-				    m->vset = r->vset[i];
-				    m->stamp = pmtimevalToReal(&r->timestamp);
-				}
-				break;
-			    }
+	/* distribute pmValueSets to Metrics */
+	p = f->profiles;
+	while (p) {
+	    m = p->metrics;
+	    while (m) {
+		for (i = 0; i < r->numpmid; i++) {
+		    if (m->desc.pmid == r->vset[i]->pmid) {
+			if (r->vset[i]->numval > 0) {
+			    m->vset = r->vset[i];
+			    m->stamp = pmtimevalToReal(&r->timestamp);
 			}
-			m = m->next;
+			break;
 		    }
-		    p = p->next;
 		}
-		f = f->next;
+		m = m->next;
 	    }
+	    p = p->next;
 	}
-	h = h->next;
+	f = f->next;
+    }
+    return 0;
+}
+
+/* report and mark a Host whose last fetch failed, from the main thread */
+static void
+hostCheck(Host *h)
+{
+    if (h->status < 0) {
+	pmNotifyErr(LOG_ERR, "pmFetch from %s failed: %s\n",
+		symName(h->name), pmErrStr(h->status));
+	host_state_changed(symName(h->conn), STATE_LOSTCONN);
+	h->down = 1;
+	h->status = 0;
+	mark_all(h);
+    }
+}
+
+#ifdef HAVE_PTHREAD_H
+/*
+ * Pool of fetch worker threads, started on first use.  Each worker
+ * claims the next Host from the current batch and runs hostFetch()
+ * for it, then queues the Host as ready.  The main thread takes each
+ * ready Host in completion order, so the rules for that Host can be
+ * evaluated while slower Hosts are still being fetched.  The PMAPI
+ * current context is per-thread, and each Host owns its own contexts.
+ */
+static pthread_mutex_t	poollock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	poolwork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	pooldone = PTHREAD_COND_INITIALIZER;
+static int		poolthreads;	/* number of running workers */
+static Host		**poolhosts;	/* Hosts in the current batch */
+static Host		**poolready;	/* fetched Hosts, completion order */
+static int		poolmax;	/* allocated size of poolhosts */
+static int		poolsize;	/* Hosts in the current batch */
+static int		poolnext;	/* next Host to be claimed */
+static int		poolnready;	/* Hosts fetched so far */
+
+static void *
+fetchWorker(void *arg)
+{
+    Host	*h;
+
+    (void)arg;
+    pthread_mutex_lock(&poollock);
+    for (;;) {
+	while (poolnext >= poolsize)
+	    pthread_cond_wait(&poolwork, &poollock);
+	h = poolhosts[poolnext++];
+	pthread_mutex_unlock(&poollock);
+
+	h->status = hostFetch(h);
+
+	pthread_mutex_lock(&poollock);
+	poolready[poolnready++] = h;
+	pthread_cond_signal(&pooldone);
+    }
+    return NULL;
+}
+
+/* start worker threads, returns number running (0 => fetch serially) */
+static int
+poolStart(void)
+{
+    pthread_t	tid;
+    int		sts;
+
+    while (poolthreads < fetchthreads) {
+	if ((sts = pthread_create(&tid, NULL, fetchWorker, NULL)) != 0) {
+	    pmNotifyErr(LOG_WARNING, "fetch thread create failed: %s\n",
+			pmErrStr(-sts));
+	    fetchthreads = poolthreads;
+	    break;
+	}
+	pthread_detach(tid);
+	poolthreads++;
+    }
+    return poolthreads;
+}
+
+/*
+ * fetch from all Hosts of a Task concurrently, calling ready() from
+ * the main thread for each Host as soon as its fetch completes
+ */
+static int
+poolFetch(Task *t, void (*ready)(Task *, Host *))
+{
+    Host	*h;
+    int		n = 0;
+    int		done;
+
+    for (h = t->hosts; h; h = h->next) {
+	if (n >= poolmax) {
+	    poolmax = poolmax ? poolmax * 2 : 8;
+	    poolhosts = (Host **) ralloc(poolhosts, poolmax * sizeof(Host *));
+	    poolready = (Host **) ralloc(poolready, poolmax * sizeof(Host *));
+	}
+	poolhosts[n++] = h;
+    }
+    if (n < 2 || poolStart() < 2)
+	return 0;
+
+    pthread_mutex_lock(&poollock);
+    poolsize = n;
+    poolnext = poolnready = 0;
+    pthread_cond_broadcast(&poolwork);
+    for (done = 0; done < n; done++) {
+	while (poolnready == done)
+	    pthread_cond_wait(&pooldone, &poollock);
+	h = poolready[done];
+	pthread_mutex_unlock(&poollock);
+
+	hostCheck(h);
+	if (ready)
+	    (*ready)(t, h);
+
+	pthread_mutex_lock(&poollock);
+    }
+    poolsize = poolnext = poolnready = 0;
+    pthread_mutex_unlock(&poollock);
+    return 1;
+}
+#endif
+
+/*
+ * execute fetches for given Task - when Hosts are fetched concurrently,
+ * ready() (if not NULL) is called for each Host as its fetch completes,
+ * otherwise Hosts are fetched serially and ready() is not called at all
+ */
+void
+taskFetch(Task *t, void (*ready)(Task *, Host *))
+{
+    Host	*h;
+
+#ifdef HAVE_PTHREAD_H
+    /* archives are replayed in order, so only live Hosts go concurrent */
+    if (!archives && fetchthreads > 1 && poolFetch(t, ready))
+	return;
+#else
+    (void)ready;
+#endif
+
+    for (h = t->hosts; h; h = h->next) {
+	h->status = hostFetch(h);
+	hostCheck(h);
     }
 }
 
@@ -65,7 +65,7 @@ int reconnect(Host *);
 void pragmatics(Symbol, RealTime);
 
 /* execute fetches for given Task */
-void taskFetch(Task *);
+void taskFetch(Task *, void (*)(Task *, Host *));
 
 /* convert Expr value to pmValueSet value */
 void fillVSet(Expr *, pmValueSet *);
@@ -16,10 +16,14 @@
 
 #include <sys/types.h>
 #include <sys/param.h>
+#include <stddef.h>
 
 /* subdir nested under PCP_TMP_DIR */
 #define PMIE_SUBDIR	"pmie"
 
+/* evaluation lateness histogram, bucket upper bounds 1ms to 10s, +Inf */
+#define PMIE_LATE_BUCKETS	6
+
 /* pmie performance instrumentation */
 typedef struct {
     char		config[MAXPATHLEN+1];
@@ -33,6 +37,14 @@ typedef struct {
     unsigned int	eval_unknown;		/* pmcd.pmie.eval.unknown  */
     unsigned int	eval_actual;		/* pmcd.pmie.eval.actual   */
     unsigned int	version;
+    /* version 2 */
+    unsigned int	eval_late;		/* pmcd.pmie.eval.late     */
+    unsigned int	late_max;		/* pmcd.pmie.eval.late_max */
+    unsigned long long	lateness;		/* pmcd.pmie.eval.lateness */
+    unsigned int	late_hist[PMIE_LATE_BUCKETS];
 } pmiestats_t;
 
+/* size of the (prefix) version 1 structure */
+#define PMIE_STATS_V1_SIZE	offsetof(pmiestats_t, eval_late)
+
 #endif /* STATS_H */
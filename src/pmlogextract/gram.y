@@ -141,10 +141,8 @@ dometric(const char *arg_name)
      * As we traverse the PMNS for every input archive, make sure the pmid
      * is not one we've seen before ...
      */
-    for (j=0; j<ml_numpmid; j++) {
-	if (pmid == ml[j].desc->pmid)
-	    return;
-    }
+    if (ml_lookup(pmid) >= 0)
+	return;
 
     if ((dp = (pmDesc *)malloc(sizeof(pmDesc))) == NULL) {
 	goto nomem;
@@ -290,8 +288,10 @@ dometric(const char *arg_name)
 	free(ml[ml_numpmid].instlist);
 	free(ml[ml_numpmid].name);
     }
-    else
+    else {
+	ml_hashadd(ml_numpmid);
 	ml_numpmid++;
+    }
     return;
 
 bad:
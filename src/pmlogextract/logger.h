@@ -58,6 +58,23 @@ typedef struct {
 extern inarch_t	*inarch;	/* input archive control(s) */
 extern int	inarchnum;	/* number of input archives */
 
+/*
+ *  One data record read (ahead) from an input archive, along with the
+ *  per-archive state from inarch_t as it was once that record had been
+ *  read ... sts is 0, else PM_ERR_EOL or the error that ended the archive
+ */
+typedef struct {
+    int			sts;
+    __pmResult		*_result;
+    __pmResult		*_Nresult;
+    __pmTimestamp	laststamp;
+    int			recnum;
+    int64_t		pmcd_pid;
+    int32_t		pmcd_seqnum;
+} logrec_t;
+
+extern int	readthreads;	/* -N, 1 => read inline, no threads */
+
 /*
  *  metric [instance] selection list
  */
@@ -124,6 +141,18 @@ extern void	dometric(const char *);
 extern void insertresult(rlist_t **, __pmResult *);
 extern __pmResult *searchmlist(__pmResult *);
 extern void abandon_extract(void);
+extern void readlog(int, logrec_t *);
+
+/* pmid and indom lookups for ml[] and skip_ml[], see metriclist.c */
+extern void ml_hashadd(int);
+extern int ml_lookup(pmID);
+extern int ml_indom(pmInDom);
+extern int skip_add(pmID);
+extern int skip_lookup(pmID);
+
+/* input archive read-ahead, see readahead.c */
+extern void readahead_start(void);
+extern void readahead_take(int, logrec_t *);
 
 /* command line args needed across source files */
 extern int	xarg;
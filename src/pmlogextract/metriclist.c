@@ -19,6 +19,76 @@
 #include "libpcp.h"
 #include "logger.h"
 
+static __pmHashCtl	ml_pmid;	/* pmid -> ml[] index + 1 */
+static __pmHashCtl	ml_indoms;	/* indoms of metrics in ml[] */
+static __pmHashCtl	skip_pmid;	/* pmids on skip_ml[] */
+
+/*
+ * add ml[j] to the pmid and indom hashes
+ */
+void
+ml_hashadd(int j)
+{
+    if (__pmHashAdd(ml[j].desc->pmid, (void *)(__psint_t)(j+1), &ml_pmid) < 0)
+	goto nomem;
+    if (__pmHashSearch(ml[j].desc->indom, &ml_indoms) == NULL &&
+	__pmHashAdd(ml[j].desc->indom, NULL, &ml_indoms) < 0)
+	goto nomem;
+    return;
+
+nomem:
+    fprintf(stderr, "%s: Error: cannot malloc space in \"ml_hashadd\".\n",
+	    pmGetProgname());
+    exit(1);
+}
+
+/*
+ * return index into ml[] for pmid, else -1
+ */
+int
+ml_lookup(pmID pmid)
+{
+    __pmHashNode	*hp;
+
+    if ((hp = __pmHashSearch(pmid, &ml_pmid)) == NULL)
+	return -1;
+    return (int)(__psint_t)hp->data - 1;
+}
+
+/*
+ * return 1 if indom is the instance domain of some metric in ml[]
+ */
+int
+ml_indom(pmInDom indom)
+{
+    return __pmHashSearch(indom, &ml_indoms) != NULL;
+}
+
+/*
+ * add pmid to the skip_ml[] hash, return 0 if it was already there
+ */
+int
+skip_add(pmID pmid)
+{
+    if (__pmHashSearch(pmid, &skip_pmid) != NULL)
+	return 0;
+    if (__pmHashAdd(pmid, NULL, &skip_pmid) < 0) {
+	fprintf(stderr, "%s: Error: cannot malloc space in \"skip_add\".\n",
+		pmGetProgname());
+	exit(1);
+    }
+    return 1;
+}
+
+/*
+ * return 1 if pmid is on skip_ml[]
+ */
+int
+skip_lookup(pmID pmid)
+{
+    return __pmHashSearch(pmid, &skip_pmid) != NULL;
+}
+
 rlist_t *
 mk_rlist_t(void)
 {
@@ -144,26 +214,19 @@ searchmlist(__pmResult *_Oresult)
     for (i=0; i<_Oresult->numpmid; i++) {
 	vsetp = _Oresult->vset[i];
 
-	for (j=0; j<skip_ml_numpmid; j++) {
-	    if (vsetp->pmid == skip_ml[j])
-		break;
-	}
-	if (j < skip_ml_numpmid) {
+	if (skip_ml_numpmid > 0 && skip_lookup(vsetp->pmid)) {
 	    /* on skip_ml[], don't need this one */
 	    continue;
 	}
 
 	if (ml != NULL) {
-	    for (j=0; j<ml_numpmid; j++) {
-		if (vsetp->pmid == ml[j].desc->pmid) {
-		    /* pmid in _Oresult and in metric list */
-		    ilist[numpmid] = i;	/* _Oresult index */
-		    jlist[numpmid] = j;	/* ml list index */
-		    numpmid++;
-		    if (ml[j].numinst > maxinst)
-			maxinst = ml[j].numinst;
-		    break;
-		}
+	    if ((j = ml_lookup(vsetp->pmid)) >= 0) {
+		/* pmid in _Oresult and in metric list */
+		ilist[numpmid] = i;	/* _Oresult index */
+		jlist[numpmid] = j;	/* ml list index */
+		numpmid++;
+		if (ml[j].numinst > maxinst)
+		    maxinst = ml[j].numinst;
 	    }
 	}
 	else {
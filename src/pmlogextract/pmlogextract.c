@@ -44,6 +44,7 @@ static pmLongOptions longopts[] = {
     { "desperate", 0, 'd', 0, "desperate, save output after fatal error" },
     { "first", 0, 'f', 0, "use timezone from first archive [default is last]" },
     { "mark", 0, 'm', 0, "ignore prologue/epilogue records and <mark> between archives" },
+    { "threads", 1, 'N', "N", "read ahead from input archives with N threads [default 4]" },
     PMOPT_START,
     { "samples", 1, 's', "NUM", "terminate after NUM log records have been written" },
     PMOPT_FINISH,
@@ -58,7 +59,7 @@ static pmLongOptions longopts[] = {
 };
 
 static pmOptions opts = {
-    .short_options = "c:D:dfmS:s:T:V:v:wxZ:z?",
+    .short_options = "c:D:dfmN:S:s:T:V:v:wxZ:z?",
     .long_options = longopts,
     .short_usage = "[options] input-archive output-archive",
 };
@@ -120,6 +121,7 @@ static __pmHashCtl	rindomtext;	/* indom text records to be written */
 static __pmHashCtl	rpmidoneline;	/* pmid oneline records to be written */
 static __pmHashCtl	rpmidtext;	/* pmid text records to be written */
 static __pmHashCtl	rlabelset;	/* label sets to be written */
+static __pmHashCtl	rdescname;	/* metric names from rdesc records */
 
 static __pmTimestamp	curlog;		/* most recent timestamp in log */
 static __pmTimestamp	current;	/* most recent timestamp overall */
@@ -140,6 +142,7 @@ static __pmTimestamp	logend = {-1,0};	/* log end time */
 char	*configfile;			/* -c arg - name of config file */
 int	farg;				/* -f arg - use first timezone */
 int	old_mark_logic;			/* -m arg - <mark> b/n archives */
+int	readthreads = 4;		/* -N arg - read-ahead threads */
 int	sarg = -1;			/* -s arg - finish after X samples */
 char	*Sarg;				/* -S arg - window start */
 char	*Targ;				/* -T arg - window end */
@@ -390,14 +393,9 @@ void
 skip_metric(pmID pmid)
 {
     pmID	*skip_ml_tmp;
-    int		j;
 
     /* avoid dups */
-    for (j=0; j<skip_ml_numpmid; j++) {
-	if (pmid == skip_ml[j])
-	    break;
-    }
-    if (j == skip_ml_numpmid) {
+    if (skip_add(pmid)) {
 	/* not already on the list, append it */
 	skip_ml_numpmid++;
 	skip_ml_tmp = realloc(skip_ml, skip_ml_numpmid*sizeof(pmID));
@@ -688,20 +686,29 @@ add_reclist_t(reclist_t *rec)
     reclist_t	*rp;
     size_t	bytes;
 
-    bytes = (rec->nrecs + 1) * sizeof(reclist_t);
+    /*
+     * the array is grown by doubling, so it is full when nrecs is a
+     * power of 2 (and the first time, when the head is copied in)
+     */
     if (rec->nrecs == 0)
-	bytes += sizeof(reclist_t);
+	bytes = 2 * sizeof(reclist_t);
+    else if ((rec->nrecs & (rec->nrecs - 1)) == 0)
+	bytes = 2 * rec->nrecs * sizeof(reclist_t);
+    else
+	bytes = 0;
 
-    if ((rp = (reclist_t *)realloc(rec->recs, bytes)) == NULL) {
+    if (bytes == 0)
+	rp = rec->recs;
+    else if ((rp = (reclist_t *)realloc(rec->recs, bytes)) == NULL) {
 	fprintf(stderr, "%s: Error: cannot realloc space for record list.\n",
 		pmGetProgname());
 	abandon_extract();
 	/*NOTREACHED*/
     }
-    if (pmDebugOptions.appl1) {
-	totalmalloc += sizeof(reclist_t);
+    else if (pmDebugOptions.appl1) {
+	totalmalloc += bytes - (rec->nrecs ? rec->nrecs : 1) * sizeof(reclist_t);
 	fprintf(stderr, "add_reclist_t: allocated %d\n",
-			(int)(rec->nrecs ? sizeof(reclist_t) : 2*sizeof(reclist_t)));
+			(int)(bytes - (rec->nrecs ? rec->nrecs : 1) * sizeof(reclist_t)));
     }
     if (!rec->nrecs)
 	rp[rec->nrecs++] = *rec;
@@ -749,6 +756,80 @@ ntoh_pmUnits(pmUnits units)
     return units;
 }
 
+/*
+ * metric name(s) in a desc pdu buffer are packed <len><name>... at
+ * the end of the buffer ... return the number of names and set *p to
+ * the first, for namelen()
+ */
+static int
+descnames(__int32_t *pdubuf, char **p)
+{
+    *p = (char *)&pdubuf[8];
+    if (ntohl(pdubuf[0]) > 8)
+	return ntohl(pdubuf[7]);
+    return 0;
+}
+
+/* return length of the name at *p, and step *p over the <len> */
+static int
+namelen(char **p)
+{
+    __int32_t	len;
+
+    memmove((void *)&len, (void *)*p, sizeof(__int32_t));
+    *p += sizeof(__int32_t);
+    return ntohl(len);
+}
+
+/* FNV-1a hash of a metric name, for rdescname */
+static unsigned int
+namehash(const char *name, int len)
+{
+    unsigned int	h = 2166136261U;
+
+    while (len-- > 0) {
+	h ^= (unsigned char)*name++;
+	h *= 16777619U;
+    }
+    return h;
+}
+
+/* is name one of the metric names in pdubuf? */
+static int
+hasname(__int32_t *pdubuf, const char *name, int len)
+{
+    char	*p;
+    int		numnames = descnames(pdubuf, &p);
+    int		i;
+    int		l;
+
+    for (i = 0; i < numnames; i++) {
+	l = namelen(&p);
+	if (l == len && strncmp(p, name, len) == 0)
+	    return 1;
+	p += l;
+    }
+    return 0;
+}
+
+/* is any of the first n metric names in b also in a? */
+static int
+hasnames(__int32_t *a, __int32_t *b, int n)
+{
+    char	*p;
+    int		i;
+    int		l;
+
+    descnames(b, &p);
+    for (i = 0; i < n; i++) {
+	l = namelen(&p);
+	if (hasname(a, p, l))
+	    return 1;
+	p += l;
+    }
+    return 0;
+}
+
 /*
  *  append a new record to the desc meta record list if not seen
  *  before, else check the desc meta record is semantically the
@@ -763,6 +844,11 @@ update_descreclist(int indx)
     pmUnits		pmu;
     pmUnits		*pmup;
     pmID		pmid;
+    char		*name;
+    int			numnames;
+    int			len;
+    int			i;
+    unsigned int	key;
 
     iap = &inarch[indx];
     pmid = ntoh_pmID(iap->pb[META][2]);
@@ -773,31 +859,31 @@ update_descreclist(int indx)
 	printmetricnames(stderr, iap->pb[META]);
 	fprintf(stderr, " (pmid:%s)\n", pmIDStr(pmid));
     }
-    for (hp = __pmHashWalk(&rdesc, PM_HASH_WALK_START);
-	 hp != NULL;
-	 hp = __pmHashWalk(&rdesc, PM_HASH_WALK_NEXT)) {
-	if (hp->key == pmid)
-	    continue;
-	curr = (reclist_t *)hp->data;
-	if (curr->pdu != NULL) {
-	    if (matchnames(curr->pdu, iap->pb[META]) != MATCH_NONE) {
-		fprintf(stderr, "%s: %s: metric ",
-		    pmGetProgname(), xarg == 0 ? "Error" : "Warning");
-		printmetricnames(stderr, curr->pdu);
-		fprintf(stderr, ": PMID changed from %s", pmIDStr(curr->desc.pmid));
-		fprintf(stderr, " to %s!\n", pmIDStr(pmid));
-		if (xarg == 0)
-		    abandon_extract();
-		    /*NOTREACHED*/
-		else
-		    skip_metric(curr->desc.pmid);
-	    }
-	    if (pmDebugOptions.appl1) {
-		fprintf(stderr, "update_descreclist: nomatch ");
-		printmetricnames(stderr, curr->pdu);
-		fprintf(stderr, " (pmid:%s)\n", pmIDStr(curr->desc.pmid));
-	    }
+    numnames = descnames(iap->pb[META], &name);
+    for (i = 0; i < numnames; i++) {
+	len = namelen(&name);
+	key = namehash(name, len);
+	for (hp = __pmHashSearch(key, &rdescname); hp != NULL; hp = hp->next) {
+	    if (hp->key != key)
+		continue;
+	    curr = (reclist_t *)hp->data;
+	    if (curr->desc.pmid == pmid || curr->pdu == NULL ||
+		!hasname(curr->pdu, name, len) ||
+		hasnames(curr->pdu, iap->pb[META], i))
+		/* same PMID, hash collision or already reported */
+		continue;
+	    fprintf(stderr, "%s: %s: metric ",
+		pmGetProgname(), xarg == 0 ? "Error" : "Warning");
+	    printmetricnames(stderr, curr->pdu);
+	    fprintf(stderr, ": PMID changed from %s", pmIDStr(curr->desc.pmid));
+	    fprintf(stderr, " to %s!\n", pmIDStr(pmid));
+	    if (xarg == 0)
+		abandon_extract();
+		/*NOTREACHED*/
+	    else
+		skip_metric(curr->desc.pmid);
 	}
+	name += len;
     }
 
     if ((hp = __pmHashSearch(pmid, &rdesc)) == NULL) {
@@ -819,6 +905,17 @@ update_descreclist(int indx)
 	    abandon_extract();
 	    /*NOTREACHED*/
 	}
+	numnames = descnames(curr->pdu, &name);
+	for (i = 0; i < numnames; i++) {
+	    len = namelen(&name);
+	    if (__pmHashAdd(namehash(name, len), (void *)curr, &rdescname) < 0) {
+		fprintf(stderr, "%s: Error: cannot add to desc name hash table.\n",
+			pmGetProgname());
+		abandon_extract();
+		/*NOTREACHED*/
+	    }
+	    name += len;
+	}
     } else {
 	curr = (reclist_t *)hp->data;
 
@@ -1684,17 +1781,6 @@ write_metareclist(__pmResult *result, int *needti)
 
 /* --- End of reclist functions --- */
 
-void
-checklogtime(__pmTimestamp *this, int indx)
-{
-    if ((curlog.sec == 0 && curlog.nsec == 0) ||
-	(curlog.sec > this->sec ||
-	(curlog.sec == this->sec && curlog.nsec > this->nsec))) {
-	    ilog = indx;
-	    curlog = *this;		/* struct assignment */
-    }
-}
-
 /*
  * pick next meta record - if all meta is at EOF return -1
  * (normally this function returns 0)
@@ -1784,21 +1870,13 @@ againmeta:
 		want = 1;
 	    else {
 		/* check merics from configfile */
-		for (j=0; j<ml_numpmid; j++) {
-		    if (pmid == ml[j].desc->pmid) {
-			want = 1;
-			break;
-		    }
-		}
+		if (ml_lookup(pmid) >= 0)
+		    want = 1;
 	    }
 	    if (want && skip_ml != NULL) {
 		/* check not on skip list */
-		for (j=0; j<skip_ml_numpmid; j++) {
-		    if (pmid == skip_ml[j]) {
-			want = 0;
-			break;
-		    }
-		}
+		if (skip_lookup(pmid))
+		    want = 0;
 	    }
 
 	    if (want) {
@@ -1828,12 +1906,8 @@ againmeta:
 	    want = 0;
 	    if (ml == NULL)
 	        want = 1;
-	    else {
-	        for (j=0; j<ml_numpmid; j++) {
-		    if (indom == ml[j].desc->indom)
-		        want = 1;
-	        }
-	    }
+	    else
+		want = ml_indom(indom);
 
 	    if (want) {
 		/*
@@ -1942,10 +2016,7 @@ againmeta:
 		     * Keep only the label sets whose metrics also being kept.
 		     */
 		    pmid = ntoh_pmID(iap->pb[META][k]);
-		    for (j=0; j<ml_numpmid; j++) {
-			if (pmid == ml[j].desc->pmid)
-			    want = 1;
-		    }
+		    want = ml_lookup(pmid) >= 0;
 		    break;
 		case PM_LABEL_INDOM:
 		case PM_LABEL_INSTANCES:
@@ -1954,10 +2025,7 @@ againmeta:
 		     * These are the domains of the metrics which are being kept.
 		     */
 		    indom = ntoh_pmInDom(iap->pb[META][k]);
-		    for (j=0; j<ml_numpmid; j++) {
-			if (indom == ml[j].desc->indom)
-			    want = 1;
-		    }
+		    want = ml_indom(indom);
 		    break;
 		default:
 		    fprintf(stderr, "%s: Error: invalid label set type: %d\n",
@@ -2007,10 +2075,7 @@ againmeta:
 		     * Keep only the label sets whose metrics also being kept.
 		     */
 		    pmid = ntoh_pmID(iap->pb[META][3]);
-		    for (j=0; j<ml_numpmid; j++) {
-			if (pmid == ml[j].desc->pmid)
-			    want = 1;
-		    }
+		    want = ml_lookup(pmid) >= 0;
 		}
 		else if ((type & PM_TEXT_INDOM)) {
 		    /*
@@ -2018,10 +2083,7 @@ againmeta:
 		     * These are the domains of the metrics which are being kept.
 		     */
 		    indom = ntoh_pmInDom(iap->pb[META][3]);
-		    for (j=0; j<ml_numpmid; j++) {
-			if (indom == ml[j].desc->indom)
-			    want = 1;
-		    }
+		    want = ml_indom(indom);
 		}
 		else {
 		    fprintf(stderr, "%s: Error: invalid text type: %d\n",
@@ -2061,54 +2123,156 @@ againmeta:
 
 
 /*
- * read in next log record for every archive
+ * read the next log record from one archive ... the per-archive state
+ * in *lrp (laststamp, recnum, pmcd_pid and pmcd_seqnum) is carried from
+ * one call to the next, the result and sts are set
+ *
+ * This may be called from the read-ahead threads, so it must not touch
+ * any state other than the input archive's context and *lrp.
  */
-static int
-nextlog(void)
+void
+readlog(int indx, logrec_t *lrp)
 {
-    int			indx;
-    int			eoflog = 0;	/* number of log files at eof */
     int			sts;
-    __pmTimestamp	curtime;
-    __pmArchCtl		*acp;
     __pmContext		*ctxp;
-    inarch_t		*iap;
+    inarch_t		*iap = &inarch[indx];
 
+    lrp->_result = lrp->_Nresult = NULL;
 
-    for (indx=0; indx<inarchnum; indx++) {
-	iap = &inarch[indx];
+    if ((ctxp = __pmHandleToPtr(iap->ctx)) == NULL) {
+	fprintf(stderr, "%s: botch: __pmHandleToPtr(%d) returns NULL!\n", pmGetProgname(), iap->ctx);
+	abandon_extract();
+	/*NOTREACHED*/
+    }
+    /* Need to hold c_lock for __pmLogRead_ctx() */
 
-	/* if at the end of log file then skip this archive */
-	if (iap->eof[LOG]) {
-	    ++eoflog;
-	    continue;
+againlog:
+    if ((sts =__pmLogRead_ctx(ctxp, PM_MODE_FORW, NULL, &lrp->_result, PMLOGREAD_NEXT)) < 0) {
+	lrp->_result = NULL;
+	lrp->sts = sts;
+	PM_UNLOCK(ctxp->c_lock);
+	return;
+    }
+    lrp->laststamp = lrp->_result->timestamp;	/* struct assignment */
+    lrp->recnum++;
+
+    /*
+     * check for prologue/epilogue records ... 
+     *
+     * Warning: If pmlogger changes the contents of the prologue
+     *          and/or epilogue records, then the 5 below will need
+     *          to be adjusted.
+     *          If the type of pmcd.pid changes from U64 or the type
+     *          of pmcd.seqnum changes from U32, the extraction will
+     *          have to change as well.
+     */
+    if (lrp->_result->numpmid == 5) {
+	int		i;
+	pmAtomValue	av;
+	int		lsts;
+	for (i=0; i<lrp->_result->numpmid; i++) {
+	    if (lrp->_result->vset[i]->pmid == pmid_pid) {
+		lsts = pmExtractValue(lrp->_result->vset[i]->valfmt, &lrp->_result->vset[i]->vlist[0], PM_TYPE_U64, &av, PM_TYPE_64);
+		if (lsts != 0) {
+		    fprintf(stderr,
+			"%s: Warning: failed to get pmcd.pid from %s at record %d: %s\n",
+			    pmGetProgname(), iap->name, lrp->recnum, pmErrStr(lsts));
+		    if (pmDebugOptions.desperate) {
+			PM_UNLOCK(ctxp->c_lock);
+			__pmPrintResult(stderr, lrp->_result);
+			PM_LOCK(ctxp->c_lock);
+		    }
+		}
+		else
+		    lrp->pmcd_pid = av.ll;
+	    }
+	    else if (lrp->_result->vset[i]->pmid == pmid_seqnum) {
+		lsts = pmExtractValue(lrp->_result->vset[i]->valfmt, &lrp->_result->vset[i]->vlist[0], PM_TYPE_U32, &av, PM_TYPE_32);
+		if (lsts != 0) {
+		    fprintf(stderr,
+			"%s: Warning: failed to get pmcd.seqnum from %s at record %d: %s\n",
+			    pmGetProgname(), iap->name, lrp->recnum, pmErrStr(lsts));
+		    if (pmDebugOptions.desperate) {
+			PM_UNLOCK(ctxp->c_lock);
+			__pmPrintResult(stderr, lrp->_result);
+			PM_LOCK(ctxp->c_lock);
+		    }
+		}
+		else
+		    lrp->pmcd_seqnum = av.l;
+	    }
 	}
+    }
 
-	/* at eof, but not yet done <mark> record, nothing to do here */
-	if (iap->mark)
-	    continue;
+    /*
+     * check whether we want this record ... the time window is checked
+     * later by fill(), as -w may move it
+     */
+    if (lrp->_result->numpmid == 0) {
+	/* mark record, process this one as is */
+	lrp->_Nresult = lrp->_result;
+    }
+    else if (ml == NULL && skip_ml == NULL) {
+	/*
+	 * ml is NOT defined and skip_ml[] is empty so, we want
+	 * everything => use the input __pmResult
+	 */
+	lrp->_Nresult = lrp->_result;
+    }
+    else {
+	/*
+	 * need to search metric list for wanted pmid's and to
+	 * omit any skipped pmid's
+	 * searchmlist() may pick no metrics, this is OK
+	 */
+	lrp->_Nresult = searchmlist(lrp->_result);
+    }
 
-	/* if we already have a log record then skip this archive */
-	if (iap->_Nresult != NULL) {
-	    continue;
-	}
+    if (lrp->_Nresult == NULL) {
+	/* dont want any of the metrics in _result, try again */
+	__pmFreeResult(lrp->_result);
+	lrp->_result = NULL;
+	goto againlog;
+    }
+    lrp->sts = 0;
+    PM_UNLOCK(ctxp->c_lock);
+}
 
+/*
+ * if an archive has no log record (nor <mark> pending), move the next
+ * one from read-ahead into inarch[indx]
+ */
+static void
+fill(int indx)
+{
+    inarch_t		*iap = &inarch[indx];
+    __pmContext		*ctxp;
+    logrec_t		lr;
 
-	if ((ctxp = __pmHandleToPtr(iap->ctx)) == NULL) {
-	    fprintf(stderr, "%s: botch: __pmHandleToPtr(%d) returns NULL!\n", pmGetProgname(), iap->ctx);
-	    abandon_extract();
-	    /*NOTREACHED*/
-	}
-	/* Need to hold c_lock for __pmLogRead_ctx() */
-	acp = ctxp->c_archctl;
+    /*
+     * if at the end of log file, at eof but not yet done <mark> record,
+     * or we already have a log record, then nothing to do here
+     */
+    if (iap->eof[LOG] || iap->mark || iap->_Nresult != NULL)
+	return;
 
-againlog:
-	if ((sts =__pmLogRead_ctx(ctxp, PM_MODE_FORW, NULL, &iap->_result, PMLOGREAD_NEXT)) < 0) {
-	    if (sts != PM_ERR_EOL) {
+    for ( ; ; ) {
+	readahead_take(indx, &lr);
+	iap->laststamp = lr.laststamp;	/* struct assignment */
+	iap->recnum = lr.recnum;
+	iap->pmcd_pid = lr.pmcd_pid;
+	iap->pmcd_seqnum = lr.pmcd_seqnum;
+
+	if (lr.sts < 0) {
+	    if (lr.sts != PM_ERR_EOL) {
 		fprintf(stderr, "%s: Error: __pmLogRead[log %s]: %s\n",
-			pmGetProgname(), iap->name, pmErrStr(sts));
-		_report(acp->ac_mfp);
-		if (sts != PM_ERR_LOGREC)
+			pmGetProgname(), iap->name, pmErrStr(lr.sts));
+		/* no more reads from this archive, so safe to look here */
+		if ((ctxp = __pmHandleToPtr(iap->ctx)) != NULL) {
+		    _report(ctxp->c_archctl->ac_mfp);
+		    PM_UNLOCK(ctxp->c_lock);
+		}
+		if (lr.sts != PM_ERR_LOGREC)
 		    abandon_extract();
 		    /*NOTREACHED*/
 	    }
@@ -2117,74 +2281,13 @@ againlog:
 	     * not generate a <mark> record, and you may as well ignore
 	     * this archive, else get ready for a <mark> records
 	     */
-	    if (first_datarec) {
+	    if (first_datarec)
 		iap->eof[LOG] = 1;
-		++eoflog;
-	    }
 	    else {
 		iap->mark = 1;
 		iap->pb[LOG] = NULL;
 	    }
-	    PM_UNLOCK(ctxp->c_lock);
-	    continue;
-	}
-	else
-	    iap->laststamp = iap->_result->timestamp;	/* struct assignment */
-	iap->recnum++;
-	assert(iap->_result != NULL);
-
-	/*
-	 * set current log time - this is only done so that we can
-	 * determine whether to keep or discard the log
-	 */
-	curtime = iap->_result->timestamp;
-
-	/*
-	 * check for prologue/epilogue records ... 
-	 *
-	 * Warning: If pmlogger changes the contents of the prologue
-	 *          and/or epilogue records, then the 5 below will need
-	 *          to be adjusted.
-	 *          If the type of pmcd.pid changes from U64 or the type
-	 *          of pmcd.seqnum changes from U32, the extraction will
-	 *          have to change as well.
-	 */
-	if (iap->_result->numpmid == 5) {
-	    int		i;
-	    pmAtomValue	av;
-	    int		lsts;
-	    for (i=0; i<iap->_result->numpmid; i++) {
-		if (iap->_result->vset[i]->pmid == pmid_pid) {
-		    lsts = pmExtractValue(iap->_result->vset[i]->valfmt, &iap->_result->vset[i]->vlist[0], PM_TYPE_U64, &av, PM_TYPE_64);
-		    if (lsts != 0) {
-			fprintf(stderr,
-			    "%s: Warning: failed to get pmcd.pid from %s at record %d: %s\n",
-				pmGetProgname(), iap->name, iap->recnum, pmErrStr(lsts));
-			if (pmDebugOptions.desperate) {
-			    PM_UNLOCK(ctxp->c_lock);
-			    __pmPrintResult(stderr, iap->_result);
-			    PM_LOCK(ctxp->c_lock);
-			}
-		    }
-		    else
-			iap->pmcd_pid = av.ll;
-		}
-		else if (iap->_result->vset[i]->pmid == pmid_seqnum) {
-		    lsts = pmExtractValue(iap->_result->vset[i]->valfmt, &iap->_result->vset[i]->vlist[0], PM_TYPE_U32, &av, PM_TYPE_32);
-		    if (lsts != 0) {
-			fprintf(stderr,
-			    "%s: Warning: failed to get pmcd.seqnum from %s at record %d: %s\n",
-				pmGetProgname(), iap->name, iap->recnum, pmErrStr(lsts));
-			if (pmDebugOptions.desperate) {
-			    PM_UNLOCK(ctxp->c_lock);
-			    __pmPrintResult(stderr, iap->_result);
-			    PM_LOCK(ctxp->c_lock);
-			}
-		    }
-		    else
-			iap->pmcd_seqnum = av.l;
-		}
-	    }
+	    return;
 	}
 
 	/*
@@ -2192,56 +2295,116 @@ againlog:
 	 * start time, then we may want it
 	 *	(irrespective of the current window end time)
 	 */
-	if (__pmTimestampCmp(&curtime, &winstart) < 0) {
-	    /*
-	     * log is not in time window - discard result and get next record
-	     */
-	    __pmFreeResult(iap->_result);
-	    iap->_result = NULL;
-	    goto againlog;
-	}
-        else {
-            /*
-	     * log is within time window - check whether we want this record
-             */
-            if (iap->_result->numpmid == 0) {
-		/* mark record, process this one as is */
-                iap->_Nresult = iap->_result;
-	    }
-            else if (ml == NULL && skip_ml == NULL) {
-                /*
-		 * ml is NOT defined and skip_ml[] is empty so, we want
-		 * everything => use the input __pmResult
-		 */
-                iap->_Nresult = iap->_result;
-            }
-            else {
-                /*
-		 * need to search metric list for wanted pmid's and to
-		 * omit any skipped pmid's
-                 * searchmlist() may pick no metrics, this is OK
-                 */
-                iap->_Nresult = searchmlist(iap->_result);
-            }
-
-            if (iap->_Nresult == NULL) {
-                /* dont want any of the metrics in _result, try again */
-		__pmFreeResult(iap->_result);
-		iap->_result = NULL;
-                goto againlog;
-            }
-	}
-	PM_UNLOCK(ctxp->c_lock);
+	if (__pmTimestampCmp(&lr._result->timestamp, &winstart) >= 0)
+	    break;
 
-    } /*for(indx)*/
+	/* log is not in time window - discard result and get next record */
+	if (lr._Nresult != lr._result)
+	    free(lr._Nresult);
+	__pmFreeResult(lr._result);
+    }
+
+    iap->_result = lr._result;
+    iap->_Nresult = lr._Nresult;
+}
+
+/*
+ * The input archives with a log record or <mark> pending are kept in
+ * a binary min-heap on the timestamp of that record (ties go to the
+ * lowest index), so picking the earliest is O(log inarchnum) instead
+ * of a scan of all inputs for every record written.
+ */
+static int	*heap;		/* indices into inarch[] */
+static int	nheap;
+static int	reheap = 1;	/* rebuild before the next pick */
+
+static __pmTimestamp *
+heapstamp(int indx)
+{
+    inarch_t	*iap = &inarch[indx];
+
+    return iap->_Nresult != NULL ? &iap->_Nresult->timestamp : &iap->laststamp;
+}
+
+static int
+heapless(int a, int b)
+{
+    int		sts = __pmTimestampCmp(heapstamp(a), heapstamp(b));
+
+    return sts < 0 || (sts == 0 && a < b);
+}
+
+static void
+heapdown(int i)
+{
+    int		c;
+    int		tmp;
+
+    for ( ; ; ) {
+	c = 2 * i + 1;
+	if (c >= nheap)
+	    break;
+	if (c + 1 < nheap && heapless(heap[c+1], heap[c]))
+	    c++;
+	if (!heapless(heap[c], heap[i]))
+	    break;
+	tmp = heap[i];
+	heap[i] = heap[c];
+	heap[c] = tmp;
+	i = c;
+    }
+}
+
+/*
+ * get next log record, set ilog and curlog to the archive with the
+ * earliest log record (or <mark>) ... if all archives are at eof
+ * return -1 (normally this function returns 0)
+ *
+ * Only the archive picked last time has moved on since (its record
+ * was written or its <mark> done), unless checkwinend() has discarded
+ * records and set reheap.
+ */
+static int
+nextlog(void)
+{
+    int			indx;
+    int			i;
+
+    if (reheap) {
+	if (heap == NULL && (heap = (int *)malloc(inarchnum * sizeof(int))) == NULL) {
+	    fprintf(stderr, "%s: Error: cannot malloc space for merge heap.\n",
+		    pmGetProgname());
+	    abandon_extract();
+	    /*NOTREACHED*/
+	}
+	nheap = 0;
+	for (indx = 0; indx < inarchnum; indx++) {
+	    fill(indx);
+	    if (!inarch[indx].eof[LOG])
+		heap[nheap++] = indx;
+	}
+	for (i = nheap / 2 - 1; i >= 0; i--)
+	    heapdown(i);
+	reheap = 0;
+    }
+    else if (nheap > 0) {
+	indx = heap[0];
+	fill(indx);
+	if (inarch[indx].eof[LOG])
+	    heap[0] = heap[--nheap];
+	heapdown(0);
+    }
 
     /*
-     * if we are here, then each archive control struct should either
-     * be at eof, or it should have a _result, or it should have a mark PDU
-     * (if we have a _result, we may want all/some/none of the pmid's in it)
+     * if we are here, then each archive in the heap should either have
+     * a _result, or it should have a mark PDU (if we have a _result, we
+     * may want all/some/none of the pmid's in it)
      */
+    if (nheap == 0)
+	return -1;
 
-    if (eoflog == inarchnum) return(-1);
+    ilog = heap[0];
+    curlog = *heapstamp(ilog);		/* struct assignment */
     return 0;
 }
 
@@ -2288,6 +2451,14 @@ parseargs(int argc, char *argv[])
 	    old_mark_logic = 1;
 	    break;
 
+	case 'N':	/* number of read-ahead threads */
+	    readthreads = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || readthreads < 1) {
+		pmprintf("%s: -N requires a positive numeric argument\n", pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
 	case 's':	/* number of samples to write out */
 	    sarg = (int)strtol(opts.optarg, &endnum, 10);
 	    if (*endnum != '\0' || sarg < 0) {
@@ -2456,6 +2627,7 @@ checkwinend(__pmTimestamp *tsp)
     }
 
     ilog = -1;
+    reheap = 1;
     for (indx=0; indx<inarchnum; indx++) {
 
 	iap = &inarch[indx];
@@ -3046,6 +3218,9 @@ main(int argc, char **argv)
 	stsmeta = nextmeta();
     } while (stsmeta >= 0);
 
+    /* metadata is done, data records may now be read ahead */
+    readahead_start();
+
     if (skip_ml_numpmid > 0) {
 	fprintf(stderr, "Warning: the metrics below will be missing from the output archive\n");
 	for (j=0; j<skip_ml_numpmid; j++) {
@@ -3066,48 +3241,30 @@ main(int argc, char **argv)
 	old_meta_offset = __pmFtell(logctl.mdfp);
 	assert(old_meta_offset >= 0);
 
-	/* nextlog() resets ilog, and curlog (to the smallest timestamp) */
+	/*
+	 * nextlog() sets ilog and curlog to the _Nresult (or mark pdu)
+	 * with the earliest timestamp
+	 */
 	stslog = nextlog();
 
 	if (stslog < 0)
 	    break;
 
-	/*
-	 * find the _Nresult (or mark pdu) with the earliest timestamp;
-	 * set ilog
-	 * (this is a bit more complex when tflag is specified)
-	 */
-	mintime.sec = mintime.nsec = 0;
-	for (indx=0; indx<inarchnum; indx++) {
-	    if (inarch[indx]._Nresult != NULL) {
-		checklogtime(&inarch[indx]._Nresult->timestamp, indx);
-		if (pmDebugOptions.appl2) {
+	mintime = tmptime = curlog;
+	if (pmDebugOptions.appl2) {
+	    for (indx=0; indx<inarchnum; indx++) {
+		if (inarch[indx]._Nresult != NULL) {
 		    fprintf(stderr, "result [%d] stamp ", indx);
 		    __pmPrintTimestamp(stderr, &inarch[indx]._Nresult->timestamp);
 		    fputc('\n', stderr);
 		}
-
-		if (ilog == indx) {
-		    tmptime = curlog;
-		    if (mintime.sec <= 0 || __pmTimestampCmp(&mintime, &tmptime) > 0)
-		        mintime = tmptime;
-		}
-	    }
-	    else if (inarch[indx].mark) {
-		checklogtime(&inarch[indx].laststamp, indx);
-		if (pmDebugOptions.appl2) {
+		else if (inarch[indx].mark) {
 		    fprintf(stderr, "mark [%d] ", indx);
 		    __pmPrintTimestamp(stderr, &inarch[indx].laststamp);
 		    if (indx == ilog)
 			fprintf(stderr, " (ilog)");
 		    fputc('\n', stderr);
 		}
-
-		if (ilog == indx) {
-		    tmptime = curlog;
-		    if (mintime.sec <= 0 || __pmTimestampCmp(&mintime, &tmptime) > 0)
-		        mintime = tmptime;
-		}
 	    }
 	}
 
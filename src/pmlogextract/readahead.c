@@ -0,0 +1,207 @@
+/*
+ * readahead.c
+ *
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * Input archive read-ahead.
+ *
+ * With -N greater than 1, a pool of reader threads reads, decodes and
+ * filters (readlog()) the data records of the input archives into a
+ * small queue per archive, while the main thread merges and writes.
+ * Each input archive is served by one reader thread only (archive i by
+ * thread i % -N) and has its own context, so there is no contention in
+ * libpcp and the records from each archive are queued in order.
+ *
+ * The readers only help when they can run alongside the main thread,
+ * so there is at most one per additional CPU, and the queues are kept
+ * short because every queued record holds a __pmResult that libpcp has
+ * to find again when it is freed.
+ *
+ * Otherwise, and for any input archives that are empty, records are
+ * read inline when they are needed.
+ */
+
+#include "pmapi.h"
+#include "libpcp.h"
+#include "logger.h"
+
+#define QUEUE	4		/* records read ahead per archive */
+
+typedef struct {
+    logrec_t	queue[QUEUE];
+    int		head;		/* next record to take */
+    int		count;		/* records in queue */
+    int		done;		/* end of archive has been queued */
+    logrec_t	last;		/* reader state after last record read */
+} readahead_t;
+
+static readahead_t	*ra;
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t	ralock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	*raspace;	/* per reader, waiting for room */
+static pthread_cond_t	raready = PTHREAD_COND_INITIALIZER;
+static int		rawait = -1;	/* archive main thread is waiting on */
+static int		nthreads;	/* running reader threads */
+
+static void *
+reader(void *arg)
+{
+    int		self = (int)(__psint_t)arg;
+    int		indx;
+    int		busy;
+    logrec_t	lr;
+    readahead_t	*rap;
+
+    pthread_mutex_lock(&ralock);
+    for ( ; ; ) {
+	/* find one of our archives with room in its queue */
+	busy = 0;
+	rap = NULL;
+	for (indx = self; indx < inarchnum; indx += nthreads) {
+	    if (ra[indx].done)
+		continue;
+	    busy = 1;
+	    if (ra[indx].count < QUEUE) {
+		rap = &ra[indx];
+		break;
+	    }
+	}
+	if (!busy)
+	    break;
+	if (rap == NULL) {
+	    pthread_cond_wait(&raspace[self], &ralock);
+	    continue;
+	}
+	lr = rap->last;		/* struct assignment */
+	pthread_mutex_unlock(&ralock);
+
+	readlog(indx, &lr);
+
+	pthread_mutex_lock(&ralock);
+	rap->last = lr;		/* struct assignment */
+	rap->queue[(rap->head + rap->count) % QUEUE] = lr;
+	rap->count++;
+	if (lr.sts < 0)
+	    rap->done = 1;
+	if (rawait == indx)
+	    pthread_cond_signal(&raready);
+    }
+    pthread_mutex_unlock(&ralock);
+    return NULL;
+}
+#endif
+
+/*
+ * called once all metadata has been read, to start the reader threads
+ */
+void
+readahead_start(void)
+{
+    int		indx;
+
+    if ((ra = (readahead_t *)calloc(inarchnum, sizeof(readahead_t))) == NULL) {
+	fprintf(stderr, "%s: Error: cannot malloc space for read-ahead.\n",
+		pmGetProgname());
+	abandon_extract();
+	/*NOTREACHED*/
+    }
+    for (indx = 0; indx < inarchnum; indx++) {
+	ra[indx].last.laststamp = inarch[indx].laststamp;
+	ra[indx].last.recnum = inarch[indx].recnum;
+	ra[indx].last.pmcd_pid = inarch[indx].pmcd_pid;
+	ra[indx].last.pmcd_seqnum = inarch[indx].pmcd_seqnum;
+	if (inarch[indx].eof[LOG])
+	    /* empty archive, no context, nothing to read */
+	    ra[indx].done = 1;
+    }
+
+#ifdef HAVE_PTHREAD_H
+    if (readthreads > 1 && inarchnum > 1) {
+	pthread_t	tid;
+	int		n;
+	int		sts;
+	long		ncpu = 2;
+
+	n = readthreads < inarchnum ? readthreads : inarchnum;
+#ifdef _SC_NPROCESSORS_ONLN
+	if ((ncpu = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+	    ncpu = 1;
+#endif
+	if (n > ncpu - 1)
+	    n = ncpu - 1;
+	if (n < 1)
+	    /* no CPU to spare, read inline */
+	    return;
+	if ((raspace = (pthread_cond_t *)malloc(n * sizeof(pthread_cond_t))) == NULL) {
+	    fprintf(stderr, "%s: Error: cannot malloc space for read-ahead.\n",
+		    pmGetProgname());
+	    abandon_extract();
+	    /*NOTREACHED*/
+	}
+	for (indx = 0; indx < n; indx++)
+	    pthread_cond_init(&raspace[indx], NULL);
+	pthread_mutex_lock(&ralock);
+	/*
+	 * the readers wait on ralock until all are created, so if one
+	 * cannot be created the rest share its archives (or with none,
+	 * read inline)
+	 */
+	for (nthreads = 0; nthreads < n; nthreads++) {
+	    if ((sts = pthread_create(&tid, NULL, reader, (void *)(__psint_t)nthreads)) != 0) {
+		if (pmDebugOptions.appl2)
+		    fprintf(stderr, "readahead_start: thread %d: %s\n",
+			    nthreads, pmErrStr(-sts));
+		break;
+	    }
+	    pthread_detach(tid);
+	}
+	pthread_mutex_unlock(&ralock);
+	if (pmDebugOptions.appl2)
+	    fprintf(stderr, "readahead_start: %d reader threads for %d archives\n",
+		    nthreads, inarchnum);
+    }
+#endif
+}
+
+/*
+ * take the next record for archive indx, waiting for its reader
+ * thread if need be
+ */
+void
+readahead_take(int indx, logrec_t *lrp)
+{
+    readahead_t	*rap = &ra[indx];
+
+#ifdef HAVE_PTHREAD_H
+    if (nthreads > 0) {
+	pthread_mutex_lock(&ralock);
+	while (rap->count == 0) {
+	    rawait = indx;
+	    pthread_cond_wait(&raready, &ralock);
+	}
+	rawait = -1;
+	*lrp = rap->queue[rap->head];	/* struct assignment */
+	rap->head = (rap->head + 1) % QUEUE;
+	if (rap->count-- == QUEUE)
+	    /* reader may be waiting for room */
+	    pthread_cond_signal(&raspace[indx % nthreads]);
+	pthread_mutex_unlock(&ralock);
+	return;
+    }
+#endif
+
+    *lrp = rap->last;			/* struct assignment */
+    readlog(indx, lrp);
+    rap->last = *lrp;			/* struct assignment */
+}
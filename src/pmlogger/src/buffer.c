@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * Buffered (group commit) archive writes.
+ *
+ * By default all archive files are unbuffered and every record is
+ * written with its own write(2).  With -b, the data and metadata files
+ * are created fully buffered instead and flushed together when the
+ * buffer fills, when the -F flush interval expires, before each temporal
+ * index entry, at a volume switch, on a pmlc sync request and on exit.
+ * The buffer size reaches libpcp as logctl.bufsize, so __pmLogCreate()
+ * and __pmLogNewFileBuf() set it before any I/O on the new files.
+ *
+ * Ordering at a flush boundary is always metadata, then data, then the
+ * temporal index, so a reader never finds an index entry referring to
+ * data that is not yet on disk, nor data using metadata that is not yet
+ * on disk.  Data records are kept whole where they fit in the buffer.
+ */
+
+#include "logger.h"
+#include "logstats.h"
+#include <sys/stat.h>
+
+int		log_bufsize;		/* -b, 0 => unbuffered */
+struct timeval	flush_interval = { 10, 0 };	/* -F */
+
+logbuf_t	logbuf;			/* per-host, see farm_switch() */
+
+static char		statsfile[MAXPATHLEN];
+static pmloggerstats_t	instrument;	/* used if we cannot map statsfile */
+static pmloggerstats_t	*stats = &instrument;
+
+static void
+stopstats(void)
+{
+    if (statsfile[0] != '\0')
+	unlink(statsfile);
+}
+
+/* create and map the write instrumentation file exported by pmcd */
+void
+startstats(void)
+{
+    void	*ptr;
+    char	dir[MAXPATHLEN];
+    char	zero = '\0';
+    int		sep = pmPathSeparator();
+    int		fd;
+
+    pmsprintf(dir, sizeof(dir), "%s%c%s",
+		pmGetConfig("PCP_TMP_DIR"), sep, PMLOGGER_STATS_SUBDIR);
+    if (mkdir2(dir, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) < 0 &&
+	oserror() != EEXIST) {
+	fprintf(stderr, "%s: warning cannot create stats file dir %s: %s\n",
+		pmGetProgname(), dir, osstrerror());
+	return;
+    }
+
+    pmsprintf(statsfile, sizeof(statsfile), "%s%c%" FMT_PID,
+		dir, sep, (pid_t)getpid());
+    unlink(statsfile);
+    if ((fd = open(statsfile, O_RDWR | O_CREAT | O_EXCL | O_TRUNC,
+			      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) < 0) {
+	/* cannot create stats file, continue on without it */
+	statsfile[0] = '\0';
+	return;
+    }
+    atexit(stopstats);
+
+    /* seek to struct size and write one zero */
+    if (lseek(fd, sizeof(pmloggerstats_t)-1, SEEK_SET) < 0 ||
+	write(fd, &zero, 1) != 1) {
+	fprintf(stderr, "%s: warning cannot size stats file %s: %s\n",
+		pmGetProgname(), statsfile, osstrerror());
+    }
+    else if ((ptr = __pmMemoryMap(fd, sizeof(pmloggerstats_t), 1)) == NULL) {
+	fprintf(stderr, "%s: memory map failed for stats file %s: %s\n",
+		pmGetProgname(), statsfile, osstrerror());
+    }
+    else {
+	stats = (pmloggerstats_t *)ptr;
+	*stats = instrument;	/* struct assignment */
+    }
+    close(fd);
+
+    stats->bufsize = log_bufsize;
+    stats->version = 1;
+}
+
+/* flush buffered metadata, then data, records */
+void
+flushlog(void)
+{
+    if (log_bufsize == 0)
+	return;
+
+    if (logctl.mdfp != NULL)
+	__pmFflush(logctl.mdfp);
+    if (logbuf.batch == 0)
+	return;
+    if (archctl.ac_mfp != NULL)
+	__pmFflush(archctl.ac_mfp);
+
+    if (pmDebugOptions.appl2)
+	pmNotifyErr(LOG_INFO, "flushlog: %u records, %zu bytes", logbuf.batch, logbuf.pending);
+    stats->flushes++;
+    if (logbuf.batch > stats->batch_max)
+	stats->batch_max = logbuf.batch;
+    logbuf.pending = 0;
+    logbuf.batch = 0;
+}
+
+/*
+ * Account for a data record of len bytes about to be written - any
+ * metadata for it must reach the file first, and a record that would
+ * overflow the buffer causes a flush first so that it is kept whole.
+ */
+void
+logwrite(size_t len)
+{
+    stats->records++;
+    stats->bytes += len;
+
+    if (log_bufsize == 0) {
+	/* every record is its own write */
+	stats->flushes++;
+	stats->batch_max = 1;
+	return;
+    }
+
+    __pmFflush(logctl.mdfp);
+    if (logbuf.batch > 0 && logbuf.pending + len > (size_t)log_bufsize)
+	flushlog();
+    logbuf.pending += len;
+    logbuf.batch++;
+}
@@ -16,6 +16,7 @@
 #include "logger.h"
 
 int	last_log_offset;
+off_t	flushsize = 100000;
 
 #define IS_DERIVED_LOGGED(x) (pmID_domain(x) == DYNAMIC_PMID && (pmID_cluster(x) & 2048) == 2048 && pmID_item(x) != 0)
 #define SET_DERIVED_LOGGED(x) pmID_build(pmID_domain(x), 2048 | pmID_cluster(x), pmID_item(x))
@@ -574,13 +575,35 @@ pduresultbytes(__pmResult *resp)
 void
 log_callback(int afid, void *data)
 {
-    task_t		*tp;
-    for (tp = tasklist; tp != NULL; tp = tp->t_next) {
-	if (tp->t_afid == afid) {
-	    tp->t_alarm = 1;
-	    log_alarm = 1;
-	    break;
+    task_t		*tp = (task_t *)data;
+
+    /*
+     * data is the task (tasks are never freed once registered), so
+     * this works for tasks that are not on the current tasklist, as
+     * in multi-host mode
+     */
+    if (tp != NULL && tp->t_afid == afid) {
+	tp->t_alarm = 1;
+	log_alarm = 1;
+    }
+}
+
+/*
+ * set up the instance profile for a fetch group
+ */
+void
+fetch_profile(fetchctl_t *fp)
+{
+    indomctl_t		*idp;
+
+    if (one_context || fp->f_state & OPT_STATE_PROFILE) {
+	/* profile for this fetch group has changed */
+	pmAddProfile(PM_INDOM_NULL, 0, (int *)0);
+	for (idp = fp->f_idp; idp != (indomctl_t *)0; idp = idp->i_next) {
+	    if (idp->i_indom != PM_INDOM_NULL && idp->i_numinst != 0)
+		pmAddProfile(idp->i_indom, idp->i_numinst, idp->i_instlist);
 	}
+	fp->f_state &= ~OPT_STATE_PROFILE;
     }
 }
 
@@ -595,7 +618,6 @@ do_work(task_t *tp)
     int			k;
     int			sts;
     fetchctl_t		*fp;
-    indomctl_t		*idp;
     __pmResult		*resp;
     __pmPDU		*pb;
     AFctl_t		*acp;
@@ -604,7 +626,6 @@ do_work(task_t *tp)
     int			changed;
     int			needindom;
     int			needti;
-    static off_t	flushsize = 100000;
     long		old_meta_offset;
     long		label_offset;
     long		new_offset;
@@ -683,15 +704,7 @@ do_work(task_t *tp)
 	    lfp->lf_fp = fp;
 	}
 
-	if (one_context || fp->f_state & OPT_STATE_PROFILE) {
-	    /* profile for this fetch group has changed */
-	    pmAddProfile(PM_INDOM_NULL, 0, (int *)0);
-	    for (idp = fp->f_idp; idp != (indomctl_t *)0; idp = idp->i_next) {
-		if (idp->i_indom != PM_INDOM_NULL && idp->i_numinst != 0)
-		    pmAddProfile(idp->i_indom, idp->i_numinst, idp->i_instlist);
-	    }
-	    fp->f_state &= ~OPT_STATE_PROFILE;
-	}
+	fetch_profile(fp);
 
 	clearavail(fp);
 
@@ -700,6 +713,10 @@ do_work(task_t *tp)
 		/* disconnect() already done in myFetch() */
 		return;
 	    }
+	    if (farm_failed()) {
+		/* -M, this host is given up after this, see farm_tasks() */
+		return;
+	    }
 	    if (sts != -ETIMEDOUT) {
 		/* optionally report and disconnect() the first time thru */
 		if (pmDebugOptions.appl2)
@@ -1021,6 +1038,7 @@ do_work(task_t *tp)
 	    fprintf(stderr, "__pmEncodeResult: %s\n", pmErrStr(sts));
 	    exit(1);
 	}
+	logwrite(((__pmPDUHdr *)pb)->len - sizeof(__pmPDUHdr) + 2*sizeof(int));
 	if (archive_version >= PM_LOG_VERS03) {
 	    if ((sts = __pmLogPutResult3(&archctl, pb)) < 0) {
 		fprintf(stderr, "__pmLogPutResult3: (encode) %s\n", pmErrStr(sts));
@@ -1042,6 +1060,11 @@ do_work(task_t *tp)
 	}
 
 	if (needti) {
+	    /*
+	     * buffered data and metadata must be on disk before the
+	     * temporal index entry that refers to them
+	     */
+	    flushlog();
 	    /*
 	     * need to unwind seek pointer to start of most recent
 	     * result (but if this is the first one, skip the label
@@ -252,9 +252,10 @@ chk_all(task_t *tp, pmID pmid)
  * Called when an error PDU containing PMCD_ADD_AGENT is received.
  * This function checks all of the configured metrics to make sure that
  * they have not changed. For example due to a PMDA being replaced by an
- * updated version 
+ * updated version.
+ * No return if any have changed, except for -M when < 0 is returned.
  */
-void
+int
 validate_metrics(void)
 {
     const task_t	*tp;
@@ -303,7 +304,10 @@ validate_metrics(void)
 	    else if (tp->t_numpmid > 2)
 		fprintf(stderr, ", ... %s", names[tp->t_numpmid-1]);
 	    fprintf(stderr, "): Reason: %s\n", pmErrStr(sts));
-	    exit(1);
+	    if (farm == NULL)
+		exit(1);
+	    free(new_pmids);
+	    return sts;
 	}
 
 	/* Now check the individual metrics for problems. */
@@ -382,9 +386,16 @@ validate_metrics(void)
 
     /* We cannot continue, if any of the metrics have changed. */
     if (error) {
-	fprintf(stderr, "One or more configured metrics have changed after pmcd state change. Exiting\n");
-	exit(1);
+	if (farm == NULL) {
+	    fprintf(stderr, "One or more configured metrics have changed after pmcd state change. Exiting\n");
+	    exit(1);
+	}
+	/* -M, only this host is given up, see farm_fail() */
+	fprintf(stderr, "One or more configured metrics have changed after pmcd state change for host \"%s\"\n",
+		pmcd_host_conn);
+	return PM_ERR_PMID;
     }
+    return 0;
 }
 
 /*
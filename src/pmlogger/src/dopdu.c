@@ -1241,6 +1241,9 @@ do_control(__pmPDU *pb)
 	__pmFreeResult(request);
 	return sts;
     }
+    if (farm != NULL)
+	/* -M, the same request for all the other hosts */
+	farm_control(pb);
     sts = do_control_req(request, control, state, ldelta, sendresult);
     return sts;
 }
@@ -1276,8 +1279,13 @@ sendstatus(void)
 	ls.last = last_stamp;	/* struct assignment */
 	__pmGetTimestamp(&ls.now);
 	ls.vol = archctl.ac_curvol;
-	ls.size = __pmFtell(archctl.ac_mfp);
-	assert(ls.size >= 0);
+	if (archctl.ac_mfp != NULL) {
+	    ls.size = __pmFtell(archctl.ac_mfp);
+	    assert(ls.size >= 0);
+	}
+	else
+	    /* -M, the lead has been given up, see farm_tasks() */
+	    ls.size = 0;
 
 	ls.pmcd.hostname = ls.pmcd.fqdn = ls.pmcd.timezone = ls.pmcd.zoneinfo = NULL;
 	ls.pmlogger.timezone = ls.pmlogger.zoneinfo = NULL;
@@ -1353,7 +1361,10 @@ do_request(__pmPDU *pb)
 	    if (denyops & PM_OP_LOG_MAND)
 		sts = __pmSendError(clientfd, FROM_ANON, PM_ERR_PERMISSION);
 	    else {
-		sts = newvolume(VOL_SW_PMLC);
+		if (farm != NULL)
+		    sts = farm_newvolume(VOL_SW_PMLC);
+		else
+		    sts = newvolume(VOL_SW_PMLC);
 		if (sts >= 0)
 		    sts = logctl.label.vol;
 		sts = __pmSendError(clientfd, FROM_ANON, sts);
@@ -1362,11 +1373,16 @@ do_request(__pmPDU *pb)
 
 	case LOG_REQUEST_SYNC:
 	    /*
-	     * Don't need to check access controls, as this is now
-	     * a no-op with unbuffered I/O from pmlogger.
+	     * Don't need to check access controls, this is a no-op
+	     * unless archive writes are buffered (-b), in which case
+	     * flush them now.
 	     *
-	     * Do nothing, simply send status 0 back to pmlc.
+	     * Then simply send status 0 back to pmlc.
 	     */
+	    if (farm != NULL)
+		farm_flush();
+	    else
+		flushlog();
 	    sts = __pmSendError(clientfd, FROM_ANON, 0);
 	    break;
 
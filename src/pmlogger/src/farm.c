@@ -0,0 +1,565 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * Multi-host mode (-M) ... one pmlogger process logs many pmcd hosts,
+ * each into its own archive.
+ *
+ * The rest of pmlogger works on one host at a time through a set of
+ * globals (logctl, archctl, tasklist, ...), so each host has a logger_t
+ * holding its copy of these, and farm_switch() swaps them in and out.
+ * The first host in the -M file is the "lead", it is set up exactly as
+ * for a single host pmlogger, owns the control port and is always
+ * current outside of the routines here.  pmlc control, new volume and
+ * sync requests are applied to every host, status is for the lead.
+ *
+ * The config file is run through pmcpp and pass0 once, and the expanded
+ * text and PMNS name list are shared, only the metadata is bound again
+ * for each host.  When timers expire, the fetch requests for all alarmed
+ * tasks of all hosts are sent before any reply is read, the replies are
+ * collected as each pmcd answers, and the work for a host is done once
+ * all of its replies are in, so one slow pmcd does not hold up the rest.
+ *
+ * A host that cannot be set up (no pmcd, config errors, nothing to log),
+ * or that has to be given up later (metrics changed after a pmcd state
+ * change), is tried again every RETRY_DELTA seconds, in a new archive.
+ */
+
+#include "logger.h"
+
+logger_t	*farm;			/* all hosts, first is the lead */
+static logger_t	*current;		/* whose state is in the globals */
+static FILE	*config;		/* from pass0(), for farm_setup() */
+int		farm_retry_alarm;	/* retry_callback() called */
+
+#define RETRY_DELTA	60
+
+/*
+ * Load the -M file, each line is "host archive", # comments
+ * ... no return on error
+ */
+void
+farm_load(const char *file)
+{
+    FILE	*f;
+    char	line[2*MAXPATHLEN];
+    char	*host;
+    char	*arch;
+    char	*p;
+    int		n = 0;
+    logger_t	*lp;
+    logger_t	*last = NULL;
+
+    if ((f = fopen(file, "r")) == NULL) {
+	fprintf(stderr, "%s: cannot open hosts file \"%s\": %s\n",
+		pmGetProgname(), file, osstrerror());
+	exit(1);
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+	n++;
+	if ((p = strchr(line, '#')) != NULL)
+	    *p = '\0';
+	if ((host = strtok(line, " \t\r\n")) == NULL)
+	    continue;
+	if ((arch = strtok(NULL, " \t\r\n")) == NULL ||
+	    strtok(NULL, " \t\r\n") != NULL) {
+	    fprintf(stderr, "%s: %s[%d]: expected \"host archive\"\n",
+		    pmGetProgname(), file, n);
+	    exit(1);
+	}
+	if ((lp = (logger_t *)calloc(1, sizeof(logger_t))) == NULL ||
+	    (lp->l_host = strdup(host)) == NULL ||
+	    (lp->l_archBase = strdup(arch)) == NULL) {
+	    pmNoMem("farm_load", sizeof(logger_t) + strlen(host) + strlen(arch), PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+	lp->l_ctx = -1;
+	lp->l_pmcdfd = -1;
+	lp->l_flushsize = 100000;
+	if (last == NULL)
+	    farm = lp;
+	else
+	    last->l_next = lp;
+	last = lp;
+    }
+    fclose(f);
+
+    if (farm == NULL) {
+	fprintf(stderr, "%s: no hosts in \"%s\"\n", pmGetProgname(), file);
+	exit(1);
+    }
+}
+
+static void
+save(logger_t *lp)
+{
+    lp->l_pmcdfd = pmcdfd;
+    lp->l_pmcd_host = pmcd_host;
+    lp->l_archName = archName;
+    lp->l_logctl = logctl;		/* struct assignment */
+    lp->l_archctl = archctl;		/* struct assignment */
+    lp->l_tasklist = tasklist;
+    lp->l_pm_hash = pm_hash;		/* struct assignment */
+    lp->l_hist_hash = hist_hash;	/* struct assignment */
+    lp->l_dyn_roots = dyn_roots;
+    lp->l_n_dyn_roots = n_dyn_roots;
+    lp->l_epoch = epoch;		/* struct assignment */
+    lp->l_last_stamp = last_stamp;	/* struct assignment */
+    lp->l_last_log_offset = last_log_offset;
+    lp->l_flushsize = flushsize;
+    lp->l_vol_bytes = vol_bytes;
+    lp->l_vol_samples_counter = vol_samples_counter;
+    lp->l_logbuf = logbuf;		/* struct assignment */
+    lp->l_prefetch = prefetch;
+}
+
+static void
+restore(logger_t *lp)
+{
+    pmcd_host_conn = lp->l_host;
+    pmcdfd = lp->l_pmcdfd;
+    pmcd_host = lp->l_pmcd_host;
+    archName = lp->l_archName;
+    logctl = lp->l_logctl;		/* struct assignment */
+    archctl = lp->l_archctl;		/* struct assignment */
+    archctl.ac_log = &logctl;
+    tasklist = lp->l_tasklist;
+    pm_hash = lp->l_pm_hash;		/* struct assignment */
+    hist_hash = lp->l_hist_hash;	/* struct assignment */
+    dyn_roots = lp->l_dyn_roots;
+    n_dyn_roots = lp->l_n_dyn_roots;
+    epoch = lp->l_epoch;		/* struct assignment */
+    last_stamp = lp->l_last_stamp;	/* struct assignment */
+    last_log_offset = lp->l_last_log_offset;
+    flushsize = lp->l_flushsize;
+    vol_bytes = lp->l_vol_bytes;
+    vol_samples_counter = lp->l_vol_samples_counter;
+    logbuf = lp->l_logbuf;		/* struct assignment */
+    prefetch = lp->l_prefetch;
+    if (lp->l_ctx >= 0)
+	pmUseContext(lp->l_ctx);
+}
+
+/*
+ * Make lp the current host
+ */
+void
+farm_switch(logger_t *lp)
+{
+    if (lp == current)
+	return;
+    if (current != NULL)
+	save(current);
+    restore(lp);
+    current = lp;
+}
+
+/*
+ * Warning: called in signal handler context ... be careful
+ */
+static void
+retry_callback(int i, void *j)
+{
+    farm_retry_alarm = 1;
+}
+
+/*
+ * Free the task list and logging history of the current host, left
+ * from an earlier farm_setup(), before the config is parsed again
+ */
+static void
+drop_tasks(void)
+{
+    __pmHashNode	*hp;
+    optreq_t		*rqp;
+    pmidhist_t		*php;
+    task_t		*tp;
+    int			i;
+
+    /* every optreq_t is in pm_hash, and in the fetch groups of one task */
+    for (hp = __pmHashWalk(&pm_hash, PM_HASH_WALK_START); hp != NULL;
+	 hp = __pmHashWalk(&pm_hash, PM_HASH_WALK_NEXT)) {
+	rqp = (optreq_t *)hp->data;
+	tp = (task_t *)rqp->r_fetch->f_aux;
+	__pmOptFetchDel(&tp->t_fetch, rqp);
+	free(rqp->r_desc);
+	free(rqp->r_instlist);
+	free(rqp);
+    }
+    __pmHashFree(&pm_hash);
+
+    for (hp = __pmHashWalk(&hist_hash, PM_HASH_WALK_START); hp != NULL;
+	 hp = __pmHashWalk(&hist_hash, PM_HASH_WALK_NEXT)) {
+	php = (pmidhist_t *)hp->data;
+	free(php->ph_instlist);
+	free(php);
+    }
+    __pmHashFree(&hist_hash);
+
+    while ((tp = tasklist) != NULL) {
+	tasklist = tp->t_next;
+	if (tp->t_afid != 0)
+	    __pmAFunregister(tp->t_afid);
+	for (i = 0; i < tp->t_numpmid; i++)
+	    free(tp->t_namelist[i]);
+	free(tp->t_namelist);
+	free(tp->t_pmidlist);
+	free(tp->t_desclist);
+	free(tp);
+    }
+}
+
+/*
+ * Connect to the pmcd for the current host lp, parse the config and
+ * create the archive ... returns < 0 if any of this fails, and
+ * farm_retry() will try again later
+ */
+static int
+farm_setup(logger_t *lp, int retry)
+{
+    __pmContext	*ctxp;
+    char	*base;
+    int		make_uniq;
+    int		sts;
+
+    if (lp->l_ctx < 0) {
+	if ((lp->l_ctx = pmNewContext(PM_CONTEXT_HOST, lp->l_host)) < 0) {
+	    if (!retry)
+		fprintf(stderr, "%s: Cannot connect to PMCD on host \"%s\": %s, will retry\n",
+			pmGetProgname(), lp->l_host, pmErrStr(lp->l_ctx));
+	    return lp->l_ctx;
+	}
+	if ((pmcd_host = strdup(pmGetContextHostName(lp->l_ctx))) == NULL) {
+	    pmNoMem("farm_setup: pmcd_host", strlen(lp->l_host), PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+    }
+    else if (pmcdfd < 0 && (sts = pmReconnectContext(lp->l_ctx)) < 0)
+	return sts;
+    if ((ctxp = __pmHandleToPtr(lp->l_ctx)) != NULL) {
+	pmcdfd = ctxp->c_pmcd->pc_fd;
+	PM_UNLOCK(ctxp->c_lock);
+    }
+
+    drop_tasks();
+    cache_rebind();
+    rewind(config);
+    yyreset(config);
+    if (yyparse() != 0) {
+	if (!retry)
+	    fprintf(stderr, "%s: config errors for host \"%s\", will retry\n",
+		    pmGetProgname(), lp->l_host);
+	return PM_ERR_GENERIC;
+    }
+    if (tasklist == NULL) {
+	if (!retry)
+	    fprintf(stderr, "%s: nothing to log for host \"%s\", will retry\n",
+		    pmGetProgname(), lp->l_host);
+	return PM_ERR_GENERIC;
+    }
+    yyend();
+
+    /* an archive from before the host was given up needs a new name */
+    base = archive_base(lp->l_archBase, &make_uniq);
+    if (archName != NULL) {
+	free(archName);
+	make_uniq = 1;
+    }
+    archive_create(base, make_uniq);
+    free(base);
+    archive_timezone(lp->l_ctx, 0);
+    if ((sts = do_prologue()) < 0)
+	fprintf(stderr, "Warning: problem writing archive prologue for \"%s\": %s\n",
+		lp->l_host, pmErrStr(sts));
+    lp->l_ready = 1;
+
+    fprintf(stderr, "Starting logger for host \"%s\" via \"%s\", archive basename: %s\n",
+	    pmcd_host, lp->l_host, archName);
+    return 0;
+}
+
+/*
+ * Set up all the hosts after the lead, called once the lead is
+ * logging, with cfg being the output from pass0()
+ */
+void
+farm_start(FILE *cfg)
+{
+    struct timeval	retry_delta = { RETRY_DELTA, 0 };
+    logger_t		*lp;
+
+    current = farm;
+    farm->l_ctx = pmWhichContext();
+    farm->l_ready = 1;
+    /* pmGetContextHostName() result is only good until the next call */
+    pmcd_host = strdup(pmcd_host);
+    config_replay = 1;
+    config = cfg;
+
+    for (lp = farm->l_next; lp != NULL; lp = lp->l_next) {
+	farm_switch(lp);
+	farm_setup(lp, 0);
+    }
+
+    farm_switch(farm);
+    __pmAFregister(&retry_delta, NULL, retry_callback);
+}
+
+/*
+ * Try again for the hosts that are not logging, called when
+ * retry_callback() has set farm_retry_alarm
+ */
+void
+farm_retry(void)
+{
+    logger_t	*lp;
+
+    for (lp = farm; lp != NULL; lp = lp->l_next) {
+	if (lp->l_ready)
+	    continue;
+	farm_switch(lp);
+	farm_setup(lp, 1);
+    }
+    farm_switch(farm);
+}
+
+/*
+ * The current host cannot go on (metrics changed after a pmcd state
+ * change, or the <mark> record cannot be written), so its archive is
+ * closed once its alarmed tasks are done, see farm_tasks()
+ */
+int
+farm_fail(int sts)
+{
+    if (current != NULL)
+	current->l_failed = 1;
+    return sts;
+}
+
+int
+farm_failed(void)
+{
+    return current != NULL && current->l_failed;
+}
+
+/*
+ * Do the alarmed tasks for lp, all replies from pmcd are in
+ */
+static void
+farm_tasks(logger_t *lp)
+{
+    task_t	*tp;
+
+    farm_switch(lp);
+    lp->l_work = 0;
+    for (tp = tasklist; tp != NULL; tp = tp->t_next) {
+	if (!tp->t_alarm)
+	    continue;
+	if (!lp->l_failed)
+	    do_work(tp);
+	tp->t_alarm = 0;
+    }
+    /* any replies not collected by do_work() */
+    fetch_drain();
+
+    if (lp->l_failed) {
+	fprintf(stderr, "%s: logging stopped for host \"%s\", archive %s closed, will retry\n",
+		pmGetProgname(), lp->l_host, archName);
+	archive_close();
+	/* sendstatus() for the lead checks this */
+	archctl.ac_mfp = NULL;
+	lp->l_ready = 0;
+	lp->l_failed = 0;
+    }
+}
+
+/*
+ * Do all the alarmed tasks, for all hosts
+ */
+void
+farm_work(void)
+{
+    logger_t		*lp;
+    task_t		*tp;
+    fetchctl_t		*fp;
+    __pmFdSet		readyfds;
+    struct timeval	timeout;
+    int			nfds;
+    int			nready = 0;
+
+    __pmAFblock();
+
+    /* first send the requests for all alarmed tasks of all hosts ... */
+    for (lp = farm; lp != NULL; lp = lp->l_next) {
+	lp->l_work = 0;
+	if (!lp->l_ready)
+	    continue;
+	farm_switch(lp);
+	for (tp = tasklist; tp != NULL; tp = tp->t_next) {
+	    if (!tp->t_alarm)
+		continue;
+	    lp->l_work = 1;
+	    for (fp = tp->t_fetch; fp != NULL; fp = fp->f_next) {
+		fetch_profile(fp);
+		fetch_send(fp->f_numpmid, fp->f_pmidlist);
+	    }
+	}
+    }
+
+    /* ... then do the work for each host once all of its replies are in */
+    for ( ; ; ) {
+	__pmFD_ZERO(&readyfds);
+	nfds = 0;
+	for (lp = farm; lp != NULL; lp = lp->l_next) {
+	    if (!lp->l_work)
+		continue;
+	    farm_switch(lp);
+	    if (nready >= 0 && pmcdfd >= 0 && fetch_pending()) {
+		__pmFD_SET(pmcdfd, &readyfds);
+		if (pmcdfd >= nfds)
+		    nfds = pmcdfd + 1;
+	    }
+	    else
+		/* or myFetch() waits for the replies, if select failed */
+		farm_tasks(lp);
+	}
+	if (nfds == 0)
+	    break;
+
+	pmtimevalFromReal(__pmRequestTimeout(), &timeout);
+	nready = __pmSelectRead(nfds, &readyfds, &timeout);
+	if (nready < 0) {
+	    if (neterror() == EINTR)
+		nready = 0;
+	    else
+		fprintf(stderr, "Error: farm select: %s\n", netstrerror());
+	    continue;
+	}
+
+	for (lp = farm; lp != NULL; lp = lp->l_next) {
+	    if (!lp->l_work)
+		continue;
+	    farm_switch(lp);
+	    if (pmcdfd < 0 || !fetch_pending())
+		continue;
+	    if (__pmFD_ISSET(pmcdfd, &readyfds))
+		fetch_recv();
+	    else if (nready == 0)
+		/* no reply in time, reconnect on the next fetch */
+		disconnect(-ETIMEDOUT);
+	}
+    }
+
+    farm_switch(farm);
+    __pmAFunblock();
+}
+
+/*
+ * pmlc control request in pb ... apply it to all the hosts except
+ * the lead, which is left to do_control() so that the result goes
+ * back to pmlc.
+ * pmlc looked up the metrics on the lead, so any metric this host
+ * does not have is skipped.
+ */
+void
+farm_control(const __pmPDU *pb)
+{
+    logger_t	*lp;
+    __pmResult	*request;
+    pmDesc	desc;
+    int		control;
+    int		state;
+    int		ldelta;
+    int		i;
+    int		j;
+
+    for (lp = farm->l_next; lp != NULL; lp = lp->l_next) {
+	if (!lp->l_ready)
+	    continue;
+	farm_switch(lp);
+	if (__pmDecodeLogControl(pb, &request, &control, &state, &ldelta) < 0)
+	    break;
+	for (i = j = 0; i < request->numpmid; i++) {
+	    if (pmLookupDesc(request->vset[i]->pmid, &desc) < 0) {
+		free(request->vset[i]);
+		continue;
+	    }
+	    request->vset[j++] = request->vset[i];
+	}
+	request->numpmid = j;
+	if (j > 0)
+	    do_control_req(request, control, state, ldelta, 0);
+	else
+	    __pmFreeResult(request);
+    }
+    farm_switch(farm);
+}
+
+/*
+ * New volume for all hosts, returns the status for the lead
+ */
+int
+farm_newvolume(int vol_switch_type)
+{
+    logger_t	*lp;
+    int		sts = PM_ERR_NOTCONN;
+    int		lsts;
+
+    for (lp = farm; lp != NULL; lp = lp->l_next) {
+	if (!lp->l_ready)
+	    continue;
+	farm_switch(lp);
+	lsts = newvolume(vol_switch_type);
+	if (lp == farm)
+	    sts = lsts;
+    }
+    farm_switch(farm);
+    return sts;
+}
+
+void
+farm_flush(void)
+{
+    logger_t	*lp;
+
+    for (lp = farm; lp != NULL; lp = lp->l_next) {
+	if (!lp->l_ready)
+	    continue;
+	farm_switch(lp);
+	flushlog();
+    }
+    farm_switch(farm);
+}
+
+/*
+ * Close the archives for all hosts, the lead is left current for
+ * run_done() to finish off
+ */
+void
+farm_done(void)
+{
+    logger_t	*lp;
+
+    if (current == NULL) {
+	/* farm_start() not done, only the lead to close */
+	archive_close();
+	return;
+    }
+    for (lp = farm; lp != NULL; lp = lp->l_next) {
+	if (!lp->l_ready)
+	    continue;
+	farm_switch(lp);
+	archive_close();
+	lp->l_ready = 0;
+    }
+    farm_switch(farm);
+}
@@ -45,6 +45,309 @@ myLocalFetch(__pmContext *ctxp, int numpmid, pmID pmidlist[], __pmResult **resul
     return 0;
 }
 
+prefetch_t	*prefetch;	/* requests already sent to pmcd, see fetch_send() */
+
+/*
+ * Send the profile (if needed) and the fetch request to pmcd,
+ * remembering what was sent in pfp so that the reply can be
+ * decoded later by recvfetch().
+ */
+static int
+sendfetch(__pmContext *ctxp, int ctx, int fd, int numpmid, pmID pmidlist[], prefetch_t *pfp)
+{
+    int		n = 0;
+    int		newcnt;
+
+    pfp->pmidlist = pmidlist;
+    pfp->numpmid = numpmid;
+    pfp->newlist = NULL;
+    pfp->have_dm = 0;
+    pfp->highres = 0;
+
+    if (ctxp->c_sent == 0) {
+	/*
+	 * current profile is _not_ already cached at other end of
+	 * IPC, so send current profile
+	 */
+	if (pmDebugOptions.profile)
+	    fprintf(stderr, "myFetch: calling __pmSendProfile, context: %d\n", ctx);
+	if ((n = __pmSendProfile(fd, FROM_ANON, ctx, ctxp->c_instprof)) >= 0)
+	    ctxp->c_sent = 1;
+    }
+    if (n < 0)
+	return n;
+
+    /* for derived metrics, may need to rewrite the pmidlist */
+    pfp->have_dm = newcnt = __pmPrepareFetch(ctxp, numpmid, pmidlist, &pfp->newlist);
+    if (newcnt > numpmid) {
+	numpmid = newcnt;
+	pmidlist = pfp->newlist;
+    }
+
+    if ((__pmFeaturesIPC(fd) & PDU_FLAG_HIGHRES))
+	pfp->highres = 1;
+    n = __pmSendFetchPDU(fd, FROM_ANON, ctx, numpmid, pmidlist,
+			pfp->highres ? PDU_HIGHRES_FETCH : PDU_FETCH);
+    if (n < 0)
+	fprintf(stderr, "Error: __pmSendFetch: %s\n", pmErrStr(n));
+    return n;
+}
+
+/*
+ * Read and decode one PDU of the reply to the request described by
+ * pfp.  Returns 0 for a PMCD state change (flags are or'd into
+ * changed) when the result is still to come.
+ */
+static int
+recvpdu(__pmContext *ctxp, int fd, prefetch_t *pfp, __pmResult **result, int *changed)
+{
+    int		n;
+    int		sts;
+    int		highres = pfp->highres;
+    __pmPDU	*pb;
+
+    n = __pmGetPDU(fd, ANY_SIZE, TIMEOUT_DEFAULT, &pb);
+    /*
+     * expect PDU_[HIGHRES_]RESULT or
+     *        PDU_DELTA_RESULT (in place of PDU_HIGHRES_RESULT) or
+     *        PDU_ERROR(changed > 0)+PDU_[HIGHRES_]RESULT or
+     *        PDU_ERROR(real error < 0 from PMCD) or
+     *        0 (end of file)
+     *        < 0 (local error or IPC problem)
+     *        other (bogus PDU)
+     */
+
+    if (pmDebugOptions.fetch) {
+	fprintf(stderr, "myFetch returns ...\n");
+	if (n == PDU_ERROR) {
+	    int		flag = 0;
+
+	    __pmDecodeError(pb, &sts);
+	    fprintf(stderr, "PMCD state changes: ");
+	    if (sts & PMCD_AGENT_CHANGE) {
+		fprintf(stderr, "agent(s)");
+		if (sts & PMCD_ADD_AGENT) fprintf(stderr, " added");
+		if (sts & PMCD_RESTART_AGENT) fprintf(stderr, " restarted");
+		if (sts & PMCD_DROP_AGENT) fprintf(stderr, " dropped");
+		flag++;
+	    }
+	    if (sts & PMCD_LABEL_CHANGE) {
+		if (flag++)
+		    fprintf(stderr, ", ");
+		fprintf(stderr, "label change");
+	    }
+	    if (sts & PMCD_NAMES_CHANGE) {
+		if (flag++)
+		    fprintf(stderr, ", ");
+		fprintf(stderr, "names change");
+	    }
+	    fputc('\n', stderr);
+	}
+	else if ((n == PDU_HIGHRES_RESULT || n == PDU_DELTA_RESULT) && !highres)
+	    fprintf(stderr, "__pmGetPDU: bad %s\n", __pmPDUTypeStr(n));
+	else if (n == PDU_RESULT && highres)
+	    fprintf(stderr, "__pmGetPDU: bad PDU_RESULT\n");
+	else
+	    fprintf(stderr, "__pmGetPDU: Error: %s\n", pmErrStr(n));
+    }
+
+    if (((n == PDU_HIGHRES_RESULT || n == PDU_DELTA_RESULT) && highres) ||
+	(n == PDU_RESULT && !highres)) {
+	/* Success with a result in a PDU buffer */
+	PM_LOCK(ctxp->c_lock);
+	if (n == PDU_RESULT)
+	    sts = __pmDecodeResult_ctx(ctxp, pb, result);
+	else if (n == PDU_DELTA_RESULT)
+	    sts = __pmDecodeDeltaResult_ctx(ctxp, pb, result);
+	else
+	    sts = __pmDecodeHighResResult_ctx(ctxp, pb, result);
+	__pmUnpinPDUBuf(pb);
+	if (sts < 0)
+	    n = sts;
+	else if (pfp->have_dm)
+	    __pmFinishResult(ctxp, sts, result);
+	PM_UNLOCK(ctxp->c_lock);
+    }
+    else if (n == PDU_ERROR) {
+	__pmDecodeError(pb, &n);
+	if (n > 0) {
+	    /* PMCD state change protocol */
+	    *changed |= n;
+	    n = 0;
+	}
+	else {
+	    fprintf(stderr, "myFetch: ERROR PDU: %s\n", pmErrStr(n));
+	    disconnect(PM_ERR_IPC);
+	    *changed = 0;
+	}
+	__pmUnpinPDUBuf(pb);
+    }
+    else if (n == 0) {
+	fprintf(stderr, "myFetch: End of File: PMCD exited?\n");
+	disconnect(PM_ERR_IPC);
+	n = PM_ERR_IPC;
+	*changed = 0;
+    }
+    else if (n == -EINTR) {
+	/* SIGINT, let the normal cleanup happen */
+	;
+    }
+    else if (n < 0) {
+	/* other badness, disconnect */
+	fprintf(stderr, "myFetch: __pmGetPDU: Error: %s\n", pmErrStr(n));
+	disconnect(PM_ERR_IPC);
+	*changed = 0;
+    }
+    else {
+	/* protocol botch, disconnect */
+	fprintf(stderr, "myFetch: Unexpected %s PDU from PMCD\n", __pmPDUTypeStr(n));
+	__pmDumpPDUTrace(stderr);
+	disconnect(PM_ERR_IPC);
+	*changed = 0;
+	__pmUnpinPDUBuf(pb);
+    }
+
+    return n;
+}
+
+/*
+ * Wait for and decode the reply to the request described by pfp.
+ * PMCD state change flags are returned via changed.
+ */
+static int
+recvfetch(__pmContext *ctxp, int fd, prefetch_t *pfp, __pmResult **result, int *changed)
+{
+    int		n;
+
+    *changed = 0;
+    do {
+	n = recvpdu(ctxp, fd, pfp, result, changed);
+    } while (n == 0);
+
+    return n;
+}
+
+static __pmContext *
+fetch_context(int *ctx)
+{
+    __pmContext		*ctxp;
+
+    if ((*ctx = pmWhichContext()) < 0)
+	return NULL;
+    if ((ctxp = __pmHandleToPtr(*ctx)) == NULL)
+	return NULL;
+    PM_UNLOCK(ctxp->c_lock);
+    return ctxp;
+}
+
+/*
+ * Send the fetch request for a fetch group ahead of myFetch(), so
+ * that in multi-host mode the requests to all pmcds are in flight
+ * together ... requests are queued in the order sent, and myFetch()
+ * for the same pmidlist collects the reply from the head of the queue.
+ */
+int
+fetch_send(int numpmid, pmID pmidlist[])
+{
+    int			ctx;
+    int			fd;
+    __pmContext		*ctxp;
+    prefetch_t		*pfp;
+    prefetch_t		**tail;
+
+    if ((ctxp = fetch_context(&ctx)) == NULL)
+	return PM_ERR_NOCONTEXT;
+    if (ctxp->c_type != PM_CONTEXT_HOST || (fd = ctxp->c_pmcd->pc_fd) < 0)
+	return 0;
+
+    if ((pfp = (prefetch_t *)calloc(1, sizeof(prefetch_t))) == NULL) {
+	pmNoMem("fetch_send", sizeof(prefetch_t), PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    for (tail = &prefetch; *tail != NULL; tail = &(*tail)->next)
+	;
+    *tail = pfp;
+    if ((pfp->sts = sendfetch(ctxp, ctx, fd, numpmid, pmidlist, pfp)) < 0)
+	pfp->done = 1;
+    return pfp->sts;
+}
+
+/*
+ * Is any reply to a request from fetch_send() still to come?
+ */
+int
+fetch_pending(void)
+{
+    prefetch_t		*pfp;
+
+    for (pfp = prefetch; pfp != NULL; pfp = pfp->next) {
+	if (!pfp->done)
+	    return 1;
+    }
+    return 0;
+}
+
+/*
+ * Called when the pmcd socket is readable, read one PDU of the reply
+ * to the oldest request from fetch_send() still to be answered ...
+ * returns < 0 if the connection to pmcd has been lost.
+ */
+int
+fetch_recv(void)
+{
+    int			ctx;
+    int			fd;
+    __pmContext		*ctxp;
+    prefetch_t		*pfp;
+
+    for (pfp = prefetch; pfp != NULL; pfp = pfp->next) {
+	if (!pfp->done)
+	    break;
+    }
+    if (pfp == NULL)
+	return 0;
+    if ((ctxp = fetch_context(&ctx)) == NULL)
+	return PM_ERR_NOCONTEXT;
+    if ((fd = ctxp->c_pmcd->pc_fd) < 0)
+	return PM_ERR_IPC;
+
+    if ((pfp->sts = recvpdu(ctxp, fd, pfp, &pfp->result, &pfp->changed)) != 0)
+	pfp->done = 1;
+    return ctxp->c_pmcd->pc_fd < 0 ? PM_ERR_IPC : 0;
+}
+
+static void
+fetch_free(prefetch_t *pfp)
+{
+    if (pfp->result != NULL)
+	__pmFreeResult(pfp->result);
+    free(pfp->newlist);
+    free(pfp);
+}
+
+/*
+ * Discard all the requests from fetch_send() not collected by
+ * myFetch(), waiting for any replies still to come
+ */
+void
+fetch_drain(void)
+{
+    int			ctx;
+    int			fd;
+    int			changed;
+    __pmContext		*ctxp;
+    prefetch_t		*pfp;
+
+    ctxp = fetch_context(&ctx);
+    while ((pfp = prefetch) != NULL) {
+	prefetch = pfp->next;
+	if (!pfp->done && pfp->sts >= 0 && ctxp != NULL &&
+	    (fd = ctxp->c_pmcd->pc_fd) >= 0)
+	    recvfetch(ctxp, fd, pfp, &pfp->result, &changed);
+	fetch_free(pfp);
+    }
+}
+
 int
 myFetch(int numpmid, pmID pmidlist[], __pmResult **result)
 {
@@ -53,7 +356,8 @@ myFetch(int numpmid, pmID pmidlist[], __pmResult **result)
     int			sts;
     int			changed = 0;
     int			ctx;
-    __pmPDU		*pb;
+    prefetch_t		pf;
+    prefetch_t		*pfp = NULL;
     __pmContext		*ctxp;
 
     if (numpmid < 1)
@@ -81,192 +385,93 @@ myFetch(int numpmid, pmID pmidlist[], __pmResult **result)
 	return PM_ERR_NOCONTEXT;
 
     if ((fd = ctxp->c_pmcd->pc_fd) < 0) {
-	/* lost connection, try to get it back */
+	/* lost connection, any requests sent earlier are gone too */
+	fetch_drain();
+	/* try to get it back */
 	n = reconnect();
 	if (n < 0)
 	    return n;
 	fd = ctxp->c_pmcd->pc_fd;
     }
 
-    if (ctxp->c_sent == 0) {
-	/*
-	 * current profile is _not_ already cached at other end of
-	 * IPC, so send current profile
-	 */
-	if (pmDebugOptions.profile)
-	    fprintf(stderr, "myFetch: calling __pmSendProfile, context: %d\n", ctx);
-	if ((n = __pmSendProfile(fd, FROM_ANON, ctx, ctxp->c_instprof)) >= 0)
-	    ctxp->c_sent = 1;
+    if (prefetch != NULL) {
+	if (prefetch->pmidlist == pmidlist && prefetch->numpmid == numpmid) {
+	    pfp = prefetch;
+	    prefetch = pfp->next;
+	}
+	else {
+	    /* not this request, discard the earlier replies and start over */
+	    fetch_drain();
+	    if ((fd = ctxp->c_pmcd->pc_fd) < 0)
+		n = PM_ERR_IPC;
+	}
     }
 
-    if (n >= 0) {
-	pmID		*newlist = NULL;
-	int		newcnt;
-	int		have_dm;
-	int		highres;
-	int		pdutype;
-
-	/* for derived metrics, may need to rewrite the pmidlist */
-	have_dm = newcnt = __pmPrepareFetch(ctxp, numpmid, pmidlist, &newlist);
-	if (newcnt > numpmid) {
-	    /* replace args passed into myFetch */
-	    numpmid = newcnt;
-	    pmidlist = newlist;
+    if (pfp != NULL) {
+	/* sent by fetch_send(), reply may have been read by fetch_recv() */
+	if (pfp->done) {
+	    n = pfp->sts;
+	    changed = pfp->changed;
+	    *result = pfp->result;
+	    pfp->result = NULL;
 	}
+	else
+	    n = recvfetch(ctxp, fd, pfp, result, &changed);
+	fetch_free(pfp);
+    }
+    else if (n >= 0) {
+	n = sendfetch(ctxp, ctx, fd, numpmid, pmidlist, &pf);
+	if (n >= 0)
+	    n = recvfetch(ctxp, fd, &pf, result, &changed);
+	if (pf.newlist != NULL)
+	    free(pf.newlist);
+    }
 
-	if ((__pmFeaturesIPC(fd) & PDU_FLAG_HIGHRES)) {
-	    pdutype = PDU_HIGHRES_FETCH;
-	    highres = 1;
-	} else {
-	    pdutype = PDU_FETCH;
-	    highres = 0;
+    if (n >= 0) {
+	if (changed & PMCD_NAMES_CHANGE) {
+	    /*
+	     * Fetch has returned with the PMCD_NAMES_CHANGE flag set.
+	     */
+	    check_dynamic_metrics();
 	}
-	n = __pmSendFetchPDU(fd, FROM_ANON, ctx, numpmid, pmidlist, pdutype);
-	if (n >= 0) {
-	    do {
-		n = __pmGetPDU(fd, ANY_SIZE, TIMEOUT_DEFAULT, &pb);
-		/*
-		 * expect PDU_[HIGHRES_]RESULT or
-		 *        PDU_ERROR(changed > 0)+PDU_[HIGHRES_]RESULT or
-		 *        PDU_ERROR(real error < 0 from PMCD) or
-		 *        0 (end of file)
-		 *        < 0 (local error or IPC problem)
-		 *        other (bogus PDU)
-		 */
-
-		if (pmDebugOptions.fetch) {
-		    fprintf(stderr, "myFetch returns ...\n");
-		    if (n == PDU_ERROR) {
-			int		flag = 0;
-
-			__pmDecodeError(pb, &sts);
-			fprintf(stderr, "PMCD state changes: ");
-			if (sts & PMCD_AGENT_CHANGE) {
-			    fprintf(stderr, "agent(s)");
-			    if (sts & PMCD_ADD_AGENT) fprintf(stderr, " added");
-			    if (sts & PMCD_RESTART_AGENT) fprintf(stderr, " restarted");
-			    if (sts & PMCD_DROP_AGENT) fprintf(stderr, " dropped");
-			    flag++;
-			}
-			if (sts & PMCD_LABEL_CHANGE) {
-			    if (flag++)
-				fprintf(stderr, ", ");
-			    fprintf(stderr, "label change");
-			}
-			if (sts & PMCD_NAMES_CHANGE) {
-			    if (flag++)
-				fprintf(stderr, ", ");
-			    fprintf(stderr, "names change");
-			}
-			fputc('\n', stderr);
-		    }
-		    else if (n == PDU_HIGHRES_RESULT && !highres)
-			fprintf(stderr, "__pmGetPDU: bad PDU_HIGHRES_RESULT\n");
-		    else if (n == PDU_RESULT && highres)
-			fprintf(stderr, "__pmGetPDU: bad PDU_RESULT\n");
-		    else
-			fprintf(stderr, "__pmGetPDU: Error: %s\n", pmErrStr(n));
-		}
-
-		if ((n == PDU_HIGHRES_RESULT && highres) ||
-		    (n == PDU_RESULT && !highres)) {
-		    /* Success with a result in a PDU buffer */
-		    PM_LOCK(ctxp->c_lock);
-		    sts = (n == PDU_RESULT) ?
-			    __pmDecodeResult_ctx(ctxp, pb, result) :
-			    __pmDecodeHighResResult_ctx(ctxp, pb, result);
-		    __pmUnpinPDUBuf(pb);
-		    if (sts < 0)
-			n = sts;
-		    else if (have_dm)
-			__pmFinishResult(ctxp, sts, result);
-		    PM_UNLOCK(ctxp->c_lock);
-		}
-		else if (n == PDU_ERROR) {
-		    __pmDecodeError(pb, &n);
-		    if (n > 0) {
-			/* PMCD state change protocol */
-			changed = n;
-			n = 0;
-		    }
-		    else {
-			fprintf(stderr, "myFetch: ERROR PDU: %s\n", pmErrStr(n));
-			disconnect(PM_ERR_IPC);
-			changed = 0;
-		    }
-		    __pmUnpinPDUBuf(pb);
-		}
-		else if (n == 0) {
-		    fprintf(stderr, "myFetch: End of File: PMCD exited?\n");
-		    disconnect(PM_ERR_IPC);
-		    n = PM_ERR_IPC;
-		    changed = 0;
-		}
-		else if (n == -EINTR) {
-		    /* SIGINT, let the normal cleanup happen */
-		    ;
-		}
-		else if (n < 0) {
-		    /* other badness, disconnect */
-		    fprintf(stderr, "myFetch: __pmGetPDU: Error: %s\n", pmErrStr(n));
-		    disconnect(PM_ERR_IPC);
-		    changed = 0;
-		}
-		else {
-		    /* protocol botch, disconnect */
-		    fprintf(stderr, "myFetch: Unexpected %s PDU from PMCD\n", __pmPDUTypeStr(n));
-		    __pmDumpPDUTrace(stderr);
-		    disconnect(PM_ERR_IPC);
-		    changed = 0;
-		    __pmUnpinPDUBuf(pb);
-		}
-	    } while (n == 0);
-
-	    if (changed & PMCD_NAMES_CHANGE) {
-		/*
-		 * Fetch has returned with the PMCD_NAMES_CHANGE flag set.
-		 */
-		check_dynamic_metrics();
+
+	if (changed & PMCD_ADD_AGENT) {
+	    /*
+	     * PMCD_DROP_AGENT does not matter, no values are returned.
+	     * Trying to restart (PMCD_RESTART_AGENT) is less interesting
+	     * than when we actually start (PMCD_ADD_AGENT) ... the latter
+	     * is also set when a successful restart occurs, but more
+	     * to the point the sequence Install-Remove-Install does
+	     * not involve a restart ... it is the second Install that
+	     * generates the second PMCD_ADD_AGENT that we need to be
+	     * particularly sensitive to, as this may reset counter
+	     * metrics.
+	     *
+	     * The potentially new instance of the agent may also be an
+	     * updated one, so it's PMNS could have changed. We need to
+	     * recheck each metric to make sure that its pmid and semantics
+	     * have not changed.
+	     * This call will not return if there is an incompatible change,
+	     * except for -M where only this host is given up.
+	     */
+	    if ((sts = validate_metrics()) < 0) {
+		__pmFreeResult(*result);
+		return farm_fail(sts);
 	    }
 
-	    if (changed & PMCD_ADD_AGENT) {
-		/*
-		 * PMCD_DROP_AGENT does not matter, no values are returned.
-		 * Trying to restart (PMCD_RESTART_AGENT) is less interesting
-		 * than when we actually start (PMCD_ADD_AGENT) ... the latter
-		 * is also set when a successful restart occurs, but more
-		 * to the point the sequence Install-Remove-Install does
-		 * not involve a restart ... it is the second Install that
-		 * generates the second PMCD_ADD_AGENT that we need to be
-		 * particularly sensitive to, as this may reset counter
-		 * metrics.
-		 *
-		 * The potentially new instance of the agent may also be an
-		 * updated one, so it's PMNS could have changed. We need to
-		 * recheck each metric to make sure that its pmid and semantics
-		 * have not changed.
-		 * This call will not return if there is an incompatible change.
-		 */
-		validate_metrics();
-
-		if (changed & PMCD_ADD_AGENT) {
-		     /*
-		      * All metrics have been validated, however, the state change
-		      * PMCD_ADD_AGENT represents a potential gap in the stream of
-		      * metrics. So we generate a <mark> record for this case.
-		      */
-		    if ((sts = putmark()) < 0) {
-			fprintf(stderr, "putmark: %s\n", pmErrStr(sts));
-			exit(1);
-		    }
-		}
+	    /*
+	     * All metrics have been validated, however, the state change
+	     * PMCD_ADD_AGENT represents a potential gap in the stream of
+	     * metrics. So we generate a <mark> record for this case.
+	     */
+	    if ((sts = putmark()) < 0) {
+		fprintf(stderr, "putmark: %s\n", pmErrStr(sts));
+		if (farm == NULL)
+		    exit(1);
+		__pmFreeResult(*result);
+		return farm_fail(sts);
 	    }
 	}
-	else {
-	    fprintf(stderr, "Error: __pmSendFetch: %s\n", pmErrStr(n));
-	}
-	if (newlist != NULL)
-	    free(newlist);
     }
 
     if (n < 0) {
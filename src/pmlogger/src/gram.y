@@ -33,6 +33,7 @@
 #include "logger.h"
 
 int		mystate = GLOBAL;	/* config file parser state */
+int		config_replay;		/* config parsed before, for -M */
 
 __pmHashCtl	pm_hash;
 task_t		*tasklist;		/* task list for logging configuration */
@@ -328,8 +329,12 @@ ctl		: allow hostlist COLON operation SEMICOLON
                             free(prevhlp->hl_name);
                             free(prevhlp);
                         }
-                        sts = __pmAccAddHost(hlp->hl_name, specmask, 
-                                             opmask, 0);
+                        /* access control is per-process, set up once */
+                        if (config_replay)
+                            sts = 0;
+                        else
+                            sts = __pmAccAddHost(hlp->hl_name, specmask, 
+                                                 opmask, 0);
                         if (sts < 0) {
                             fprintf(stderr, "error was on line %d\n", 
                                 hlp->hl_line);
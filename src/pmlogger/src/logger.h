@@ -123,6 +123,9 @@ extern __pmTimestamp	epoch;
 /* offset to start of last written result */
 extern int	last_log_offset;
 
+/* temporal index is next written beyond this data file offset */
+extern off_t	flushsize;
+
 /* yylex() gets input from here ... */
 extern FILE		*fconfig;
 extern FILE		*yyin;
@@ -130,6 +133,10 @@ extern char		*configfile;
 extern int		lineno;
 
 extern int myFetch(int, pmID *, __pmResult **);
+extern int fetch_send(int, pmID *);
+extern int fetch_pending(void);
+extern int fetch_recv(void);
+extern void fetch_drain(void);
 extern void yyerror(char *);
 extern void yywarn(char *);
 extern void yylinemarker(char *);
@@ -141,11 +148,12 @@ extern void freeinst(int *, int *, char **);
 extern void linkback(task_t *);
 extern optreq_t *findoptreq(pmID, int);
 extern void log_callback(int, void *);
+extern void fetch_profile(fetchctl_t *);
 extern void do_work(task_t *);
 extern int chk_one(task_t *, pmID, int);
 extern int chk_all(task_t *, pmID);
 extern int newvolume(int);
-extern void validate_metrics(void);
+extern int validate_metrics(void);
 extern void check_dynamic_metrics();
 extern int do_control_req(__pmResult *, int, int, int, int);
 
@@ -202,6 +210,90 @@ extern int		parse_done;
 extern __int64_t	exit_bytes;
 extern __int64_t	vol_bytes;
 extern int		sig_code;
+extern int		pmcdfd;		/* comms to pmcd */
+
+/* buffered archive writes - buffer.c */
+typedef struct {
+    size_t		pending;	/* data bytes buffered, not flushed */
+    unsigned int	batch;		/* data records buffered, not flushed */
+} logbuf_t;
+
+extern int		log_bufsize;		/* -b, 0 => unbuffered */
+extern struct timeval	flush_interval;		/* -F */
+extern logbuf_t		logbuf;
+extern void startstats(void);
+extern void logwrite(size_t);
+extern void flushlog(void);
+
+/* a fetch request sent ahead of myFetch(), see fetch_send() */
+typedef struct prefetch_s {
+    struct prefetch_s	*next;		/* in the order sent */
+    pmID		*pmidlist;	/* as passed by caller */
+    int			numpmid;
+    pmID		*newlist;	/* rewritten for derived metrics */
+    int			have_dm;
+    int			highres;
+    int			sts;		/* from the send, then the reply */
+    int			done;		/* reply received, see fetch_recv() */
+    int			changed;	/* PMCD state change flags */
+    __pmResult		*result;
+} prefetch_t;
+
+extern prefetch_t	*prefetch;	/* requests in flight, oldest first */
+
+/*
+ * Multi-host mode (-M) ... one logger_t per pmcd host and archive,
+ * and all of the per-host globals are swapped in by farm_switch()
+ * before any work is done for that host, see farm.c
+ */
+typedef struct logger_s {
+    struct logger_s	*l_next;
+    char		*l_host;	/* pmcd_host_conn */
+    char		*l_archBase;	/* archive basename, maybe strftime(3) */
+    int			l_ready;	/* archive created, see farm_setup() */
+    int			l_failed;	/* cannot go on, see farm_fail() */
+    int			l_work;		/* has alarmed tasks, see farm_work() */
+    int			l_ctx;
+    int			l_pmcdfd;
+    char		*l_pmcd_host;
+    char		*l_archName;
+    __pmLogCtl		l_logctl;
+    __pmArchCtl		l_archctl;
+    task_t		*l_tasklist;
+    __pmHashCtl		l_pm_hash;
+    __pmHashCtl		l_hist_hash;
+    dynroot_t		*l_dyn_roots;
+    int			l_n_dyn_roots;
+    __pmTimestamp	l_epoch;
+    __pmTimestamp	l_last_stamp;
+    int			l_last_log_offset;
+    off_t		l_flushsize;
+    __int64_t		l_vol_bytes;
+    int			l_vol_samples_counter;
+    logbuf_t		l_logbuf;
+    prefetch_t		*l_prefetch;
+} logger_t;
+
+extern logger_t		*farm;		/* all hosts, first is the lead */
+extern int		config_replay;	/* config parsed before, for farm */
+extern void farm_load(const char *);
+extern void farm_switch(logger_t *);
+extern void farm_start(FILE *);
+extern void farm_work(void);
+extern void farm_retry(void);
+extern int farm_fail(int);
+extern int farm_failed(void);
+extern void farm_control(const __pmPDU *);
+extern int farm_newvolume(int);
+extern void farm_flush(void);
+extern void farm_done(void);
+extern int farm_retry_alarm;	/* farm_retry() is due */
+extern void cache_rebind(void);
+extern void yyreset(FILE *);
+extern char *archive_base(const char *, int *);
+extern void archive_create(const char *, int);
+extern void archive_timezone(int, int);
+extern void archive_close(void);
 
 /* event record handling */
 extern int do_events(pmValueSet *);
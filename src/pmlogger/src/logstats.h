@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#ifndef LOGSTATS_H
+#define LOGSTATS_H
+
+/*
+ * subdir nested under PCP_TMP_DIR, kept apart from the pmlogger port
+ * files in PCP_TMP_DIR/pmlogger which are scanned by __pmLogFindLocalPorts
+ */
+#define PMLOGGER_STATS_SUBDIR	"pmlogstats"
+
+/*
+ * pmlogger archive write instrumentation, one memory mapped file
+ * per pmlogger process, exported by pmcd as pmcd.pmlogger.write.*
+ */
+typedef struct {
+    unsigned int	version;
+    unsigned int	bufsize;	/* pmcd.pmlogger.write.bufsize */
+    unsigned long long	records;	/* pmcd.pmlogger.write.records */
+    unsigned long long	bytes;		/* pmcd.pmlogger.write.bytes   */
+    unsigned long long	flushes;	/* pmcd.pmlogger.write.flushes */
+    unsigned int	batch_max;	/* pmcd.pmlogger.write.batch_max */
+    unsigned int	pad;
+} pmloggerstats_t;
+
+#endif /* LOGSTATS_H */
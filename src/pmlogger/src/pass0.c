@@ -557,3 +557,34 @@ pass0(FILE *fpipe)
 
     return fp;
 }
+
+/*
+ * Multi-host mode, the names from pass0() are shared by all hosts but
+ * the metadata is not ... discard the metadata and bind the names again
+ * using the current context
+ */
+void
+cache_rebind(void)
+{
+    __pmHashNode	*hp;
+    cache_entry_t	*cep;
+
+    if (no_cache)
+	return;
+
+    hp = __pmHashWalk(&name_cache, PM_HASH_WALK_START);
+    while (hp != NULL) {
+	for (cep = (cache_entry_t *)hp->data; cep != NULL; cep = cep->next) {
+	    cep->state = N_UNKNOWN;
+	    cep->pmid = PM_ID_NULL;
+	    cep->desc.pmid = PM_ID_NULL;
+	}
+	hp = __pmHashWalk(&name_cache, PM_HASH_WALK_NEXT);
+    }
+
+    cache_bind();
+    pass1();
+
+    if (pmDebugOptions.appl6)
+	cache_dump(stderr);
+}
@@ -45,6 +45,7 @@ int		vol_samples_counter;     /* Counts samples - reset for new vol*/
 int		vol_switch_afid = -1;    /* afid of event for vol switch */
 int		vol_switch_flag;         /* sighup received - switch vol now */
 int		vol_switch_alarm;	 /* vol_switch_callback() called */
+int		flush_alarm;		 /* flush_callback() called */
 int		log_switch_flag;         /* SIGUSR2 received to re-exec / log-roll */
 int		argc_saved;		 /* saved for execv when switching logs */
 char		**argv_saved;		 /* saved for re-exec when switching logs */
@@ -71,7 +72,7 @@ int		sig_code;		/* caught signal */
 int		qa_case;		/* QA error injection state */
 char		*note;			/* note for port map file */
 
-static int 	    pmcdfd = -1;	/* comms to pmcd */
+int 		    pmcdfd = -1;	/* comms to pmcd */
 static __pmFdSet    fds;		/* file descriptors mask for select */
 static int	    numfds;		/* number of file descriptors in mask */
 static __pmFdSet    readyfds;		/* fd mask for control port select() */
@@ -84,35 +85,25 @@ static char	*folio_name = "<unknown>";
 static char	*dialog_title = "PCP Archive Recording Session";
 static int	sep;
 
+/*
+ * Write the epilogue and last temporal index entry, and close the
+ * current archive
+ */
 void
-run_done(int sts, char *msg)
+archive_close(void)
 {
-    int	i, lsts;
-
-    /* no more timer events, especially on the re-exec path */
-    __pmAFblock();
-
-    if (pmDebugOptions.services || (pmDebugOptions.log && pmDebugOptions.desperate)) {
-	fprintf(stderr, "run_done(%d, %s) last_log_offset=%d last_stamp=",
-		sts, msg, last_log_offset);
-	__pmPrintTimestamp(stderr, &last_stamp);
-	fputc('\n', stderr);
-    }
+    int		sts;
 
-    if ((lsts = do_epilogue()) < 0)
+    if ((sts = do_epilogue()) < 0)
 	fprintf(stderr, "Warning: problem writing archive epilogue: %s\n",
-	    pmErrStr(lsts));
-
-    if (msg != NULL)
-	pmNotifyErr(LOG_INFO, "pmlogger: %s, %s\n", msg, log_switch_flag ? "reexec" : "exiting");
-    else
-	pmNotifyErr(LOG_INFO, "pmlogger: End of run time, %s\n", log_switch_flag ? "reexec" : "exiting");
+	    pmErrStr(sts));
 
     /*
      * write the last last temporal index entry with the time stamp
      * of the last pmResult and the seek pointer set to the offset
      * _before_ the last log record
      */
+    flushlog();
     if (last_stamp.sec != 0) {
 	if (last_log_offset < __pmLogLabelSize(archctl.ac_log))
 	    fprintf(stderr, "run_done: Botch: last_log_offset = %ld\n", (long)last_log_offset);
@@ -126,6 +117,33 @@ run_done(int sts, char *msg)
     __pmFclose(archctl.ac_mfp);
     __pmFclose(archctl.ac_log->tifp);
     __pmFclose(archctl.ac_log->mdfp);
+}
+
+void
+run_done(int sts, char *msg)
+{
+    int	i;
+
+    /* no more timer events, especially on the re-exec path */
+    __pmAFblock();
+
+    if (pmDebugOptions.services || (pmDebugOptions.log && pmDebugOptions.desperate)) {
+	fprintf(stderr, "run_done(%d, %s) last_log_offset=%d last_stamp=",
+		sts, msg, last_log_offset);
+	__pmPrintTimestamp(stderr, &last_stamp);
+	fputc('\n', stderr);
+    }
+
+    if (msg != NULL)
+	pmNotifyErr(LOG_INFO, "pmlogger: %s, %s\n", msg, log_switch_flag ? "reexec" : "exiting");
+    else
+	pmNotifyErr(LOG_INFO, "pmlogger: End of run time, %s\n", log_switch_flag ? "reexec" : "exiting");
+
+    /* for -M, farm_done() closes the archives of all the hosts */
+    if (farm != NULL)
+	farm_done();
+    else
+	archive_close();
 
     if (log_switch_flag) {
     	/*
@@ -174,6 +192,15 @@ vol_switch_callback(int i, void *j)
     vol_switch_alarm = 1;
 }
 
+/*
+ * Warning: called in signal handler context ... be careful
+ */
+STATIC_FUNC void
+flush_callback(int i, void *j)
+{
+    flush_alarm = 1;
+}
+
 static int
 maxfd(void)
 {
@@ -561,15 +588,18 @@ failed:
 
 static pmLongOptions longopts[] = {
     PMAPI_OPTIONS_HEADER("Options"),
+    { "buffer", 1, 'b', "SIZE", "buffer archive writes, flushing every SIZE bytes" },
     { "config", 1, 'c', "FILE", "file to load configuration from" },
     { "check", 0, 'C', 0, "parse configuration and exit" },
     PMOPT_DEBUG,
+    { "flush", 1, 'F', "DELTA", "flush buffered archive writes at least every DELTA [default 10 seconds]" },
     PMOPT_HOST,
     { "labelhost", 1, 'H', "LABELHOST", "override the hostname written into the label" },
     { "pmlc-ipc-version", 1, 'I', "VERSION", "set IPC version for pmlc port [defaily LOG_PDU_VERSION]" },
     { "log", 1, 'l', "FILE", "redirect diagnostics and trace output" },
     { "linger", 0, 'L', 0, "run even if not primary logger instance and nothing to log" },
     { "note", 1, 'm', "MSG", "descriptive note to be added to the port map file" },
+    { "farm", 1, 'M', "FILE", "log many hosts in one process, host and archive pairs from FILE" },
     PMOPT_SPECLOCAL,
     { "local-PMDA", 0, 'o', 0, "metrics sourced without connecting to pmcd" },
     PMOPT_NAMESPACE,
@@ -591,7 +621,7 @@ static pmLongOptions longopts[] = {
 };
 
 static pmOptions opts = {
-    .short_options = "c:CD:fh:H:I:l:K:Lm:Nn:op:Prs:T:t:uU:v:V:x:y?",
+    .short_options = "b:c:CD:fF:h:H:I:l:K:Lm:M:Nn:op:Prs:T:t:uU:v:V:x:y?",
     .long_options = longopts,
     .short_usage = "[options] archive",
 };
@@ -903,6 +933,139 @@ control_port_ready(void)
     }
 }
 
+/*
+ * Archive basename from the command line (or -M file), with any
+ * strftime(3) meta chars substituted
+ */
+char *
+archive_base(const char *arg, int *make_uniq)
+{
+    char	*base;
+
+    if (strchr(arg, '%') == NULL) {
+	/* no meta chars - go with what we have been given */
+	if ((base = strdup(arg)) == NULL) {
+	    pmNoMem("main: strdup archBase", strlen(arg)+1, PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+	*make_uniq = 0;
+    } else {
+	/*
+	 * strftime(3) meta char substitution.
+	 */
+	time_t	now;
+	struct tm	*arch_tm;
+
+	if ((base = malloc(MAXPATHLEN+1)) == NULL) {
+	    pmNoMem("main malloc archBase", MAXPATHLEN+1, PM_FATAL_ERR);
+	    /* NOTREACHED */
+	}
+	time(&now);
+	arch_tm = localtime(&now);
+	if (strftime(base, MAXPATHLEN, arg, arch_tm) == 0) {
+	    fprintf(stderr, "Error: strftime failed on \"%s\"\n", arg);
+	    exit(1);
+	}
+	if (pmDebugOptions.services)
+	    fprintf(stderr, "archBase after strftime substitutions: \"%s\"\n", base);
+	*make_uniq = 1;
+    }
+    return base;
+}
+
+/*
+ * Create the archive files for base, setting up archName, logctl
+ * and archctl ... no return on failure
+ */
+void
+archive_create(const char *base, int make_uniq)
+{
+    int		suff;		/* for -NN */
+    int		sts = 0;
+
+    if ((archName = malloc(MAXPATHLEN+1)) == NULL) {
+	pmNoMem("main: archName", MAXPATHLEN+1, PM_FATAL_ERR);
+	/* NOTREACHED */
+    }
+    archctl.ac_log = &logctl;
+    /* -b buffering is set as each file is created, see buffer.c */
+    logctl.bufsize = log_bufsize;
+
+    /*
+     * If we reexec quickly then archBase will be the same as the
+     * previous iteration, and if this happens use a -NN suffix to make
+     * archName different, ... but only if make_uniq is set
+     */
+    for (suff = -1; suff < 99; suff++) { /* limit of 100 retries */
+	if (suff == -1)
+	    memcpy(archName, base, strlen(base)+1);
+	else
+	    snprintf(archName, MAXPATHLEN, "%s-%02d", base, suff);
+
+	if ((sts = __pmLogCreate(pmcd_host, archName, archive_version, &archctl)) < 0) {
+	    if (make_uniq)
+		continue;	/* try the next -NN */
+	    /* otherwise this is fatal */
+	    break;
+	}
+	/* success */
+	if (pmDebugOptions.services)
+	    fprintf(stderr, "archName after __pmLogCreate: \"%s\"\n", archName);
+	break;
+    }
+    if (sts < 0) {
+	fprintf(stderr, "__pmLogCreate(%s, %s, ...): %s\n", pmcd_host, archName, pmErrStr(sts));
+	exit(1);
+    }
+}
+
+/*
+ * try and establish $TZ from the remote PMCD ...
+ * Note the label record has been set up, but not written yet
+ */
+void
+archive_timezone(int ctx, int newzone)
+{
+    int			sts;
+    const char		*names[2] = { "pmcd.timezone", "pmcd.zoneinfo" };
+    pmID		pmids[2];
+    pmHighResResult	*resp;
+    pmValueSet		*vp;
+
+    __pmGetTimestamp(&epoch);
+    sts = pmUseContext(ctx);
+
+    if (sts >= 0)
+	sts = pmLookupName(2, names, pmids);
+    if (sts >= 0)
+	sts = pmFetchHighRes(2, pmids, &resp);
+    if (sts >= 0) {
+	vp = resp->vset[0];
+	if (vp->numval > 1) { /* pmcd.zoneinfo present */
+	    if (logctl.label.zoneinfo)
+		free(logctl.label.zoneinfo);
+	    logctl.label.zoneinfo = strdup(vp->vlist[1].value.pval->vbuf);
+	}
+	if (vp->numval > 0) { /* pmcd.timezone present */
+	    if (logctl.label.timezone)
+		free(logctl.label.timezone);
+	    logctl.label.timezone = strdup(vp->vlist[0].value.pval->vbuf);
+	    /* prefer to use remote time to avoid clock drift problems */
+	    epoch.sec = resp->timestamp.tv_sec;
+	    epoch.nsec = resp->timestamp.tv_nsec;
+	    if (newzone)
+		pmNewZone(logctl.label.timezone);
+	}
+	else if (pmDebugOptions.log) {
+	    fprintf(stderr,
+		    "archive_timezone: Could not get timezone from host %s\n",
+		    pmcd_host);
+	}
+	pmFreeHighResResult(resp);
+    }
+
+}
+
 int
 main(int argc, char **argv)
 {
@@ -916,22 +1079,21 @@ main(int argc, char **argv)
 				    /* default log (not archive) file name */
     char		*endnum;
     int			i;
-    int			suff;		/* for -NN */
     int			make_uniq = 0;	/* set if -NN suffix regime is in play */
     task_t		*tp;
     optcost_t		ocp;
     char		*p;
     char		*runtime = NULL;
+    int			bufsamples;	/* -b parsing, bytes only */
+    __int64_t		bufbytes;
+    struct timeval	buftime;
     int	    		ctx;		/* handle corresponding to ctxp below */
     __pmContext  	*ctxp;		/* pmlogger has just this one context */
     int			niter;
     pid_t               target_pid = 0;
     int			exit_code = 0;
     char		*exit_msg;
-    const char		*names[2] = { "pmcd.timezone", "pmcd.zoneinfo" };;
-    pmID		pmids[2];
-    pmHighResResult	*resp;
-    pmValueSet		*vp;
+    char		*farmfile = NULL;
     struct timespec	myepoch;
     struct timeval	nowait = {0, 0};
     FILE		*fp;		/* pipe from pmcpp */
@@ -1071,6 +1233,29 @@ main(int argc, char **argv)
 	    }
 	    break;
 
+	case 'b':		/* buffered archive writes */
+	    sts = ParseSize(opts.optarg, &bufsamples, &bufbytes, &buftime);
+	    if (sts < 0 || bufbytes <= 0 || bufbytes > INT_MAX) {
+		pmprintf("%s: illegal size argument '%s' for buffer size\n",
+			pmGetProgname(), opts.optarg);
+		opts.errors++;
+	    }
+	    else
+		log_bufsize = (int)bufbytes;
+	    break;
+
+	case 'F':		/* flush interval for buffered writes */
+	    if (pmParseInterval(opts.optarg, &flush_interval, &p) < 0) {
+		pmprintf("%s: illegal -F argument\n%s", pmGetProgname(), p);
+		free(p);
+		opts.errors++;
+	    }
+	    break;
+
+	case 'M':		/* multi-host mode */
+	    farmfile = opts.optarg;
+	    break;
+
 	case 'P':		/* this is the primary pmlogger */
 	    primary = 1;
 	    isdaemon = 1;
@@ -1179,13 +1364,29 @@ main(int argc, char **argv)
 	opts.errors++;
     }
 
-    if (!opts.errors && ((Cflag == 0 && opts.optind > argc - 1) ||
+    if (farmfile != NULL && (pmcd_host_conn != NULL || primary ||
+	host_context == PM_CONTEXT_LOCAL || pmcd_host_label != NULL ||
+	rsc_fd != -1 || target_pid != 0)) {
+	pmprintf(
+	    "%s: -M is mutually exclusive with -h, -H, -o, -p, -P and -x\n",
+		pmGetProgname());
+	opts.errors++;
+    }
+
+    if (!opts.errors && farmfile == NULL &&
+			((Cflag == 0 && opts.optind > argc - 1) ||
 			 (Cflag == 1 && opts.optind > argc))) {
 	pmprintf("%s: insufficient arguments\n", pmGetProgname());
 	opts.errors++;
     }
 
-    if (!opts.errors && ((Cflag == 0 && opts.optind < argc - 1) ||
+    if (!opts.errors && farmfile != NULL && opts.optind < argc) {
+	pmprintf("%s: no archive argument with -M\n", pmGetProgname());
+	opts.errors++;
+    }
+
+    if (!opts.errors && farmfile == NULL &&
+			((Cflag == 0 && opts.optind < argc - 1) ||
 			 (Cflag == 1 && opts.optind < argc))) {
 	pmprintf("%s: too many arguments\n", pmGetProgname());
 	opts.errors++;
@@ -1196,6 +1397,12 @@ main(int argc, char **argv)
 	exit(1);
     }
 
+    if (farmfile != NULL) {
+	/* no return if this fails, first host is the lead */
+	farm_load(farmfile);
+	pmcd_host_conn = farm->l_host;
+    }
+
     if (getenv("PMLOGGER_REEXEC") != NULL) {
 	/*
 	 * We have been re-exec'd. See run_done(). This flag indicates
@@ -1242,37 +1449,7 @@ main(int argc, char **argv)
 
     if (Cflag == 0) {
 	/* base name for archive is here ... */
-	if ((archName = malloc(MAXPATHLEN+1)) == NULL) {
-	    pmNoMem("main: archName", strlen(argv[opts.optind])+1, PM_FATAL_ERR);
-	    /* NOTREACHED */
-	}
-	if (strchr(argv[opts.optind], '%') == NULL) {
-	    /* no meta chars - go with what we have been given */
-	    if ((archBase = strdup(argv[opts.optind])) == NULL) {
-		pmNoMem("main: strdup archBase", strlen(argv[opts.optind])+1, PM_FATAL_ERR);
-		/* NOTREACHED */
-	    }
-	} else {
-	    /*
-	     * strftime(3) meta char substitution.
-	     */
-	    time_t	now;
-	    struct tm	*arch_tm;
-
-	    if ((archBase = malloc(MAXPATHLEN+1)) == NULL) {
-		pmNoMem("main malloc archBase", MAXPATHLEN+1, PM_FATAL_ERR);
-		/* NOTREACHED */
-	    }
-	    time(&now);
-	    arch_tm = localtime(&now);
-	    if (strftime(archBase, MAXPATHLEN, argv[opts.optind], arch_tm) == 0) {
-		fprintf(stderr, "Error: strftime failed on \"%s\"\n", argv[opts.optind]);
-		exit(1);
-	    }
-	    if (pmDebugOptions.services)
-		fprintf(stderr, "archBase after strftime substitutions: \"%s\"\n", archBase);
-	    make_uniq = 1;
-	}
+	archBase = archive_base(farm != NULL ? farm->l_archBase : argv[opts.optind], &make_uniq);
     }
 
     /* initialise access control */
@@ -1354,11 +1531,13 @@ main(int argc, char **argv)
 
     if (yyparse() != 0)
 	exit(1);
-    fclose(yyin);
     yyend();
 
-    /* no further need for the pass0 name cache */
-    cache_free();
+    if (farm == NULL) {
+	fclose(yyin);
+	/* no further need for the pass0 name cache */
+	cache_free();
+    }
 
     fprintf(stderr, "Config parsed\n");
 
@@ -1430,71 +1609,12 @@ main(int argc, char **argv)
     if (pmcd_host_label != NULL)
 	pmcd_host = pmcd_host_label;
 
-    archctl.ac_log = &logctl;
+    archive_create(archBase, make_uniq);
+    startstats();
+    if (log_bufsize > 0 && (flush_interval.tv_sec > 0 || flush_interval.tv_usec > 0))
+	__pmAFregister(&flush_interval, NULL, flush_callback);
 
-    /*
-     * If we reexec quickly then archBase will be the same as the
-     * previous iteration, and if this happens use a -NN suffix to make
-     * archName different, ... but only if make_uniq is set
-     */
-    for (suff = -1; suff < 99; suff++) { /* limit of 100 retries */
-	if (suff == -1)
-	    memcpy(archName, archBase, strlen(archBase)+1);
-	else
-	    snprintf(archName, MAXPATHLEN, "%s-%02d", archBase, suff);
-
-	if ((sts = __pmLogCreate(pmcd_host, archName, archive_version, &archctl)) < 0) {
-	    if (make_uniq)
-		continue;	/* try the next -NN */
-	    /* otherwise this is fatal */
-	    break;
-	}
-	/* success */
-	if (pmDebugOptions.services)
-	    fprintf(stderr, "archName after __pmLogCreate: \"%s\"\n", archName);
-	break;
-    }
-    if (sts < 0) {
-	fprintf(stderr, "__pmLogCreate(%s, %s, ...): %s\n", pmcd_host, archName, pmErrStr(sts));
-	exit(1);
-    }
-
-    /*
-     * try and establish $TZ from the remote PMCD ...
-     * Note the label record has been set up, but not written yet
-     */
-
-    __pmGetTimestamp(&epoch);
-    sts = pmUseContext(ctx);
-
-    if (sts >= 0)
-	sts = pmLookupName(2, names, pmids);
-    if (sts >= 0)
-	sts = pmFetchHighRes(2, pmids, &resp);
-    if (sts >= 0) {
-	vp = resp->vset[0];
-	if (vp->numval > 1) { /* pmcd.zoneinfo present */
-	    if (logctl.label.zoneinfo)
-		free(logctl.label.zoneinfo);
-	    logctl.label.zoneinfo = strdup(vp->vlist[1].value.pval->vbuf);
-	}
-	if (vp->numval > 0) { /* pmcd.timezone present */
-	    if (logctl.label.timezone)
-		free(logctl.label.timezone);
-	    logctl.label.timezone = strdup(vp->vlist[0].value.pval->vbuf);
-	    /* prefer to use remote time to avoid clock drift problems */
-	    epoch.sec = resp->timestamp.tv_sec;
-	    epoch.nsec = resp->timestamp.tv_nsec;
-	    if (! use_localtime)
-		pmNewZone(logctl.label.timezone);
-	}
-	else if (pmDebugOptions.log) {
-	    fprintf(stderr,
-		    "main: Could not get timezone from host %s\n",
-		    pmcd_host);
-	}
-	pmFreeHighResResult(resp);
-    }
+    archive_timezone(ctx, !use_localtime);
 
     /* do ParseTimeWindow stuff for -T */
     if (runtime) {
@@ -1558,7 +1678,8 @@ main(int argc, char **argv)
 	    __pmFD_SET(ctlfds[i], &fds);
     }
 #ifndef IS_MINGW
-    if (pmcdfd != -1)
+    /* for -M, lost connections are noticed on the next fetch instead */
+    if (pmcdfd != -1 && farm == NULL)
 	__pmFD_SET(pmcdfd, &fds);
 #endif
     if (rsc_fd != -1)
@@ -1569,6 +1690,14 @@ main(int argc, char **argv)
 	fprintf(stderr, "Warning: problem writing archive prologue: %s\n",
 	    pmErrStr(sts));
 
+    if (farm != NULL) {
+	/*
+	 * parse the same config again for all the other hosts, config
+	 * and the name cache are kept for farm_retry()
+	 */
+	farm_start(yyin);
+    }
+
     sts = 0;		/* default exit status */
 
     parse_done = 1;	/* enable callback processing */
@@ -1597,6 +1726,11 @@ main(int argc, char **argv)
 		else
 		    pmNotifyErr(LOG_INFO, "main: delayed log_alarm");
 	    }
+	    if (farm != NULL) {
+		/* alarmed tasks for all hosts, lead is current again after */
+		farm_work();
+		continue;
+	    }
 	    /*
 	     * Scan the task list looking for ones with t_alarm
 	     * set, and link these together (add to end of chain
@@ -1679,7 +1813,27 @@ main(int argc, char **argv)
 	    if (pmDebugOptions.appl2)
 		pmNotifyErr(LOG_INFO, "main: vol_switch_alarm");
 	    __pmAFblock();
-	    newvolume(VOL_SW_TIME);
+	    if (farm != NULL)
+		farm_newvolume(VOL_SW_TIME);
+	    else
+		newvolume(VOL_SW_TIME);
+	    __pmAFunblock();
+	}
+
+	if (flush_alarm) {
+	    flush_alarm = 0;
+	    __pmAFblock();
+	    if (farm != NULL)
+		farm_flush();
+	    else
+		flushlog();
+	    __pmAFunblock();
+	}
+
+	if (farm_retry_alarm) {
+	    farm_retry_alarm = 0;
+	    __pmAFblock();
+	    farm_retry();
 	    __pmAFunblock();
 	}
 
@@ -1715,7 +1869,10 @@ main(int argc, char **argv)
 	if (nready > 0)
 	    control_port_ready();
 	else if (vol_switch_flag) {
-	    newvolume(VOL_SW_SIGHUP);
+	    if (farm != NULL)
+		farm_newvolume(VOL_SW_SIGHUP);
+	    else
+		newvolume(VOL_SW_SIGHUP);
 	    vol_switch_flag = 0;
 	}
 	else if (nready < 0 && neterror() != EINTR)
@@ -1771,7 +1928,7 @@ newvolume(int vol_switch_type)
                                    vol_switch_callback);
     }
 
-    if ((newfp = __pmLogNewFile(archName, nextvol)) != NULL) {
+    if ((newfp = __pmLogNewFileBuf(archName, nextvol, logctl.bufsize)) != NULL) {
 	if (logctl.state == PM_LOG_STATE_NEW) {
 	    /*
 	     * nothing has been logged as yet, force out the label records
@@ -1796,6 +1953,7 @@ newvolume(int vol_switch_type)
 	 *	this happens in do_work() over in callback.c
 	 */
 
+	flushlog();
 	__pmFclose(archctl.ac_mfp);
 	archctl.ac_mfp = newfp;
 	logctl.label.vol = archctl.ac_curvol = nextvol;
@@ -1881,8 +2039,10 @@ reconnect(void)
     sts = pmReconnectContext(ctx);
     if (sts >= 0) {
 	pmcdfd = ctxp->c_pmcd->pc_fd;
-	__pmFD_SET(pmcdfd, &fds);
-	numfds = maxfd() + 1;
+	if (farm == NULL) {
+	    __pmFD_SET(pmcdfd, &fds);
+	    numfds = maxfd() + 1;
+	}
     }
     if (sts < 0)
 	return sts;
@@ -1899,8 +2059,10 @@ reconnect(void)
      * or processes (a new-named archive will have to be created,
      * from a new pmlogger process, and pmlogrewrite/pmlogextract
      * will need to become involved if they need to be merged).
+     * For -M only this host is given up, see farm_fail().
      */
-    validate_metrics();
+    if ((sts = validate_metrics()) < 0)
+	return farm_fail(sts);
 
     /*
      * All metrics have been validated, however, this state change
@@ -1909,7 +2071,9 @@ reconnect(void)
      */
      if ((sts = putmark()) < 0) {
 	fprintf(stderr, "putmark: %s\n", pmErrStr(sts));
-	exit(1);
+	if (farm == NULL)
+	    exit(1);
+	return farm_fail(sts);
     }
 
     return 0;
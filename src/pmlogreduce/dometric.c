@@ -1,5 +1,33 @@
 #include "pmlogreduce.h"
 
+static __pmHashCtl	pmidhash;	/* pmID -> index into pmidlist[] */
+
+/*
+ * index of pmid in pmidlist[] and metriclist[], or -1 if not found
+ */
+int
+findmetric(pmID pmid)
+{
+    __pmHashNode	*hp;
+
+    if ((hp = __pmHashSearch((unsigned int)pmid, &pmidhash)) == NULL)
+	return -1;
+    return (int)(__psint_t)hp->data;
+}
+
+/*
+ * value control for one instance of a metric, or NULL if not found
+ */
+value_t *
+findvalue(metric_t *mp, int inst)
+{
+    __pmHashNode	*hp;
+
+    if ((hp = __pmHashSearch((unsigned int)inst, &mp->values)) == NULL)
+	return NULL;
+    return (value_t *)hp->data;
+}
+
 void
 dometric(const char *name)
 {
@@ -36,6 +64,7 @@ dometric(const char *name)
     }
     mp = &metriclist[numpmid];
     mp->first = NULL;
+    __pmHashInit(&mp->values);
     if ((sts = pmLookupDesc(pmidlist[numpmid], &mp->idesc)) < 0) {
 	fprintf(stderr,
 	    "%s: dometric: Error: cannot lookup pmDesc for metric \"%s\": %s\n",
@@ -66,12 +95,10 @@ dometric(const char *name)
      * PMNS names are added to the output archive metadata when
      * __pmLogPutDesc() is called below.
      */
-    for (j = 0; j < numpmid; j++) {
-	if (pmidlist[j] == pmidlist[numpmid]) {
-	    free(namelist[numpmid]);
-	    numpmid--;
-	    goto done;
-	}
+    if (findmetric(pmidlist[numpmid]) >= 0) {
+	free(namelist[numpmid]);
+	numpmid--;
+	goto done;
     }
 
     /*
@@ -176,6 +203,14 @@ dometric(const char *name)
 
 done:
 
+    /* findmetric() returns the first pmidlist[] entry for each PMID */
+    if (findmetric(pmidlist[numpmid]) < 0 &&
+	__pmHashAdd((unsigned int)pmidlist[numpmid], (void *)(__psint_t)numpmid, &pmidhash) < 0) {
+	fprintf(stderr,
+	    "%s: dometric: Error: cannot hash pmID for metric \"%s\"\n",
+		pmGetProgname(), name);
+	exit(1);
+    }
     numpmid++;
 }
 
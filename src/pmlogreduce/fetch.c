@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * Interpolated fetches of all the metrics, one result per output sample.
+ *
+ * With -N greater than 1, the metrics in pmidlist[] are partitioned into
+ * contiguous slices, and each slice is fetched by its own worker thread
+ * with its own interp mode context for the input archive, so the
+ * interpolation state for a metric is only ever touched by one thread.
+ * The workers fetch the next sample while the main thread scans the
+ * input records and writes the current one, and the slices are joined
+ * back into pmidlist[] order, in place of the one fetch for all the
+ * metrics from ictx_a that is done otherwise.  ictx_a is still used
+ * for the instance domains in doindom(), so its current time is moved
+ * along as if it had done the fetch.
+ */
+
+#include "pmlogreduce.h"
+
+#ifdef HAVE_PTHREAD_H
+typedef struct {
+    int		ctx;		/* interp mode context */
+    int		first;		/* slice is pmidlist[first] ... */
+    int		num;		/* ... pmidlist[first+num-1] */
+    int		wround;		/* last fetch done */
+    int		sts;		/* from __pmFetch */
+    __pmResult	*rp;		/* ditto */
+} worker_t;
+
+static worker_t		*worker;
+static int		nworker;
+static int		fetchround;	/* fetch the workers are asked for */
+static int		ndone;		/* workers done with this round */
+static struct timespec	delta;		/* interp mode interval */
+static pthread_mutex_t	fetchlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	fetchwork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	fetchdone = PTHREAD_COND_INITIALIZER;
+
+static void *
+fetcher(void *arg)
+{
+    worker_t	*wp = (worker_t *)arg;
+    __pmResult	*rp;
+    int		sts;
+
+    if ((sts = pmUseContext(wp->ctx)) < 0) {
+	fprintf(stderr, "%s: Error: cannot use context (%s): %s\n",
+		pmGetProgname(), iname, pmErrStr(sts));
+	exit(1);
+    }
+
+    pthread_mutex_lock(&fetchlock);
+    for ( ; ; ) {
+	while (wp->wround == fetchround)
+	    pthread_cond_wait(&fetchwork, &fetchlock);
+	pthread_mutex_unlock(&fetchlock);
+
+	sts = __pmFetch(NULL, wp->num, &pmidlist[wp->first], &rp);
+
+	pthread_mutex_lock(&fetchlock);
+	wp->sts = sts;
+	wp->rp = sts < 0 ? NULL : rp;
+	wp->wround = fetchround;
+	if (++ndone == nworker)
+	    pthread_cond_signal(&fetchdone);
+    }
+    /*NOTREACHED*/
+    return NULL;
+}
+#endif
+
+/*
+ * called once all the metrics are known, with the same start and
+ * interval as ictx_a
+ */
+void
+fetch_start(struct timespec *start, struct timespec *interval)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_t	tid;
+    worker_t	*wp;
+    long	ncpu = 2;
+    int		n;
+    int		i;
+    int		sts;
+
+    n = Narg < numpmid ? Narg : numpmid;
+#ifdef _SC_NPROCESSORS_ONLN
+    if ((ncpu = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+	ncpu = 1;
+#endif
+    if (n > ncpu)
+	n = ncpu;
+    if (n <= 1)
+	/* fetch everything from ictx_a */
+	return;
+
+    if ((worker = (worker_t *)calloc(n, sizeof(worker_t))) == NULL) {
+	fprintf(stderr, "%s: Error: cannot malloc space for %d fetch threads\n",
+		pmGetProgname(), n);
+	exit(1);
+    }
+    for (i = 0; i < n; i++) {
+	wp = &worker[i];
+	wp->first = (int)(((long)numpmid * i) / n);
+	wp->num = (int)(((long)numpmid * (i+1)) / n) - wp->first;
+	if ((wp->ctx = pmNewContext(PM_CONTEXT_ARCHIVE, iname)) < 0) {
+	    fprintf(stderr, "%s: Error: cannot open archive \"%s\" (fetch thread %d): %s\n",
+		    pmGetProgname(), iname, i, pmErrStr(wp->ctx));
+	    exit(1);
+	}
+	if ((sts = pmSetModeHighRes(PM_MODE_INTERP, start, interval)) < 0) {
+	    fprintf(stderr, "%s: pmSetModeHighRes(PM_MODE_INTERP ...) failed: %s\n",
+		    pmGetProgname(), pmErrStr(sts));
+	    exit(1);
+	}
+    }
+    delta = *interval;		/* struct assignment */
+
+    /* first round of fetches starts as soon as the workers do */
+    fetchround = 1;
+    for (nworker = 0; nworker < n; nworker++) {
+	if ((sts = pthread_create(&tid, NULL, fetcher, &worker[nworker])) != 0) {
+	    fprintf(stderr, "%s: Error: cannot create fetch thread %d: %s\n",
+		    pmGetProgname(), nworker, pmErrStr(-sts));
+	    exit(1);
+	}
+	pthread_detach(tid);
+    }
+    if (pmDebugOptions.appl0)
+	fprintf(stderr, "fetch_start: %d fetch threads for %d metrics\n",
+		nworker, numpmid);
+
+    if ((sts = pmUseContext(ictx_a)) < 0) {
+	fprintf(stderr, "%s: Error: cannot use context (%s): %s\n",
+		pmGetProgname(), iname, pmErrStr(sts));
+	exit(1);
+    }
+#else
+    (void)start;
+    (void)interval;
+#endif
+}
+
+/*
+ * next interpolated result for all the metrics in pmidlist[], with
+ * the same return value as __pmFetch() ... ictx_a must be current
+ */
+int
+fetch_next(__pmResult **result)
+{
+    int		sts;
+#ifdef HAVE_PTHREAD_H
+    __pmResult	*rp;
+    worker_t	*wp;
+    struct timespec	origin;
+    int		i;
+    int		j;
+
+    if (nworker > 0) {
+	pthread_mutex_lock(&fetchlock);
+	while (ndone < nworker)
+	    pthread_cond_wait(&fetchdone, &fetchlock);
+	pthread_mutex_unlock(&fetchlock);
+
+	/* all the workers are idle now, so no locking needed here */
+	rp = NULL;
+	sts = 0;
+	for (i = 0; i < nworker; i++) {
+	    if (worker[i].sts < 0) {
+		sts = worker[i].sts;
+		break;
+	    }
+	}
+	if (sts == 0 && (rp = __pmAllocResult(numpmid)) == NULL)
+	    sts = -oserror();
+	if (rp != NULL) {
+	    rp->timestamp = worker[0].rp->timestamp;	/* struct assignment */
+	    rp->numpmid = numpmid;
+	}
+	for (i = 0; i < nworker; i++) {
+	    wp = &worker[i];
+	    if (wp->rp == NULL)
+		continue;
+	    if (rp != NULL) {
+		/* the value sets move to rp, only free the shell */
+		for (j = 0; j < wp->num; j++)
+		    rp->vset[wp->first + j] = wp->rp->vset[j];
+		wp->rp->numpmid = 0;
+	    }
+	    __pmFreeResult(wp->rp);
+	    wp->rp = NULL;
+	}
+
+	if (sts == 0) {
+	    /* start on the next sample */
+	    pthread_mutex_lock(&fetchlock);
+	    ndone = 0;
+	    fetchround++;
+	    pthread_cond_broadcast(&fetchwork);
+	    pthread_mutex_unlock(&fetchlock);
+
+	    /* where the fetch would have left ictx_a */
+	    origin.tv_sec = rp->timestamp.sec + delta.tv_sec;
+	    origin.tv_nsec = rp->timestamp.nsec + delta.tv_nsec;
+	    if (origin.tv_nsec >= 1000000000) {
+		origin.tv_sec++;
+		origin.tv_nsec -= 1000000000;
+	    }
+	    if ((sts = pmSetModeHighRes(PM_MODE_INTERP, &origin, &delta)) < 0) {
+		__pmFreeResult(rp);
+		return sts;
+	    }
+	    *result = rp;
+	}
+	return sts;
+    }
+#endif
+
+    return __pmFetch(NULL, numpmid, pmidlist, result);
+}
+
+/*
+ * wait for any fetch in progress, so the workers are idle before exit
+ */
+void
+fetch_end(void)
+{
+#ifdef HAVE_PTHREAD_H
+    int		i;
+
+    if (nworker > 0) {
+	pthread_mutex_lock(&fetchlock);
+	while (ndone < nworker)
+	    pthread_cond_wait(&fetchdone, &fetchlock);
+	pthread_mutex_unlock(&fetchlock);
+	for (i = 0; i < nworker; i++) {
+	    if (worker[i].rp != NULL) {
+		__pmFreeResult(worker[i].rp);
+		worker[i].rp = NULL;
+	    }
+	}
+    }
+#endif
+}
@@ -24,12 +24,8 @@ doindom(__pmResult *rp)
 	 * correspondence because we come here after rewrite() has
 	 * been called ... search for matching pmid
 	 */
-	for (j = 0; j < numpmid; j++) {
-	    if (pmidlist[j] == vsp->pmid) {
-		mp = &metriclist[j];
-		break;
-	    }
-	}
+	if ((j = findmetric(vsp->pmid)) >= 0)
+	    mp = &metriclist[j];
 	if (mp == NULL) {
 	    fprintf(stderr,
 		"%s: doindom: Arrgh, unexpected PMID %s @ vset[%d]\n",
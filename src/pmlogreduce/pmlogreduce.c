@@ -1,7 +1,7 @@
 /*
  * pmlogreduce - statistical reduction of a PCP archive log
  *
- * Copyright (c) 2014,2017,2021-2022 Red Hat.
+ * Copyright (c) 2014,2017,2021-2022,2026 Red Hat.
  * Copyright (c) 2004 Silicon Graphics, Inc.  All Rights Reserved.
  *
  * This program is free software; you can redistribute it and/or modify it
@@ -64,6 +64,7 @@ char		*Aarg;			/* -A arg - output time alignment */
 int		varg = -1;		/* -v arg - switch log vol every X */
 int		zarg;			/* -z arg - use archive timezone */
 char		*tz;			/* -Z arg - use timezone from user */
+int		Narg = 4;		/* -N arg - interpolation threads */
 
 int	        written;		/* num log writes so far */
 int		exit_status;
@@ -89,6 +90,7 @@ static pmLongOptions longopts[] = {
     PMOPT_START,
     PMOPT_SAMPLES,
     PMOPT_FINISH,
+    { "threads", 1, 'N', "N", "interpolate metrics with N threads [default 4]" },
     { "interval", 1, 't', "DELTA", "sample output interval [default 10min]" },
     { "", 1, 'v', "NUM", "switch log volumes after this many samples" },
     PMOPT_TIMEZONE,
@@ -98,7 +100,7 @@ static pmLongOptions longopts[] = {
 };
 
 static pmOptions opts = {
-    .short_options = "A:D:S:s:T:t:v:Z:z?",
+    .short_options = "A:D:N:S:s:T:t:v:Z:z?",
     .long_options = longopts,
     .short_usage = "[options] input-archive output-archive",
 };
@@ -128,6 +130,15 @@ parseargs(int argc, char *argv[])
 	    }
 	    break;
 
+	case 'N':	/* number of interpolation threads */
+	    Narg = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || Narg < 1) {
+		pmprintf("%s: -N requires numeric argument\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
 	case 's':	/* number of samples to write out */
 	    sarg = (int)strtol(opts.optarg, &endnum, 10);
 	    if (*endnum != '\0' || sarg < 0) {
@@ -352,6 +363,8 @@ main(int argc, char **argv)
 	goto cleanup;
     }
 
+    fetch_start(&start, &targ);
+
     max_offset = (vers == PM_LOG_VERS02) ? 0x7fffffff : LONGLONG_MAX;
     written = 0;
 
@@ -367,7 +380,7 @@ main(int argc, char **argv)
 		    pmGetProgname(), iname, pmErrStr(sts));
 	    goto cleanup;
 	}
-	if ((sts = __pmFetch(NULL, numpmid, pmidlist, &irp)) < 0) {
+	if ((sts = fetch_next(&irp)) < 0) {
 	    if (sts == PM_ERR_EOL)
 		break;
 	    fprintf(stderr,
@@ -509,6 +522,8 @@ next:
 	__pmFreeResult(irp);
     }
 
+    fetch_end();
+
     /* write the last time stamp */
     __pmFflush(archctl.ac_mfp);
     __pmFflush(logctl.mdfp);
@@ -519,6 +534,7 @@ next:
 cleanup:
     {
 	char    fname[MAXNAMELEN];
+	fetch_end();
 	fprintf(stderr, "Archive \"%s\" not created.\n", oname);
 	pmsprintf(fname, sizeof(fname), "%s.0", oname);
 	unlink(fname);
@@ -46,6 +46,7 @@ typedef struct {
     pmDesc	idesc;		/* input archive descriptor */
     pmDesc	odesc;		/* output archive descriptor */
     value_t	*first;		/* list of values, one per instance */
+    __pmHashCtl	values;		/* value_t's hashed by instance id */
     indom_t	*idp;		/* instance domain control, if any */
     int		mode;		/* have to skip or rewrite the value format */
 } metric_t;
@@ -69,6 +70,8 @@ extern char		*Aarg;		/* -A arg - output time alignment */
 extern int		varg;		/* -v arg - switch log vol every X */
 extern int		zarg;		/* -z arg - use archive timezone */
 extern char		*tz;		/* -Z arg - use timezone from user */
+extern int		Narg;		/* -N arg - interpolation threads */
+extern int		ictx_a;		/* interp mode context */
 
 extern void	newlabel(void);
 extern void	writelabel(void);
@@ -78,5 +81,11 @@ extern __pmResult *rewrite(__pmResult *);
 extern void	rewrite_free(void);
 
 extern void	dometric(const char *);
+extern int	findmetric(pmID);
+extern value_t	*findvalue(metric_t *, int);
 extern int	doindom(__pmResult *);
 extern void	doscan(__pmTimestamp *);
+
+extern void	fetch_start(struct timespec *, struct timespec *);
+extern int	fetch_next(__pmResult **);
+extern void	fetch_end(void);
@@ -67,11 +67,7 @@ rewrite(__pmResult *rp)
 	else {
 	    ovsp->numval = 0;
 	    for (j = 0; j < vsp->numval; j++) {
-		for (vp = mp->first; vp != NULL; vp = vp->next) {
-		    if (vp->inst == vsp->vlist[j].inst)
-			break;
-		}
-		if (vp == NULL) {
+		if ((vp = findvalue(mp, vsp->vlist[j].inst)) == NULL) {
 		    fprintf(stderr,
 			"%s: rewrite: Arrgh: cannot find inst %d in value_t list for %s (%s)\n",
 			    pmGetProgname(), vsp->vlist[j].inst, namelist[i], pmIDStr(vsp->pmid));
@@ -150,11 +146,7 @@ rewrite_free(void)
 	int		j;
 	metric_t	*mp;
 
-	for (j = 0; j < numpmid; j++) {
-	    if (vsp->pmid == pmidlist[j])
-		break;
-	}
-	if (j == numpmid) {
+	if ((j = findmetric(vsp->pmid)) < 0) {
 	    fprintf(stderr,
 		"%s: rewrite_free: Arrgh, cannot find pmid %s in pmidlist[]\n",
 		    pmGetProgname(), pmIDStr(vsp->pmid));
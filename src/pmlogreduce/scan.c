@@ -126,11 +126,7 @@ doscan(__pmTimestamp *end)
 	    if (vsp->numval <= 0)
 		continue;
 
-	    for (i = 0; i < numpmid; i++) {
-		if (vsp->pmid == pmidlist[i])
-		    break;
-	    }
-	    if (i == numpmid) {
+	    if ((i = findmetric(vsp->pmid)) < 0) {
 		fprintf(stderr,
 		    "%s: scan: Arrgh, cannot find pid %s in pidlist[]\n",
 			pmGetProgname(), pmIDStr(vsp->pmid));
@@ -141,27 +137,19 @@ doscan(__pmTimestamp *end)
 		continue;
 
 	    for (j = 0; j < vsp->numval; j++) {
-		value_t		*lvp = NULL;
-		for (vp = mp->first; vp != NULL; vp = vp->next) {
-		    if (vp->inst == vsp->vlist[j].inst)
-			break;
-		    lvp = vp;
-		}
-		if (vp == NULL) {
+		if ((vp = findvalue(mp, vsp->vlist[j].inst)) == NULL) {
 		    vp = (value_t *)malloc(sizeof(value_t));
-		    if (vp == NULL) {
+		    if (vp == NULL ||
+			__pmHashAdd((unsigned int)vsp->vlist[j].inst, (void *)vp, &mp->values) < 0) {
 			fprintf(stderr,
 			    "%s: rewrite: Arrgh, cannot malloc value_t\n", pmGetProgname());
 			exit(1);
 		    }
-		    if (lvp == NULL)
-			mp->first = vp;
-		    else
-			lvp->next = vp;
+		    vp->next = mp->first;
+		    mp->first = vp;
 		    vp->inst = vsp->vlist[j].inst;
 		    vp->nobs = vp->nwrap = 0;
 		    vp->control = V_INIT;
-		    vp->next = NULL;
 
 		    if (pmDebugOptions.appl1) {
 			fprintf(stderr,
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014,2016 Red Hat.
+ * Copyright (c) 2014,2016,2026 Red Hat.
  * Copyright (c) 1995-2001,2003 Silicon Graphics, Inc.  All Rights Reserved.
  * 
  * This program is free software; you can redistribute it and/or modify it
@@ -14,10 +14,14 @@
  */
 
 #include <math.h>
+#include <float.h>
 #include <stdarg.h>
 #include <limits.h>
 #include "pmapi.h"
 #include "libpcp.h"
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 static pmLongOptions longopts[] = {
     PMAPI_OPTIONS_HEADER("Options"),
@@ -25,17 +29,20 @@ static pmLongOptions longopts[] = {
     { "all", 0, 'a', 0, "print all information (equivalent to -blmMy)" },
     { "", 0, 'b', 0, "print both stochastic and time averages for counter metrics" },
     { "bins", 1, 'B', "N", "print value distribution across a number of bins" },
+    { "stddev", 0, 'd', 0, "also print standard deviation" },
     { "", 0, 'f', 0, "print using \"spreadsheet\" format (tab delimited fields)" },
     { "", 0, 'F', 0, "print using \"spreadsheet\" format (comma separated values)" },
     { "header", 0, 'H', 0, "print one-line header at start showing each column" },
     { "mintime", 0, 'i', 0, "also print timestamp for minimum value" },
     { "maxtime", 0, 'I', 0, "also print timestamp for maximum value" },
+    { "threads", 1, 'j', "N", "summarize N slices of the archive in parallel [default 1]" },
     { "label", 0, 'l', 0, "also print the archive label and time window" },
     { "minimum", 0, 'm', 0, "also print minimum value" },
     { "maximum", 0, 'M', 0, "also print maximum value" },
     PMOPT_NAMESPACE,
     { "", 0, 'N', 0, "suppress warnings from individual archive fetches (default)" },
     { "precision", 1, 'p', "N", "number of digits to display after the decimal point" },
+    { "quantiles", 0, 'q', 0, "also print estimated 50th, 95th and 99th percentiles" },
     { "sum", 0, 's', 0, "only print the sum of all values of each metric" },
     PMOPT_START,
     PMOPT_FINISH,
@@ -52,12 +59,35 @@ static pmLongOptions longopts[] = {
 static int override(int, pmOptions *);
 static pmOptions opts = {
     .flags = PM_OPTFLAG_DONE | PM_OPTFLAG_BOUNDARIES | PM_OPTFLAG_STDOUT_TZ,
-    .short_options = "abB:D:fFHiIlmMNn:p:rsS:T:vVxyzZ:?",
+    .short_options = "abB:dD:fFHiIj:lmMNn:p:qrsS:T:vVxyzZ:?",
     .long_options = longopts,
     .short_usage = "[options] archive [metricname ...]",
     .override = override,
 };
 
+/*
+ * Quantile sketch (-q) ... values are counted in buckets whose bounds
+ * grow geometrically by a factor of GAMMA, so each quantile estimate is
+ * within ALPHA (relative) of a value in the sample.  Sketches for two
+ * parts of the archive are combined by adding their bucket counts.
+ */
+#define ALPHA		0.01
+#define GAMMA		((1.0 + ALPHA) / (1.0 - ALPHA))
+#define MAXBUCKET	2048	/* beyond this, smallest buckets are folded */
+
+typedef struct {
+    int			lo;		/* bucket index of count[0] */
+    int			nbucket;	/* length of count[] */
+    unsigned int	*count;
+} bucketList;
+
+typedef struct {
+    bucketList		pos;		/* values > 0 */
+    bucketList		neg;		/* values < 0, by magnitude */
+    unsigned int	zero;		/* values == 0 */
+    unsigned int	total;
+} sketchData;
+
 typedef struct {
     int			inst;
     unsigned int	count;
@@ -75,6 +105,14 @@ typedef struct {
     int			marked;		/* seen since last "mark" record? */
     unsigned int	bintotal;	/* copy of count for 2nd pass */
     unsigned int	*bin;		/* bins for value distribution */
+    unsigned int	nvalue;		/* values (rates for counters) seen */
+    double		mean;		/* running mean of these values */
+    double		sqdev;		/* sum of squared deviations from mean */
+    sketchData		*sketch;	/* distribution of values for -q */
+    struct timeval	headtime;	/* time of first sample in slice */
+    double		headval;	/* value of first sample in slice */
+    int			headmark;	/* slice mark records before first */
+    struct timeval	ratetime;	/* time of first rate in slice */
 } instData;
 
 typedef struct {
@@ -82,13 +120,33 @@ typedef struct {
     double		scale;
     instData		**instlist;
     unsigned int	listsize;
+    __pmHashCtl		insthash;	/* inst -> index in instlist */
 } aveData;
 
+/*
+ * The first pass over the archive may be split into time slices, and
+ * each slice is summarized separately (in parallel with -j) before the
+ * slices are merged in time order
+ */
+typedef struct {
+    int			ctx;		/* archive context for this slice */
+    struct timeval	start;		/* records from start ... */
+    struct timeval	end;		/* ... to before end */
+    int			last;		/* last slice, end is inclusive */
+    __pmHashCtl		hashlist;	/* aveData for each metric */
+    struct timeval	*mark;		/* times of mark records */
+    int			nmark;
+    int			sts;		/* PM_ERR_EOL or fetch error */
+} sliceData;
+
 /*
  * Hash control for statistics & errors related to each metric
  */
 static __pmHashCtl	hashlist;
 static __pmHashCtl	errlist;
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t	errlock = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 /* output format flags */
 static unsigned int	stocaveflag;	/* no stochastic counter ave */
@@ -103,6 +161,10 @@ static unsigned int	warnflag;	/* warnings are off by default */
 static unsigned int	delimiter = ' ';/* output field separator */
 static unsigned int	nbins;		/* number of distribution bins */
 static unsigned int	precision = 3;	/* number of digits after "." */
+static unsigned int	devflag;	/* no standard deviation */
+static unsigned int	quantflag;	/* no quantiles */
+static int		threads = 1;	/* slices summarized in parallel */
+static int		dowrap;		/* PCP_COUNTER_WRAP is set */
 
 /* time window stuff */
 static int		dayflag;
@@ -138,10 +200,39 @@ tadd(struct timeval *a, struct timeval *b)
     return 0;
 }
 
+/* is a before b? */
+static int
+tbefore(struct timeval *a, struct timeval *b)
+{
+    return a->tv_sec < b->tv_sec ||
+	   (a->tv_sec == b->tv_sec && a->tv_usec < b->tv_usec);
+}
+
+static int
+badvalue(double val)
+{
+    int		fp_bad = 0;
+
+#ifdef HAVE_FPCLASSIFY
+    fp_bad = fpclassify(val) == FP_NAN;
+#else
+#ifdef HAVE_ISNAN
+    fp_bad = isnan(val);
+#endif
+#endif
+    return fp_bad;
+}
+
 static void
 pmiderr(pmID pmid, const char *msg, ...)
 {
-    if (warnflag && __pmHashSearch(pmid, &errlist) == NULL) {
+    if (!warnflag)
+	return;
+#ifdef HAVE_PTHREAD_H
+    /* slices may be summarized in parallel */
+    pthread_mutex_lock(&errlock);
+#endif
+    if (__pmHashSearch(pmid, &errlist) == NULL) {
 	va_list	arg;
 	int	numnames;
 	char	**names;
@@ -156,6 +247,9 @@ pmiderr(pmID pmid, const char *msg, ...)
 	__pmHashAdd(pmid, NULL, &errlist);
 	if (numnames > 0) free(names);
     }
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_unlock(&errlock);
+#endif
 }
 
 static void
@@ -242,11 +336,185 @@ printheaders(void)
 	printf("%cmaximum_time", delimiter);
     if (countflag)
 	printf("%ccount", delimiter);
+    if (devflag)
+	printf("%cstandard_deviation", delimiter);
+    if (quantflag)
+	printf("%c50th_percentile%c95th_percentile%c99th_percentile",
+		delimiter, delimiter, delimiter);
     if (nbins)
 	printf("%cbins", delimiter);
     printf("%cunits\n", delimiter);
 }
 
+/*
+ * add n to bucket i, folding the smallest buckets together if the
+ * list would be too long ... the result depends only on the values
+ * added, not their order, so sketches can be merged
+ */
+static void
+bucketadd(bucketList *bp, int i, unsigned int n)
+{
+    int			lo, hi;
+    int			j, k;
+    size_t		size;
+    unsigned int	*count;
+
+    if (bp->nbucket == 0)
+	lo = hi = i;
+    else {
+	lo = bp->lo < i ? bp->lo : i;
+	hi = bp->lo + bp->nbucket - 1;
+	if (i > hi)
+	    hi = i;
+    }
+    if (hi - lo >= MAXBUCKET)
+	lo = hi - MAXBUCKET + 1;
+    if (i < lo)
+	i = lo;
+    if (lo != bp->lo || hi - lo + 1 != bp->nbucket) {
+	size = (hi - lo + 1) * sizeof(unsigned int);
+	if ((count = (unsigned int *)calloc(1, size)) == NULL)
+	    pmNoMem("bucketadd", size, PM_FATAL_ERR);
+	for (j = 0; j < bp->nbucket; j++) {
+	    k = bp->lo + j;
+	    count[(k < lo ? lo : k) - lo] += bp->count[j];
+	}
+	if (bp->count)
+	    free(bp->count);
+	bp->count = count;
+	bp->lo = lo;
+	bp->nbucket = hi - lo + 1;
+    }
+    bp->count[i - lo] += n;
+}
+
+/* bucket for magnitude v > 0, covering (GAMMA^(i-1), GAMMA^i] */
+static int
+bucketindex(double v)
+{
+    if (v > DBL_MAX)
+	v = DBL_MAX;
+    return (int)ceil(log(v) / log(GAMMA));
+}
+
+/* estimate for the values in bucket i, within ALPHA of any of them */
+static double
+bucketvalue(int i)
+{
+    return 2.0 * exp(i * log(GAMMA)) / (1.0 + GAMMA);
+}
+
+static void
+sketchadd(sketchData *sp, double val)
+{
+    if (val > 0)
+	bucketadd(&sp->pos, bucketindex(val), 1);
+    else if (val < 0)
+	bucketadd(&sp->neg, bucketindex(-val), 1);
+    else
+	sp->zero++;
+    sp->total++;
+}
+
+static void
+sketchmerge(sketchData *sp, sketchData *from)
+{
+    int		j;
+
+    for (j = 0; j < from->pos.nbucket; j++) {
+	if (from->pos.count[j])
+	    bucketadd(&sp->pos, from->pos.lo + j, from->pos.count[j]);
+    }
+    for (j = 0; j < from->neg.nbucket; j++) {
+	if (from->neg.count[j])
+	    bucketadd(&sp->neg, from->neg.lo + j, from->neg.count[j]);
+    }
+    sp->zero += from->zero;
+    sp->total += from->total;
+}
+
+/* estimate of the q-th quantile (0 <= q <= 1) of the values */
+static double
+sketchquantile(sketchData *sp, double q)
+{
+    double	rank;
+    double	seen = 0;
+    int		j;
+
+    if (sp->total == 0)
+	return 0.0;
+    rank = q * (sp->total - 1);
+    for (j = sp->neg.nbucket - 1; j >= 0; j--) {
+	if ((seen += sp->neg.count[j]) > rank)
+	    return -bucketvalue(sp->neg.lo + j);
+    }
+    if ((seen += sp->zero) > rank)
+	return 0.0;
+    for (j = 0; j < sp->pos.nbucket - 1; j++) {
+	if ((seen += sp->pos.count[j]) > rank)
+	    break;
+    }
+    return bucketvalue(sp->pos.lo + j);
+}
+
+/*
+ * value (or rate, for counters) for -d and -q, the mean and sum of
+ * squared deviations are updated as per Welford
+ */
+static void
+addvalue(instData *instdata, double val)
+{
+    double	delta;
+
+    if (!devflag && !quantflag)
+	return;
+    instdata->nvalue++;
+    delta = val - instdata->mean;
+    instdata->mean += delta / instdata->nvalue;
+    instdata->sqdev += delta * (val - instdata->mean);
+    if (instdata->sketch)
+	sketchadd(instdata->sketch, val);
+}
+
+/* values for a later slice, combined as per Chan et al */
+static void
+mergevalues(instData *instdata, instData *from)
+{
+    double	delta;
+    double	n;
+
+    if (from->nvalue == 0)
+	return;
+    if (instdata->nvalue == 0) {
+	instdata->mean = from->mean;
+	instdata->sqdev = from->sqdev;
+    }
+    else {
+	n = (double)instdata->nvalue + from->nvalue;
+	delta = from->mean - instdata->mean;
+	instdata->mean += delta * from->nvalue / n;
+	instdata->sqdev += from->sqdev + delta * delta * instdata->nvalue * from->nvalue / n;
+    }
+    instdata->nvalue += from->nvalue;
+    if (instdata->sketch && from->sketch)
+	sketchmerge(instdata->sketch, from->sketch);
+}
+
+static void
+freeinst(instData *instdata)
+{
+    if (instdata->bin)
+	free(instdata->bin);
+    if (instdata->sketch) {
+	if (instdata->sketch->pos.count)
+	    free(instdata->sketch->pos.count);
+	if (instdata->sketch->neg.count)
+	    free(instdata->sketch->neg.count);
+	free(instdata->sketch);
+    }
+    free(instdata);
+}
+
 static void
 printsummary(const char *name)
 {
@@ -356,6 +624,25 @@ printsummary(const char *name)
 		instdata->count = instdata->count - instdata->markcount - 1;
 	    if (countflag)
 		printf("%c%u", delimiter, instdata->count);
+	    if (devflag)
+		printf("%c%.*f", delimiter, (int)precision, instdata->nvalue == 0 ?
+			0.0 : sqrt(instdata->sqdev / instdata->nvalue));
+	    if (quantflag) {
+		static const double	q[] = { 0.50, 0.95, 0.99 };
+		double			val;
+
+		for (j = 0; j < sizeof(q) / sizeof(q[0]); j++) {
+		    val = sketchquantile(instdata->sketch, q[j]);
+		    /* the estimate may be just outside the observed range */
+		    if (instdata->nvalue > 0) {
+			if (val < instdata->min)
+			    val = instdata->min;
+			if (val > instdata->max)
+			    val = instdata->max;
+		    }
+		    printf("%c%.*f", delimiter, (int)precision, val);
+		}
+	    }
 	    for (j=0; j < nbins; j++) {	/* print value distribution summary */
 		if (j > 0 && instdata->min == instdata->max)	/* all in 1st bin */
 		    printf("%c[]%c%u", delimiter, delimiter, 0);
@@ -366,13 +653,11 @@ printsummary(const char *name)
 	    }
 	    u = pmUnitsStr(&avedata->desc.units);
 	    printf("%c%s\n", delimiter, *u == '\0' ? "none" : u);
-	    if (instdata) {
-		if (instdata->bin)
-		    free(instdata->bin);
-		free(instdata);
-	    }
+	    if (instdata)
+		freeinst(instdata);
 	}
 	if (avedata->instlist) free(avedata->instlist);
+	__pmHashFree(&avedata->insthash);
 	__pmHashDel(avedata->desc.pmid, (void*)avedata, &hashlist);
 	free(avedata);
     }
@@ -382,16 +667,8 @@ static double
 unwrap(double current, double previous, int pmtype)
 {
     double	outval = current;
-    static int	dowrap = -1;
 
     if ((current - previous) < 0.0) {
-	if (dowrap == -1) {
-	    /* PCP_COUNTER_WRAP in environment enables "counter wrap" logic */
-	    if (getenv("PCP_COUNTER_WRAP") == NULL)
-		dowrap = 0;
-	    else
-		dowrap = 1;
-	}
 	if (dowrap) {
 	    switch (pmtype) {
 		case PM_TYPE_32:
@@ -409,12 +686,50 @@ unwrap(double current, double previous, int pmtype)
     return outval;
 }
 
+/*
+ * append instdata to the list for avedata
+ */
+static void
+addinst(aveData *avedata, instData *instdata)
+{
+    size_t	size;
+
+    size = (avedata->listsize+1) * sizeof(instData *);
+    avedata->instlist = (instData **) realloc(avedata->instlist, size);
+    if (avedata->instlist == NULL)
+	pmNoMem("addinst.instlist", size, PM_FATAL_ERR);
+    avedata->instlist[avedata->listsize] = instdata;
+    if (__pmHashAdd((unsigned int)instdata->inst,
+		(void *)(__psint_t)avedata->listsize, &avedata->insthash) < 0)
+	pmNoMem("addinst.insthash", sizeof(__pmHashNode), PM_FATAL_ERR);
+    avedata->listsize++;
+}
+
+/*
+ * index of the instance for vsp->vlist[j] in avedata->instlist, or -1
+ * ... values are usually in the same order as the list, so try j first
+ */
+static int
+findinst(aveData *avedata, pmValueSet *vsp, int j)
+{
+    __pmHashNode	*hptr;
+    int			inst = vsp->vlist[j].inst;
+
+    if (vsp->numval == 1 && avedata->desc.indom == PM_INDOM_NULL)
+	return avedata->listsize > 0 ? 0 : -1;
+    if (j < avedata->listsize && avedata->instlist[j]->inst == inst)
+	return j;
+    if ((hptr = __pmHashSearch((unsigned int)inst, &avedata->insthash)) == NULL)
+	return -1;
+    return (int)(__psint_t)hptr->data;
+}
+
 static void
-newHashInst(pmValue *vp,
+newHashInst(sliceData *sp,
+	pmValue *vp,
 	aveData *avedata,		/* updated by this function */
 	int valfmt,
-	struct timeval *timestamp,	/* timestamp for this sample */
-	int pos)			/* position of this inst in instlist */
+	struct timeval *timestamp)	/* timestamp for this sample */
 {
     int		sts;
     size_t	size;
@@ -426,13 +741,10 @@ newHashInst(pmValue *vp,
 	fprintf(stderr, "%s: possibly corrupt archive?\n", pmGetProgname());
 	exit(1);
     }
-    size = (pos+1) * sizeof(instData *);
-    avedata->instlist = (instData **) realloc(avedata->instlist, size);
-    if (avedata->instlist == NULL)
-	pmNoMem("newHashInst.instlist", size, PM_FATAL_ERR);
+    if (badvalue(av.d))	/* wait for a usable value */
+	return;
     size = sizeof(instData);
-    avedata->instlist[pos] = instdata = (instData *) malloc(size);
-    if (instdata == NULL)
+    if ((instdata = (instData *) calloc(1, size)) == NULL)
 	pmNoMem("newHashInst.instlist[inst]", size, PM_FATAL_ERR);
     if (nbins == 0)
 	instdata->bin = NULL;
@@ -443,6 +755,11 @@ newHashInst(pmValue *vp,
 	    pmNoMem("newHashInst.instlist[inst].bin", size, PM_FATAL_ERR);
 	memset(instdata->bin, 0, size);
     }
+    if (quantflag) {
+	size = sizeof(sketchData);
+	if ((instdata->sketch = (sketchData *)calloc(1, size)) == NULL)
+	    pmNoMem("newHashInst.instlist[inst].sketch", size, PM_FATAL_ERR);
+    }
     instdata->inst = vp->inst;
     if (avedata->desc.sem == PM_SEM_COUNTER) {
 	instdata->min = 0.0;
@@ -463,6 +780,7 @@ newHashInst(pmValue *vp,
 	instdata->stocave = av.d;
 	instdata->timeave = 0.0;
 	instdata->count = 1;
+	addvalue(instdata, av.d);
     }
     instdata->marked = 0;
     instdata->bintotal = 0;
@@ -470,7 +788,10 @@ newHashInst(pmValue *vp,
     instdata->lastval = av.d;
     instdata->firsttime = *timestamp;
     instdata->lasttime = *timestamp;
-    avedata->listsize++;
+    instdata->headval = av.d;
+    instdata->headtime = *timestamp;
+    instdata->headmark = sp->nmark;
+    addinst(avedata, instdata);
     if (pmDebugOptions.appl0) {
 	int	numnames;
 	char	**names;
@@ -483,7 +804,8 @@ newHashInst(pmValue *vp,
 }
 
 static void
-newHashItem(pmValueSet *vsp,
+newHashItem(sliceData *sp,
+	pmValueSet *vsp,
 	pmDesc *desc,
 	aveData *avedata,		/* output from this function */
 	struct timeval *timestamp)	/* timestamp for this sample */
@@ -512,8 +834,9 @@ newHashItem(pmValueSet *vsp,
     }
     avedata->listsize = 0;
     avedata->instlist = NULL;
+    __pmHashInit(&avedata->insthash);
     for (j = 0; j < vsp->numval; j++)
-	newHashInst(&vsp->vlist[j], avedata, vsp->valfmt, timestamp, j);
+	newHashInst(sp, &vsp->vlist[j], avedata, vsp->valfmt, timestamp);
 }
 
 /*
@@ -549,42 +872,49 @@ findbin(pmID pmid, double val, double min, double max)
     return index;
 }
 
+/*
+ * note a mark record at stamp for one instance of a metric
+ */
+static void
+markinst(aveData *avedata, instData *instdata, struct timeval *stamp)
+{
+    double		val;
+    struct timeval	timediff;
+
+    if (avedata->desc.sem == PM_SEM_DISCRETE) {
+	/* extend discrete metrics to the mark point */
+	timediff = *stamp;
+	tsub(&timediff, &instdata->lasttime);
+	val = instdata->lastval;
+	instdata->stocave += val;
+	instdata->timeave += val*pmtimevalToReal(&timediff);
+	instdata->lasttime = *stamp;
+	instdata->count++;
+    }
+    instdata->marked = 1;
+    instdata->markcount++;
+}
+
 /*
  * must keep a note for every instance of every metric whenever a mark
  * record has been seen between now & the last fetch for that instance
  */
 static void
-markrecord(pmResult *result)
+markrecord(__pmHashCtl *hcp, pmResult *result)
 {
     int			i, j;
     __pmHashNode	*hptr;
     aveData		*avedata;
-    instData		*instdata;
-    double		val;
-    struct timeval	timediff;
 
     if (pmDebugOptions.appl0) {
 	printstamp(&result->timestamp, '\n');
 	printf(" - mark record\n\n");
     }
-    for (i = 0; i < hashlist.hsize; i++) {
-	for (hptr = hashlist.hash[i]; hptr != NULL; hptr = hptr->next) {
+    for (i = 0; i < hcp->hsize; i++) {
+	for (hptr = hcp->hash[i]; hptr != NULL; hptr = hptr->next) {
 	    avedata = (aveData *)hptr->data;
-	    for (j = 0; j < avedata->listsize; j++) {
-		instdata = avedata->instlist[j];
-		if (avedata->desc.sem == PM_SEM_DISCRETE) {
-		    /* extend discrete metrics to the mark point */
-		    timediff = result->timestamp;
-		    tsub(&timediff, &instdata->lasttime);
-		    val = instdata->lastval;
-		    instdata->stocave += val;
-		    instdata->timeave += val*pmtimevalToReal(&timediff);
-		    instdata->lasttime = result->timestamp;
-		    instdata->count++;
-		}
-		instdata->marked = 1;
-		instdata->markcount++;
-	    }
+	    for (j = 0; j < avedata->listsize; j++)
+		markinst(avedata, avedata->instlist[j], &result->timestamp);
 	}
     }
 }
@@ -607,7 +937,7 @@ calcbinning(pmResult *result)
     struct timeval	timediff;
 
     if (result->numpmid == 0)	/* mark record */
-	markrecord(result);
+	markrecord(&hashlist, result);
 
     for (i = 0; i < result->numpmid; i++) {
 	vsp = result->vset[i];
@@ -621,25 +951,11 @@ calcbinning(pmResult *result)
 	if ((hptr = __pmHashSearch(vsp->pmid, &hashlist)) != NULL) {
 	    avedata = (aveData *)hptr->data;
 	    for (j = 0; j < vsp->numval; j++) {	/* iterate thro result values */
-		int	fp_bad;
 		vp = &vsp->vlist[j];
-		k = j;	/* index into stored inst list, result may differ */
-		if ((vsp->numval > 1) || (avedata->desc.indom != PM_INDOM_NULL)) {
-		    if ((k < avedata->listsize) && (avedata->instlist[k]->inst != vp->inst)) {
-			for (k = 0; k < avedata->listsize; k++) {
-			    if (vp->inst == avedata->instlist[k]->inst)
-				break;	/* k now correct */
-			}
-			if (k == avedata->listsize) {
-			    pmiderr(vsp->pmid, "ignoring new instance found on second pass\n");
-			    continue;
-			}
-		    }
-		    else if (k >= avedata->listsize) {
-			k = avedata->listsize;
-			pmiderr(vsp->pmid, "ignoring new instance found on second pass\n");
-			continue;
-		    }
+		/* index into stored inst list, result may differ */
+		if ((k = findinst(avedata, vsp, j)) < 0) {
+		    pmiderr(vsp->pmid, "ignoring new instance found on second pass\n");
+		    continue;
 		}
 		instdata = avedata->instlist[k];
 
@@ -647,15 +963,7 @@ calcbinning(pmResult *result)
 		    pmiderr(avedata->desc.pmid, "failed to extract value: %s\n", pmErrStr(sts));
 		    continue;
 		}
-		fp_bad = 0;
-#ifdef HAVE_FPCLASSIFY
-		fp_bad = fpclassify(av.d) == FP_NAN;
-#else
-#ifdef HAVE_ISNAN
-		fp_bad = isnan(av.d);
-#endif
-#endif
-		if (fp_bad)
+		if (badvalue(av.d))
 		    continue;
 
 		/* reset values from first pass needed in this second pass */
@@ -714,7 +1022,7 @@ calcbinning(pmResult *result)
 }
 
 static void
-calcaverage(pmResult *result)
+calcaverage(sliceData *sp, pmResult *result)
 {
     int			i, j, k;
     int			sts;
@@ -729,10 +1037,16 @@ calcaverage(pmResult *result)
     instData		*instdata;
     double		diff;
     double		rate = 0;
+    size_t		size;
     struct timeval	timediff;
 
-    if (result->numpmid == 0)	/* mark record */
-	markrecord(result);
+    if (result->numpmid == 0) {	/* mark record */
+	size = (sp->nmark+1) * sizeof(struct timeval);
+	if ((sp->mark = (struct timeval *)realloc(sp->mark, size)) == NULL)
+	    pmNoMem("calcaverage.mark", size, PM_FATAL_ERR);
+	sp->mark[sp->nmark++] = result->timestamp;
+	markrecord(&sp->hashlist, result);
+    }
 
     for (i = 0; i < result->numpmid; i++) {
 	vsp = result->vset[i];
@@ -744,7 +1058,7 @@ calcaverage(pmResult *result)
 	}
 
 	/* check if pmid already in hash list */
-	if ((hptr = __pmHashSearch(vsp->pmid, &hashlist)) == NULL) {
+	if ((hptr = __pmHashSearch(vsp->pmid, &sp->hashlist)) == NULL) {
 	    if ((sts = pmLookupDesc(vsp->pmid, &desc)) < 0) {
 		pmiderr(vsp->pmid, "cannot find descriptor: %s\n", pmErrStr(sts));
 		continue;
@@ -758,40 +1072,26 @@ calcaverage(pmResult *result)
 
 	    /* create a new one & add to list */
 	    avedata = (aveData*) malloc(sizeof(aveData));
-	    newHashItem(vsp, &desc, avedata, &result->timestamp);
-	    if (__pmHashAdd(avedata->desc.pmid, (void*)avedata, &hashlist) < 0) {
+	    newHashItem(sp, vsp, &desc, avedata, &result->timestamp);
+	    if (__pmHashAdd(avedata->desc.pmid, (void*)avedata, &sp->hashlist) < 0) {
 		pmiderr(avedata->desc.pmid, "failed %s hash table insertion\n", pmGetProgname());
 		/* free memory allocated above on insert failure */
-		for (j = 0; j < vsp->numval; j++)
-		    if (avedata->instlist[j]) free(avedata->instlist[j]);
+		for (j = 0; j < avedata->listsize; j++)
+		    freeinst(avedata->instlist[j]);
 		if (avedata->instlist) free(avedata->instlist);
+		__pmHashFree(&avedata->insthash);
 		continue;
 	    }
 	}
 	else {	/* pmid exists - update statistics */
 	    avedata = (aveData*)hptr->data;
 	    for (j = 0; j < vsp->numval; j++) {	/* iterate thro result values */
-		int	fp_bad;
 		vp = &vsp->vlist[j];
-		k = j;	/* index into stored inst list, result may differ */
-		if ((vsp->numval > 1) || (avedata->desc.indom != PM_INDOM_NULL)) {
-		    /* must store values using correct inst - probably in correct order already */
-		    if ((k < avedata->listsize) && (avedata->instlist[k]->inst != vp->inst)) {
-			for (k = 0; k < avedata->listsize; k++) {
-			    if (vp->inst == avedata->instlist[k]->inst) {
-				break;	/* k now correct */
-			    }
-			}
-			if (k == avedata->listsize) {	/* no matching inst was found */
-			    newHashInst(vp, avedata, vsp->valfmt, &result->timestamp, k);
-			    continue;
-			}
-		    }
-		    else if (k >= avedata->listsize) {
-			k = avedata->listsize;
-			newHashInst(vp, avedata, vsp->valfmt, &result->timestamp, k);
-			continue;
-		    }
+		/* must store values using correct inst - probably in correct order already */
+		if ((k = findinst(avedata, vsp, j)) < 0) {
+		    /* no matching inst was found */
+		    newHashInst(sp, vp, avedata, vsp->valfmt, &result->timestamp);
+		    continue;
 		}
 		instdata = avedata->instlist[k];
 
@@ -799,15 +1099,7 @@ calcaverage(pmResult *result)
 		    pmiderr(avedata->desc.pmid, "failed to extract value: %s\n", pmErrStr(sts));
 		    continue;
 		}
-		fp_bad = 0;
-#ifdef HAVE_FPCLASSIFY
-		fp_bad = fpclassify(av.d) == FP_NAN;
-#else
-#ifdef HAVE_ISNAN
-		fp_bad = isnan(av.d);
-#endif
-#endif
-		if (fp_bad)
+		if (badvalue(av.d))
 		    continue;
 		timediff = result->timestamp;
 		tsub(&timediff, &instdata->lasttime);
@@ -859,6 +1151,7 @@ calcaverage(pmResult *result)
 			if (instdata->count == 0) {		/* 1st time */
 			    instdata->min = instdata->max = rate;
 			    instdata->sum = (val - instdata->lastval);
+			    instdata->ratetime = result->timestamp;
 			}
 			else {
 			    if (pmDebugOptions.appl2) {
@@ -899,12 +1192,14 @@ calcaverage(pmResult *result)
 			    }
 			    instdata->sum += (val - instdata->lastval);
 			}
+			addvalue(instdata, rate);
 		    }
 		}
 		else {	/* for the other semantics - discrete & instantaneous */
 		    val = av.d;
 		    instdata->sum += val;
 		    instdata->stocave += val;
+		    addvalue(instdata, val);
 		    if (val < instdata->min) {
 			instdata->min = val;
 			instdata->mintime = result->timestamp;
@@ -968,6 +1263,394 @@ calcaverage(pmResult *result)
     }
 }
 
+/*
+ * Fold the statistics for one instance from a later slice (from) into
+ * those for all the earlier slices (instdata), as though the values had
+ * been seen in one pass.  The first sample in the later slice was taken
+ * as the start of the series there, so it is done again here following
+ * the last sample before it.
+ */
+static void
+mergeinst(aveData *avedata, instData *instdata, sliceData *sp, instData *from)
+{
+    int			m;
+    double		val;
+    double		diff;
+    double		rate;
+    struct timeval	timediff;
+
+    /* mark records in the slice before the first sample */
+    for (m = 0; m < from->headmark; m++)
+	markinst(avedata, instdata, &sp->mark[m]);
+
+    /* slices do not overlap in time, so diff is never zero here */
+    timediff = from->headtime;
+    tsub(&timediff, &instdata->lasttime);
+    diff = pmtimevalToReal(&timediff);
+    if (avedata->desc.sem == PM_SEM_COUNTER) {
+	diff *= avedata->scale;
+	if (instdata->marked)
+	    val = from->headval;
+	else
+	    val = unwrap(from->headval, instdata->lastval, avedata->desc.type);
+	if (instdata->marked || val < instdata->lastval) {
+	    instdata->marked = 0;
+	    tadd(&instdata->firsttime, &from->headtime);
+	    tsub(&instdata->firsttime, &instdata->lasttime);
+	}
+	else {
+	    rate = (val - instdata->lastval) / diff;
+	    instdata->stocave += rate;
+	    instdata->timeave += (val - instdata->lastval);
+	    if (instdata->count == 0) {
+		instdata->min = instdata->max = rate;
+		instdata->sum = (val - instdata->lastval);
+	    }
+	    else {
+		if (rate < instdata->min) {
+		    instdata->min = rate;
+		    instdata->mintime = from->headtime;
+		}
+		if (rate > instdata->max) {
+		    instdata->max = rate;
+		    instdata->maxtime = from->headtime;
+		}
+		instdata->sum += (val - instdata->lastval);
+	    }
+	    instdata->count++;
+	    addvalue(instdata, rate);
+	}
+	/*
+	 * min/max for the rest of the rates ... the first rate in the
+	 * slice did not set the time (it was the first one there)
+	 */
+	if (from->count > 0) {
+	    if (instdata->count == 0) {
+		instdata->min = from->min;
+		instdata->max = from->max;
+		if (tbefore(&from->headtime, &from->mintime))
+		    instdata->mintime = from->mintime;
+		if (tbefore(&from->headtime, &from->maxtime))
+		    instdata->maxtime = from->maxtime;
+	    }
+	    else {
+		if (from->min < instdata->min) {
+		    instdata->min = from->min;
+		    instdata->mintime = tbefore(&from->headtime, &from->mintime) ?
+				from->mintime : from->ratetime;
+		}
+		if (from->max > instdata->max) {
+		    instdata->max = from->max;
+		    instdata->maxtime = tbefore(&from->headtime, &from->maxtime) ?
+				from->maxtime : from->ratetime;
+		}
+	    }
+	}
+    }
+    else {
+	/* the first value itself is already in the slice statistics */
+	if (!instdata->marked)
+	    instdata->timeave += instdata->lastval*diff;
+	else {
+	    instdata->marked = 0;
+	    tadd(&instdata->firsttime, &from->headtime);
+	    tsub(&instdata->firsttime, &instdata->lasttime);
+	}
+	if (from->min < instdata->min) {
+	    instdata->min = from->min;
+	    instdata->mintime = from->mintime;
+	}
+	if (from->max > instdata->max) {
+	    instdata->max = from->max;
+	    instdata->maxtime = from->maxtime;
+	}
+    }
+
+    instdata->count += from->count;
+    instdata->stocave += from->stocave;
+    instdata->timeave += from->timeave;
+    instdata->sum += from->sum;
+    instdata->markcount += from->markcount;
+    mergevalues(instdata, from);
+    /* time removed from the time-based calc within the slice */
+    tadd(&instdata->firsttime, &from->firsttime);
+    tsub(&instdata->firsttime, &from->headtime);
+    instdata->marked = from->marked;
+    instdata->lastval = from->lastval;
+    instdata->lasttime = from->lasttime;
+}
+
+/*
+ * Fold a later slice into hashlist, which holds the statistics for all
+ * of the earlier slices
+ */
+static void
+mergeslice(sliceData *sp)
+{
+    int			i, j, k, m;
+    __pmHashNode	*hptr;
+    __pmHashNode	*sptr;
+    __pmHashNode	*iptr;
+    aveData		*avedata;
+    aveData		*from;
+    instData		*instdata;
+
+    for (i = 0; i < hashlist.hsize; i++) {
+	for (hptr = hashlist.hash[i]; hptr != NULL; hptr = hptr->next) {
+	    avedata = (aveData *)hptr->data;
+	    from = NULL;
+	    if ((sptr = __pmHashSearch(avedata->desc.pmid, &sp->hashlist)) != NULL)
+		from = (aveData *)sptr->data;
+	    for (j = 0; j < avedata->listsize; j++) {
+		instdata = avedata->instlist[j];
+		k = -1;
+		if (from == NULL)
+		    ;
+		else if (avedata->desc.indom == PM_INDOM_NULL) {
+		    /* as for findinst(), inst is not to be trusted here */
+		    if (j < from->listsize)
+			k = j;
+		}
+		else if ((iptr = __pmHashSearch((unsigned int)instdata->inst, &from->insthash)) != NULL)
+		    k = (int)(__psint_t)iptr->data;
+		if (k < 0) {
+		    /* not seen in the slice, but the marks still count */
+		    for (m = 0; m < sp->nmark; m++)
+			markinst(avedata, instdata, &sp->mark[m]);
+		    continue;
+		}
+		mergeinst(avedata, instdata, sp, from->instlist[k]);
+		freeinst(from->instlist[k]);
+		from->instlist[k] = NULL;
+	    }
+	    if (from == NULL)
+		continue;
+	    /* instances first seen in the slice */
+	    for (k = 0; k < from->listsize; k++) {
+		if (from->instlist[k] != NULL)
+		    addinst(avedata, from->instlist[k]);
+	    }
+	    if (from->instlist) free(from->instlist);
+	    __pmHashFree(&from->insthash);
+	    free(from);
+	    sptr->data = NULL;
+	}
+    }
+
+    /* metrics first seen in the slice */
+    for (i = 0; i < sp->hashlist.hsize; i++) {
+	for (sptr = sp->hashlist.hash[i]; sptr != NULL; sptr = sptr->next) {
+	    if ((from = (aveData *)sptr->data) == NULL)
+		continue;
+	    if (__pmHashAdd(from->desc.pmid, (void *)from, &hashlist) < 0)
+		pmNoMem("mergeslice.hashlist", sizeof(__pmHashNode), PM_FATAL_ERR);
+	}
+    }
+    __pmHashFree(&sp->hashlist);
+    if (sp->mark)
+	free(sp->mark);
+}
+
+static void
+freeslice(sliceData *sp)
+{
+    int			i, j;
+    __pmHashNode	*hptr;
+    aveData		*avedata;
+
+    for (i = 0; i < sp->hashlist.hsize; i++) {
+	for (hptr = sp->hashlist.hash[i]; hptr != NULL; hptr = hptr->next) {
+	    avedata = (aveData *)hptr->data;
+	    for (j = 0; j < avedata->listsize; j++)
+		freeinst(avedata->instlist[j]);
+	    if (avedata->instlist) free(avedata->instlist);
+	    __pmHashFree(&avedata->insthash);
+	    free(avedata);
+	}
+    }
+    __pmHashFree(&sp->hashlist);
+    if (sp->mark)
+	free(sp->mark);
+    memset(sp, 0, sizeof(*sp));
+}
+
+/*
+ * First pass over the records in one slice of the archive
+ */
+static void *
+scanslice(void *arg)
+{
+    sliceData	*sp = (sliceData *)arg;
+    pmResult	*result;
+    int		sts;
+
+    if ((sts = pmUseContext(sp->ctx)) < 0) {
+	fprintf(stderr, "%s: Cannot use context: %s\n",
+		pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+    for ( ; ; ) {
+	if ((sts = pmFetchArchive(&result)) < 0)
+	    break;
+
+	if (tbefore(&result->timestamp, &sp->start)) {
+	    /* belongs to the slice before */
+	    pmFreeResult(result);
+	}
+	else if (sp->last ? !tbefore(&sp->end, &result->timestamp) :
+			    tbefore(&result->timestamp, &sp->end)) {
+	    calcaverage(sp, result);
+	    pmFreeResult(result);
+	}
+	else {
+	    pmFreeResult(result);
+	    sts = PM_ERR_EOL;
+	    break;
+	}
+    }
+    sp->sts = sts;
+    return NULL;
+}
+
+/*
+ * First pass over the archive ... with -j, the time window is divided
+ * into equal slices, each with its own archive context, and the slices
+ * are summarized in parallel then merged in time order.  Returns the
+ * status of the last fetch, as for a single pass.
+ */
+static int
+summarize(int ctx, char *archive)
+{
+    sliceData		*slice;
+    struct timeval	when;
+    struct timeval	usec = { 0, 1 };
+    double		start;
+    double		span;
+    int			nslice = 1;
+    int			i;
+    int			sts;
+#ifdef HAVE_PTHREAD_H
+    pthread_t		*tid = NULL;
+    long		ncpu = 2;
+
+    nslice = threads;
+#ifdef _SC_NPROCESSORS_ONLN
+    if ((ncpu = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+	ncpu = 1;
+#endif
+    if (nslice > ncpu)
+	nslice = ncpu;
+    if (opts.finish.tv_sec == PM_MAX_TIME_T || !tbefore(&opts.start, &opts.finish))
+	nslice = 1;
+#endif
+
+    if ((slice = (sliceData *)calloc(nslice, sizeof(sliceData))) == NULL)
+	pmNoMem("summarize.slice", nslice * sizeof(sliceData), PM_FATAL_ERR);
+    start = pmtimevalToReal(&opts.start);
+    span = pmtimevalToReal(&opts.finish) - start;
+    for (i = 0; i < nslice; i++) {
+	if (i == 0) {
+	    slice[i].ctx = ctx;
+	    slice[i].start = opts.start;
+	}
+	else {
+	    pmtimevalFromReal(start + span * i / nslice, &slice[i].start);
+	    if ((slice[i].ctx = pmNewContext(PM_CONTEXT_ARCHIVE, archive)) < 0) {
+		fprintf(stderr, "%s: Cannot open archive \"%s\": %s\n",
+			pmGetProgname(), archive, pmErrStr(slice[i].ctx));
+		exit(1);
+	    }
+	    /*
+	     * just before the start, so no record at the start is missed,
+	     * the records before it are skipped in scanslice()
+	     */
+	    when = slice[i].start;
+	    tsub(&when, &usec);
+	    if ((sts = pmSetMode(PM_MODE_FORW, &when, 0)) < 0) {
+		fprintf(stderr, "%s: pmSetMode failed: %s\n", pmGetProgname(), pmErrStr(sts));
+		exit(1);
+	    }
+	    slice[i-1].end = slice[i].start;
+	}
+    }
+    slice[nslice-1].end = opts.finish;
+    slice[nslice-1].last = 1;
+    if (pmDebugOptions.appl0 && nslice > 1)
+	fprintf(stderr, "summarize: %d slices\n", nslice);
+
+#ifdef HAVE_PTHREAD_H
+    if (nslice > 1) {
+	if ((tid = (pthread_t *)calloc(nslice, sizeof(pthread_t))) == NULL)
+	    pmNoMem("summarize.tid", nslice * sizeof(pthread_t), PM_FATAL_ERR);
+	for (i = 1; i < nslice; i++) {
+	    if ((sts = pthread_create(&tid[i], NULL, scanslice, &slice[i])) != 0) {
+		fprintf(stderr, "%s: Cannot create thread for slice %d: %s\n",
+			pmGetProgname(), i, pmErrStr(-sts));
+		exit(1);
+	    }
+	}
+    }
+    scanslice(&slice[0]);
+    for (i = 1; i < nslice; i++) {
+	pthread_join(tid[i], NULL);
+	pmDestroyContext(slice[i].ctx);
+    }
+    if (tid)
+	free(tid);
+#else
+    scanslice(&slice[0]);
+#endif
+    if ((sts = pmUseContext(ctx)) < 0) {
+	fprintf(stderr, "%s: Cannot use context: %s\n",
+		pmGetProgname(), pmErrStr(sts));
+	exit(1);
+    }
+
+    for (i = 1; i < nslice; i++) {
+	if (slice[i].sts != PM_ERR_EOL)
+	    break;
+    }
+    if (i < nslice && slice[0].sts == PM_ERR_EOL) {
+	/*
+	 * a fetch failed after the start of a later slice, which may be
+	 * a problem with the archive's temporal index used to get there
+	 * ... start again with one slice, read in order from the start
+	 */
+	if (pmDebugOptions.appl0)
+	    fprintf(stderr, "summarize: slice %d: %s, one slice instead\n",
+		    i, pmErrStr(slice[i].sts));
+	for (i = 0; i < nslice; i++)
+	    freeslice(&slice[i]);
+	nslice = 1;
+	slice[0].ctx = ctx;
+	slice[0].start = opts.start;
+	slice[0].end = opts.finish;
+	slice[0].last = 1;
+	if ((sts = pmSetMode(PM_MODE_FORW, &opts.start, 0)) < 0) {
+	    fprintf(stderr, "%s: pmSetMode reset failed: %s\n",
+		pmGetProgname(), pmErrStr(sts));
+	    exit(1);
+	}
+	scanslice(&slice[0]);
+    }
+
+    hashlist = slice[0].hashlist;	/* struct assignment */
+    if (slice[0].mark)
+	free(slice[0].mark);
+    sts = slice[0].sts;
+    for (i = 1; i < nslice; i++) {
+	if (sts != PM_ERR_EOL)
+	    /* a fetch failed, the pass stops there */
+	    break;
+	mergeslice(&slice[i]);
+	sts = slice[i].sts;
+    }
+    for ( ; i < nslice; i++)
+	freeslice(&slice[i]);
+    free(slice);
+    return sts;
+}
+
 static int
 override(int opt, pmOptions *optsp)
 {
@@ -979,7 +1662,7 @@ override(int opt, pmOptions *optsp)
 int
 main(int argc, char *argv[])
 {
-    int			c, i, sts, trip, exitstatus = 0;
+    int			c, i, sts, exitstatus = 0;
     int			lflag = 0;		/* no label by default */
     int			Hflag = 0;		/* no header by default */
     pmResult		*result;
@@ -1012,6 +1695,10 @@ main(int argc, char *argv[])
 		nbins = (unsigned int)sts;
 	    break;
 
+	case 'd':	/* print standard deviation */
+	    devflag = 1;
+	    break;
+
 	case 'f':	/* spreadsheet format - use tab delimiters */
 	    delimiter = '\t';
 	    break;
@@ -1032,6 +1719,15 @@ main(int argc, char *argv[])
 	    maxtimeflag = 1;
 	    break;
 
+	case 'j':	/* slices summarized in parallel */
+	    threads = (int)strtol(opts.optarg, &endnum, 10);
+	    if (*endnum != '\0' || threads < 1) {
+		pmprintf("%s: -j requires positive numeric argument\n",
+			pmGetProgname());
+		opts.errors++;
+	    }
+	    break;
+
 	case 'l':	/* display label */
 	    lflag = 1;
 	    break;
@@ -1056,8 +1752,13 @@ main(int argc, char *argv[])
 	    }
 	    break;
 
+	case 'q':	/* print quantiles */
+	    quantflag = 1;
+	    break;
+
 	case 's':	/* print sums (and only sums) */
 	    stocaveflag = timeaveflag = lflag = countflag = minflag = maxflag = 0;
+	    devflag = quantflag = 0;
 	    sumflag = 1;
 	    break;
 
@@ -1125,7 +1826,19 @@ main(int argc, char *argv[])
     if (timespan.tv_sec > 86400) /* seconds per day: 60*60*24 */
 	dayflag = 1;
 
-    for (trip = 0; trip < 2; trip++) {	/* two passes if binning */
+    /* PCP_COUNTER_WRAP in environment enables "counter wrap" logic */
+    dowrap = getenv("PCP_COUNTER_WRAP") != NULL;
+
+    sts = summarize(c, archive);
+
+    if (nbins > 0) {	/* distribute values into bins, a second pass */
+	if (pmDebugOptions.appl0)
+	    fprintf(stderr, "resetting for second iteration\n");
+	if ((sts = pmSetMode(PM_MODE_FORW, &opts.start, 0)) < 0) {
+	    fprintf(stderr, "%s: pmSetMode reset failed: %s\n",
+		pmGetProgname(), pmErrStr(sts));
+	    exit(1);
+	}
 	for ( ; ; ) {
 	    if ((sts = pmFetchArchive(&result)) < 0)
 		break;
@@ -1133,10 +1846,7 @@ main(int argc, char *argv[])
 	    if (opts.finish.tv_sec > result->timestamp.tv_sec ||
 		(opts.finish.tv_sec == result->timestamp.tv_sec &&
 		 opts.finish.tv_usec >= result->timestamp.tv_usec)) {
-		if (trip == 0)
-		    calcaverage(result);
-		else
-		    calcbinning(result);
+		calcbinning(result);
 		pmFreeResult(result);
 	    }
 	    else {
@@ -1145,18 +1855,6 @@ main(int argc, char *argv[])
 		break;
 	    }
 	}
-
-	if (trip == 0 && nbins > 0) {	/* distribute values into bins */
-	    if (pmDebugOptions.appl0)
-		fprintf(stderr, "resetting for second iteration\n");
-	    if ((sts = pmSetMode(PM_MODE_FORW, &opts.start, 0)) < 0) {
-		fprintf(stderr, "%s: pmSetMode reset failed: %s\n",
-		    pmGetProgname(), pmErrStr(sts));
-		exit(1);
-	    }
-	}
-	else
-	    break;	/* two passes only when doing binning */
     }
 
     if (sts != PM_ERR_EOL) {
@@ -999,6 +999,9 @@ setup_http_module(struct proxy *proxy)
     register_servlet(proxy, &pmsearch_servlet);
     register_servlet(proxy, &pmseries_servlet);
     register_servlet(proxy, &pmwebapi_servlet);
+#ifdef HAVE_REMOTE_WRITE
+    register_servlet(proxy, &pmremote_servlet);
+#endif
 }
 
 void
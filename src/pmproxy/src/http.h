@@ -95,5 +95,8 @@ typedef struct servlet {
 extern struct servlet pmsearch_servlet;
 extern struct servlet pmseries_servlet;
 extern struct servlet pmwebapi_servlet;
+#ifdef HAVE_REMOTE_WRITE
+extern struct servlet pmremote_servlet;
+#endif
 
 #endif /* PMPROXY_HTTP_H */
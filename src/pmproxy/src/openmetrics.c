@@ -11,9 +11,27 @@
  * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
  * License for more details.
  */
+#include <uv.h>
 #include "openmetrics.h"
 #include "libpcp.h"
 
+/*
+ * Merging and escaping labels is the dominant cost of a scrape, yet the
+ * result rarely changes between scrapes.  Merged Open Metrics labels are
+ * cached here, keyed on the content of the labelsets (and instance) they
+ * were produced from, so unchanged labels cost one hash and one copy.
+ */
+typedef struct labelkey {
+    uint64_t		hash;		/* hash of all labelset JSON */
+    unsigned int	instid;		/* instance identifier */
+    sds			content;	/* cached: labelsets, instance name */
+    pmWebLabelSet	*labels;	/* lookup: compared where they lie */
+} labelkey_t;
+
+static dict		*labelcache;
+static unsigned int	labelcache_limit = 65536;
+static uv_mutex_t	labelcache_lock;
+
 static void
 labelname(const pmLabel *lp, const char *json, __pmHashCtl *lc,
 		const char **name, int *length)
@@ -118,6 +136,203 @@ open_metrics_labels(pmWebLabelSet *labels, struct dict *labeldict)
     } while (cursor);
 }
 
+static uint64_t
+labelKeyHashCallBack(const void *key)
+{
+    return ((const labelkey_t *)key)->hash;
+}
+
+/*
+ * Cached keys hold the JSON of each labelset (NUL separated) followed
+ * by the instance name - compare that content against the labelsets
+ * being looked up, so a hash collision can never return wrong labels.
+ */
+static int
+labelkey_content_equal(const sds content, pmWebLabelSet *labels)
+{
+    pmLabelSet		*labelset;
+    const char		*p = content, *end = content + sdslen(content);
+    size_t		length;
+    int			i;
+
+    for (i = 0; i < labels->nsets; i++) {
+	if ((labelset = labels->sets[i])->json == NULL)
+	    continue;
+	length = labelset->jsonlen;
+	if ((size_t)(end - p) < length + 1 || p[length] != '\0' ||
+	    memcmp(p, labelset->json, length) != 0)
+	    return 0;
+	p += length + 1;
+    }
+    if (labels->instname) {
+	length = sdslen(labels->instname);
+	if ((size_t)(end - p) < length || memcmp(p, labels->instname, length) != 0)
+	    return 0;
+	p += length;
+    }
+    return p == end;
+}
+
+static int
+labelKeyCompareCallBack(void *privdata, const void *key1, const void *key2)
+{
+    const labelkey_t	*k1 = (const labelkey_t *)key1;
+    const labelkey_t	*k2 = (const labelkey_t *)key2;
+
+    (void)privdata;
+    if (k1->hash != k2->hash || k1->instid != k2->instid)
+	return 0;
+    if (k1->labels)
+	return labelkey_content_equal(k2->content, k1->labels);
+    if (k2->labels)
+	return labelkey_content_equal(k1->content, k2->labels);
+    return sdslen(k1->content) == sdslen(k2->content) &&
+	   memcmp(k1->content, k2->content, sdslen(k1->content)) == 0;
+}
+
+static void
+labelKeyFreeCallBack(void *privdata, void *key)
+{
+    (void)privdata;
+    sdsfree(((labelkey_t *)key)->content);
+    free(key);
+}
+
+static void
+labelValueFreeCallBack(void *privdata, void *value)
+{
+    (void)privdata;
+    sdsfree(value);
+}
+
+static dictType labelCacheCallBacks = {
+    .hashFunction	= labelKeyHashCallBack,
+    .keyCompare		= labelKeyCompareCallBack,
+    .keyDestructor	= labelKeyFreeCallBack,
+    .valDestructor	= labelValueFreeCallBack,
+};
+
+static void
+labelkey(pmWebLabelSet *labels, labelkey_t *key)
+{
+    pmLabelSet		*labelset;
+    uint64_t		hash = 0;
+    int			i;
+
+    memset(key, 0, sizeof(*key));
+    for (i = 0; i < labels->nsets; i++) {
+	if ((labelset = labels->sets[i])->json == NULL)
+	    continue;
+	hash = (hash * 1099511628211ULL) ^
+		dictGenHashFunction(labelset->json, labelset->jsonlen);
+    }
+    if (labels->instname) {
+	hash = (hash * 1099511628211ULL) ^
+		dictGenHashFunction(labels->instname, sdslen(labels->instname));
+    }
+    key->hash = hash;
+    key->instid = labels->instid;
+    key->labels = labels;
+}
+
+/* copy of the content of a lookup key, for a new cache entry */
+static sds
+labelkey_content(pmWebLabelSet *labels)
+{
+    pmLabelSet		*labelset;
+    sds			content = sdsempty();
+    int			i;
+
+    for (i = 0; i < labels->nsets; i++) {
+	if ((labelset = labels->sets[i])->json == NULL)
+	    continue;
+	content = sdscatlen(content, labelset->json, labelset->jsonlen + 1);
+    }
+    if (labels->instname)
+	content = sdscatsds(content, labels->instname);
+    return content;
+}
+
+/*
+ * Convert an array of PCP labelsets into Open Metrics form, using the
+ * label cache - the given dictionary is scratch space for cache misses.
+ */
+void
+open_metrics_cache_labels(pmWebLabelSet *labels, struct dict *labeldict)
+{
+    labelkey_t		key, *kp;
+    dictEntry		*entry;
+    sds			value;
+
+    if (labelcache == NULL) {
+	open_metrics_labels(labels, labeldict);
+	dictEmpty(labeldict, NULL);
+	return;
+    }
+
+    labelkey(labels, &key);
+
+    uv_mutex_lock(&labelcache_lock);
+    if ((entry = dictFind(labelcache, &key)) != NULL) {
+	value = (sds)dictGetVal(entry);
+	labels->buffer = sdscpylen(labels->buffer, value, sdslen(value));
+	uv_mutex_unlock(&labelcache_lock);
+	return;
+    }
+    uv_mutex_unlock(&labelcache_lock);
+
+    open_metrics_labels(labels, labeldict);
+    dictEmpty(labeldict, NULL);
+
+    if ((kp = malloc(sizeof(labelkey_t))) == NULL)
+	return;
+    *kp = key;
+    kp->content = labelkey_content(labels);
+    kp->labels = NULL;
+    value = sdsdup(labels->buffer);
+
+    uv_mutex_lock(&labelcache_lock);
+    if (dictSize(labelcache) >= labelcache_limit)
+	dictEmpty(labelcache, NULL);	/* bounded: start afresh */
+    if (dictAdd(labelcache, kp, value) != DICT_OK) {
+	free(kp);	/* raced with another scrape, already cached */
+	sdsfree(value);
+    }
+    uv_mutex_unlock(&labelcache_lock);
+}
+
+void
+open_metrics_setup(dict *config)
+{
+    sds			option;
+    char		*endnum;
+    long		limit;
+
+    if ((option = pmIniFileLookup(config, "pmproxy", "labelcache")) != NULL) {
+	limit = strtol(option, &endnum, 10);
+	if (*endnum != '\0' || limit < 0 || limit > UINT_MAX)
+	    pmNotifyErr(LOG_ERR, "%s: invalid labelcache value \"%s\", "
+			"using %u\n", "open_metrics_setup", option,
+			labelcache_limit);
+	else
+	    labelcache_limit = (unsigned int)limit;
+    }
+    if (labelcache_limit == 0 || labelcache != NULL)
+	return;
+    uv_mutex_init(&labelcache_lock);
+    labelcache = dictCreate(&labelCacheCallBacks, NULL);
+}
+
+void
+open_metrics_close(void)
+{
+    if (labelcache == NULL)
+	return;
+    dictRelease(labelcache);
+    labelcache = NULL;
+    uv_mutex_destroy(&labelcache_lock);
+}
+
 /* check if PCP metric type has valid Open Metrics form */
 int
 open_metrics_type_check(sds type)
@@ -133,12 +348,13 @@ open_metrics_type_check(sds type)
     return -ESRCH;
 }
 
-/* convert PCP metric name to Open Metrics form */
+/* convert PCP metric name to Open Metrics form, reusing a result buffer */
 sds
-open_metrics_name(sds metric, int compat)
+open_metrics_name(sds name, sds metric, int compat)
 {
-    sds		p, name = sdsdup(metric);
-    char	sep = compat ? ':' : '_';
+    char	*p, sep = compat ? ':' : '_';
+
+    name = sdscpylen(name ? name : sdsempty(), metric, sdslen(metric));
 
     for (p = name; p && *p; p++) {
 	/* swap dots with underscores in name */
@@ -149,10 +365,10 @@ open_metrics_name(sds metric, int compat)
 }
 
 /* convert PCP metric type to Open Metrics form */
-sds
+const char *
 open_metrics_semantics(sds sem)
 {
     if (strncmp(sem, "instant", 7) == 0 || strncmp(sem, "discrete", 8) == 0)
-	return sdsnew("gauge");
-    return sdsnew("counter");
+	return "gauge";
+    return "counter";
 }
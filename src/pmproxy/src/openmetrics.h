@@ -21,12 +21,19 @@
 extern int open_metrics_type_check(sds);
 
 /* convert PCP metric name to Open Metrics form */
-extern sds open_metrics_name(sds, int);
+extern sds open_metrics_name(sds, sds, int);
 
 /* convert PCP metric type to Open Metrics form */
-extern sds open_metrics_semantics(sds);
+extern const char *open_metrics_semantics(sds);
 
 /* convert an array of PCP labelsets into Open Metrics form */
 extern void open_metrics_labels(pmWebLabelSet *, dict *);
 
+/* as above, via a cache of labels persisting across scrapes */
+extern void open_metrics_cache_labels(pmWebLabelSet *, dict *);
+
+/* label cache setup and teardown */
+extern void open_metrics_setup(dict *);
+extern void open_metrics_close(void);
+
 #endif	/* OPEN_METRICS_H */
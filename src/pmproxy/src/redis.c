@@ -141,6 +141,7 @@ static void
 on_redis_connected(void *arg)
 {
     struct proxy	*proxy = (struct proxy *)arg;
+    pmDiscoverCallBacks	*callbacks, *exporter;
     sds			message;
 
     message = sdsnew("Redis slots");
@@ -165,12 +166,26 @@ on_redis_connected(void *arg)
 	redis_discover.callbacks = redis_search;
     }
 
-    if (archive_discovery && (series_queries || search_queries)) {
+    /* remote-write exporter receives discovered values last of all */
+    if ((exporter = remote_write_exporter()) != NULL) {
+	if (series_queries || search_queries) {
+	    callbacks = &redis_discover.callbacks;
+	    while (callbacks->next != NULL)
+		callbacks = callbacks->next;
+	    callbacks->next = exporter;
+	} else {
+	    redis_discover.callbacks = *exporter;
+	}
+    }
+
+    if (archive_discovery && (series_queries || search_queries || exporter)) {
 	mmv_registry_t	*registry = proxymetrics(proxy, METRICS_DISCOVER);
 
 	pmDiscoverSetEventLoop(&redis_discover.module, proxy->events);
 	pmDiscoverSetConfiguration(&redis_discover.module, proxy->config);
 	pmDiscoverSetMetricRegistry(&redis_discover.module, registry);
+	pmDiscoverSetSourceMetrics(&redis_discover.module,
+			proxymetrics_path(METRICS_SOURCES), METRICS_SOURCES);
 	pmDiscoverSetup(&redis_discover.module, &redis_discover.callbacks, proxy);
 	pmDiscoverSetSlots(&redis_discover.module, proxy->slots);
     }
@@ -269,4 +284,5 @@ close_redis_module(struct proxy *proxy)
 
     proxymetrics_close(proxy, METRICS_REDIS);
     proxymetrics_close(proxy, METRICS_DISCOVER);
+    proxymetrics_close(proxy, METRICS_SOURCES);
 }
@@ -0,0 +1,1523 @@
+/*
+ * Copyright (c) 2026 Red Hat.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ */
+#include "server.h"
+#include "discover.h"
+#include "encoding.h"
+#include "util.h"
+#include "openmetrics.h"
+#include "remote.pb-c.h"
+#include <snappy-c.h>
+#include <ctype.h>
+#include <netdb.h>
+#include <strings.h>
+
+/*
+ * Prometheus remote-write protocol support - a receiver servlet that
+ * decodes snappy-compressed protobuf WriteRequest messages and loads
+ * samples directly into the Redis time series schema, and an exporter
+ * which encodes discovered PCP archive values into WriteRequests for
+ * an upstream remote-write endpoint.
+ */
+
+#define REMOTE_DOMAIN		144	/* OPENMETRICS PMDA domain number */
+#define REMOTE_MAX_BODY		(64 * 1024 * 1024)
+#define REMOTE_MAX_PENDING	8	/* exporter batches held while busy */
+#define REMOTE_TIMEOUT		30	/* exporter request timeout, seconds */
+#define REMOTE_STALE_NAN	0x7ff0000000000002ULL
+
+#define REMOTE_MAX_SOURCES	1024	/* default receiver limits */
+#define REMOTE_MAX_METRICS	10000
+#define REMOTE_MAX_INSTANCES	10000
+#define REMOTE_EXPIRE		600	/* idle source expiry, seconds */
+
+typedef struct remote_source {
+    pmDiscover		discover;	/* context, labels and load baton */
+    dict		*metrics;	/* metric name -> remote_metric_t */
+    unsigned int	nextid;		/* next metric item identifier */
+    unsigned int	limited : 1;	/* metric/instance limit logged */
+    time_t		updated;	/* time of most recent request */
+} remote_source_t;
+
+typedef struct remote_metric {
+    pmID		pmid;
+    pmInDom		indom;
+    dict		*insts;		/* instance key -> instance id + 1 */
+    unsigned int	nextinst;	/* next instance identifier */
+} remote_metric_t;
+
+typedef struct remote_sample {
+    remote_source_t	*source;
+    int64_t		timestamp;	/* milliseconds since the epoch */
+    pmID		pmid;
+    int			inst;
+    double		value;
+} remote_sample_t;
+
+typedef struct remote_request {
+    remote_sample_t	*samples;	/* all samples of this request */
+    unsigned int	nsamples;
+    unsigned int	maxsamples;
+    void		*arg;
+} remote_request_t;
+
+typedef struct pmRemoteBaton {
+    struct client	*client;
+    sds			body;		/* request content (compressed) */
+    unsigned int	snappy : 1;	/* snappy Content-Encoding */
+    unsigned int	unsupported : 1; /* unknown Content-Encoding */
+    unsigned int	toolarge : 1;	/* request exceeds size limit */
+} pmRemoteBaton;
+
+/*
+ * Exporter state - metric metadata observed via archive discovery and
+ * the pending batch of samples for the next WriteRequest.
+ */
+typedef struct exporter_metric {
+    sds			name;		/* Open Metrics style name */
+    int			type;
+    pmInDom		indom;
+} exporter_metric_t;
+
+typedef struct exporter_source {
+    dict		*metrics;	/* pmID -> exporter_metric_t */
+    dict		*indoms;	/* pmInDom -> dict(inst -> name) */
+} exporter_source_t;
+
+typedef struct exporter_series {
+    sds			name;		/* __name__ label value */
+    sds			hostname;	/* hostname label value or NULL */
+    sds			instname;	/* instname label value or NULL */
+    double		value;
+    int64_t		timestamp;	/* milliseconds since the epoch */
+} exporter_series_t;
+
+typedef struct exporter_message {
+    Prometheus__TimeSeries	series;
+    Prometheus__Label		label[3];
+    Prometheus__Label		*labels[3];
+    Prometheus__Sample		sample;
+    Prometheus__Sample		*samples[1];
+} exporter_message_t;
+
+typedef struct remote_exporter {
+    sds			host;
+    sds			path;
+    unsigned int	port;
+    unsigned int	batchsize;	/* series per WriteRequest */
+    unsigned int	series;		/* series in pending batch */
+    unsigned int	maxseries;	/* allocated batch entries */
+    unsigned int	busy : 1;	/* request in flight */
+    unsigned int	dropped : 1;	/* batches discarded, logged */
+    unsigned int	closed : 1;	/* released once request completes */
+    int			timer;
+    time_t		started;	/* time current request began */
+    struct sockaddr_storage address;
+    uv_loop_t		*events;
+    uv_tcp_t		socket;
+    uv_connect_t	connect;
+    uv_write_t		writer;
+    exporter_series_t	*batch;		/* samples of the next request */
+    sds			request;	/* HTTP request in flight */
+    sds			response;	/* HTTP response status line */
+    sds			metric;		/* name conversion buffer */
+    dict		*sources;	/* pmDiscover -> exporter_source_t */
+    struct proxy	*proxy;
+} remote_exporter_t;
+
+static pmDiscoverSettings remote_discover = {
+    .module.on_info	= proxylog,
+};
+
+static struct proxy *remote_proxy;
+static int remote_enabled;		/* accept remote-write requests */
+static int remote_timer = -1;		/* idle source expiry timer */
+static unsigned int remote_limited;	/* source limit reached, logged */
+static unsigned int remote_max_sources = REMOTE_MAX_SOURCES;
+static unsigned int remote_max_metrics = REMOTE_MAX_METRICS;
+static unsigned int remote_max_instances = REMOTE_MAX_INSTANCES;
+static unsigned int remote_expire = REMOTE_EXPIRE;
+static dict *remote_sources;		/* context labels -> remote_source_t */
+static remote_exporter_t *exporter;
+static sds remote_url;
+
+/*
+ * Receiver - map remote-write series onto PCP sources, metrics and
+ * instances (following pmdaopenmetrics naming), then load each group
+ * of samples sharing a source and timestamp as one result.
+ */
+static int
+remote_label_reserved(const char *name)
+{
+    return strcmp(name, "__name__") == 0 ||
+	   strcmp(name, "job") == 0 ||
+	   strcmp(name, "instance") == 0;
+}
+
+static sds
+remote_labels_json(sds s, Prometheus__Label **labels, size_t nlabels)
+{
+    unsigned int	i, count = 0;
+    sds			value;
+
+    s = sdscatlen(s, "{", 1);
+    for (i = 0; i < nlabels; i++) {
+	if (remote_label_reserved(labels[i]->name))
+	    continue;
+	if (count++)
+	    s = sdscatlen(s, ",", 1);
+	value = unicode_encode(labels[i]->name, strlen(labels[i]->name));
+	s = sdscatsds(s, value);
+	sdsfree(value);
+	s = sdscatlen(s, ":", 1);
+	value = unicode_encode(labels[i]->value, strlen(labels[i]->value));
+	s = sdscatsds(s, value);
+	sdsfree(value);
+    }
+    return sdscatlen(s, "}", 1);
+}
+
+static sds
+remote_labels_key(sds s, Prometheus__Label **labels, size_t nlabels)
+{
+    unsigned int	i;
+
+    for (i = 0; i < nlabels; i++) {
+	if (remote_label_reserved(labels[i]->name))
+	    continue;
+	if (sdslen(s))
+	    s = sdscatlen(s, " ", 1);
+	s = sdscat(s, labels[i]->name);
+	s = sdscatlen(s, ":", 1);
+	s = sdscat(s, labels[i]->value);
+    }
+    return s;
+}
+
+static sds
+remote_metric_name(sds s, const char *job, const char *name)
+{
+    const char		*p;
+
+    s = sdscatlen(s, "openmetrics.", sizeof("openmetrics.")-1);
+    for (p = job; *p; p++)
+	s = sdscatlen(s, isalnum((unsigned char)*p) ? p : "_", 1);
+    s = sdscatlen(s, ".", 1);
+    for (p = name; *p; p++)
+	s = sdscatlen(s, isalnum((unsigned char)*p) ? p : "_", 1);
+    return s;
+}
+
+static int
+remote_metric_semantics(const char *name)
+{
+    static const char	*suffixes[] = { "_total", "_count", "_sum", "_bucket" };
+    size_t		length = strlen(name), n;
+    unsigned int	i;
+
+    for (i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+	n = strlen(suffixes[i]);
+	if (length > n && strcmp(name + length - n, suffixes[i]) == 0)
+	    return PM_SEM_COUNTER;
+    }
+    return PM_SEM_INSTANT;
+}
+
+static void
+remote_log(remote_source_t *source, const char *message)
+{
+    sds			msg;
+
+    if (source)
+	msg = sdscatfmt(sdsempty(), "remote-write source %S: %s",
+			source->discover.context.name, message);
+    else
+	msg = sdscatfmt(sdsempty(), "remote-write receiver: %s", message);
+    proxylog(PMLOG_WARNING, msg, remote_proxy);
+    sdsfree(msg);
+}
+
+static void
+remote_source_free(remote_source_t *source)
+{
+    pmDiscoverEvent	event;
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    remote_metric_t	*metric;
+
+    if (source->discover.baton) {
+	memset(&event, 0, sizeof(event));
+	event.module = &remote_discover.module;
+	event.context = source->discover.context;
+	event.data = &source->discover;
+	pmSeriesDiscoverClosed(&event, remote_proxy);
+    }
+    iterator = dictGetIterator(source->metrics);
+    while ((entry = dictNext(iterator)) != NULL) {
+	metric = (remote_metric_t *)dictGetVal(entry);
+	if (metric->insts)
+	    dictRelease(metric->insts);
+	free(metric);
+    }
+    dictReleaseIterator(iterator);
+    dictRelease(source->metrics);
+    if (source->discover.context.labelset)
+	pmFreeLabelSets(source->discover.context.labelset, 1);
+    sdsfree(source->discover.context.hostname);
+    sdsfree(source->discover.context.name);
+    free(source);
+}
+
+/*
+ * Sources without requests for the expiry interval are released, along
+ * with their metric and instance maps - a returning source is simply
+ * rediscovered, with identifiers reassigned from the start.
+ */
+static void
+remote_expire_sources(void *arg)
+{
+    remote_source_t	*source;
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    time_t		now = time(NULL);
+
+    (void)arg;
+    if (remote_sources == NULL || remote_expire == 0)
+	return;
+    iterator = dictGetSafeIterator(remote_sources);
+    while ((entry = dictNext(iterator)) != NULL) {
+	source = (remote_source_t *)dictGetVal(entry);
+	if (now - source->updated < (time_t)remote_expire)
+	    continue;
+	if (pmDebugOptions.http)
+	    fprintf(stderr, "remote source %s expired\n",
+			    source->discover.context.name);
+	remote_source_free(source);
+	dictDelete(remote_sources, dictGetKey(entry));
+    }
+    dictReleaseIterator(iterator);
+    if (dictSize(remote_sources) < remote_max_sources)
+	remote_limited = 0;
+}
+
+static remote_source_t *
+remote_source_lookup(remote_request_t *request, const char *job,
+		const char *instance)
+{
+    remote_source_t	*source;
+    pmDiscoverEvent	event;
+    pmLabelSet		*set = NULL;
+    const char		*colon;
+    dictEntry		*entry;
+    sds			key, host, value;
+
+    /* context labels identify the source, mapping job and instance */
+    if ((colon = strchr(instance, ':')) != NULL)
+	host = sdsnewlen(instance, colon - instance);
+    else
+	host = sdsnew(instance);
+    key = sdsnew("{\"hostname\":");
+    value = unicode_encode(host, sdslen(host));
+    key = sdscatsds(key, value);
+    sdsfree(value);
+    key = sdscat(key, ",\"instance\":");
+    value = unicode_encode(instance, strlen(instance));
+    key = sdscatsds(key, value);
+    sdsfree(value);
+    key = sdscat(key, ",\"job\":");
+    value = unicode_encode(job, strlen(job));
+    key = sdscatsds(key, value);
+    sdsfree(value);
+    key = sdscatlen(key, "}", 1);
+
+    if ((entry = dictFind(remote_sources, key)) != NULL) {
+	source = (remote_source_t *)dictGetVal(entry);
+	sdsfree(host);
+	sdsfree(key);
+    } else if (dictSize(remote_sources) >= remote_max_sources) {
+	if (!remote_limited)
+	    remote_log(NULL, "source limit reached, dropping samples");
+	remote_limited = 1;
+	sdsfree(host);
+	sdsfree(key);
+	return NULL;
+    } else {
+	if (__pmParseLabelSet(key, sdslen(key), PM_LABEL_CONTEXT, &set) < 0 ||
+	    (source = calloc(1, sizeof(remote_source_t))) == NULL) {
+	    if (set)
+		pmFreeLabelSets(set, 1);
+	    sdsfree(host);
+	    sdsfree(key);
+	    return NULL;
+	}
+	source->metrics = dictCreate(&sdsKeyDictCallBacks, NULL);
+	source->discover.ctx = -1;	/* no PMAPI context */
+	source->discover.context.type = PM_CONTEXT_HOST;
+	source->discover.context.name = sdsnew(instance);
+	source->discover.context.hostname = host;
+	source->discover.context.labelset = set;
+	source->discover.module = &remote_discover.module;
+	dictAdd(remote_sources, key, source);
+	sdsfree(key);
+    }
+    source->updated = time(NULL);
+
+    /* (re)establish the load baton for this source if not yet done */
+    if (source->discover.baton == NULL) {
+	memset(&event, 0, sizeof(event));
+	event.module = &remote_discover.module;
+	event.context = source->discover.context;
+	event.data = &source->discover;
+	pmSeriesDiscoverSource(&event, request->arg);
+    }
+    return source;
+}
+
+static remote_metric_t *
+remote_metric_lookup(remote_request_t *request, remote_source_t *source,
+		const char *job, const char *name, int labelled)
+{
+    remote_metric_t	*metric;
+    pmDiscoverEvent	event;
+    pmDesc		desc;
+    char		*names[1];
+    sds			key;
+
+    key = remote_metric_name(sdsempty(), job, name);
+    if ((metric = (remote_metric_t *)dictFetchValue(source->metrics, key)) != NULL) {
+	sdsfree(key);
+	return metric;
+    }
+    if (source->nextid >= remote_max_metrics ||
+	(metric = calloc(1, sizeof(remote_metric_t))) == NULL) {
+	if (source->nextid >= remote_max_metrics && !source->limited)
+	    remote_log(source, "metric limit reached, dropping samples");
+	source->limited = 1;
+	sdsfree(key);
+	return NULL;
+    }
+    metric->pmid = pmID_build(REMOTE_DOMAIN,
+			source->nextid / 1024, source->nextid % 1024);
+    if (labelled) {
+	metric->indom = pmInDom_build(REMOTE_DOMAIN, source->nextid);
+	metric->insts = dictCreate(&sdsKeyDictCallBacks, NULL);
+    } else {
+	metric->indom = PM_INDOM_NULL;
+    }
+    source->nextid++;
+    dictAdd(source->metrics, key, metric);
+
+    memset(&desc, 0, sizeof(desc));
+    desc.pmid = metric->pmid;
+    desc.type = PM_TYPE_DOUBLE;
+    desc.indom = metric->indom;
+    desc.sem = remote_metric_semantics(name);
+    names[0] = key;
+
+    memset(&event, 0, sizeof(event));
+    event.module = &remote_discover.module;
+    event.context = source->discover.context;
+    event.data = &source->discover;
+    pmSeriesDiscoverMetric(&event, &desc, 1, names, request->arg);
+    sdsfree(key);
+    return metric;
+}
+
+static int
+remote_instance_lookup(remote_request_t *request, remote_source_t *source,
+		remote_metric_t *metric, Prometheus__Label **labels, size_t nlabels)
+{
+    pmDiscoverEvent	event;
+    pmInResult		in;
+    pmLabelSet		*set = NULL;
+    dictEntry		*entry;
+    char		*name;
+    sds			key, json;
+    int			inst;
+
+    key = remote_labels_key(sdsempty(), labels, nlabels);
+    if ((entry = dictFind(metric->insts, key)) != NULL) {
+	sdsfree(key);
+	return (int)((intptr_t)dictGetVal(entry) - 1);
+    }
+    if (metric->nextinst >= remote_max_instances) {
+	if (!source->limited)
+	    remote_log(source, "instance limit reached, dropping samples");
+	source->limited = 1;
+	sdsfree(key);
+	return PM_IN_NULL;
+    }
+    inst = metric->nextinst++;
+    dictAdd(metric->insts, key, (void *)(intptr_t)(inst + 1));
+
+    memset(&event, 0, sizeof(event));
+    event.module = &remote_discover.module;
+    event.context = source->discover.context;
+    event.data = &source->discover;
+
+    /* instance names follow pmdaopenmetrics - "<id> <label:value ...>" */
+    name = (char *)sdscatfmt(sdsempty(), "%i %S", inst, key);
+    memset(&in, 0, sizeof(in));
+    in.indom = metric->indom;
+    in.numinst = 1;
+    in.instlist = &inst;
+    in.namelist = &name;
+    pmSeriesDiscoverInDom(&event, &in, request->arg);
+    sdsfree(name);
+
+    json = remote_labels_json(sdsempty(), labels, nlabels);
+    if (__pmParseLabelSet(json, sdslen(json), PM_LABEL_INSTANCES, &set) >= 0) {
+	set->inst = inst;
+	pmSeriesDiscoverLabels(&event, metric->indom, PM_LABEL_INSTANCES,
+				set, 1, request->arg);
+	pmFreeLabelSets(set, 1);
+    }
+    sdsfree(json);
+    sdsfree(key);
+    return inst;
+}
+
+static int
+remote_add_sample(remote_request_t *request, remote_source_t *source,
+		remote_metric_t *metric, int inst, int64_t timestamp, double value)
+{
+    remote_sample_t	*sample;
+    size_t		bytes;
+
+    if (request->nsamples == request->maxsamples) {
+	request->maxsamples = request->maxsamples ? request->maxsamples * 2 : 256;
+	bytes = request->maxsamples * sizeof(remote_sample_t);
+	if ((sample = realloc(request->samples, bytes)) == NULL)
+	    return -ENOMEM;
+	request->samples = sample;
+    }
+    sample = &request->samples[request->nsamples++];
+    sample->source = source;
+    sample->timestamp = timestamp;
+    sample->pmid = metric->pmid;
+    sample->inst = inst;
+    sample->value = value;
+    return 0;
+}
+
+static int
+remote_decode_series(remote_request_t *request, Prometheus__TimeSeries *series)
+{
+    Prometheus__Sample	*sample;
+    remote_source_t	*source;
+    remote_metric_t	*metric;
+    const char		*name = NULL, *job = NULL, *instance = NULL;
+    unsigned int	i, labelled = 0;
+    uint64_t		bits;
+    int			sts, inst = PM_IN_NULL;
+
+    for (i = 0; i < series->n_labels; i++) {
+	if (strcmp(series->labels[i]->name, "__name__") == 0)
+	    name = series->labels[i]->value;
+	else if (strcmp(series->labels[i]->name, "job") == 0)
+	    job = series->labels[i]->value;
+	else if (strcmp(series->labels[i]->name, "instance") == 0)
+	    instance = series->labels[i]->value;
+	else
+	    labelled = 1;
+    }
+    if (name == NULL || *name == '\0')
+	return -EINVAL;
+    if (job == NULL)
+	job = "remote";
+    if (instance == NULL)
+	instance = job;
+
+    /* series beyond the configured limits are dropped (and logged) */
+    if ((source = remote_source_lookup(request, job, instance)) == NULL)
+	return 0;
+    if (source->discover.baton == NULL)
+	return -EAGAIN;
+    if ((metric = remote_metric_lookup(request, source, job,
+				name, labelled)) == NULL)
+	return 0;
+    /* label presence must remain consistent with the metric indom */
+    if ((metric->indom != PM_INDOM_NULL) != labelled)
+	return 0;
+    if (labelled &&
+	(inst = remote_instance_lookup(request, source, metric,
+				series->labels, series->n_labels)) == PM_IN_NULL)
+	return 0;
+
+    for (i = 0; i < series->n_samples; i++) {
+	sample = series->samples[i];
+	memcpy(&bits, &sample->value, sizeof(bits));
+	if (bits == REMOTE_STALE_NAN)	/* staleness marker, no value */
+	    continue;
+	if (sample->timestamp < 0)
+	    continue;
+	if ((sts = remote_add_sample(request, source, metric,
+				inst, sample->timestamp, sample->value)) < 0)
+	    return sts;
+    }
+    return 0;
+}
+
+static int
+remote_sample_compare(const void *a, const void *b)
+{
+    const remote_sample_t *sa = (const remote_sample_t *)a;
+    const remote_sample_t *sb = (const remote_sample_t *)b;
+
+    if (sa->source != sb->source)
+	return ((uintptr_t)sa->source < (uintptr_t)sb->source) ? -1 : 1;
+    if (sa->timestamp != sb->timestamp)
+	return (sa->timestamp < sb->timestamp) ? -1 : 1;
+    if (sa->pmid != sb->pmid)
+	return (sa->pmid < sb->pmid) ? -1 : 1;
+    if (sa->inst != sb->inst)
+	return (sa->inst < sb->inst) ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Build a result for samples [first, last) - all sharing one source
+ * and timestamp - and pass it through the series loading path.  The
+ * value blocks share a single allocation, freed after the (synchronous)
+ * result processing completes.
+ */
+static int
+remote_load_samples(remote_request_t *request, remote_sample_t *first,
+		remote_sample_t *last)
+{
+    remote_sample_t	*sample;
+    pmHighResResult	*result;
+    pmDiscoverEvent	event;
+    pmValueSet		*vsp;
+    pmValueBlock	*vbp;
+    unsigned int	numpmid = 0, numval, i;
+    char		*blocks;
+    size_t		size;
+
+    for (sample = first; sample < last; sample++)
+	if (sample == first || sample->pmid != sample[-1].pmid)
+	    numpmid++;
+
+    size = sizeof(pmHighResResult) + (numpmid - 1) * sizeof(pmValueSet *);
+    if ((result = calloc(1, size)) == NULL)
+	return -ENOMEM;
+    if ((blocks = calloc(last - first, 16)) == NULL) {
+	free(result);
+	return -ENOMEM;
+    }
+    result->timestamp.tv_sec = first->timestamp / 1000;
+    result->timestamp.tv_nsec = (first->timestamp % 1000) * 1000000;
+
+    for (sample = first; sample < last; sample += numval) {
+	for (numval = 1; sample + numval < last; numval++)
+	    if (sample[numval].pmid != sample->pmid)
+		break;
+	size = sizeof(pmValueSet) + (numval - 1) * sizeof(pmValue);
+	if ((vsp = calloc(1, size)) == NULL)
+	    break;
+	vsp->pmid = sample->pmid;
+	vsp->numval = numval;
+	vsp->valfmt = PM_VAL_DPTR;
+	for (i = 0; i < numval; i++) {
+	    vbp = (pmValueBlock *)(blocks + (sample + i - first) * 16);
+	    vbp->vtype = PM_TYPE_DOUBLE;
+	    vbp->vlen = PM_VAL_HDR_SIZE + sizeof(double);
+	    memcpy(vbp->vbuf, &sample[i].value, sizeof(double));
+	    vsp->vlist[i].inst = sample[i].inst;
+	    vsp->vlist[i].value.pval = vbp;
+	}
+	result->vset[result->numpmid++] = vsp;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.module = &remote_discover.module;
+    event.context = first->source->discover.context;
+    event.timestamp.tv_sec = result->timestamp.tv_sec;
+    event.timestamp.tv_nsec = result->timestamp.tv_nsec;
+    event.data = &first->source->discover;
+    if (result->numpmid == numpmid)
+	pmSeriesDiscoverValues(&event, result, request->arg);
+
+    for (i = 0; i < result->numpmid; i++)
+	free(result->vset[i]);
+    free(result);
+    free(blocks);
+    return 0;
+}
+
+static int
+remote_write_request(sds content, void *arg)
+{
+    Prometheus__WriteRequest	*message;
+    remote_request_t	request = {0};
+    remote_sample_t	*first, *sample, *last;
+    unsigned int	i;
+    int			sts = 0;
+
+    if ((message = prometheus__write_request__unpack(NULL, sdslen(content),
+				(const uint8_t *)content)) == NULL)
+	return -EINVAL;
+
+    request.arg = arg;
+    pmDiscoverSetSlots(&remote_discover.module, ((struct proxy *)arg)->slots);
+
+    for (i = 0; i < message->n_timeseries; i++)
+	if ((sts = remote_decode_series(&request, message->timeseries[i])) < 0)
+	    break;
+
+    if (sts >= 0 && request.nsamples) {
+	qsort(request.samples, request.nsamples, sizeof(remote_sample_t),
+		remote_sample_compare);
+	last = request.samples + request.nsamples;
+	for (first = request.samples; first < last; first = sample) {
+	    for (sample = first + 1; sample < last; sample++)
+		if (sample->source != first->source ||
+		    sample->timestamp != first->timestamp)
+		    break;
+	    if ((sts = remote_load_samples(&request, first, sample)) < 0)
+		break;
+	}
+    }
+    prometheus__write_request__free_unpacked(message, NULL);
+    free(request.samples);
+    return sts;
+}
+
+static sds
+remote_uncompress(sds content)
+{
+    size_t		length;
+    sds			buffer;
+
+    if (snappy_uncompressed_length(content, sdslen(content), &length) != SNAPPY_OK ||
+	length > REMOTE_MAX_BODY)
+	return NULL;
+    if ((buffer = sdsnewlen(NULL, length)) == NULL)
+	return NULL;
+    if (snappy_uncompress(content, sdslen(content), buffer, &length) != SNAPPY_OK) {
+	sdsfree(buffer);
+	return NULL;
+    }
+    sdssetlen(buffer, length);
+    buffer[length] = '\0';
+    return buffer;
+}
+
+static int
+pmremote_request_url(struct client *client, sds url, dict *parameters)
+{
+    pmRemoteBaton	*baton;
+
+    (void)parameters;
+    if (!remote_enabled || strcmp(url, "/api/v1/write") != 0)
+	return 0;
+
+    if ((baton = calloc(1, sizeof(*baton))) != NULL) {
+	client->u.http.data = baton;
+	baton->client = client;
+	baton->body = sdsempty();
+    } else {
+	client->u.http.parser.status_code = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+    }
+    return 1;
+}
+
+static int
+pmremote_request_headers(struct client *client, struct dict *headers)
+{
+    pmRemoteBaton	*baton = (pmRemoteBaton *)client->u.http.data;
+    dictIterator	*iterator;
+    dictEntry		*entry;
+    sds			value;
+
+    if (pmDebugOptions.http)
+	fprintf(stderr, "remote servlet headers (client=%p)\n", client);
+
+    iterator = dictGetSafeIterator(headers);
+    while ((entry = dictNext(iterator)) != NULL) {
+	if (strcasecmp((sds)dictGetKey(entry), "Content-Encoding") != 0)
+	    continue;
+	if ((value = (sds)dictGetVal(entry)) == NULL)
+	    continue;
+	if (strcasecmp(value, "snappy") == 0)
+	    baton->snappy = 1;
+	else if (strcasecmp(value, "identity") != 0)
+	    baton->unsupported = 1;
+    }
+    dictReleaseIterator(iterator);
+    return 0;
+}
+
+static int
+pmremote_request_body(struct client *client, const char *content, size_t length)
+{
+    pmRemoteBaton	*baton = (pmRemoteBaton *)client->u.http.data;
+
+    if (pmDebugOptions.http)
+	fprintf(stderr, "remote servlet body (client=%p)\n", client);
+
+    if (baton->toolarge || sdslen(baton->body) + length > REMOTE_MAX_BODY)
+	baton->toolarge = 1;
+    else
+	baton->body = sdscatlen(baton->body, content, length);
+    return 0;
+}
+
+static int
+pmremote_request_done(struct client *client)
+{
+    pmRemoteBaton	*baton = (pmRemoteBaton *)client->u.http.data;
+    struct proxy	*proxy = client->proxy;
+    sds			content = NULL;
+    int			sts;
+
+    client_get(client);
+
+    if (client->u.http.parser.status_code) {
+	http_error(client, client->u.http.parser.status_code, "request failed");
+    } else if (client->u.http.parser.method == HTTP_OPTIONS ||
+	client->u.http.parser.method == HTTP_TRACE ||
+	client->u.http.parser.method == HTTP_HEAD) {
+	http_reply(client, sdsempty(), HTTP_STATUS_OK, HTTP_FLAG_TEXT,
+			HTTP_OPTIONS_POST);
+    } else if (client->u.http.parser.method != HTTP_POST) {
+	http_error(client, HTTP_STATUS_METHOD_NOT_ALLOWED, "POST required");
+    } else if (baton->toolarge) {
+	http_error(client, HTTP_STATUS_PAYLOAD_TOO_LARGE, "request too large");
+    } else if (baton->unsupported) {
+	http_error(client, HTTP_STATUS_UNSUPPORTED_MEDIA_TYPE,
+			"unsupported content encoding");
+    } else if (proxy->slots == NULL || proxy->slots->state != SLOTS_READY) {
+	http_error(client, HTTP_STATUS_SERVICE_UNAVAILABLE,
+			"time series service not ready");
+    } else if (baton->snappy &&
+	(content = remote_uncompress(baton->body)) == NULL) {
+	http_error(client, HTTP_STATUS_BAD_REQUEST, "invalid snappy content");
+    } else if ((sts = remote_write_request(content ? content : baton->body,
+				proxy)) == -EAGAIN) {
+	http_error(client, HTTP_STATUS_SERVICE_UNAVAILABLE,
+			"time series source not ready");
+    } else if (sts < 0) {
+	http_error(client, HTTP_STATUS_BAD_REQUEST, "invalid write request");
+    } else {
+	http_reply(client, sdsempty(), HTTP_STATUS_NO_CONTENT, HTTP_FLAG_TEXT,
+			HTTP_OPTIONS_POST);
+    }
+    sdsfree(content);
+
+    client_put(client);
+    return 0;
+}
+
+static void
+pmremote_data_release(struct client *client)
+{
+    pmRemoteBaton	*baton = (pmRemoteBaton *)client->u.http.data;
+
+    if (pmDebugOptions.http)
+	fprintf(stderr, "remote servlet release (client=%p)\n", client);
+
+    if (baton) {
+	sdsfree(baton->body);
+	memset(baton, 0, sizeof(*baton));
+	free(baton);
+	client->u.http.data = NULL;
+    }
+}
+
+/*
+ * Exporter - discovered archive values are encoded as TimeSeries
+ * messages, batched, snappy-compressed and sent via HTTP POST.
+ */
+static uint64_t
+pointerHashCallBack(const void *key)
+{
+    return dictGenHashFunction(&key, sizeof(key));
+}
+
+static int
+pointerCmpCallBack(void *privdata, const void *a, const void *b)
+{
+    (void)privdata;
+    return a == b;
+}
+
+static uint64_t
+identHashCallBack(const void *key)
+{
+    return dictGenHashFunction(key, sizeof(unsigned int));
+}
+
+static int
+identCmpCallBack(void *privdata, const void *a, const void *b)
+{
+    (void)privdata;
+    return *(const unsigned int *)a == *(const unsigned int *)b;
+}
+
+static void *
+identDupCallBack(void *privdata, const void *key)
+{
+    unsigned int	*ident = malloc(sizeof(unsigned int));
+
+    (void)privdata;
+    if (ident)
+	*ident = *(const unsigned int *)key;
+    return ident;
+}
+
+static void
+identFreeCallBack(void *privdata, void *key)
+{
+    (void)privdata;
+    free(key);
+}
+
+static void
+metricFreeCallBack(void *privdata, void *value)
+{
+    exporter_metric_t	*metric = (exporter_metric_t *)value;
+
+    (void)privdata;
+    sdsfree(metric->name);
+    free(metric);
+}
+
+static void
+nameFreeCallBack(void *privdata, void *value)
+{
+    (void)privdata;
+    sdsfree(value);
+}
+
+static void
+indomFreeCallBack(void *privdata, void *value)
+{
+    (void)privdata;
+    dictRelease((dict *)value);
+}
+
+static void
+sourceFreeCallBack(void *privdata, void *value)
+{
+    exporter_source_t	*source = (exporter_source_t *)value;
+
+    (void)privdata;
+    dictRelease(source->metrics);
+    dictRelease(source->indoms);
+    free(source);
+}
+
+static dictType exporterSourceCallBacks = {
+    .hashFunction	= pointerHashCallBack,
+    .keyCompare		= pointerCmpCallBack,
+    .valDestructor	= sourceFreeCallBack,
+};
+
+static dictType exporterMetricCallBacks = {
+    .hashFunction	= identHashCallBack,
+    .keyCompare		= identCmpCallBack,
+    .keyDup		= identDupCallBack,
+    .keyDestructor	= identFreeCallBack,
+    .valDestructor	= metricFreeCallBack,
+};
+
+static dictType exporterInDomCallBacks = {
+    .hashFunction	= identHashCallBack,
+    .keyCompare		= identCmpCallBack,
+    .keyDup		= identDupCallBack,
+    .keyDestructor	= identFreeCallBack,
+    .valDestructor	= indomFreeCallBack,
+};
+
+static dictType exporterNameCallBacks = {
+    .hashFunction	= identHashCallBack,
+    .keyCompare		= identCmpCallBack,
+    .keyDup		= identDupCallBack,
+    .keyDestructor	= identFreeCallBack,
+    .valDestructor	= nameFreeCallBack,
+};
+
+static exporter_source_t *
+exporter_source(void *discover)
+{
+    exporter_source_t	*source;
+
+    if ((source = dictFetchValue(exporter->sources, discover)) != NULL)
+	return source;
+    if ((source = calloc(1, sizeof(exporter_source_t))) == NULL)
+	return NULL;
+    source->metrics = dictCreate(&exporterMetricCallBacks, NULL);
+    source->indoms = dictCreate(&exporterInDomCallBacks, NULL);
+    dictAdd(exporter->sources, discover, source);
+    return source;
+}
+
+static void
+exporter_log(pmLogLevel level, const char *message)
+{
+    sds			msg = sdscatfmt(sdsempty(), "remote-write exporter %s: %s",
+				exporter->host, message);
+
+    proxylog(level, msg, exporter->proxy);
+    sdsfree(msg);
+}
+
+static void
+exporter_clear(remote_exporter_t *ep)
+{
+    exporter_series_t	*sp;
+    unsigned int	i;
+
+    for (i = 0; i < ep->series; i++) {
+	sp = &ep->batch[i];
+	sdsfree(sp->name);
+	sdsfree(sp->hostname);
+	sdsfree(sp->instname);
+    }
+    ep->series = 0;
+}
+
+static void
+exporter_free(remote_exporter_t *ep)
+{
+    exporter_clear(ep);
+    dictRelease(ep->sources);
+    sdsfree(ep->host);
+    sdsfree(ep->path);
+    free(ep->batch);
+    sdsfree(ep->request);
+    sdsfree(ep->response);
+    sdsfree(ep->metric);
+    free(ep);
+}
+
+static void
+on_exporter_close(uv_handle_t *handle)
+{
+    remote_exporter_t	*ep = (remote_exporter_t *)handle->data;
+
+    sdsfree(ep->request);
+    ep->request = NULL;
+    ep->busy = 0;
+    if (ep->closed)
+	exporter_free(ep);
+}
+
+static void
+exporter_disconnect(remote_exporter_t *ep)
+{
+    if (!uv_is_closing((uv_handle_t *)&ep->socket))
+	uv_close((uv_handle_t *)&ep->socket, on_exporter_close);
+}
+
+static void
+on_exporter_alloc(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf)
+{
+    static char		buffer[256];
+
+    (void)handle;
+    (void)suggested_size;
+    buf->base = buffer;
+    buf->len = sizeof(buffer);
+}
+
+static void
+on_exporter_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf)
+{
+    remote_exporter_t	*ep = (remote_exporter_t *)stream->data;
+    char		*eol;
+    int			status = 0;
+
+    /* EAGAIN - nothing read yet, the response is still to come */
+    if (nread == 0)
+	return;
+
+    /* only the response status line is of interest */
+    if (nread > 0) {
+	if (sdslen(ep->response) < 128)
+	    ep->response = sdscatlen(ep->response, buf->base, nread);
+	if (strchr(ep->response, '\n') == NULL && sdslen(ep->response) < 128)
+	    return;
+    }
+
+    if ((eol = strpbrk(ep->response, "\r\n")) != NULL)
+	*eol = '\0';
+    if (strncmp(ep->response, "HTTP/", 5) == 0 &&
+	(eol = strchr(ep->response, ' ')) != NULL)
+	status = atoi(eol + 1);
+    if (status < 200 || status >= 300)
+	exporter_log(PMLOG_WARNING, *ep->response ?
+			ep->response : "no response status");
+    exporter_disconnect(ep);
+}
+
+static void
+on_exporter_write(uv_write_t *request, int status)
+{
+    remote_exporter_t	*ep = (remote_exporter_t *)request->data;
+
+    if (status < 0) {
+	exporter_log(PMLOG_WARNING, uv_strerror(status));
+	exporter_disconnect(ep);
+    } else {
+	uv_read_start((uv_stream_t *)&ep->socket, on_exporter_alloc,
+			on_exporter_read);
+    }
+}
+
+static void
+on_exporter_connect(uv_connect_t *request, int status)
+{
+    remote_exporter_t	*ep = (remote_exporter_t *)request->data;
+    uv_buf_t		buffer;
+
+    if (status < 0) {
+	exporter_log(PMLOG_WARNING, uv_strerror(status));
+	exporter_disconnect(ep);
+	return;
+    }
+    buffer = uv_buf_init(ep->request, sdslen(ep->request));
+    ep->writer.data = ep;
+    uv_write(&ep->writer, (uv_stream_t *)&ep->socket, &buffer, 1,
+		on_exporter_write);
+}
+
+/*
+ * Build a WriteRequest from the pending batch, referencing (not copying)
+ * the batch strings, then pack and snappy-compress it for sending.
+ */
+static sds
+exporter_encode(remote_exporter_t *ep)
+{
+    Prometheus__WriteRequest	message = PROMETHEUS__WRITE_REQUEST__INIT;
+    Prometheus__TimeSeries	**timeseries;
+    exporter_message_t	*messages, *mp;
+    exporter_series_t	*sp;
+    unsigned int	i, n;
+    size_t		length, bytes;
+    uint8_t		*packed = NULL;
+    sds			body = NULL;
+
+    timeseries = calloc(ep->series, sizeof(Prometheus__TimeSeries *));
+    messages = calloc(ep->series, sizeof(exporter_message_t));
+    if (timeseries == NULL || messages == NULL)
+	goto done;
+
+    for (i = 0; i < ep->series; i++) {
+	sp = &ep->batch[i];
+	mp = &messages[i];
+	/* labels, in name order - __name__, hostname, instname */
+	n = 0;
+	prometheus__label__init(&mp->label[n]);
+	mp->label[n].name = (char *)"__name__";
+	mp->label[n].value = sp->name;
+	mp->labels[n] = &mp->label[n];
+	n++;
+	if (sp->hostname) {
+	    prometheus__label__init(&mp->label[n]);
+	    mp->label[n].name = (char *)"hostname";
+	    mp->label[n].value = sp->hostname;
+	    mp->labels[n] = &mp->label[n];
+	    n++;
+	}
+	if (sp->instname) {
+	    prometheus__label__init(&mp->label[n]);
+	    mp->label[n].name = (char *)"instname";
+	    mp->label[n].value = sp->instname;
+	    mp->labels[n] = &mp->label[n];
+	    n++;
+	}
+	prometheus__sample__init(&mp->sample);
+	mp->sample.value = sp->value;
+	mp->sample.timestamp = sp->timestamp;
+	mp->samples[0] = &mp->sample;
+
+	prometheus__time_series__init(&mp->series);
+	mp->series.n_labels = n;
+	mp->series.labels = mp->labels;
+	mp->series.n_samples = 1;
+	mp->series.samples = mp->samples;
+	timeseries[i] = &mp->series;
+    }
+    message.n_timeseries = ep->series;
+    message.timeseries = timeseries;
+
+    length = prometheus__write_request__get_packed_size(&message);
+    if ((packed = malloc(length)) == NULL)
+	goto done;
+    prometheus__write_request__pack(&message, packed);
+
+    bytes = snappy_max_compressed_length(length);
+    if ((body = sdsnewlen(NULL, bytes)) == NULL)
+	goto done;
+    if (snappy_compress((const char *)packed, length, body, &bytes) != SNAPPY_OK) {
+	sdsfree(body);
+	body = NULL;
+	goto done;
+    }
+    sdssetlen(body, bytes);
+
+done:
+    free(packed);
+    free(messages);
+    free(timeseries);
+    return body;
+}
+
+static void
+exporter_flush(remote_exporter_t *ep)
+{
+    sds			body;
+
+    if (ep->busy || ep->series == 0)
+	return;
+
+    body = exporter_encode(ep);
+    exporter_clear(ep);
+    if (body == NULL) {
+	exporter_log(PMLOG_WARNING, "request encoding failed");
+	return;
+    }
+
+    ep->request = sdscatfmt(sdsempty(),
+		"POST %S HTTP/1.1\r\n"
+		"Host: %S:%u\r\n"
+		"Content-Type: application/x-protobuf\r\n"
+		"Content-Encoding: snappy\r\n"
+		"X-Prometheus-Remote-Write-Version: 0.1.0\r\n"
+		"User-Agent: pmproxy/" PCP_VERSION "\r\n"
+		"Content-Length: %u\r\n"
+		"Connection: close\r\n\r\n",
+		ep->path, ep->host, ep->port, (unsigned int)sdslen(body));
+    ep->request = sdscatsds(ep->request, body);
+    sdsfree(body);
+    sdsclear(ep->response);
+
+    ep->busy = 1;
+    ep->started = time(NULL);
+    uv_tcp_init(ep->events, &ep->socket);
+    ep->socket.data = ep;
+    ep->connect.data = ep;
+    if (uv_tcp_connect(&ep->connect, &ep->socket,
+			(struct sockaddr *)&ep->address, on_exporter_connect) < 0)
+	exporter_disconnect(ep);
+}
+
+static void
+exporter_worker(void *arg)
+{
+    remote_exporter_t	*ep = (remote_exporter_t *)arg;
+
+    if (ep->busy && time(NULL) - ep->started > REMOTE_TIMEOUT) {
+	exporter_log(PMLOG_WARNING, "request timed out");
+	exporter_disconnect(ep);
+    }
+    exporter_flush(ep);
+}
+
+static void
+exporter_on_metric(pmDiscoverEvent *event,
+		pmDesc *desc, int numnames, char **names, void *arg)
+{
+    exporter_source_t	*source;
+    exporter_metric_t	*metric;
+
+    (void)arg;
+    if (exporter == NULL || numnames < 1 ||
+	desc->type < PM_TYPE_32 || desc->type > PM_TYPE_DOUBLE)
+	return;
+    if ((source = exporter_source(event->data)) == NULL)
+	return;
+    if ((metric = dictFetchValue(source->metrics, &desc->pmid)) != NULL) {
+	metric->type = desc->type;
+	metric->indom = desc->indom;
+	return;
+    }
+    if ((metric = calloc(1, sizeof(exporter_metric_t))) == NULL)
+	return;
+    exporter->metric = sdscpy(exporter->metric, names[0]);
+    metric->name = open_metrics_name(NULL, exporter->metric, 0);
+    metric->type = desc->type;
+    metric->indom = desc->indom;
+    dictAdd(source->metrics, &desc->pmid, metric);
+}
+
+static void
+exporter_on_indom(pmDiscoverEvent *event, pmInResult *in, void *arg)
+{
+    exporter_source_t	*source;
+    dictEntry		*entry;
+    dict		*names;
+    int			i;
+
+    (void)arg;
+    if (exporter == NULL || (source = exporter_source(event->data)) == NULL)
+	return;
+    if ((names = dictFetchValue(source->indoms, &in->indom)) == NULL) {
+	names = dictCreate(&exporterNameCallBacks, NULL);
+	dictAdd(source->indoms, &in->indom, names);
+    }
+    for (i = 0; i < in->numinst; i++) {
+	if ((entry = dictFind(names, &in->instlist[i])) != NULL)
+	    dictDelete(names, &in->instlist[i]);
+	dictAdd(names, &in->instlist[i], sdsnew(in->namelist[i]));
+    }
+}
+
+static void
+exporter_append(remote_exporter_t *ep, exporter_metric_t *metric,
+		sds hostname, sds instname, double value, int64_t timestamp)
+{
+    exporter_series_t	*sp;
+    unsigned int	size;
+
+    if (ep->series == ep->maxseries) {
+	size = ep->maxseries ? ep->maxseries * 2 : ep->batchsize;
+	if ((sp = realloc(ep->batch, size * sizeof(exporter_series_t))) == NULL)
+	    return;
+	ep->batch = sp;
+	ep->maxseries = size;
+    }
+    sp = &ep->batch[ep->series++];
+    sp->name = sdsdup(metric->name);
+    sp->hostname = hostname ? sdsdup(hostname) : NULL;
+    sp->instname = instname ? sdsdup(instname) : NULL;
+    sp->value = value;
+    sp->timestamp = timestamp;
+}
+
+static void
+exporter_on_values(pmDiscoverEvent *event, pmHighResResult *result, void *arg)
+{
+    remote_exporter_t	*ep = exporter;
+    exporter_source_t	*source;
+    exporter_metric_t	*metric;
+    pmAtomValue		atom;
+    pmValueSet		*vsp;
+    dict		*names;
+    sds			instname;
+    int64_t		timestamp;
+    int			i, j;
+
+    (void)arg;
+    if (ep == NULL || (source = dictFetchValue(ep->sources, event->data)) == NULL)
+	return;
+
+    /* bound memory use while an upstream request remains outstanding */
+    if (ep->busy && ep->series >= ep->batchsize * REMOTE_MAX_PENDING) {
+	if (!ep->dropped)
+	    exporter_log(PMLOG_WARNING, "upstream too slow, dropping samples");
+	ep->dropped = 1;
+	exporter_clear(ep);
+    }
+
+    timestamp = (int64_t)result->timestamp.tv_sec * 1000 +
+		result->timestamp.tv_nsec / 1000000;
+    for (i = 0; i < result->numpmid; i++) {
+	vsp = result->vset[i];
+	if (vsp->numval <= 0)
+	    continue;
+	if ((metric = dictFetchValue(source->metrics, &vsp->pmid)) == NULL)
+	    continue;
+	names = NULL;
+	if (metric->indom != PM_INDOM_NULL)
+	    names = dictFetchValue(source->indoms, &metric->indom);
+	for (j = 0; j < vsp->numval; j++) {
+	    if (pmExtractValue(vsp->valfmt, &vsp->vlist[j], metric->type,
+				&atom, PM_TYPE_DOUBLE) < 0)
+		continue;
+	    instname = names ? dictFetchValue(names, &vsp->vlist[j].inst) : NULL;
+	    exporter_append(ep, metric, event->context.hostname,
+			instname, atom.d, timestamp);
+	}
+    }
+
+    if (ep->series >= ep->batchsize)
+	exporter_flush(ep);
+}
+
+static void
+exporter_on_closed(pmDiscoverEvent *event, void *arg)
+{
+    (void)arg;
+    if (exporter)
+	dictDelete(exporter->sources, event->data);
+}
+
+static pmDiscoverCallBacks exporter_callbacks = {
+    .on_metric		= exporter_on_metric,
+    .on_values		= exporter_on_values,
+    .on_indom		= exporter_on_indom,
+    .on_closed		= exporter_on_closed,
+};
+
+pmDiscoverCallBacks *
+remote_write_exporter(void)
+{
+    return exporter ? &exporter_callbacks : NULL;
+}
+
+/*
+ * Parse an exporter URL of the form http://host[:port][/path] and
+ * resolve the upstream address once, during servlet setup.
+ */
+static int
+exporter_setup(struct proxy *proxy, const char *url, const char *batchsize)
+{
+    remote_exporter_t	*ep;
+    struct addrinfo	hints, *res = NULL;
+    const char		*host, *port, *path;
+    char		service[16];
+    sds			msg;
+    int			sts;
+
+    if (strncmp(url, "http://", 7) != 0) {
+	infofmt(msg, "unsupported remote-write exporter URL: %s", url);
+	proxylog(PMLOG_ERROR, msg, proxy);
+	sdsfree(msg);
+	return -EINVAL;
+    }
+    if ((ep = calloc(1, sizeof(remote_exporter_t))) == NULL)
+	return -ENOMEM;
+
+    host = url + 7;
+    if ((path = strchr(host, '/')) == NULL)
+	path = host + strlen(host);
+    if ((port = memchr(host, ':', path - host)) != NULL) {
+	ep->host = sdsnewlen(host, port - host);
+	ep->port = atoi(port + 1);
+    } else {
+	ep->host = sdsnewlen(host, path - host);
+	ep->port = 80;
+    }
+    ep->path = sdsnew(*path ? path : "/");
+    ep->batchsize = batchsize ? atoi(batchsize) : 0;
+    if (ep->batchsize == 0)
+	ep->batchsize = 2000;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    pmsprintf(service, sizeof(service), "%u", ep->port);
+    if ((sts = getaddrinfo(ep->host, service, &hints, &res)) != 0 || res == NULL) {
+	infofmt(msg, "cannot resolve remote-write exporter host %s: %s",
+			ep->host, gai_strerror(sts));
+	proxylog(PMLOG_ERROR, msg, proxy);
+	sdsfree(msg);
+	sdsfree(ep->host);
+	sdsfree(ep->path);
+	free(ep);
+	return -EHOSTUNREACH;
+    }
+    memcpy(&ep->address, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+
+    ep->proxy = proxy;
+    ep->events = proxy->events;
+    ep->response = sdsempty();
+    ep->metric = sdsempty();
+    ep->sources = dictCreate(&exporterSourceCallBacks, NULL);
+    ep->timer = pmWebTimerRegister(exporter_worker, ep);
+    exporter = ep;
+    return 0;
+}
+
+static void
+exporter_close(void)
+{
+    remote_exporter_t	*ep = exporter;
+
+    if (ep == NULL)
+	return;
+    exporter = NULL;
+    if (ep->timer >= 0)
+	pmWebTimerRelease(ep->timer);
+    if (ep->busy) {	/* released from on_exporter_close */
+	ep->closed = 1;
+	exporter_disconnect(ep);
+    } else {
+	exporter_free(ep);
+    }
+}
+
+static void
+pmremote_servlet_setup(struct proxy *proxy)
+{
+    const char		*option, *batchsize;
+
+    remote_proxy = proxy;
+    remote_sources = dictCreate(&sdsKeyDictCallBacks, NULL);
+
+    pmDiscoverSetEventLoop(&remote_discover.module, proxy->events);
+    pmDiscoverSetConfiguration(&remote_discover.module, proxy->config);
+
+    if ((option = pmIniFileLookup(proxy->config, "remote", "enabled")))
+	remote_enabled = (strcmp(option, "true") == 0);
+    if ((option = pmIniFileLookup(proxy->config, "remote", "max.sources")))
+	remote_max_sources = strtoul(option, NULL, 0);
+    if ((option = pmIniFileLookup(proxy->config, "remote", "max.metrics")))
+	remote_max_metrics = strtoul(option, NULL, 0);
+    if ((option = pmIniFileLookup(proxy->config, "remote", "max.instances")))
+	remote_max_instances = strtoul(option, NULL, 0);
+    if ((option = pmIniFileLookup(proxy->config, "remote", "source.expire")))
+	remote_expire = strtoul(option, NULL, 0);
+    /* item and indom identifiers are assigned per metric in a source */
+    if (remote_max_metrics > (1 << 22))
+	remote_max_metrics = (1 << 22);
+    if (remote_enabled && remote_expire)
+	remote_timer = pmWebTimerRegister(remote_expire_sources, NULL);
+    if ((option = pmIniFileLookup(proxy->config, "remote", "exporter.url"))) {
+	remote_url = sdsnew(option);
+	batchsize = pmIniFileLookup(proxy->config, "remote", "exporter.batchsize");
+	exporter_setup(proxy, remote_url, batchsize);
+    }
+}
+
+static void
+pmremote_servlet_close(struct proxy *proxy)
+{
+    dictIterator	*iterator;
+    dictEntry		*entry;
+
+    (void)proxy;
+    if (remote_timer >= 0)
+	pmWebTimerRelease(remote_timer);
+    remote_timer = -1;
+
+    iterator = dictGetIterator(remote_sources);
+    while ((entry = dictNext(iterator)) != NULL)
+	remote_source_free((remote_source_t *)dictGetVal(entry));
+    dictReleaseIterator(iterator);
+    dictRelease(remote_sources);
+    remote_sources = NULL;
+
+    exporter_close();
+    sdsfree(remote_url);
+    remote_url = NULL;
+
+    /* module state only - no discovery handle was registered */
+    free(remote_discover.module.privdata);
+    remote_discover.module.privdata = NULL;
+}
+
+struct servlet pmremote_servlet = {
+    .name		= "remote",
+    .setup 		= pmremote_servlet_setup,
+    .close 		= pmremote_servlet_close,
+    .on_url		= pmremote_request_url,
+    .on_headers		= pmremote_request_headers,
+    .on_body		= pmremote_request_body,
+    .on_done		= pmremote_request_done,
+    .on_release		= pmremote_data_release,
+};
@@ -30,6 +30,7 @@ static struct {
 	{ .group = "series" },		/* METRICS_SERIES */
 	{ .group = "webgroup" },	/* METRICS_WEBGROUP */
 	{ .group = "search" },          /* METRICS_SEARCH */
+	{ .group = "sources" },		/* METRICS_SOURCES */
 };
 
 void
@@ -67,13 +68,34 @@ proxylog(pmLogLevel level, sds message, void *arg)
     pmNotifyErr(priority, "%s%s", state, message);
 }
 
+/*
+ * Path to the MMV file for a metrics group.  Registries for groups
+ * whose instance domains change over time are created (and recreated)
+ * by the libraries themselves, given this path.
+ */
+const char *
+proxymetrics_path(enum proxy_registry prid)
+{
+    char		path[MAXPATHLEN];
+    int			sep = pmPathSeparator();
+
+    if (prid >= NUM_REGISTRY || prid <= METRICS_NOTUSED)
+	return NULL;
+
+    if (server_metrics[prid].path == NULL) {
+	pmsprintf(path, sizeof(path), "%s%cpmproxy%c%s",
+		pmGetConfig("PCP_TMP_DIR"), sep, sep, server_metrics[prid].group);
+	server_metrics[prid].path = strdup(path);
+    }
+    return server_metrics[prid].path;
+}
+
 mmv_registry_t *
 proxymetrics(struct proxy *proxy, enum proxy_registry prid)
 {
     mmv_stats_flags_t	flags = MMV_FLAG_PROCESS;
     mmv_registry_t	*registry;
-    char		*file, path[MAXPATHLEN];
-    int			sep = pmPathSeparator();
+    const char		*file;
 
     if (prid >= NUM_REGISTRY || prid <= METRICS_NOTUSED)
 	return NULL;
@@ -81,17 +103,12 @@ proxymetrics(struct proxy *proxy, enum proxy_registry prid)
     if (proxy->metrics[prid] != NULL)	/* already setup */
 	return proxy->metrics[prid];
 
-    pmsprintf(path, sizeof(path), "%s%cpmproxy%c%s",
-	    pmGetConfig("PCP_TMP_DIR"), sep, sep, server_metrics[prid].group);
-    if ((file = strdup(path)) == NULL)
+    if ((file = proxymetrics_path(prid)) == NULL)
 	return NULL;
 
     if (prid == METRICS_SERVER)
 	flags |= MMV_FLAG_NOPREFIX;
-    if ((registry = mmv_stats_registry(file, prid, flags)) != NULL)
-	server_metrics[prid].path = file;
-    else
-	free(file);
+    registry = mmv_stats_registry(file, prid, flags);
     proxy->metrics[prid] = registry;
     return registry;
 }
@@ -40,6 +40,7 @@ typedef enum proxy_registry {
     METRICS_SERIES,
     METRICS_WEBGROUP,
     METRICS_SEARCH,
+    METRICS_SOURCES,
     NUM_REGISTRY
 } proxy_registry_t;
 
@@ -164,6 +165,7 @@ typedef struct proxy {
 } proxy_t;
 
 extern void proxylog(pmLogLevel, sds, void *);
+extern const char *proxymetrics_path(enum proxy_registry);
 extern mmv_registry_t *proxymetrics(struct proxy *, enum proxy_registry);
 extern void proxymetrics_close(struct proxy *, enum proxy_registry);
 
@@ -223,6 +225,12 @@ extern void close_redis_module(struct proxy *);
 extern void setup_http_module(struct proxy *);
 extern void close_http_module(struct proxy *);
 
+#ifdef HAVE_REMOTE_WRITE
+extern pmDiscoverCallBacks *remote_write_exporter(void);
+#else
+#define remote_write_exporter()	NULL
+#endif
+
 extern void setup_pcp_module(struct proxy *);
 extern void close_pcp_module(struct proxy *);
 
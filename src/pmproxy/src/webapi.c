@@ -53,6 +53,7 @@ typedef struct pmWebGroupBaton {
     unsigned int	numinsts;
     unsigned int	numindoms;
     sds			name;		/* metric currently being processed */
+    sds			omname;		/* name in Open Metrics form */
     pmID		pmid;		/* metric currently being processed */
     pmInDom		indom;		/* indom currently being processed */
 } pmWebGroupBaton;
@@ -133,6 +134,7 @@ pmwebapi_data_release(struct client *client)
 			baton, client);
 
     sdsfree(baton->name);
+    sdsfree(baton->omname);
     sdsfree(baton->suffix);
     sdsfree(baton->context);
     sdsfree(baton->clientid);
@@ -482,15 +484,19 @@ on_pmwebapi_scrape(sds context, pmWebScrape *scrape, void *arg)
     pmWebValue		*value = &scrape->value;
     long long		milliseconds;
     char		pmidstr[20], indomstr[20];
-    sds			name = NULL, semantics = NULL, labels = NULL;
+    sds			name, labels = NULL;
     sds			s, result;
 
     pmwebapi_set_context(baton, context);
     if (open_metrics_type_check(metric->type) < 0)
 	return 0;
 
+    /*
+     * Stream directly into the client buffer - metric names are only
+     * converted once per metric and labels arrive pre-rendered, so in
+     * the steady state no memory is allocated for each value written.
+     */
     result = http_get_buffer(baton->client);
-    name = open_metrics_name(metric->name, baton->compat);
 
     if (baton->name == NULL)
 	baton->name = sdsempty();
@@ -499,8 +505,11 @@ on_pmwebapi_scrape(sds context, pmWebScrape *scrape, void *arg)
     if (metric->pmid != baton->pmid || sdscmp(metric->name, s) != 0) {
 	sdsclear(s);	/* new metric */
 	baton->name = sdscpylen(s, metric->name, sdslen(metric->name));
+	baton->omname = open_metrics_name(baton->omname, metric->name, baton->compat);
 	baton->pmid = metric->pmid;
+	name = baton->omname;
     } else {    
+	name = baton->omname;
 	goto value;	/* metric header already done */
     }
 
@@ -517,33 +526,33 @@ on_pmwebapi_scrape(sds context, pmWebScrape *scrape, void *arg)
 
     if (metric->oneline)
 	result = sdscatfmt(result, "# HELP %S %S\n", name, metric->oneline);
-    semantics = open_metrics_semantics(metric->sem);
-    result = sdscatfmt(result, "# TYPE %S %S\n", name, semantics);
+    result = sdscatfmt(result, "# TYPE %S %s\n", name,
+			open_metrics_semantics(metric->sem));
 
 value:
     if (metric->indom != PM_INDOM_NULL)
 	labels = instance->labels;
     if (labels == NULL)
 	labels = metric->labels;
-    if (labels)
-	result = sdscatfmt(result, "%S{%S}", name, labels);
-    else /* no labels */
-	result = sdscatsds(result, name);
+    result = sdscatlen(result, name, sdslen(name));
+    if (labels) {
+	result = sdscatlen(result, "{", 1);
+	result = sdscatlen(result, labels, sdslen(labels));
+	result = sdscatlen(result, "}", 1);
+    }
 
     /* append the value */
-    result = sdscatfmt(result, " %S", value->value);
+    result = sdscatlen(result, " ", 1);
+    result = sdscatlen(result, value->value, sdslen(value->value));
 
     if (baton->times) {
 	/* append the timestamp string */
 	milliseconds = (scrape->seconds * 1000) + (scrape->nanoseconds / 1000);
 	result = sdscatfmt(result, " %I\n", milliseconds);
     } else {
-	result = sdscatfmt(result, "\n");
+	result = sdscatlen(result, "\n", 1);
     }
 
-    sdsfree(semantics);
-    sdsfree(name);
-
     http_set_buffer(baton->client, result, HTTP_FLAG_TEXT);
     http_transfer(baton->client);
     return 0;
@@ -566,11 +575,9 @@ on_pmwebapi_scrape_labels(sds context, pmWebLabelSet *labelset, void *arg)
 	fprintf(stderr, "%s: client=%p (ctx=%s)\n",
 		"on_pmwebapi_scrape_labels", client, context);
     }
-    if (baton->labels == NULL)
+    if (baton->labels == NULL)	/* scratch space, reused for each call */
 	baton->labels = dictCreate(&sdsOwnDictCallBacks, NULL);
-    open_metrics_labels(labelset, baton->labels);
-    dictRelease(baton->labels);	/* reset for next caller */
-    baton->labels = NULL;
+    open_metrics_cache_labels(labelset, baton->labels);
 }
 
 static int
@@ -1015,6 +1022,8 @@ pmwebapi_servlet_setup(struct proxy *proxy)
     pmWebGroupSetEventLoop(&pmwebapi_settings.module, proxy->events);
     pmWebGroupSetConfiguration(&pmwebapi_settings.module, proxy->config);
     pmWebGroupSetMetricRegistry(&pmwebapi_settings.module, metric_registry);
+
+    open_metrics_setup(proxy->config);
 }
 
 static void
@@ -1022,6 +1031,7 @@ pmwebapi_servlet_close(struct proxy *proxy)
 {
     pmWebGroupClose(&pmwebapi_settings.module);
     proxymetrics_close(proxy, METRICS_WEBGROUP);
+    open_metrics_close();
 
     sdsfree(PARAM_NAMES);
     sdsfree(PARAM_NAME);
@@ -1,6 +1,6 @@
 """ Wrapper module for LIBPCP - the core Performace Co-Pilot API
 #
-# Copyright (C) 2012-2022 Red Hat
+# Copyright (C) 2012-2022,2026 Red Hat
 # Copyright (C) 2009-2012 Michael T. Werner
 #
 # This file is part of the "pcp" module, the python interfaces for the
@@ -2169,6 +2169,30 @@ class pmContext(object):
             raise pmErr(status)
         return result_p
 
+    def pmFetchBulk(self, pmidA, descs, samples=1):
+        """PMAPI - Fetch samples and extract all values in a single call
+
+        (timestamps, numvals, insts, values) =
+                pmFetchBulk(c_uint pmid[], (pmDesc* pmdesc)[], samples)
+
+        Each of up to 'samples' results (successive records from an
+        archive, or one result from a live host each) is fetched and
+        every value converted to double, into contiguous buffers that
+        memoryview.cast() or numpy.frombuffer() use without copying:
+          timestamps: 'd', seconds, one per sample
+          numvals:    'i', values for each metric in each sample
+                      (negative for an error code)
+          insts:      'i', instance identifier of each value
+          values:     'd', each value (NaN if not numeric)
+        Fewer samples may be returned at the end of an archive; pmErr
+        is raised only if no sample could be fetched.
+        """
+        types = [desc.contents.type for desc in descs]
+        result = c_api.pmFetchBulk(self.ctx, list(pmidA), types, samples)
+        if result[0] < 0 and not result[1]:
+            raise pmErr(result[0])
+        return result[1:]
+
     def pmHighResFetch(self, pmidA):
         """PMAPI - Fetch pmHighResResult from the target source (deprecated)
 
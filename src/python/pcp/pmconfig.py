@@ -21,11 +21,12 @@
 """ PCP Python Utils Config Routines """
 
 from copy import deepcopy
-from collections import OrderedDict
+from collections import OrderedDict, deque
 try:
     import configparser as ConfigParser
 except ImportError:
     import ConfigParser
+import multiprocessing
 import signal
 import time
 import math
@@ -41,6 +42,23 @@ TRUNC = "xxx"
 VERSION = 1
 CURR_INSTS = False
 
+# Samples per archive worker chunk (at least), chunks per worker (at most)
+WORKER_CHUNK = 32
+WORKER_CHUNKS = 4
+
+# pmConfig instance of an archive worker process
+_WORKER = None
+
+def _worker_init(config):
+    """ Archive worker process initialization """
+    global _WORKER # pylint: disable=global-statement
+    _WORKER = config
+    _WORKER.worker_connect()
+
+def _worker_fetch(chunk):
+    """ Archive worker process chunk fetch """
+    return _WORKER.worker_fetch(chunk)
+
 class pmConfig(object):
     """ Config reader and validator """
     def __init__(self, util):
@@ -81,6 +99,20 @@ class pmConfig(object):
         # Update PCP labels on instance changes
         self._prev_insts = []
 
+        # Fetchgroup item parameters, to recreate items in workers
+        self._pmfg_items = OrderedDict()
+
+        # Archive worker processes and their samples not yet reported
+        self._workers = None
+        self._worker_pool = None
+        self._worker_parent = None
+        self._worker_origin = 0
+        self._worker_step = 0
+        self._worker_queue = deque()
+        self._worker_error = 0
+        self._worker_ts = None
+        self._worker_values = None
+
     def set_signal_handler(self):
         """ Set default signal handler """
         def handler(_signum, _frame):
@@ -719,6 +751,11 @@ class pmConfig(object):
                 self.util.precision_force = int(self.util.precision_force)
                 if self.util.precision_force < 0:
                     raise ValueError(err)
+            if hasattr(self.util, 'workers') and self.util.workers:
+                attr = 'workers'
+                self.util.workers = int(self.util.workers)
+                if self.util.workers < 0:
+                    raise ValueError(err)
             if hasattr(self.util, 'repeat_header') and self.util.repeat_header:
                 attr = 'repeat_header'
                 if self.util.repeat_header != "auto":
@@ -1022,6 +1059,8 @@ class pmConfig(object):
                 items = []
                 max_insts = max(1, max_insts)
                 scale = self.util.metrics[metric][2][0]
+                self._pmfg_items[metric] = (mtype, scale, max_insts,
+                                            curr_insts and self.util.metrics[metric][1])
                 if curr_insts and self.util.metrics[metric][1]:
                     mitems = 0
                     vanished = []
@@ -1124,6 +1163,7 @@ class pmConfig(object):
         self.texts = []
         self.labels = []
         self.res_labels = OrderedDict()
+        self._pmfg_items = OrderedDict()
         self.util.pmfg.clear()
         self.util.pmfg_ts = None
 
@@ -1142,9 +1182,15 @@ class pmConfig(object):
 
     def fetch(self):
         """ Sample using fetchgroup and handle special cases """
+        if self._workers is None:
+            self._workers = self.start_workers()
         try:
-            state = self.util.pmfg.fetch()
+            if self._workers:
+                state = self.fetch_from_workers()
+            else:
+                state = self.util.pmfg.fetch()
         except pmapi.pmErr as error:
+            self.stop_workers()
             if error.args[0] == pmapi.c_api.PM_ERR_EOL:
                 return -1
             if error.args[0] == pmapi.c_api.PM_ERR_TOOSMALL:
@@ -1170,6 +1216,148 @@ class pmConfig(object):
         # Successfully completed sampling
         return 0
 
+    def start_workers(self):
+        """ Start archive worker processes when requested and possible """
+        # Archive replay at full speed only, the archive time range is
+        # then split in chunks fetched by workers and reported in order
+        if not hasattr(self.util, 'workers') or not self.util.workers or \
+           self.util.workers < 2 or \
+           self.util.context.type != pmapi.c_api.PM_CONTEXT_ARCHIVE or \
+           (hasattr(self.util, 'delay') and self.util.delay) or \
+           self.names_change_action() == 2:
+            return False
+        origin = self.util.opts.pmGetOptionHighResOrigin()
+        finish = self.util.opts.pmGetOptionHighResFinish()
+        if origin is None or finish is None:
+            return False
+        if not hasattr(multiprocessing, 'get_context') or \
+           'fork' not in multiprocessing.get_all_start_methods():
+            return False
+
+        self._worker_origin = origin.tv_sec * 1000000000 + origin.tv_nsec
+        self._worker_step = self.util.interval.tv_sec * 1000000000 + \
+                            self.util.interval.tv_usec * 1000
+        finish = finish.tv_sec * 1000000000 + finish.tv_nsec
+        if self.util.interpol:
+            # Interpolated samples are known beforehand, split by count
+            samples = (finish - self._worker_origin) // self._worker_step + 1
+            if self.util.samples and self.util.samples > 0:
+                samples = min(samples, self.util.samples)
+            if samples < 2 * WORKER_CHUNK:
+                return False
+            size = -(-samples // (self.util.workers * WORKER_CHUNKS))
+            size = max(size, WORKER_CHUNK)
+            chunks = [(first, min(first + size, samples)) for first in range(0, samples, size)]
+        else:
+            # Records are split by time, up to the whole second past
+            # the end time as fetch() checks the end in seconds
+            finish += 1000000000
+            size = -(-(finish - self._worker_origin) // (self.util.workers * WORKER_CHUNKS))
+            size = max(size, 1000000000)
+            chunks = [(first, min(first + size, finish))
+                      for first in range(self._worker_origin, finish, size)]
+        if len(chunks) < 2:
+            return False
+
+        # Workers are forked with metrics already resolved, see worker_connect()
+        context = multiprocessing.get_context('fork')
+        workers = min(self.util.workers, len(chunks))
+        self._worker_pool = context.Pool(workers, _worker_init, (self,))
+        self.util.pmfg_ts = lambda: self._worker_ts
+        return self._worker_pool.imap(_worker_fetch, chunks)
+
+    def stop_workers(self):
+        """ Stop archive worker processes """
+        if self._worker_pool:
+            self._worker_pool.terminate()
+            self._worker_pool = None
+
+    def fetch_from_workers(self):
+        """ Get the next archive sample fetched by workers, in order """
+        while not self._worker_queue:
+            if self._worker_error:
+                raise pmapi.pmErr(self._worker_error)
+            try:
+                samples, self._worker_error = next(self._workers)
+            except StopIteration:
+                self.stop_workers()
+                raise pmapi.pmErr(pmapi.c_api.PM_ERR_EOL)
+            self._worker_queue.extend(samples)
+        self._worker_ts, self._worker_values = self._worker_queue.popleft()
+        return 0
+
+    def worker_connect(self):
+        """ Connect an archive worker process, reusing resolved metadata """
+        # The parent handles signals and owns its context and files
+        signal.signal(signal.SIGINT, signal.SIG_IGN)
+        for sig in "SIGHUP", "SIGTERM":
+            try:
+                signal.signal(getattr(signal, sig), signal.SIG_DFL)
+            except Exception:
+                pass
+        self._worker_pool = None
+        self._worker_parent = self.util.pmfg
+        self.util.pmfg = pmapi.fetchgroup(self.util.context.type, self.util.source)
+        self.util.pmfg_ts = self.util.pmfg.extend_timestamp()
+        self.util.context = self.util.pmfg.get_context()
+
+        for i, metric in enumerate(self.util.metrics):
+            mtype, scale, max_insts, curr_insts = self._pmfg_items[metric]
+            if curr_insts:
+                items = []
+                for j in range(0, len(self.insts[i][1])):
+                    try:
+                        item = self.util.pmfg.extend_item(metric, mtype, scale, self.insts[i][1][j])
+                        items.append((self.insts[i][0][j], self.insts[i][1][j], item))
+                    except pmapi.pmErr:
+                        pass
+                self.util.metrics[metric][5] = self.pmfg_items_to_indom(items)
+            else:
+                self.util.metrics[metric][5] = \
+                    self.util.pmfg.extend_indom(metric, mtype, scale, max_insts)
+
+    def worker_fetch(self, chunk):
+        """ Fetch a chunk of archive samples in a worker process """
+        def timespec(nsec):
+            """ Nanoseconds to timespec """
+            return pmapi.timespec(nsec // 1000000000, nsec % 1000000000)
+
+        # Rate conversion needs the values a single process would have
+        # fetched previously, the first chunk starts without as it would
+        first, last = chunk
+        samples = []
+        warmup = 0
+        if self.util.interpol:
+            if first:
+                warmup = 1
+            origin = self._worker_origin + (first - warmup) * self._worker_step
+            self.util.context.pmSetModeHighRes(pmapi.c_api.PM_MODE_INTERP, timespec(origin),
+                                               timespec(self._worker_step))
+        else:
+            if first > self._worker_origin:
+                self.util.context.pmSetModeHighRes(pmapi.c_api.PM_MODE_BACK, timespec(first - 1), None)
+                try:
+                    self.util.pmfg.fetch()
+                except pmapi.pmErr as error:
+                    if error.args[0] != pmapi.c_api.PM_ERR_EOL:
+                        return samples, error.args[0]
+            self.util.context.pmSetModeHighRes(pmapi.c_api.PM_MODE_FORW, timespec(first), None)
+
+        n = 0
+        while not self.util.interpol or n < warmup + last - first:
+            try:
+                self.util.pmfg.fetch()
+            except pmapi.pmErr as error:
+                return samples, error.args[0]
+            if not self.util.interpol:
+                ts = self.util.pmfg_ts.value
+                if ts.tv_sec * 1000000000 + ts.tv_usec * 1000 >= last:
+                    break
+            if n >= warmup:
+                samples.append((self.util.pmfg_ts(), self.get_values()))
+            n += 1
+        return samples, 0
+
     def pause(self):
         """ Pause before next sampling """
         self._round += 1
@@ -1232,16 +1420,16 @@ class pmConfig(object):
         """ Deprecated, use get_ranked_results() instead """
         return self.get_ranked_results(valid_only)
 
-    def get_ranked_results(self, valid_only=False):
-        """ Get filtered and ranked results """
-        results = OrderedDict()
+    def get_values(self):
+        """ Get limit filtered values of the latest fetch """
+        values = OrderedDict()
         if hasattr(self.util, 'predicate') and self.util.predicate:
             predicates = self.util.predicate.split(",")
         else:
             predicates = ()
         early_live_filter = self.do_live_filtering() and not self.do_invert_filtering()
-        for i, metric in enumerate(self.util.metrics):
-            results[metric] = []
+        for metric in self.util.metrics:
+            values[metric] = []
             try:
                 for inst, name, val in self.util.metrics[metric][5]():
                     try:
@@ -1259,12 +1447,25 @@ class pmConfig(object):
                                     continue
                                 elif limit < 0 and value > abs(limit):
                                     continue
-                        results[metric].append((inst, name, value))
+                        values[metric].append((inst, name, value))
                     except Exception:
                         pass
             except Exception:
                 pass
+        return values
 
+    def get_ranked_results(self, valid_only=False):
+        """ Get filtered and ranked results """
+        if self._workers:
+            results = OrderedDict((metric, list(self._worker_values[metric]))
+                                  for metric in self._worker_values)
+        else:
+            results = self.get_values()
+        if hasattr(self.util, 'predicate') and self.util.predicate:
+            predicates = self.util.predicate.split(",")
+        else:
+            predicates = ()
+        for i, metric in enumerate(list(results)):
             if valid_only and not results[metric]:
                 del results[metric]
 
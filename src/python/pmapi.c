@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2012-2022 Red Hat.
+ * Copyright (C) 2012-2022,2026 Red Hat.
  * Copyright (C) 2009-2012 Michael T. Werner
  *
  * This file is part of the "pcp" module, the python interfaces for the
@@ -1007,6 +1007,129 @@ pmnsTraverse(PyObject *self, PyObject *args, PyObject *keywords)
     return Py_BuildValue("i", sts);
 }
 
+/*
+ * Fetch one or more samples of a list of metrics and extract all of
+ * the values in one call, rather than through ctypes for each value.
+ * Values are returned in contiguous buffers (bytearrays) usable as-is
+ * by memoryview.cast() or numpy.frombuffer():
+ *   timestamps - double, seconds, one per sample
+ *   numvals    - int32, one per metric in each sample, the number of
+ *                values or a negative error code
+ *   insts      - int32, instance identifier, one per value
+ *   values     - double, one per value, NaN if not numeric
+ * Fewer samples than requested are returned after an error (such as
+ * the end of an archive), along with that error code.
+ */
+static PyObject *
+fetchBulk(PyObject *self, PyObject *args, PyObject *keywords)
+{
+    PyObject *pmidlist, *typelist, *pmidseq = NULL, *typeseq = NULL;
+    PyObject *stamps = NULL, *numvals = NULL, *insts = NULL, *values = NULL;
+    pmHighResResult **results = NULL;
+    pmValueSet *vsp;
+    pmAtomValue atom;
+    pmID *pmids = NULL;
+    double *dp, *vp;
+    int *types = NULL, *np, *ip;
+    int context, samples = 1, npmids, nresults = 0, count = 0;
+    int i, j, k, sts;
+    char *keyword_list[] = {"context", "pmids", "types", "samples", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywords,
+		"iOO|i:pmFetchBulk", keyword_list,
+		&context, &pmidlist, &typelist, &samples))
+	return NULL;
+    if ((pmidseq = PySequence_Fast(pmidlist, "pmids must be a sequence")) == NULL)
+	return NULL;
+    if ((typeseq = PySequence_Fast(typelist, "types must be a sequence")) == NULL)
+	goto fail;
+    npmids = (int)PySequence_Fast_GET_SIZE(pmidseq);
+    if (npmids == 0 || PySequence_Fast_GET_SIZE(typeseq) != npmids) {
+	PyErr_SetString(PyExc_ValueError,
+			"pmFetchBulk needs one type for each of the pmids");
+	goto fail;
+    }
+    if (samples < 1)
+	samples = 1;
+
+    pmids = (pmID *)malloc(npmids * sizeof(pmID));
+    types = (int *)malloc(npmids * sizeof(int));
+    results = (pmHighResResult **)malloc(samples * sizeof(pmHighResResult *));
+    if (pmids == NULL || types == NULL || results == NULL) {
+	PyErr_NoMemory();
+	goto fail;
+    }
+    for (i = 0; i < npmids; i++) {
+	pmids[i] = (pmID)PyLong_AsUnsignedLong(PySequence_Fast_GET_ITEM(pmidseq, i));
+	types[i] = (int)PyLong_AsLong(PySequence_Fast_GET_ITEM(typeseq, i));
+    }
+    if (PyErr_Occurred())
+	goto fail;
+
+    Py_BEGIN_ALLOW_THREADS
+    if ((sts = pmUseContext(context)) >= 0) {
+	for (nresults = 0; nresults < samples; nresults++) {
+	    if ((sts = pmFetchHighRes(npmids, pmids, &results[nresults])) < 0)
+		break;
+	    for (i = 0; i < npmids; i++)
+		if ((vsp = results[nresults]->vset[i])->numval > 0)
+		    count += vsp->numval;
+	}
+    }
+    Py_END_ALLOW_THREADS
+
+    stamps = PyByteArray_FromStringAndSize(NULL, nresults * sizeof(double));
+    numvals = PyByteArray_FromStringAndSize(NULL, nresults * npmids * sizeof(int));
+    insts = PyByteArray_FromStringAndSize(NULL, count * sizeof(int));
+    values = PyByteArray_FromStringAndSize(NULL, count * sizeof(double));
+    if (stamps == NULL || numvals == NULL || insts == NULL || values == NULL)
+	goto fail;
+
+    dp = (double *)PyByteArray_AS_STRING(stamps);
+    np = (int *)PyByteArray_AS_STRING(numvals);
+    ip = (int *)PyByteArray_AS_STRING(insts);
+    vp = (double *)PyByteArray_AS_STRING(values);
+    for (i = 0; i < nresults; i++) {
+	*dp++ = pmtimespecToReal(&results[i]->timestamp);
+	for (j = 0; j < npmids; j++) {
+	    vsp = results[i]->vset[j];
+	    *np++ = vsp->numval;
+	    for (k = 0; k < vsp->numval; k++) {
+		*ip++ = vsp->vlist[k].inst;
+		if (types[j] < PM_TYPE_32 || types[j] > PM_TYPE_DOUBLE ||
+		    pmExtractValue(vsp->valfmt, &vsp->vlist[k], types[j],
+				   &atom, PM_TYPE_DOUBLE) < 0)
+		    atom.d = Py_NAN;
+		*vp++ = atom.d;
+	    }
+	}
+    }
+
+    for (i = 0; i < nresults; i++)
+	pmFreeHighResResult(results[i]);
+    free(results);
+    free(types);
+    free(pmids);
+    Py_DECREF(typeseq);
+    Py_DECREF(pmidseq);
+    return Py_BuildValue("(iNNNN)", sts < 0 ? sts : 0,
+			 stamps, numvals, insts, values);
+
+fail:
+    for (i = 0; i < nresults; i++)
+	pmFreeHighResResult(results[i]);
+    Py_XDECREF(values);
+    Py_XDECREF(insts);
+    Py_XDECREF(numvals);
+    Py_XDECREF(stamps);
+    free(results);
+    free(types);
+    free(pmids);
+    Py_XDECREF(typeseq);
+    Py_XDECREF(pmidseq);
+    return NULL;
+}
+
 static PyObject *
 usageMessage(PyObject *self, PyObject *args)
 {
@@ -1535,6 +1658,9 @@ static PyMethodDef methods[] = {
     { .ml_name = "pmnsTraverse",
 	.ml_meth = (PyCFunction) pmnsTraverse,
         .ml_flags = METH_VARARGS | METH_KEYWORDS },
+    { .ml_name = "pmFetchBulk",
+	.ml_meth = (PyCFunction) fetchBulk,
+        .ml_flags = METH_VARARGS | METH_KEYWORDS },
     { .ml_name = "pmUnits_int",
 	.ml_meth = (PyCFunction) pmUnits_int,
         .ml_flags = METH_VARARGS | METH_KEYWORDS },